@@ -2,11 +2,23 @@
 // Check thingProperties.h to find out which ones.
 #define MINIMAL_THINGS_CONFIG
 
+// Publishes all status bits as one packed integer property and applies
+// deadbands and rate limits to the temperatures. Takes precedence over MINIMAL_THINGS_CONFIG.
+// #define PACKED_STATUS_CONFIG
+
 // Defines if an external light sensor is attached and should be used
 // This is useful to check e.g. if the light is on in the room containing the cold store
 #define USE_EXTERNAL_LIGHT_SENSOR
 #define LIGHT_SENSOR_PIN A3
 
+// Times the phases of the main loop. Send 'p' over the serial port to print a report.
+// To include the Modbus transactions, pass -DLOOP_PROFILER as a build flag instead.
+// #define LOOP_PROFILER
+
+// Runs the board from its battery: the poll interval is stretched as the battery
+// drains and the board sleeps in between. The cloud watchdog is disabled, as it
+// would reset the board while it sleeps.
+// #define BATTERY_POWERED
 
 // Enable debugging
 // #define DEBUG
@@ -20,10 +32,17 @@
 #include <Arduino.h>
 #include "thingProperties.h"
 #include "PegoController.h"
+#include "LoopProfiler.h"
+#if defined(PACKED_STATUS_CONFIG)
+  #include "SnapshotPublisher.h"
+#endif
 #if defined(USE_EXTERNAL_LIGHT_SENSOR)
   #include "lightSensor.h"
 #endif
 #include "battery.h"
+#if defined(BATTERY_POWERED)
+  #include "PowerManager.h"
+#endif
 
 // Defines the serial port to be used for debugging
 #define SerialPort Serial //Serial1 for debugging on the hardware serial pins
@@ -40,6 +59,27 @@
 
 PegoController controller = PegoController(RS485_BAUDRATE);
 
+// Restarts the Modbus client if the RS485 bus gets wedged, e.g. after a brown-out
+BusSupervisor busSupervisor = BusSupervisor(RS485_BAUDRATE);
+
+#if defined(PACKED_STATUS_CONFIG)
+SnapshotPublisher publisher;
+#endif
+
+#if defined(BATTERY_POWERED)
+PowerManager powerManager = PowerManager(REGISTER_UPDATE_INTERVAL);
+#endif
+
+// Whether any alarm was active at the last poll
+bool alarmActive = false;
+
+// Samples the light sensor and battery level in the background
+AuxiliarySampler auxiliarySampler;
+int8_t batteryChannel;
+#if defined(USE_EXTERNAL_LIGHT_SENSOR)
+int8_t lightChannel;
+#endif
+
 /**
  * @brief Blinks an LED at a given interval
  * @param interval The interval in milliseconds
@@ -60,7 +100,7 @@ void setupCloud(){
   SerialPort.println("Connecting to Arduino IoT cloud...");
 
   // Connect to Arduino IoT Cloud
-  #if defined(USE_GSM_CONNECTION)
+  #if defined(USE_GSM_CONNECTION) || defined(BATTERY_POWERED)
     ArduinoCloud.begin(ArduinoIoTPreferredConnection, false /* disable watch dog (unreliable) */);
   #else
     ArduinoCloud.begin(ArduinoIoTPreferredConnection, true /* enable watch dog */);
@@ -83,6 +123,7 @@ void setupCloud(){
  * If the setup failed the built-in LED should blinks at a 500ms rate
  */
 void setupController(){
+  controller.setBusSupervisor(&busSupervisor);
   if(!controller.begin()){
     SerialPort.println("Failed to start Modbus RTU Client!");    
     while (true){ blinkLED(500); }
@@ -94,12 +135,45 @@ void setup() {
   SerialPort.begin(SERIAL_BAUDRATE);
   delay(5000);
 
+  analogReadResolution(10);
+  batteryChannel = addBatteryChannel(auxiliarySampler);
+  #if defined(USE_EXTERNAL_LIGHT_SENSOR)
+    lightChannel = addLightSensorChannel(auxiliarySampler, LIGHT_SENSOR_PIN);
+  #endif
+
   SerialPort.println("Starting the Modbus RTU client...");    
   setupController();
 
   setupCloud();
 }
 
+#if defined(PACKED_STATUS_CONFIG)
+/**
+ * @brief Reads all values in one snapshot and only updates the cloud variables
+ * the publisher considers worth sending.
+ */
+void readValuesFromController(){
+  ControllerSnapshot snapshot;
+  controller.readSnapshot(snapshot);
+  auxiliarySampler.fill(snapshot);
+  uint8_t publish;
+  {
+    PROFILE_PHASE(LOOP_PHASE_DECODE);
+    publish = publisher.update(snapshot);
+  }
+
+  if(publish & PUBLISH_AMBIENT_TEMPERATURE) ambientTemperature = publisher.ambientTemperature();
+  if(publish & PUBLISH_EVAPORATOR_TEMPERATURE) evaporatorTemperature = publisher.evaporatorTemperature();
+  if(publish & PUBLISH_STATUS) packedStatus = publisher.packedStatus();
+  alarmActive = (snapshot.valid & SNAPSHOT_STATUS_VALID) && snapshot.alarmStatus != 0;
+
+  if(!snapshot.responsive){
+    SerialPort.println("Couldn't reach the controller. Power outage?");
+  }
+  SerialPort.print("Packed Status: ");
+  SerialPort.println(publisher.packedStatus(), HEX);
+}
+#else
 /**
  * @brief Reads the register values from the Pego controller and saves the values
  * into the cloud variables.
@@ -133,6 +207,7 @@ void readValuesFromController(){
     SerialPort.print("Temperature alarm: ");
     SerialPort.println(temperatureAlarmStatus ? "ON\n" : "OFF\n");
   }
+  alarmActive = openDoorAlarmStatus || temperatureAlarmStatus;
   
   #if !defined(MINIMAL_THINGS_CONFIG)  
     
@@ -206,24 +281,61 @@ void readValuesFromController(){
     SerialPort.println(ambientProbeFaultStatus ? "ON\n" : "OFF\n");  
   #endif
 }
+#endif
 
 void loop() {
+  PROFILE_PHASE(LOOP_PHASE_LOOP);
+
   // Indicate that the Modbus client & IoTCloud connection was started successfully
   digitalWrite(LED_BUILTIN, ArduinoCloud.connected() ? HIGH : LOW);  
   
-  static auto lastCheck= millis();
+  #if defined(BATTERY_POWERED)
+    bool pollDue = powerManager.pollDue();
+  #else
+    static auto lastCheck= millis();
+    bool pollDue = millis() - lastCheck >= REGISTER_UPDATE_INTERVAL;
+  #endif
 
-  if (millis() - lastCheck >= REGISTER_UPDATE_INTERVAL) {
-    lastCheck = millis();
+  if (pollDue) {
+    #if defined(BATTERY_POWERED)
+      powerManager.startPoll();
+    #else
+      lastCheck = millis();
+    #endif
     readValuesFromController();
+    #if defined(BATTERY_POWERED)
+      uint8_t level = auxiliarySampler.level(batteryChannel);
+      if(level != AUXILIARY_LEVEL_UNKNOWN) powerManager.setBatteryLevel(level);
+      powerManager.setAlarmActive(alarmActive);
+    #endif
+    PROFILE_PHASE(LOOP_PHASE_LOG);
     #if defined(USE_EXTERNAL_LIGHT_SENSOR)
-      ambientLightStatus = getAmbientLightStatus(LIGHT_SENSOR_PIN);
+      ambientLightStatus = auxiliarySampler.state(lightChannel);
       SerialPort.print("Ambient Light Status: ");
       SerialPort.println(ambientLightStatus ? "ON" : "OFF");
     #endif
     SerialPort.print("Battery Level: ");
-    SerialPort.println(batteryLevel());
+    SerialPort.println(auxiliarySampler.level(batteryChannel));
     SerialPort.println();
   }
-  ArduinoCloud.update();
+  {
+    PROFILE_PHASE(LOOP_PHASE_SENSOR);
+    auxiliarySampler.update();
+  }
+  busSupervisor.update();
+  {
+    PROFILE_PHASE(LOOP_PHASE_PUBLISH);
+    ArduinoCloud.update();
+  }
+
+  #if defined(LOOP_PROFILER)
+    if(SerialPort.available() && SerialPort.read() == 'p'){
+      PROFILE_REPORT(SerialPort);
+      PROFILE_RESET();
+    }
+  #endif
+
+  #if defined(BATTERY_POWERED)
+    powerManager.sleepUntilNextPoll();
+  #endif
 }
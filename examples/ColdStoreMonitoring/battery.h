@@ -1,3 +1,5 @@
+#include "AuxiliarySampler.h"
+
 // Use voltmeter to determine battery voltage when fully charged
 float batteryLevel(float battery_voltage = 4.3){    
     analogReadResolution(10); // 10bit resolution
@@ -27,4 +29,15 @@ float batteryLevel(float battery_voltage = 4.3){
 
 bool batteryConnected(){
     return batteryLevel() > 5;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Registers the battery with an auxiliary sampler so that its level is
+ * oversampled in the background. Expects a 10bit ADC resolution.
+ * The channel state tells whether a battery is connected (level > 5%).
+ * @param sampler The sampler to add the channel to.
+ * @return The channel index to be used with the sampler.
+ */
+int8_t addBatteryChannel(AuxiliarySampler &sampler){
+    return sampler.addChannel(ADC_BATTERY, AR_INTERNAL1V0, 1023, 6, 6);
+}
@@ -1,4 +1,5 @@
 #include <Arduino.h>
+#include "AuxiliarySampler.h"
 
 #ifndef SerialPort
 #define SerialPort Serial
@@ -26,4 +27,22 @@ bool getAmbientLightStatus(uint8_t sensorPin, uint8_t threshold = 20) {
         SerialPort.println(lightLevel); // print the light value in Serial Monitor
     #endif
     return lightLevel >= threshold;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Registers the light sensor with an auxiliary sampler so that it is
+ * oversampled in the background instead of being read on demand.
+ * The light is considered on at the threshold and off again 5 points below it.
+ * @param sampler The sampler to add the channel to.
+ * @param sensorPin The pin on which the light sensor is connected.
+ * @param threshold The threshold for the light to be cosidered on.
+ * @return The channel index to be used with the sampler.
+ */
+int8_t addLightSensorChannel(AuxiliarySampler &sampler, uint8_t sensorPin, uint8_t threshold = 20) {
+    uint8_t offThreshold = threshold > 5 ? threshold - 5 : 0;
+    #if defined(ARDUINO_ARCH_SAMD)
+        return sampler.addChannel(sensorPin, AR_INTERNAL2V23, SENSOR_MAX_VALUE, threshold, offThreshold);
+    #else
+        return sampler.addChannel(sensorPin, AUXILIARY_SAMPLER_DEFAULT_REFERENCE, SENSOR_MAX_VALUE, threshold, offThreshold);
+    #endif
+}
@@ -2,7 +2,11 @@
 #include <Arduino_ConnectionHandler.h>
 #include "arduino_secrets.h"
 
-#if !defined(MINIMAL_THINGS_CONFIG)
+#if defined(PACKED_STATUS_CONFIG)
+// All status bits and the responsiveness in one property. See SnapshotPublisher.h for the layout.
+CloudTemperature evaporatorTemperature;
+int packedStatus;
+#elif !defined(MINIMAL_THINGS_CONFIG)
 CloudTemperature evaporatorTemperature;
 bool ambientProbeFaultStatus;
 bool coldRoomLightRelayStatus;
@@ -21,9 +25,11 @@ bool manInRoomAlarmStatus;
 bool standByStatus;
 #endif
 
+#if !defined(PACKED_STATUS_CONFIG)
 bool deviceResponsive;
 bool openDoorAlarmStatus;
 bool temperatureAlarmStatus;
+#endif
 CloudTemperature ambientTemperature;
 
 #if defined(USE_EXTERNAL_LIGHT_SENSOR)
@@ -32,7 +38,11 @@ bool ambientLightStatus;
 
 void initProperties(){
 
-  #if !defined(MINIMAL_THINGS_CONFIG)  
+  #if defined(PACKED_STATUS_CONFIG)
+  // Deadbands and rate limits are applied by the SnapshotPublisher
+  ArduinoCloud.addProperty(evaporatorTemperature, READ, ON_CHANGE, NULL);
+  ArduinoCloud.addProperty(packedStatus, READ, ON_CHANGE, NULL);
+  #elif !defined(MINIMAL_THINGS_CONFIG)
   ArduinoCloud.addProperty(evaporatorTemperature, READ, ON_CHANGE, NULL, 1);
   ArduinoCloud.addProperty(ambientProbeFaultStatus, READ, ON_CHANGE, NULL);
   ArduinoCloud.addProperty(coldRoomLightRelayStatus, READ, ON_CHANGE, NULL);
@@ -51,10 +61,14 @@ void initProperties(){
   ArduinoCloud.addProperty(standByStatus, READ, ON_CHANGE, NULL);
   #endif
 
+  #if defined(PACKED_STATUS_CONFIG)
+  ArduinoCloud.addProperty(ambientTemperature, READ, ON_CHANGE, NULL);
+  #else
   ArduinoCloud.addProperty(deviceResponsive, READ, ON_CHANGE, NULL);
   ArduinoCloud.addProperty(openDoorAlarmStatus, READ, ON_CHANGE, NULL);
   ArduinoCloud.addProperty(temperatureAlarmStatus, READ, ON_CHANGE, NULL);
   ArduinoCloud.addProperty(ambientTemperature, READ, ON_CHANGE, NULL, 1);  
+  #endif
 
   #if defined(USE_EXTERNAL_LIGHT_SENSOR)  
   ArduinoCloud.addProperty(ambientLightStatus, READ, ON_CHANGE, NULL);
@@ -0,0 +1,471 @@
+/*
+Counts the Modbus transactions, bytes on the wire and modelled wall time
+of every public PegoController API and of complete polling cycles.
+The numbers are compared against a checked-in baseline so that changes
+which increase the bus traffic don't go unnoticed.
+
+Usage: Benchmark [--baud <rate>] [--turnaround <µs>] [--baseline <file>] [--update-baseline]
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "PegoController.h"
+#include "FleetBroadcast.h"
+#include "ParameterBackup.h"
+#include "MockModbusClient.h"
+
+#define DEFAULT_BASELINE_FILE "baseline.txt"
+#define DEFAULT_TURNAROUND 5000 // µs
+#define MAX_BASELINE_ENTRIES 256
+
+struct BenchmarkCase {
+    const char *name;
+    // The model the controller is configured for before running the case
+    PegoModel model;
+    void (*run)(PegoController &controller);
+};
+
+struct BenchmarkResult {
+    char name[64];
+    unsigned long transactions;
+    unsigned long bytes;
+};
+
+#define READ_CASE(method) {#method, PEGO_MODEL_ECP_202, [](PegoController &controller){ controller.method(); }}
+#define WRITE_CASE(method, value) {#method, PEGO_MODEL_ECP_202, [](PegoController &controller){ controller.method(value); }}
+
+// The per-value cycle of the ColdStoreMonitoring example (readValuesFromController)
+static void pollGetters(PegoController &controller){
+    if(!controller.responsive()) return;
+    controller.getAmbientTemperature();
+    controller.getOpenDoorAlarmStatus();
+    controller.getTemperatureAlarmStatus();
+    controller.getEvaporatorTemperature();
+    controller.getHotResistanceStatus();
+    controller.getStandByStatus();
+    controller.getDrippingStatus();
+    controller.getColdRoomLightRelayStatus();
+    controller.getFansRelayStatus();
+    controller.getDefrostRelayStatus();
+    controller.getCompressorRelayStatus();
+    controller.getCompressorProtectionStatus();
+    controller.getDoorSwitchStatus();
+    controller.getLightAlarmStatus();
+    controller.getCompressorProtectionAlarmStatus();
+    controller.getManInRoomAlarmStatus();
+    controller.getEEPROMErrorStatus();
+    controller.getEvaporatorProbeFaultStatus();
+    controller.getAmbientProbeFaultStatus();
+}
+
+// The snapshot cycle of the ColdStoreMonitoring example
+static void pollSnapshot(PegoController &controller){
+    ControllerSnapshot snapshot;
+    controller.readSnapshot(snapshot);
+}
+
+// Both cycles with several consumers sharing the results within a coalescing window
+static void pollGettersCoalesced(PegoController &controller){
+    controller.setReadCoalescingWindow(1000);
+    pollGetters(controller);
+}
+
+static void pollSnapshotAndGettersCoalesced(PegoController &controller){
+    controller.setReadCoalescingWindow(1000);
+    pollSnapshot(controller);
+    pollGetters(controller);
+}
+
+// Forcing a defrost changes the relays, so the status has to be read again despite the window
+static void forceDefrostCoalesced(PegoController &controller){
+    controller.setReadCoalescingWindow(1000);
+    controller.getDefrostRelayStatus();
+    controller.setDefrostForcingStatus(true);
+    controller.getDefrostRelayStatus();
+}
+
+// An ECP base whose model isn't known: the missing registers are only requested once
+static void readUnsupportedRegisterRepeatedly(PegoController &controller){
+    MockBus.addUnsupportedRange(PARAMETER_BLOCK_EXPERT_FIRST, PARAMETER_BLOCK_EXPERT_COUNT);
+    for(uint8_t i = 0; i < 3; ++i){
+        controller.getTemperatureSettingForAuxRelay();
+    }
+}
+
+static void readPartiallyUnsupportedBlockRepeatedly(PegoController &controller){
+    MockBus.addUnsupportedRange(PARAMETER_BLOCK_EXPERT_FIRST, PARAMETER_BLOCK_EXPERT_COUNT);
+    RegisterDescription block = {HOLDING_REGISTERS, PARAMETER_BLOCK_EXPERT_FIRST - 4, false, 1};
+    int16_t values[8];
+    for(uint8_t i = 0; i < 3; ++i){
+        controller.readModbusRegisters(block, 8, values);
+    }
+}
+
+// An ECP base whose model isn't known yet lacks 17 registers in two blocks,
+// all of them stay remembered while both blocks are read repeatedly
+static void readMissingBlocksRepeatedly(PegoController &controller){
+    MockBus.addUnsupportedRange(PARAMETER_BLOCK_EXPERT_FIRST, PARAMETER_BLOCK_EXPERT_COUNT);
+    MockBus.addUnsupportedRange(PARAMETER_BLOCK_CONFIGURATION_FIRST, PARAMETER_BLOCK_CONFIGURATION_COUNT);
+    RegisterDescription expertBlock = {HOLDING_REGISTERS, PARAMETER_BLOCK_EXPERT_FIRST, false, 1};
+    RegisterDescription configurationBlock = {HOLDING_REGISTERS, PARAMETER_BLOCK_CONFIGURATION_FIRST, false, 1};
+    int16_t values[PARAMETER_BLOCK_EXPERT_COUNT];
+    for(uint8_t i = 0; i < 3; ++i){
+        controller.readModbusRegisters(expertBlock, PARAMETER_BLOCK_EXPERT_COUNT, values);
+        controller.readModbusRegisters(configurationBlock, PARAMETER_BLOCK_CONFIGURATION_COUNT, values);
+        controller.getTemperatureSettingForAuxRelay();
+    }
+}
+
+#define FLEET_SIZE 30
+
+// Puts a fleet of controllers into stand-by, one acknowledged write per controller
+static void standByUnicast(PegoController &){
+    for(uint8_t id = 1; id <= FLEET_SIZE; ++id){
+        PegoController controller(RS485_DEFAULT_BAUD_RATE, id);
+        controller.setModel(PEGO_MODEL_ECP_202);
+        controller.setDeviceStandByStatus(true);
+    }
+}
+
+static void standByBroadcast(PegoController &, bool verify){
+    static PegoController *fleet[FLEET_SIZE];
+    FleetBroadcast broadcast;
+    for(uint8_t id = 1; id <= FLEET_SIZE; ++id){
+        if(fleet[id - 1] == NULL) fleet[id - 1] = new PegoController(RS485_DEFAULT_BAUD_RATE, id);
+        broadcast.add(*fleet[id - 1]);
+    }
+    broadcast.broadcastStandBy(true, verify);
+    delay(FLEET_BROADCAST_SETTLE_TIME);
+    while(broadcast.verifying()) broadcast.update();
+}
+
+static void readParameters(PegoController &controller){
+    ControllerParameters parameters;
+    controller.readParameters(parameters);
+}
+
+// Flash for the parameter backup, kept in RAM
+class RamFlashMemory : public FlashMemory {
+private:
+    uint8_t _memory[4][256];
+public:
+    RamFlashMemory(){ memset(_memory, 0xFF, sizeof(_memory)); }
+    size_t sectorSize() const override { return sizeof(_memory[0]); }
+    uint16_t sectorCount() const override { return 4; }
+    bool read(uint32_t address, void *data, size_t size) override {
+        memcpy(data, &_memory[0][0] + address, size);
+        return true;
+    }
+    bool write(uint32_t address, const void *data, size_t size) override {
+        const uint8_t *source = (const uint8_t *)data;
+        // Programming only clears bits
+        for(size_t i = 0; i < size; ++i) (&_memory[0][0])[address + i] &= source[i];
+        return true;
+    }
+    bool erase(uint16_t sector) override {
+        memset(_memory[sector], 0xFF, sizeof(_memory[sector]));
+        return true;
+    }
+};
+
+// A controller whose EEPROM lost three parameters gets its backup pushed back
+static void restoreParameters(PegoController &controller){
+    ControllerParameters image;
+    image.valid = PARAMETERS_BASE_VALID | PARAMETERS_EXPERT_VALID | PARAMETERS_CONFIGURATION_VALID;
+    for(uint8_t i = 0; i < PARAMETER_BLOCK_BASE_COUNT; ++i) image.base[i] = MockBus.getRegister(PARAMETER_BLOCK_BASE_FIRST + i);
+    for(uint8_t i = 0; i < PARAMETER_BLOCK_EXPERT_COUNT; ++i) image.expert[i] = MockBus.getRegister(PARAMETER_BLOCK_EXPERT_FIRST + i);
+    for(uint8_t i = 0; i < PARAMETER_BLOCK_CONFIGURATION_COUNT; ++i) image.configuration[i] = MockBus.getRegister(PARAMETER_BLOCK_CONFIGURATION_FIRST + i);
+
+    static RamFlashMemory flash;
+    ParameterBackup backup(flash);
+    backup.begin();
+    backup.store(controller.peripheralID(), PEGO_MODEL_ECP_202, image);
+
+    MockBus.setRegister(768, 0);
+    MockBus.setRegister(770, 0);
+    MockBus.setRegister(772, 0);
+    backup.restore(controller);
+}
+
+static const BenchmarkCase benchmarkCases[] = {
+    {"cycle.getters", PEGO_MODEL_ECP_202, pollGetters},
+    {"cycle.getters.ecpBase", PEGO_MODEL_ECP_BASE, pollGetters},
+    {"cycle.snapshot", PEGO_MODEL_ECP_202, pollSnapshot},
+    {"cycle.getters.coalesced", PEGO_MODEL_ECP_202, pollGettersCoalesced},
+    {"cycle.snapshotAndGetters.coalesced", PEGO_MODEL_ECP_202, pollSnapshotAndGettersCoalesced},
+    {"forceDefrost.coalesced", PEGO_MODEL_ECP_202, forceDefrostCoalesced},
+    {"readParameters", PEGO_MODEL_ECP_202, readParameters},
+    {"readParameters.ecpBase", PEGO_MODEL_ECP_BASE, readParameters},
+    {"restoreParameters.threeChanged", PEGO_MODEL_ECP_202, restoreParameters},
+    {"unsupportedRegister.repeated", PEGO_MODEL_UNKNOWN, readUnsupportedRegisterRepeatedly},
+    {"partiallyUnsupportedBlock.repeated", PEGO_MODEL_UNKNOWN, readPartiallyUnsupportedBlockRepeatedly},
+    {"missingBlocks.repeated", PEGO_MODEL_UNKNOWN, readMissingBlocksRepeatedly},
+    {"fleet.standBy.unicast", PEGO_MODEL_ECP_202, standByUnicast},
+    {"fleet.standBy.broadcast", PEGO_MODEL_ECP_202, [](PegoController &controller){ standByBroadcast(controller, false); }},
+    {"fleet.standBy.broadcastVerified", PEGO_MODEL_ECP_202, [](PegoController &controller){ standByBroadcast(controller, true); }},
+    {"detectModel", PEGO_MODEL_UNKNOWN, [](PegoController &controller){ controller.detectModel(); }},
+    READ_CASE(responsive),
+
+    READ_CASE(getAmbientTemperature),
+    READ_CASE(getEvaporatorTemperature),
+
+    READ_CASE(getTemperatureSetPoint),
+    WRITE_CASE(setTemperatureSetPoint, 2.0),
+    READ_CASE(getTemperatureDifferential),
+    WRITE_CASE(setTemperatureDifferential, 2.0),
+    READ_CASE(getDefrostingPeriod),
+    WRITE_CASE(setDefrostingPeriod, 4),
+    READ_CASE(getEndOfDefrostingTemperature),
+    WRITE_CASE(setEndOfDefrostingTemperature, 15),
+    READ_CASE(getMaxDefrostingDuration),
+    WRITE_CASE(setMaxDefrostingDuration, 25),
+    READ_CASE(getDrippingDuration),
+    WRITE_CASE(setDrippingDuration, 2),
+    READ_CASE(getFansStopDurationPostDefrosting),
+    WRITE_CASE(setFansStopDurationPostDefrosting, 2),
+    READ_CASE(getTemperatureAlarmMinimumThreshold),
+    WRITE_CASE(setTemperatureAlarmMinimumThreshold, -5),
+    READ_CASE(getTemperatureAlarmMaximumThreshold),
+    WRITE_CASE(setTemperatureAlarmMaximumThreshold, 10),
+    READ_CASE(getFansStatusWithStoppedCompressor),
+    WRITE_CASE(setFansStatusWithStoppedCompressor, 1),
+    READ_CASE(getFansStopInDefrosting),
+    WRITE_CASE(setFansStopInDefrosting, 1),
+    READ_CASE(getEvaporatorProbeExclusion),
+    WRITE_CASE(setEvaporatorProbeExclusion, 0),
+    READ_CASE(getTemperatureAlarmSignalingDelay),
+    WRITE_CASE(setTemperatureAlarmSignalingDelay, 120),
+    READ_CASE(getCompressorReStartingDelay),
+    WRITE_CASE(setCompressorReStartingDelay, 0),
+    READ_CASE(getAmbientProbeCalibration),
+    WRITE_CASE(setAmbientProbeCalibration, 0.5),
+    READ_CASE(getCompressorSafetyTimeForDoorSwitch),
+    WRITE_CASE(setCompressorSafetyTimeForDoorSwitch, 5),
+    READ_CASE(getCompressorRestartTimeAfterDoorOpening),
+    WRITE_CASE(setCompressorRestartTimeAfterDoorOpening, 0),
+    READ_CASE(getFansBlockageTemperature),
+    WRITE_CASE(setFansBlockageTemperature, 10),
+    READ_CASE(getDifferentialOnFansBlockage),
+    WRITE_CASE(setDifferentialOnFansBlockage, 2),
+    READ_CASE(getTemperatureSetPointMinimumLimit),
+    WRITE_CASE(setTemperatureSetPointMinimumLimit, -45),
+    READ_CASE(getTemperatureSetPointMaximumLimit),
+    WRITE_CASE(setTemperatureSetPointMaximumLimit, 45),
+
+    READ_CASE(getTemperatureSettingForAuxRelay),
+    WRITE_CASE(setTemperatureSettingForAuxRelay, 0),
+    READ_CASE(getDefrostAtPowerOnStatus),
+    WRITE_CASE(setDefrostAtPowerOnStatus, false),
+    READ_CASE(getSmartDefrostStatus),
+    WRITE_CASE(setSmartDefrostStatus, false),
+    READ_CASE(getSmartDefrostSetpoint),
+    WRITE_CASE(setSmartDefrostSetpoint, 0),
+    READ_CASE(getDurationOfCompressorOnTimeWithFaultyAmbientProbe),
+    WRITE_CASE(setDurationOfCompressorOnTimeWithFaultyAmbientProbe, 15),
+    READ_CASE(getDurationOfCompressorOffTimeWithFaultyAmbientProbe),
+    WRITE_CASE(setDurationOfCompressorOffTimeWithFaultyAmbientProbe, 15),
+    READ_CASE(getCorrectionFactorForTheSETButtonDuringNightOperation),
+    WRITE_CASE(setCorrectionFactorForTheSETButtonDuringNightOperation, 3.0),
+    READ_CASE(getBuzzerEnableStatus),
+    WRITE_CASE(setBuzzerEnableStatus, true),
+    READ_CASE(getEvaporatorFansActivationForAirRecirculation),
+    WRITE_CASE(setEvaporatorFansActivationForAirRecirculation, 0),
+    READ_CASE(getEvaporatorFansDurationForAirRecirculation),
+    WRITE_CASE(setEvaporatorFansDurationForAirRecirculation, 5),
+    READ_CASE(getThermostatFunctioningMode),
+    READ_CASE(getDefrostType),
+    READ_CASE(getDisplayViewingDuringDefrost),
+    READ_CASE(getInput1Setting),
+    READ_CASE(getInput2Setting),
+    READ_CASE(getAuxiliaryRelay1Control),
+    READ_CASE(getAuxiliaryRelay2Control),
+
+    READ_CASE(getOutputStatus),
+    READ_CASE(getInputStatus),
+    READ_CASE(getAlarmStatus),
+    READ_CASE(getDeviceStatus),
+    READ_CASE(getHotResistanceStatus),
+    READ_CASE(getStandByStatus),
+    READ_CASE(getDrippingStatus),
+    READ_CASE(getColdRoomLightRelayStatus),
+    READ_CASE(getFansRelayStatus),
+    READ_CASE(getDefrostRelayStatus),
+    READ_CASE(getCompressorRelayStatus),
+    READ_CASE(getNightDigitalInputStatus),
+    READ_CASE(getRemoteStopDefrostStatus),
+    READ_CASE(getRemoteStartDefrostStatus),
+    READ_CASE(getRemoteStandByStatus),
+    READ_CASE(getPumpDownInputStatus),
+    READ_CASE(getManInColdRoomAlarmStatus),
+    READ_CASE(getCompressorProtectionStatus),
+    READ_CASE(getDoorSwitchStatus),
+    READ_CASE(getLightAlarmStatus),
+    READ_CASE(getCompressorProtectionAlarmStatus),
+    READ_CASE(getManInRoomAlarmStatus),
+    READ_CASE(getLowTemperatureAlarmStatus),
+    READ_CASE(getHighTemperatureAlarmStatus),
+    READ_CASE(getTemperatureAlarmStatus),
+    READ_CASE(getOpenDoorAlarmStatus),
+    READ_CASE(getEEPROMErrorStatus),
+    READ_CASE(getEvaporatorProbeFaultStatus),
+    READ_CASE(getAmbientProbeFaultStatus),
+    READ_CASE(getDefrostForcingStatus),
+    WRITE_CASE(setDefrostForcingStatus, false),
+    READ_CASE(getColdRoomLightKeyStatus),
+    WRITE_CASE(setColdRoomLightKeyStatus, true),
+    READ_CASE(getDeviceStandByStatus),
+    WRITE_CASE(setDeviceStandByStatus, false)
+};
+
+#define BENCHMARK_CASE_COUNT (sizeof(benchmarkCases) / sizeof(benchmarkCases[0]))
+
+// Register values of a cold room at 4.5 °C with running compressor and fans
+static void initializeRegisters(){
+    MockBus.setRegister(256, 45);
+    MockBus.setRegister(257, (uint16_t)-120);
+    MockBus.setRegister(768, 40);
+    MockBus.setRegister(769, 20);
+    MockBus.setRegister(770, 4);
+    MockBus.setRegister(771, 15);
+    MockBus.setRegister(772, 25);
+    MockBus.setRegister(1280, bit(OUTPUT_STATUS_COMPRESSOR_RELAY_BIT) | bit(OUTPUT_STATUS_FANS_RELAY_BIT));
+    MockBus.setRegister(1281, 0);
+    MockBus.setRegister(1282, 0);
+    MockBus.setRegister(1536, 0);
+}
+
+static void configureModel(PegoModel model){
+    MockBus.clearUnsupportedRanges();
+    if(model == PEGO_MODEL_ECP_BASE){
+        MockBus.addUnsupportedRange(PARAMETER_BLOCK_EXPERT_FIRST, PARAMETER_BLOCK_EXPERT_COUNT);
+        MockBus.addUnsupportedRange(PARAMETER_BLOCK_CONFIGURATION_FIRST, PARAMETER_BLOCK_CONFIGURATION_COUNT);
+    }
+}
+
+static int loadBaseline(const char *path, BenchmarkResult *entries){
+    FILE *file = fopen(path, "r");
+    if(file == NULL) return -1;
+    int count = 0;
+    char line[256];
+    while(fgets(line, sizeof(line), file) != NULL && count < MAX_BASELINE_ENTRIES){
+        if(line[0] == '#' || line[0] == '\n') continue;
+        BenchmarkResult &entry = entries[count];
+        if(sscanf(line, "%63s %lu %lu", entry.name, &entry.transactions, &entry.bytes) == 3) ++count;
+    }
+    fclose(file);
+    return count;
+}
+
+static const BenchmarkResult *findEntry(const BenchmarkResult *entries, int count, const char *name){
+    for(int i = 0; i < count; ++i){
+        if(strcmp(entries[i].name, name) == 0) return &entries[i];
+    }
+    return NULL;
+}
+
+static bool saveBaseline(const char *path, const BenchmarkResult *results, int count){
+    FILE *file = fopen(path, "w");
+    if(file == NULL) return false;
+    fprintf(file, "# Modbus traffic per benchmark case: name transactions bytes\n");
+    fprintf(file, "# Regenerate with: run-benchmark.sh --update-baseline\n");
+    for(int i = 0; i < count; ++i){
+        fprintf(file, "%s %lu %lu\n", results[i].name, results[i].transactions, results[i].bytes);
+    }
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char **argv){
+    unsigned long baudRate = RS485_DEFAULT_BAUD_RATE;
+    unsigned long turnaround = DEFAULT_TURNAROUND;
+    const char *baselinePath = DEFAULT_BASELINE_FILE;
+    bool updateBaseline = false;
+
+    for(int i = 1; i < argc; ++i){
+        if(strcmp(argv[i], "--baud") == 0 && i + 1 < argc){
+            baudRate = strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--turnaround") == 0 && i + 1 < argc){
+            turnaround = strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--baseline") == 0 && i + 1 < argc){
+            baselinePath = argv[++i];
+        } else if(strcmp(argv[i], "--update-baseline") == 0){
+            updateBaseline = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--baud <rate>] [--turnaround <us>] [--baseline <file>] [--update-baseline]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    hostUseSimulatedClock(true);
+    // Keep the error messages of the library out of the report
+    Serial.setMuted(true);
+    initializeRegisters();
+
+    static BenchmarkResult results[BENCHMARK_CASE_COUNT];
+    static BenchmarkResult baseline[MAX_BASELINE_ENTRIES];
+    int baselineCount = updateBaseline ? 0 : loadBaseline(baselinePath, baseline);
+    if(baselineCount < 0){
+        // Without a baseline no regression could be detected, so don't pass silently
+        fprintf(stderr, "No baseline found at %s, run with --update-baseline to create it.\n", baselinePath);
+        return 1;
+    }
+
+    printf("Link: %lu baud, %lu us turnaround\n\n", baudRate, turnaround);
+    printf("%-56s %6s %7s %10s  %s\n", "Case", "Trans.", "Bytes", "Time [ms]", "Baseline");
+
+    int regressions = 0;
+    for(size_t i = 0; i < BENCHMARK_CASE_COUNT; ++i){
+        const BenchmarkCase &benchmarkCase = benchmarkCases[i];
+        PegoController controller(baudRate);
+        controller.begin();
+        MockBus.setLink(baudRate, turnaround);
+        configureModel(benchmarkCase.model);
+        controller.setModel(benchmarkCase.model);
+
+        MockBus.resetStatistics();
+        benchmarkCase.run(controller);
+        const MockBusStatistics &statistics = MockBus.statistics();
+
+        BenchmarkResult &result = results[i];
+        strncpy(result.name, benchmarkCase.name, sizeof(result.name) - 1);
+        result.name[sizeof(result.name) - 1] = '\0';
+        result.transactions = statistics.transactions;
+        result.bytes = statistics.bytes;
+
+        const char *verdict = "new";
+        const BenchmarkResult *reference = findEntry(baseline, baselineCount, result.name);
+        if(updateBaseline){
+            verdict = "updated";
+        } else if(reference != NULL){
+            if(result.transactions > reference->transactions || result.bytes > reference->bytes){
+                verdict = "REGRESSION";
+                ++regressions;
+            } else if(result.transactions < reference->transactions || result.bytes < reference->bytes){
+                verdict = "improved";
+            } else {
+                verdict = "ok";
+            }
+        }
+        printf("%-56s %6lu %7lu %10.1f  %s\n", result.name, result.transactions, result.bytes, statistics.wireTime / 1000.0, verdict);
+        if(reference != NULL && strcmp(verdict, "REGRESSION") == 0){
+            printf("%-56s %6lu %7lu\n", "  (baseline)", reference->transactions, reference->bytes);
+        }
+    }
+
+    if(updateBaseline){
+        if(!saveBaseline(baselinePath, results, BENCHMARK_CASE_COUNT)){
+            fprintf(stderr, "Couldn't write the baseline to %s\n", baselinePath);
+            return 1;
+        }
+        printf("\nBaseline written to %s\n", baselinePath);
+        return 0;
+    }
+
+    if(regressions > 0){
+        printf("\n%d case(s) exceed the baseline.\n", regressions);
+        return 1;
+    }
+    printf("\nAll cases within the baseline.\n");
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include "MockModbusClient.h"
+
+// All clients share the one simulated bus
+struct ModbusRTUPort {};
+
+MockModbusBus MockBus;
+static ModbusRTUPort mockPort;
+ModbusRTUClientClass ModbusRTUClient(mockPort);
+
+MockModbusBus::MockModbusBus() :
+_baudRate(9600),
+_serialConfig(SERIAL_8N1),
+_turnaround(0),
+_responseTimeout(1000),
+_online(true),
+_unsupportedRanges(0),
+_responseLength(0),
+_responsePosition(0),
+_writeID(0),
+_writeAddress(-1),
+_writeCount(0),
+_writeLength(0),
+_lastError("")
+{
+    memset(_registers, 0, sizeof(_registers));
+    resetStatistics();
+}
+
+void MockModbusBus::setLink(unsigned long baudRate, unsigned long turnaround){
+    _baudRate = baudRate;
+    _turnaround = turnaround;
+}
+
+void MockModbusBus::addUnsupportedRange(unsigned int first, unsigned int count){
+    if(_unsupportedRanges >= MOCK_MAX_UNSUPPORTED_RANGES) return;
+    _unsupportedFirst[_unsupportedRanges] = first;
+    _unsupportedCount[_unsupportedRanges] = count;
+    ++_unsupportedRanges;
+}
+
+void MockModbusBus::clearUnsupportedRanges(){
+    _unsupportedRanges = 0;
+}
+
+void MockModbusBus::setOnline(bool online){
+    _online = online;
+}
+
+void MockModbusBus::setRegister(unsigned int address, uint16_t value){
+    _registers[address & 0xFFFF] = value;
+}
+
+uint16_t MockModbusBus::getRegister(unsigned int address) const {
+    return _registers[address & 0xFFFF];
+}
+
+void MockModbusBus::resetStatistics(){
+    memset(&_statistics, 0, sizeof(_statistics));
+}
+
+const MockBusStatistics &MockModbusBus::statistics() const {
+    return _statistics;
+}
+
+bool MockModbusBus::rangeSupported(int address, int count) const {
+    for(uint8_t i = 0; i < _unsupportedRanges; ++i){
+        unsigned int first = _unsupportedFirst[i];
+        unsigned int last = first + _unsupportedCount[i];
+        if((unsigned int)address < last && (unsigned int)(address + count) > first) return false;
+    }
+    return true;
+}
+
+unsigned long MockModbusBus::characterTime() const {
+    // Start bit, 8 data bits, parity or second stop bit and stop bit
+    unsigned long bits = _serialConfig == SERIAL_8N1 ? 10 : 11;
+    return bits * 1000000UL / _baudRate;
+}
+
+void MockModbusBus::transfer(unsigned long requestBytes, unsigned long responseBytes, bool broadcast){
+    unsigned long character = characterTime();
+    unsigned long duration = (requestBytes + responseBytes) * character;
+    // Silent interval after the request and after the response
+    duration += (unsigned long)(2 * MOCK_RTU_FRAME_GAP_CHARACTERS * character);
+    if(responseBytes > 0){
+        duration += _turnaround;
+    } else if(!broadcast){
+        duration += _responseTimeout * 1000UL;
+    }
+
+    ++_statistics.transactions;
+    _statistics.bytes += requestBytes + responseBytes;
+    _statistics.wireTime += duration;
+    hostAdvanceClock(duration);
+}
+
+void MockModbusBus::fail(int error, const char *message){
+    errno = error;
+    _lastError = message;
+}
+
+int MockModbusBus::begin(unsigned long baudRate, uint16_t config){
+    _baudRate = baudRate;
+    _serialConfig = config;
+    return 1;
+}
+
+void MockModbusBus::setTimeout(unsigned long timeout){
+    _responseTimeout = timeout;
+}
+
+int MockModbusBus::requestFrom(int id, int type, int address, int count){
+    _responseLength = 0;
+    _responsePosition = 0;
+    // Function code 03: address (2), quantity (2)
+    unsigned long requestBytes = MOCK_RTU_FRAME_OVERHEAD + 4;
+
+    if(!_online || type != HOLDING_REGISTERS || id == 0){
+        transfer(requestBytes, 0);
+        ++_statistics.timeouts;
+        fail(ETIMEDOUT, "Connection timed out");
+        return 0;
+    }
+    if(count < 1 || count > 125 || !rangeSupported(address, count)){
+        // Exception response: function code | 0x80, exception code
+        transfer(requestBytes, MOCK_RTU_FRAME_OVERHEAD + 1);
+        ++_statistics.exceptions;
+        fail(EMBXILADD, "Illegal data address");
+        return 0;
+    }
+
+    // Byte count (1) followed by the register values
+    transfer(requestBytes, MOCK_RTU_FRAME_OVERHEAD + 1 + 2 * count);
+    for(int i = 0; i < count; ++i){
+        _response[i] = _registers[(address + i) & 0xFFFF];
+    }
+    _responseLength = count;
+    return count;
+}
+
+int MockModbusBus::available(){
+    return _responseLength - _responsePosition;
+}
+
+long MockModbusBus::read(){
+    if(_responsePosition >= _responseLength) return -1;
+    return _response[_responsePosition++];
+}
+
+int MockModbusBus::beginTransmission(int id, int type, int address, int count){
+    if(type != HOLDING_REGISTERS || count < 1 || count > 123){
+        fail(EINVAL, "Invalid argument");
+        return 0;
+    }
+    _writeID = id;
+    _writeAddress = address;
+    _writeCount = count;
+    _writeLength = 0;
+    return 1;
+}
+
+int MockModbusBus::write(unsigned int value){
+    if(_writeAddress < 0 || _writeLength >= _writeCount) return 0;
+    _writeValues[_writeLength++] = value;
+    return 1;
+}
+
+int MockModbusBus::endTransmission(){
+    if(_writeAddress < 0) return 0;
+    int address = _writeAddress;
+    int count = _writeLength;
+    _writeAddress = -1;
+
+    // Function code 06: address (2), value (2), echoed by the controller.
+    // Function code 16: address (2), quantity (2), byte count (1), values; answered with address and quantity.
+    unsigned long requestBytes = MOCK_RTU_FRAME_OVERHEAD + (count == 1 ? 4 : 5 + 2 * count);
+    unsigned long responseBytes = MOCK_RTU_FRAME_OVERHEAD + 4;
+
+    // Broadcasts are applied by every controller but never answered
+    if(_writeID == 0){
+        transfer(requestBytes, 0, true);
+        if(!_online || !rangeSupported(address, count)) return 1;
+        for(int i = 0; i < count; ++i){
+            _registers[(address + i) & 0xFFFF] = _writeValues[i];
+        }
+        return 1;
+    }
+    if(!_online){
+        transfer(requestBytes, 0);
+        ++_statistics.timeouts;
+        fail(ETIMEDOUT, "Connection timed out");
+        return 0;
+    }
+    if(!rangeSupported(address, count)){
+        transfer(requestBytes, MOCK_RTU_FRAME_OVERHEAD + 1);
+        ++_statistics.exceptions;
+        fail(EMBXILADD, "Illegal data address");
+        return 0;
+    }
+    transfer(requestBytes, responseBytes);
+    for(int i = 0; i < count; ++i){
+        _registers[(address + i) & 0xFFFF] = _writeValues[i];
+    }
+    return 1;
+}
+
+const char *MockModbusBus::lastError(){
+    return _lastError;
+}
+
+int ModbusRTUClientClass::begin(unsigned long baudrate, uint16_t config){ return MockBus.begin(baudrate, config); }
+void ModbusRTUClientClass::end(){}
+void ModbusRTUClientClass::setTimeout(unsigned long timeout){ MockBus.setTimeout(timeout); }
+int ModbusRTUClientClass::requestFrom(int id, int type, int address, int nb){ return MockBus.requestFrom(id, type, address, nb); }
+int ModbusRTUClientClass::available(){ return MockBus.available(); }
+long ModbusRTUClientClass::read(){ return MockBus.read(); }
+int ModbusRTUClientClass::beginTransmission(int id, int type, int address, int nb){ return MockBus.beginTransmission(id, type, address, nb); }
+int ModbusRTUClientClass::write(unsigned int value){ return MockBus.write(value); }
+int ModbusRTUClientClass::endTransmission(){ return MockBus.endTransmission(); }
+const char *ModbusRTUClientClass::lastError(){ return MockBus.lastError(); }
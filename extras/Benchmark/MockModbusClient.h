@@ -0,0 +1,110 @@
+#ifndef MOCK_MODBUS_CLIENT_H
+#define MOCK_MODBUS_CLIENT_H
+
+#include <Arduino.h>
+#include <ArduinoModbus.h>
+
+// Bytes of a Modbus RTU frame: address, function code and CRC
+#define MOCK_RTU_FRAME_OVERHEAD 4
+
+// Silent interval between two frames in character times
+#define MOCK_RTU_FRAME_GAP_CHARACTERS 3.5
+
+// Amount of register ranges the mock can reject
+#define MOCK_MAX_UNSUPPORTED_RANGES 4
+
+/**
+ * @brief Bus traffic counted by the mock since the last reset.
+ */
+struct MockBusStatistics {
+    unsigned long transactions;
+    unsigned long exceptions;
+    unsigned long timeouts;
+    // Bytes on the wire in both directions, including address and CRC
+    unsigned long bytes;
+    // Modelled wall time of all transactions in µs
+    unsigned long long wireTime;
+};
+
+/**
+ * @brief Simulates a Pego controller behind ModbusRTUClient.
+ * Every request is answered from an in-memory register map. The bytes of
+ * request and response are counted as they would appear on an RTU link and
+ * the simulated clock advances by the time the transaction would take.
+ */
+class MockModbusBus {
+private:
+    uint16_t _registers[65536];
+    unsigned long _baudRate;
+    uint16_t _serialConfig;
+    unsigned long _turnaround;
+    unsigned long _responseTimeout;
+    bool _online;
+
+    unsigned int _unsupportedFirst[MOCK_MAX_UNSUPPORTED_RANGES];
+    unsigned int _unsupportedCount[MOCK_MAX_UNSUPPORTED_RANGES];
+    uint8_t _unsupportedRanges;
+
+    MockBusStatistics _statistics;
+
+    // Response of the last read request
+    uint16_t _response[125];
+    int _responseLength;
+    int _responsePosition;
+
+    // Pending write request
+    int _writeID;
+    int _writeAddress;
+    int _writeCount;
+    uint16_t _writeValues[123];
+    int _writeLength;
+
+    const char *_lastError;
+
+    bool rangeSupported(int address, int count) const;
+    unsigned long characterTime() const;
+    void transfer(unsigned long requestBytes, unsigned long responseBytes, bool broadcast = false);
+    void fail(int error, const char *message);
+
+public:
+    MockModbusBus();
+
+    /**
+     * @brief Sets the simulated link.
+     * @param baudRate The baud rate of the RS485 bus.
+     * @param turnaround The time in µs the controller needs to answer a request.
+     */
+    void setLink(unsigned long baudRate, unsigned long turnaround);
+
+    /**
+     * @brief Makes requests for registers in the given range fail with an illegal data address exception.
+     */
+    void addUnsupportedRange(unsigned int first, unsigned int count);
+    void clearUnsupportedRanges();
+
+    /**
+     * @brief Makes all requests time out as if the controller was switched off.
+     */
+    void setOnline(bool online);
+
+    void setRegister(unsigned int address, uint16_t value);
+    uint16_t getRegister(unsigned int address) const;
+
+    void resetStatistics();
+    const MockBusStatistics &statistics() const;
+
+    // Backend of the ModbusRTUClientClass methods
+    int begin(unsigned long baudRate, uint16_t config);
+    void setTimeout(unsigned long timeout);
+    int requestFrom(int id, int type, int address, int count);
+    int available();
+    long read();
+    int beginTransmission(int id, int type, int address, int count);
+    int write(unsigned int value);
+    int endTransmission();
+    const char *lastError();
+};
+
+extern MockModbusBus MockBus;
+
+#endif
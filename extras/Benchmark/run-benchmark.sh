@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# Builds the bus benchmark for the host and runs it.
+# All arguments are passed on to the benchmark, e.g. --baud 19200 or --update-baseline
+
+BENCHMARK_PATH=$(cd "$(dirname "$0")" && pwd)
+LIBRARY_PATH="$BENCHMARK_PATH/../../src"
+HOST_PATH="$BENCHMARK_PATH/../host"
+BUILD_PATH="$BENCHMARK_PATH/build"
+CXX=${CXX:-g++}
+
+mkdir -p "$BUILD_PATH"
+echo "🔧 Compiling benchmark ..."
+$CXX -std=gnu++11 -O1 -Wall -I"$HOST_PATH" -I"$LIBRARY_PATH" -I"$BENCHMARK_PATH" \
+    "$BENCHMARK_PATH/Benchmark.cpp" \
+    "$BENCHMARK_PATH/MockModbusClient.cpp" \
+    "$HOST_PATH/Arduino.cpp" \
+    "$LIBRARY_PATH/PegoController.cpp" \
+    "$LIBRARY_PATH/PegoModel.cpp" \
+    "$LIBRARY_PATH/BusSupervisor.cpp" \
+    "$LIBRARY_PATH/ReadCoalescer.cpp" \
+    "$LIBRARY_PATH/ModbusError.cpp" \
+    "$LIBRARY_PATH/UnsupportedRegisterCache.cpp" \
+    "$LIBRARY_PATH/FleetBroadcast.cpp" \
+    "$LIBRARY_PATH/ParameterBackup.cpp" \
+    -o "$BUILD_PATH/Benchmark"
+
+if [ $? -ne 0 ]; then
+    echo "❌ Compilation failed."
+    exit 1
+fi
+
+cd "$BENCHMARK_PATH"
+"$BUILD_PATH/Benchmark" "$@"
+RESULT=$?
+
+if [ $RESULT -eq 0 ]; then
+    echo "✅ Benchmark passed."
+else
+    echo "❌ Benchmark failed."
+fi
+exit $RESULT
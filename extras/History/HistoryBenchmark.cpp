@@ -0,0 +1,213 @@
+/*
+Fills a HistoryStore in a temporary directory with simulated cold rooms
+polled every 10 s and measures the storage size per sample as well as
+the time of typical queries: reading a month of samples, hourly rollups of
+a month and daily rollups of the whole period. The hourly rollups are
+checked against the ones computed from the raw samples.
+
+Usage: HistoryBenchmark [--days <n>] [--controllers <n>] [--keep]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "HistoryStore.h"
+
+#define POLL_INTERVAL 10
+#define START_TIME 1735689600 // 2025-01-01
+#define DAY 86400
+#define MONTH (30 * DAY)
+#define HOUR 3600
+#define MAX_BUCKETS 1000
+
+static double wallClock(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * @brief A cold room at about 2 °C with a defrost every 6 hours.
+ */
+static void simulate(uint8_t controller, int64_t time, ControllerSnapshot &snapshot){
+    int64_t cycle = (time + controller * 997) % (6 * HOUR);
+    bool defrosting = cycle < 20 * 60;
+    bool compressor = !defrosting && (time / 900 + controller) % 2 == 0;
+    snapshot.timestamp = (unsigned long)(time * 1000);
+    snapshot.responsive = true;
+    snapshot.valid = SNAPSHOT_TEMPERATURES_VALID | SNAPSHOT_STATUS_VALID | SNAPSHOT_DEVICE_STATUS_VALID;
+    snapshot.ambientTemperature = 20 + (int16_t)lround(8 * sin(time / 5400.0)) + (defrosting ? 15 : 0) + rand() % 3 - 1;
+    snapshot.evaporatorTemperature = defrosting ? (int16_t)(-80 + cycle / 8) : -80 + rand() % 5 - 2;
+    snapshot.outputStatus = (compressor ? 0x01 : 0) | (defrosting ? 0x02 : 0x04);
+    snapshot.inputStatus = 0;
+    snapshot.alarmStatus = 0;
+    snapshot.deviceStatus = 0x01;
+}
+
+static unsigned long long diskUsage(const char *directory){
+    unsigned long long bytes = 0;
+    DIR *listing = opendir(directory);
+    if(listing == NULL) return 0;
+    struct dirent *entry;
+    char path[512];
+    while((entry = readdir(listing)) != NULL){
+        struct stat status;
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        if(stat(path, &status) == 0 && S_ISREG(status.st_mode)) bytes += (unsigned long long)status.st_blocks * 512;
+    }
+    closedir(listing);
+    return bytes;
+}
+
+static void removeStore(const char *directory){
+    DIR *listing = opendir(directory);
+    if(listing == NULL) return;
+    struct dirent *entry;
+    char path[512];
+    while((entry = readdir(listing)) != NULL){
+        if(entry->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        unlink(path);
+    }
+    closedir(listing);
+    rmdir(directory);
+}
+
+struct Reference {
+    int64_t from;
+    HistoryRollup *buckets;
+};
+
+static void countSample(const HistorySample &sample, void *context){
+    (void)sample;
+    ++*(long *)context;
+}
+
+static void addReference(const HistorySample &sample, void *context){
+    Reference &reference = *(Reference *)context;
+    HistoryRollup &bucket = reference.buckets[(sample.time - reference.from) / HOUR];
+    ++bucket.samples;
+    bucket.ambientTemperature.add(sample.ambientTemperature);
+    bucket.evaporatorTemperature.add(sample.evaporatorTemperature);
+}
+
+static bool sameChannel(const HistoryChannel &a, const HistoryChannel &b){
+    return a.count == b.count && a.sum == b.sum && (a.count == 0 || (a.minimum == b.minimum && a.maximum == b.maximum));
+}
+
+int main(int argc, char **argv){
+    int days = 365;
+    int controllers = 1;
+    bool keep = false;
+    for(int i = 1; i < argc; ++i){
+        bool hasValue = i + 1 < argc;
+        if(strcmp(argv[i], "--days") == 0 && hasValue){
+            days = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--controllers") == 0 && hasValue){
+            controllers = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--keep") == 0){
+            keep = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--days <n>] [--controllers <n>] [--keep]\n", argv[0]);
+            return 2;
+        }
+    }
+    if(days < 31 || controllers < 1 || controllers > HISTORY_STORE_MAX_CONTROLLERS){
+        fprintf(stderr, "At least 31 days and 1 .. %d controllers\n", HISTORY_STORE_MAX_CONTROLLERS);
+        return 2;
+    }
+
+    char directory[] = "/tmp/pego-history-XXXXXX";
+    if(mkdtemp(directory) == NULL){
+        perror("mkdtemp");
+        return 1;
+    }
+
+    HistoryStore store;
+    store.begin(directory);
+    srand(1);
+    int64_t end = START_TIME + (int64_t)days * DAY;
+    unsigned long samples = 0;
+    double start = wallClock();
+    ControllerSnapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    for(int64_t time = START_TIME; time < end; time += POLL_INTERVAL){
+        for(uint8_t controller = 1; controller <= controllers; ++controller){
+            // Polls drift by a second now and then
+            int64_t jitter = rand() % 50 == 0 ? 1 : 0;
+            simulate(controller, time + jitter, snapshot);
+            if(!store.append(controller, time + jitter, snapshot)){
+                fprintf(stderr, "Append failed\n");
+                return 1;
+            }
+            ++samples;
+        }
+    }
+    double appendTime = wallClock() - start;
+    store.end();
+    unsigned long long bytes = diskUsage(directory);
+
+    printf("%-32s %12lu\n", "Samples", samples);
+    printf("%-32s %12.2f\n", "Bytes per sample", (double)bytes / samples);
+    printf("%-32s %12.0f\n", "Appends per second", samples / appendTime);
+
+    // Queries run on a freshly opened store like in a separate process
+    HistoryStore reader;
+    reader.begin(directory, false);
+    int64_t monthStart = end - MONTH;
+
+    long count = 0;
+    start = wallClock();
+    reader.read(1, monthStart, end, countSample, &count);
+    printf("%-32s %9.2f ms  (%ld samples)\n", "Read a month", (wallClock() - start) * 1000, count);
+
+    static HistoryRollup hourly[MAX_BUCKETS];
+    start = wallClock();
+    long buckets = reader.rollup(1, monthStart, end, HOUR, hourly, MAX_BUCKETS);
+    printf("%-32s %9.2f ms  (%ld buckets)\n", "Hourly rollups of a month", (wallClock() - start) * 1000, buckets);
+
+    static HistoryRollup daily[MAX_BUCKETS];
+    start = wallClock();
+    long dailyBuckets = reader.rollup(1, START_TIME, end, DAY, daily, MAX_BUCKETS);
+    printf("%-32s %9.2f ms  (%ld buckets)\n", "Daily rollups of all days", (wallClock() - start) * 1000, dailyBuckets);
+
+    HistoryRollup total;
+    start = wallClock();
+    reader.rollup(1, START_TIME, end, 0, &total, 1);
+    printf("%-32s %9.2f ms  (mean %.2f °C, min %.1f °C, max %.1f °C)\n", "Rollup of all days", (wallClock() - start) * 1000,
+        total.ambientTemperature.mean() / 10, total.ambientTemperature.minimum / 10.0, total.ambientTemperature.maximum / 10.0);
+
+    // The rollups taken from the block index must match the raw samples
+    static HistoryRollup expected[MAX_BUCKETS];
+    for(long i = 0; i < buckets; ++i){
+        expected[i].samples = 0;
+        expected[i].ambientTemperature.clear();
+        expected[i].evaporatorTemperature.clear();
+    }
+    Reference reference = {monthStart, expected};
+    reader.read(1, monthStart, end, addReference, &reference);
+    int mismatches = 0;
+    for(long i = 0; i < buckets; ++i){
+        if(hourly[i].samples != expected[i].samples ||
+           !sameChannel(hourly[i].ambientTemperature, expected[i].ambientTemperature) ||
+           !sameChannel(hourly[i].evaporatorTemperature, expected[i].evaporatorTemperature)) ++mismatches;
+    }
+    bool complete = count == MONTH / POLL_INTERVAL && total.samples == samples / controllers;
+    reader.end();
+
+    if(keep){
+        printf("Store kept in %s\n", directory);
+    } else {
+        removeStore(directory);
+    }
+    if(mismatches > 0 || !complete){
+        printf("%d rollup bucket(s) differ from the raw samples, %s\n", mismatches, complete ? "all samples read" : "samples missing");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+Queries a HistoryStore, e.g. the one the gateway keeps with --history.
+Prints rollups of the temperatures per interval or, with --samples, every
+stored sample as CSV.
+
+Usage: HistoryQuery --dir <directory> --unit <id> [--from <time>] [--to <time>]
+                    [--interval <s>] [--samples]
+Times are in seconds since the epoch. By default the last 30 days are shown
+in hourly intervals.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+#include "HistoryStore.h"
+
+#define DEFAULT_RANGE (30 * 86400)
+#define DEFAULT_INTERVAL 3600
+#define MAX_BUCKETS 100000
+
+static void printTime(int64_t time){
+    char text[32];
+    time_t seconds = time;
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", localtime(&seconds));
+    printf("%s", text);
+}
+
+static void printTemperature(int16_t value){
+    if(value == HISTORY_NO_VALUE){
+        printf(",");
+    } else {
+        printf(",%.1f", value / 10.0);
+    }
+}
+
+static void printSample(const HistorySample &sample, void *context){
+    (void)context;
+    printTime(sample.time);
+    printTemperature(sample.ambientTemperature);
+    printTemperature(sample.evaporatorTemperature);
+    printf(",%04X,%04X,%04X,%04X,%u\n", sample.outputStatus, sample.inputStatus, sample.alarmStatus,
+        sample.deviceStatus, (sample.flags & HISTORY_SAMPLE_RESPONSIVE) ? 1 : 0);
+}
+
+static void printChannel(const HistoryChannel &channel){
+    if(channel.count == 0){
+        printf("  %6s %6s %6s", "-", "-", "-");
+    } else {
+        printf("  %6.1f %6.1f %6.1f", channel.minimum / 10.0, channel.mean() / 10, channel.maximum / 10.0);
+    }
+}
+
+int main(int argc, char **argv){
+    const char *directory = NULL;
+    int unit = -1;
+    int64_t to = time(NULL);
+    int64_t from = INT64_MIN;
+    int64_t interval = DEFAULT_INTERVAL;
+    bool samples = false;
+
+    for(int i = 1; i < argc; ++i){
+        bool hasValue = i + 1 < argc;
+        if(strcmp(argv[i], "--dir") == 0 && hasValue){
+            directory = argv[++i];
+        } else if(strcmp(argv[i], "--unit") == 0 && hasValue){
+            unit = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--from") == 0 && hasValue){
+            from = strtoll(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--to") == 0 && hasValue){
+            to = strtoll(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--interval") == 0 && hasValue){
+            interval = strtoll(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--samples") == 0){
+            samples = true;
+        } else {
+            directory = NULL;
+            break;
+        }
+    }
+    if(from == INT64_MIN) from = to - DEFAULT_RANGE;
+    if(directory == NULL || unit < 1 || unit > 255 || to <= from){
+        fprintf(stderr, "Usage: %s --dir <directory> --unit <id> [--from <time>] [--to <time>] [--interval <s>] [--samples]\n", argv[0]);
+        return 2;
+    }
+
+    HistoryStore store;
+    if(!store.begin(directory, false)){
+        perror(directory);
+        return 1;
+    }
+
+    if(samples){
+        printf("time,ambient,evaporator,output,input,alarm,device,responsive\n");
+        return store.read(unit, from, to, printSample, NULL) < 0 ? 1 : 0;
+    }
+
+    static HistoryRollup buckets[MAX_BUCKETS];
+    long count = store.rollup(unit, from, to, interval, buckets, MAX_BUCKETS);
+    if(count < 0) return 1;
+    printf("%-19s  %7s  %20s  %20s\n", "", "", "ambient °C", "evaporator °C");
+    printf("%-19s  %7s  %6s %6s %6s  %6s %6s %6s\n", "from", "samples", "min", "mean", "max", "min", "mean", "max");
+    for(long i = 0; i < count; ++i){
+        if(buckets[i].samples == 0) continue;
+        printTime(buckets[i].from);
+        printf("  %7" PRIu32, buckets[i].samples);
+        printChannel(buckets[i].ambientTemperature);
+        printChannel(buckets[i].evaporatorTemperature);
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,712 @@
+#include "HistoryStore.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define HISTORY_SEGMENT_MAGIC 0x50474853 // "PGHS"
+#define HISTORY_SEGMENT_VERSION 1
+
+// Columns of a block in the order they are stored
+enum HistoryColumn : uint8_t {
+    HISTORY_COLUMN_TIME = 0,
+    HISTORY_COLUMN_AMBIENT_TEMPERATURE,
+    HISTORY_COLUMN_EVAPORATOR_TEMPERATURE,
+    HISTORY_COLUMN_OUTPUT_STATUS,
+    HISTORY_COLUMN_INPUT_STATUS,
+    HISTORY_COLUMN_ALARM_STATUS,
+    HISTORY_COLUMN_DEVICE_STATUS,
+    HISTORY_COLUMN_FLAGS,
+    HISTORY_COLUMN_COUNT
+};
+
+// Largest encoding of a value: 3 prefix bits and 32 value bits
+#define HISTORY_MAX_VALUE_BITS 35
+#define HISTORY_MAX_COLUMN_SIZE ((HISTORY_BLOCK_SAMPLES * HISTORY_MAX_VALUE_BITS + 7) / 8)
+#define HISTORY_MAX_BLOCK_SIZE (HISTORY_COLUMN_COUNT * (2 + HISTORY_MAX_COLUMN_SIZE))
+
+/**
+ * @brief Index entry of a sealed block.
+ */
+struct HistoryBlock {
+    int64_t firstTime;
+    int64_t lastTime;
+    // Position in the data area and size in bytes
+    uint32_t offset;
+    uint16_t size;
+    uint16_t count;
+    HistoryChannel ambientTemperature;
+    HistoryChannel evaporatorTemperature;
+};
+
+struct HistorySegmentHeader {
+    // Written last when the segment is created
+    uint32_t magic;
+    uint16_t version;
+    uint8_t peripheralID;
+    uint8_t reserved;
+    // Sealed blocks in the upper and samples of the open block in the lower
+    // 32 bits, so that sealing a block is a single store
+    uint64_t state;
+    int64_t firstTime;
+};
+
+/**
+ * @brief Layout of a segment file. Only the used part of the data area
+ * takes space on disk, as the file is created sparse.
+ */
+struct HistorySegmentFile {
+    HistorySegmentHeader header;
+    HistoryBlock blocks[HISTORY_SEGMENT_BLOCKS];
+    HistorySample open[HISTORY_BLOCK_SAMPLES];
+    uint8_t data[HISTORY_SEGMENT_BLOCKS * HISTORY_MAX_BLOCK_SIZE];
+};
+
+static uint32_t blockCount(uint64_t state){
+    return state >> 32;
+}
+
+static uint32_t openCount(uint64_t state){
+    return state & 0xFFFFFFFF;
+}
+
+static uint64_t segmentState(const HistorySegmentFile &segment){
+    return __atomic_load_n(&segment.header.state, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Writes values MSB first into a zeroed buffer.
+ */
+class BitWriter {
+private:
+    uint8_t *_buffer;
+    size_t _bits;
+
+public:
+    BitWriter(uint8_t *buffer) : _buffer(buffer), _bits(0) {}
+
+    void write(uint64_t value, uint8_t count){
+        while(count > 0){
+            uint8_t space = 8 - (_bits & 7);
+            uint8_t take = count < space ? count : space;
+            uint8_t bits = (value >> (count - take)) & ((1 << take) - 1);
+            _buffer[_bits >> 3] |= bits << (space - take);
+            _bits += take;
+            count -= take;
+        }
+    }
+
+    size_t size() const {
+        return (_bits + 7) / 8;
+    }
+};
+
+class BitReader {
+private:
+    const uint8_t *_buffer;
+    size_t _bits;
+
+public:
+    BitReader(const uint8_t *buffer) : _buffer(buffer), _bits(0) {}
+
+    uint64_t read(uint8_t count){
+        uint64_t value = 0;
+        while(count > 0){
+            uint8_t available = 8 - (_bits & 7);
+            uint8_t take = count < available ? count : available;
+            uint8_t bits = (_buffer[_bits >> 3] >> (available - take)) & ((1 << take) - 1);
+            value = (value << take) | bits;
+            _bits += take;
+            count -= take;
+        }
+        return value;
+    }
+};
+
+/*
+Prefix code for signed differences:
+0                 0
+10  + 7 bits      -64 .. 63
+110 + 12 bits     -2048 .. 2047
+111 + 32 bits     anything else
+*/
+static void writeDifference(BitWriter &writer, int64_t value){
+    if(value == 0){
+        writer.write(0, 1);
+    } else if(value >= -64 && value < 64){
+        writer.write(0x2, 2);
+        writer.write(value & 0x7F, 7);
+    } else if(value >= -2048 && value < 2048){
+        writer.write(0x6, 3);
+        writer.write(value & 0xFFF, 12);
+    } else {
+        writer.write(0x7, 3);
+        writer.write((uint32_t)value, 32);
+    }
+}
+
+static int64_t signExtend(uint64_t value, uint8_t bits){
+    uint64_t sign = 1ULL << (bits - 1);
+    return (int64_t)((value ^ sign) - sign);
+}
+
+static int64_t readDifference(BitReader &reader){
+    if(reader.read(1) == 0) return 0;
+    if(reader.read(1) == 0) return signExtend(reader.read(7), 7);
+    if(reader.read(1) == 0) return signExtend(reader.read(12), 12);
+    return signExtend(reader.read(32), 32);
+}
+
+// A status word that didn't change takes a single 0 bit
+static void writeXor(BitWriter &writer, uint16_t value, uint16_t previous, uint8_t bits){
+    uint16_t difference = value ^ previous;
+    if(difference == 0){
+        writer.write(0, 1);
+    } else {
+        writer.write(1, 1);
+        writer.write(difference, bits);
+    }
+}
+
+static uint16_t readXor(BitReader &reader, uint16_t previous, uint8_t bits){
+    if(reader.read(1) == 0) return previous;
+    return previous ^ reader.read(bits);
+}
+
+static uint16_t statusValue(const HistorySample &sample, uint8_t column){
+    switch(column){
+        case HISTORY_COLUMN_OUTPUT_STATUS: return sample.outputStatus;
+        case HISTORY_COLUMN_INPUT_STATUS: return sample.inputStatus;
+        case HISTORY_COLUMN_ALARM_STATUS: return sample.alarmStatus;
+        case HISTORY_COLUMN_DEVICE_STATUS: return sample.deviceStatus;
+        default: return sample.flags;
+    }
+}
+
+static void setStatusValue(HistorySample &sample, uint8_t column, uint16_t value){
+    switch(column){
+        case HISTORY_COLUMN_OUTPUT_STATUS: sample.outputStatus = value; break;
+        case HISTORY_COLUMN_INPUT_STATUS: sample.inputStatus = value; break;
+        case HISTORY_COLUMN_ALARM_STATUS: sample.alarmStatus = value; break;
+        case HISTORY_COLUMN_DEVICE_STATUS: sample.deviceStatus = value; break;
+        default: sample.flags = value;
+    }
+}
+
+/**
+ * @brief Compresses samples column by column.
+ * @param buffer Receives the block, at least HISTORY_MAX_BLOCK_SIZE bytes and zeroed.
+ * @return The size of the block.
+ */
+static size_t encodeBlock(const HistorySample *samples, uint16_t count, uint8_t *buffer){
+    // The block starts with the size of each column
+    size_t position = 2 * HISTORY_COLUMN_COUNT;
+    for(uint8_t column = 0; column < HISTORY_COLUMN_COUNT; ++column){
+        BitWriter writer(buffer + position);
+        if(column == HISTORY_COLUMN_TIME){
+            int64_t previous = samples[0].time;
+            int64_t delta = 0;
+            for(uint16_t i = 0; i < count; ++i){
+                writeDifference(writer, samples[i].time - previous - delta);
+                delta = samples[i].time - previous;
+                previous = samples[i].time;
+            }
+        } else if(column == HISTORY_COLUMN_AMBIENT_TEMPERATURE || column == HISTORY_COLUMN_EVAPORATOR_TEMPERATURE){
+            int16_t previous = 0;
+            for(uint16_t i = 0; i < count; ++i){
+                int16_t value = column == HISTORY_COLUMN_AMBIENT_TEMPERATURE ? samples[i].ambientTemperature : samples[i].evaporatorTemperature;
+                writeDifference(writer, (int32_t)value - previous);
+                previous = value;
+            }
+        } else {
+            uint8_t bits = column == HISTORY_COLUMN_FLAGS ? 8 : 16;
+            uint16_t previous = 0;
+            for(uint16_t i = 0; i < count; ++i){
+                uint16_t value = statusValue(samples[i], column);
+                writeXor(writer, value, previous, bits);
+                previous = value;
+            }
+        }
+        buffer[2 * column] = highByte(writer.size());
+        buffer[2 * column + 1] = lowByte(writer.size());
+        position += writer.size();
+    }
+    return position;
+}
+
+static void decodeBlock(const HistoryBlock &block, const uint8_t *buffer, HistorySample *samples){
+    size_t position = 2 * HISTORY_COLUMN_COUNT;
+    for(uint8_t column = 0; column < HISTORY_COLUMN_COUNT; ++column){
+        BitReader reader(buffer + position);
+        if(column == HISTORY_COLUMN_TIME){
+            int64_t previous = block.firstTime;
+            int64_t delta = 0;
+            for(uint16_t i = 0; i < block.count; ++i){
+                delta += readDifference(reader);
+                previous += delta;
+                samples[i].time = previous;
+            }
+        } else if(column == HISTORY_COLUMN_AMBIENT_TEMPERATURE || column == HISTORY_COLUMN_EVAPORATOR_TEMPERATURE){
+            int16_t previous = 0;
+            for(uint16_t i = 0; i < block.count; ++i){
+                previous += readDifference(reader);
+                if(column == HISTORY_COLUMN_AMBIENT_TEMPERATURE){
+                    samples[i].ambientTemperature = previous;
+                } else {
+                    samples[i].evaporatorTemperature = previous;
+                }
+            }
+        } else {
+            uint8_t bits = column == HISTORY_COLUMN_FLAGS ? 8 : 16;
+            uint16_t previous = 0;
+            for(uint16_t i = 0; i < block.count; ++i){
+                previous = readXor(reader, previous, bits);
+                setStatusValue(samples[i], column, previous);
+            }
+        }
+        position += (buffer[2 * column] << 8) | buffer[2 * column + 1];
+    }
+}
+
+void HistoryChannel::clear(){
+    count = 0;
+    minimum = INT16_MAX;
+    maximum = INT16_MIN;
+    sum = 0;
+}
+
+void HistoryChannel::add(int16_t value){
+    if(value == HISTORY_NO_VALUE) return;
+    ++count;
+    if(value < minimum) minimum = value;
+    if(value > maximum) maximum = value;
+    sum += value;
+}
+
+void HistoryChannel::merge(const HistoryChannel &other){
+    if(other.count == 0) return;
+    count += other.count;
+    if(other.minimum < minimum) minimum = other.minimum;
+    if(other.maximum > maximum) maximum = other.maximum;
+    sum += other.sum;
+}
+
+float HistoryChannel::mean() const {
+    return count == 0 ? NAN : (float)sum / count;
+}
+
+HistoryStore::HistoryStore() :
+_writable(false),
+_seriesCount(0)
+{
+    _directory[0] = '\0';
+}
+
+HistoryStore::~HistoryStore(){
+    end();
+}
+
+bool HistoryStore::begin(const char *directory, bool writable){
+    end();
+    if(strlen(directory) >= sizeof(_directory)) return false;
+    DIR *listing = opendir(directory);
+    if(listing == NULL) return false;
+    strcpy(_directory, directory);
+    _writable = writable;
+
+    struct dirent *entry;
+    while((entry = readdir(listing)) != NULL){
+        unsigned int peripheralID;
+        int64_t firstTime;
+        int length = 0;
+        if(sscanf(entry->d_name, "%u-%" SCNd64 ".seg%n", &peripheralID, &firstTime, &length) != 2) continue;
+        if(length == 0 || entry->d_name[length] != '\0' || peripheralID > 255) continue;
+        Series *found = series(peripheralID, true);
+        if(found != NULL) addSegment(*found, firstTime);
+    }
+    closedir(listing);
+    return true;
+}
+
+void HistoryStore::end(){
+    for(uint8_t i = 0; i < _seriesCount; ++i){
+        Series &series = _series[i];
+        if(series.active != NULL){
+            msync(series.active, sizeof(HistorySegmentFile), MS_SYNC);
+            unmap(series.active);
+        }
+        free(series.segments);
+    }
+    _seriesCount = 0;
+}
+
+HistoryStore::Series *HistoryStore::series(uint8_t peripheralID, bool create){
+    for(uint8_t i = 0; i < _seriesCount; ++i){
+        if(_series[i].peripheralID == peripheralID) return &_series[i];
+    }
+    if(!create || _seriesCount >= HISTORY_STORE_MAX_CONTROLLERS) return NULL;
+    Series &series = _series[_seriesCount++];
+    series.peripheralID = peripheralID;
+    series.segments = NULL;
+    series.segmentCount = 0;
+    series.segmentCapacity = 0;
+    series.active = NULL;
+    series.lastTime = INT64_MIN;
+    return &series;
+}
+
+bool HistoryStore::addSegment(Series &series, int64_t firstTime){
+    if(series.segmentCount == series.segmentCapacity){
+        size_t capacity = series.segmentCapacity == 0 ? 16 : series.segmentCapacity * 2;
+        int64_t *segments = (int64_t *)realloc(series.segments, capacity * sizeof(int64_t));
+        if(segments == NULL) return false;
+        series.segments = segments;
+        series.segmentCapacity = capacity;
+    }
+    // Directory listings come unsorted, appends are always the newest
+    size_t position = series.segmentCount;
+    while(position > 0 && series.segments[position - 1] > firstTime){
+        series.segments[position] = series.segments[position - 1];
+        --position;
+    }
+    series.segments[position] = firstTime;
+    ++series.segmentCount;
+    return true;
+}
+
+void HistoryStore::segmentPath(char *path, size_t size, uint8_t peripheralID, int64_t firstTime) const {
+    snprintf(path, size, "%s/%u-%" PRId64 ".seg", _directory, peripheralID, firstTime);
+}
+
+HistorySegmentFile *HistoryStore::map(uint8_t peripheralID, int64_t firstTime, bool writable) const {
+    char path[300];
+    segmentPath(path, sizeof(path), peripheralID, firstTime);
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if(fd < 0) return NULL;
+    void *memory = mmap(NULL, sizeof(HistorySegmentFile), writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(memory == MAP_FAILED) return NULL;
+    HistorySegmentFile *segment = (HistorySegmentFile *)memory;
+    if(__atomic_load_n(&segment->header.magic, __ATOMIC_ACQUIRE) != HISTORY_SEGMENT_MAGIC ||
+       segment->header.version != HISTORY_SEGMENT_VERSION){
+        unmap(segment);
+        return NULL;
+    }
+    return segment;
+}
+
+void HistoryStore::unmap(HistorySegmentFile *segment) const {
+    munmap(segment, sizeof(HistorySegmentFile));
+}
+
+/**
+ * @brief Position in the data area behind the given amount of sealed blocks.
+ */
+static uint32_t dataEnd(const HistorySegmentFile &segment, uint32_t blocks){
+    return blocks == 0 ? 0 : segment.blocks[blocks - 1].offset + segment.blocks[blocks - 1].size;
+}
+
+/**
+ * @brief Compresses the open samples of a segment into a new block.
+ */
+static void sealBlock(HistorySegmentFile &segment, uint32_t blocks){
+    HistoryBlock &block = segment.blocks[blocks];
+    const HistorySample *samples = segment.open;
+    block.offset = dataEnd(segment, blocks);
+    block.count = HISTORY_BLOCK_SAMPLES;
+    block.firstTime = samples[0].time;
+    block.lastTime = samples[HISTORY_BLOCK_SAMPLES - 1].time;
+    block.ambientTemperature.clear();
+    block.evaporatorTemperature.clear();
+    for(uint16_t i = 0; i < HISTORY_BLOCK_SAMPLES; ++i){
+        block.ambientTemperature.add(samples[i].ambientTemperature);
+        block.evaporatorTemperature.add(samples[i].evaporatorTemperature);
+    }
+    // The data area past the last block is still zero
+    block.size = encodeBlock(samples, HISTORY_BLOCK_SAMPLES, segment.data + block.offset);
+    // Readers see the block and the emptied open samples at the same time
+    __atomic_store_n(&segment.header.state, (uint64_t)(blocks + 1) << 32, __ATOMIC_RELEASE);
+}
+
+bool HistoryStore::openActive(Series &series, int64_t time){
+    if(series.active == NULL && series.segmentCount > 0){
+        series.active = map(series.peripheralID, series.segments[series.segmentCount - 1], true);
+        if(series.active != NULL){
+            uint64_t state = segmentState(*series.active);
+            // More open samples than fit, or a full block without room to seal it
+            bool corrupt = openCount(state) > HISTORY_BLOCK_SAMPLES ||
+                           (openCount(state) == HISTORY_BLOCK_SAMPLES && blockCount(state) >= HISTORY_SEGMENT_BLOCKS);
+            if(corrupt){
+                unmap(series.active);
+                series.active = NULL;
+                return false;
+            }
+            if(openCount(state) == HISTORY_BLOCK_SAMPLES){
+                // The writer stopped between publishing the last open sample and
+                // sealing the block. The encoder ORs bits into zeroed memory, so
+                // whatever the interrupted seal left behind is cleared first.
+                HistorySegmentFile &segment = *series.active;
+                memset(segment.data + dataEnd(segment, blockCount(state)), 0, HISTORY_MAX_BLOCK_SIZE);
+                sealBlock(segment, blockCount(state));
+                state = segmentState(segment);
+            }
+            // Continue after the newest sample of the segment
+            if(openCount(state) > 0){
+                series.lastTime = series.active->open[openCount(state) - 1].time;
+            } else if(blockCount(state) > 0){
+                series.lastTime = series.active->blocks[blockCount(state) - 1].lastTime;
+            }
+            if(blockCount(state) >= HISTORY_SEGMENT_BLOCKS){
+                unmap(series.active);
+                series.active = NULL;
+            }
+        }
+    }
+    if(series.active != NULL) return true;
+    if(series.segmentCount > 0 && time <= series.segments[series.segmentCount - 1]) return false;
+
+    char path[300];
+    segmentPath(path, sizeof(path), series.peripheralID, time);
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(fd < 0) return false;
+    if(ftruncate(fd, sizeof(HistorySegmentFile)) != 0){
+        close(fd);
+        unlink(path);
+        return false;
+    }
+    void *memory = mmap(NULL, sizeof(HistorySegmentFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(memory == MAP_FAILED || !addSegment(series, time)){
+        if(memory != MAP_FAILED) munmap(memory, sizeof(HistorySegmentFile));
+        unlink(path);
+        return false;
+    }
+    HistorySegmentFile *segment = (HistorySegmentFile *)memory;
+    segment->header.version = HISTORY_SEGMENT_VERSION;
+    segment->header.peripheralID = series.peripheralID;
+    segment->header.firstTime = time;
+    __atomic_store_n(&segment->header.magic, HISTORY_SEGMENT_MAGIC, __ATOMIC_RELEASE);
+    series.active = segment;
+    return true;
+}
+
+bool HistoryStore::append(uint8_t peripheralID, int64_t time, const ControllerSnapshot &snapshot){
+    if(!_writable) return false;
+    Series *found = series(peripheralID, true);
+    if(found == NULL || !openActive(*found, time)) return false;
+    Series &series = *found;
+    if(time < series.lastTime) return false;
+
+    HistorySample sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.time = time;
+    bool temperaturesValid = snapshot.valid & SNAPSHOT_TEMPERATURES_VALID;
+    sample.ambientTemperature = temperaturesValid ? snapshot.ambientTemperature : HISTORY_NO_VALUE;
+    sample.evaporatorTemperature = temperaturesValid ? snapshot.evaporatorTemperature : HISTORY_NO_VALUE;
+    sample.outputStatus = snapshot.outputStatus;
+    sample.inputStatus = snapshot.inputStatus;
+    sample.alarmStatus = snapshot.alarmStatus;
+    sample.deviceStatus = snapshot.deviceStatus;
+    sample.flags = snapshot.valid & ~HISTORY_SAMPLE_RESPONSIVE;
+    if(snapshot.responsive) sample.flags |= HISTORY_SAMPLE_RESPONSIVE;
+
+    HistorySegmentFile &segment = *series.active;
+    uint64_t state = segmentState(segment);
+    segment.open[openCount(state)] = sample;
+    __atomic_store_n(&segment.header.state, state + 1, __ATOMIC_RELEASE);
+    series.lastTime = time;
+
+    if(openCount(state) + 1 == HISTORY_BLOCK_SAMPLES){
+        sealBlock(segment, blockCount(state));
+        if(blockCount(state) + 1 == HISTORY_SEGMENT_BLOCKS){
+            msync(series.active, sizeof(HistorySegmentFile), MS_ASYNC);
+            unmap(series.active);
+            series.active = NULL;
+        }
+    }
+    return true;
+}
+
+void HistoryStore::sync(){
+    for(uint8_t i = 0; i < _seriesCount; ++i){
+        if(_series[i].active != NULL) msync(_series[i].active, sizeof(HistorySegmentFile), MS_ASYNC);
+    }
+}
+
+bool HistoryStore::segmentRange(const Series &series, int64_t from, int64_t to, size_t &first, size_t &last) const {
+    // A segment holds the samples from its first time up to the first time of the next one
+    size_t count = 0;
+    for(size_t i = 0; i < series.segmentCount; ++i){
+        if(series.segments[i] >= to) break;
+        bool endsBefore = i + 1 < series.segmentCount && series.segments[i + 1] < from;
+        if(endsBefore) continue;
+        if(count == 0) first = i;
+        last = i;
+        ++count;
+    }
+    return count > 0;
+}
+
+HistorySegmentFile *HistoryStore::mapForReading(const Series &series, size_t index) const {
+    if(series.active != NULL && index == series.segmentCount - 1) return series.active;
+    return map(series.peripheralID, series.segments[index], false);
+}
+
+void HistoryStore::release(const Series &series, HistorySegmentFile *segment) const {
+    if(segment != series.active) unmap(segment);
+}
+
+/**
+ * @brief Index of the first block that ends at or after the given time.
+ */
+static uint32_t firstBlock(const HistorySegmentFile &segment, uint32_t blocks, int64_t from){
+    uint32_t low = 0;
+    uint32_t high = blocks;
+    while(low < high){
+        uint32_t middle = (low + high) / 2;
+        if(segment.blocks[middle].lastTime < from){
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief What a query does with the contents of a segment.
+ */
+struct SegmentVisitor {
+    int64_t from;
+    int64_t to;
+    // Takes a block as a whole if possible, returns false to get its samples instead
+    bool (*block)(const HistoryBlock &block, void *context);
+    // Called with every sample within [from, to)
+    void (*sample)(const HistorySample &sample, void *context);
+    void *context;
+};
+
+/**
+ * @brief Passes the contents of a segment within the range of the visitor
+ * in chronological order. Another process may append to the segment
+ * meanwhile: blocks sealed during the visit are visited as well, and the
+ * open samples are only taken if no block was sealed while copying them.
+ */
+static void visitSegment(const HistorySegmentFile &segment, const SegmentVisitor &visitor){
+    HistorySample samples[HISTORY_BLOCK_SAMPLES];
+    uint64_t state = segmentState(segment);
+    uint32_t i = firstBlock(segment, blockCount(state), visitor.from);
+    while(true){
+        uint32_t blocks = blockCount(state);
+        for(; i < blocks; ++i){
+            const HistoryBlock &block = segment.blocks[i];
+            if(block.firstTime >= visitor.to) return;
+            if(visitor.block != NULL && visitor.block(block, visitor.context)) continue;
+            decodeBlock(block, segment.data + block.offset, samples);
+            for(uint16_t j = 0; j < block.count; ++j){
+                if(samples[j].time >= visitor.from && samples[j].time < visitor.to) visitor.sample(samples[j], visitor.context);
+            }
+        }
+        if(blocks >= HISTORY_SEGMENT_BLOCKS) return;
+
+        uint32_t count = openCount(state);
+        memcpy(samples, segment.open, count * sizeof(HistorySample));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint64_t current = segmentState(segment);
+        // Samples appended behind the copied ones don't matter, a sealed block does
+        if(blockCount(current) == blocks){
+            for(uint32_t j = 0; j < count; ++j){
+                if(samples[j].time >= visitor.from && samples[j].time < visitor.to) visitor.sample(samples[j], visitor.context);
+            }
+            return;
+        }
+        state = current;
+    }
+}
+
+struct ReadContext {
+    HistorySampleCallback callback;
+    void *context;
+    long count;
+};
+
+static void readSample(const HistorySample &sample, void *context){
+    ReadContext &read = *(ReadContext *)context;
+    read.callback(sample, read.context);
+    ++read.count;
+}
+
+struct RollupContext {
+    int64_t from;
+    int64_t to;
+    int64_t interval;
+    HistoryRollup *buckets;
+};
+
+static bool rollupBlock(const HistoryBlock &block, void *context){
+    RollupContext &rollup = *(RollupContext *)context;
+    // A block within a single bucket is taken from the index as is
+    if(block.firstTime < rollup.from || block.lastTime >= rollup.to) return false;
+    int64_t bucket = (block.firstTime - rollup.from) / rollup.interval;
+    if(bucket != (block.lastTime - rollup.from) / rollup.interval) return false;
+    HistoryRollup &target = rollup.buckets[bucket];
+    target.samples += block.count;
+    target.ambientTemperature.merge(block.ambientTemperature);
+    target.evaporatorTemperature.merge(block.evaporatorTemperature);
+    return true;
+}
+
+static void rollupSample(const HistorySample &sample, void *context){
+    RollupContext &rollup = *(RollupContext *)context;
+    HistoryRollup &target = rollup.buckets[(sample.time - rollup.from) / rollup.interval];
+    ++target.samples;
+    target.ambientTemperature.add(sample.ambientTemperature);
+    target.evaporatorTemperature.add(sample.evaporatorTemperature);
+}
+
+bool HistoryStore::visit(uint8_t peripheralID, const SegmentVisitor &visitor){
+    Series *found = series(peripheralID, false);
+    size_t first, last;
+    if(found == NULL || !segmentRange(*found, visitor.from, visitor.to, first, last)) return true;
+    for(size_t index = first; index <= last; ++index){
+        HistorySegmentFile *segment = mapForReading(*found, index);
+        if(segment == NULL) return false;
+        visitSegment(*segment, visitor);
+        release(*found, segment);
+    }
+    return true;
+}
+
+long HistoryStore::read(uint8_t peripheralID, int64_t from, int64_t to, HistorySampleCallback callback, void *context){
+    ReadContext read = {callback, context, 0};
+    SegmentVisitor visitor = {from, to, NULL, readSample, &read};
+    if(!visit(peripheralID, visitor)) return -1;
+    return read.count;
+}
+
+long HistoryStore::rollup(uint8_t peripheralID, int64_t from, int64_t to, int64_t interval, HistoryRollup *buckets, size_t capacity){
+    if(to <= from || capacity == 0) return 0;
+    if(interval <= 0) interval = to - from;
+    size_t count = (to - from + interval - 1) / interval;
+    if(count > capacity){
+        // Buckets past the capacity are left out
+        count = capacity;
+        to = from + (int64_t)count * interval;
+    }
+    for(size_t i = 0; i < count; ++i){
+        buckets[i].from = from + (int64_t)i * interval;
+        buckets[i].samples = 0;
+        buckets[i].ambientTemperature.clear();
+        buckets[i].evaporatorTemperature.clear();
+    }
+
+    RollupContext rollup = {from, to, interval, buckets};
+    SegmentVisitor visitor = {from, to, rollupBlock, rollupSample, &rollup};
+    if(!visit(peripheralID, visitor)) return -1;
+    return count;
+}
@@ -0,0 +1,186 @@
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+/*
+Append-only long-term history of controller snapshots for Linux / macOS
+hosts, e.g. to keep HACCP temperature records on the gateway for years.
+
+Every controller gets its own series of segment files named
+<peripheral ID>-<time of the first sample>.seg in the store's directory.
+A segment is memory mapped and holds:
+- an index with one entry per block of HISTORY_BLOCK_SAMPLES samples,
+  telling its time range and the minimum, maximum and sum of both
+  temperatures, which doubles as time index and as precomputed rollup
+- the sealed blocks, each column compressed on its own: timestamps as
+  delta of delta, temperatures as delta and status words XOR the previous
+  one, written with a prefix code so that an unchanged value takes one bit
+- the samples of the open block, uncompressed, so that a crash loses nothing.
+  A block whose seal was interrupted is sealed again when the segment is reopened.
+
+A poll every 10 s takes about 3 bytes per sample on disk. Range queries
+only decode the blocks that overlap the range, rollups only the blocks
+that don't fall into a single bucket, so a month of data is answered in
+milliseconds.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ControllerSnapshot.h"
+
+// Samples per compressed block
+#define HISTORY_BLOCK_SAMPLES 256
+
+// Blocks per segment file, 30 days at a 10 s poll interval
+#define HISTORY_SEGMENT_BLOCKS 1024
+
+#ifndef HISTORY_STORE_MAX_CONTROLLERS
+#define HISTORY_STORE_MAX_CONTROLLERS 64
+#endif
+
+// Temperature that wasn't read, equal to READ_ERROR
+#define HISTORY_NO_VALUE INT16_MIN
+
+// HistorySample::flags holds the SNAPSHOT_*_VALID flags and this one
+#define HISTORY_SAMPLE_RESPONSIVE 0x80
+
+/**
+ * @brief A stored snapshot.
+ */
+struct HistorySample {
+    // Seconds since the epoch
+    int64_t time;
+    // In 0.1 °C, HISTORY_NO_VALUE if not available
+    int16_t ambientTemperature;
+    int16_t evaporatorTemperature;
+    uint16_t outputStatus;
+    uint16_t inputStatus;
+    uint16_t alarmStatus;
+    uint16_t deviceStatus;
+    uint8_t flags;
+};
+
+/**
+ * @brief Minimum, maximum and mean of a temperature over a time range.
+ */
+struct HistoryChannel {
+    // Amount of samples with a value
+    uint32_t count;
+    int16_t minimum;
+    int16_t maximum;
+    int64_t sum;
+
+    void clear();
+    void add(int16_t value);
+    void merge(const HistoryChannel &other);
+
+    /**
+     * @brief The mean in 0.1 °C or NAN without values.
+     */
+    float mean() const;
+};
+
+/**
+ * @brief Aggregate of a bucket of a rollup query.
+ */
+struct HistoryRollup {
+    // Start of the bucket in seconds since the epoch
+    int64_t from;
+    uint32_t samples;
+    HistoryChannel ambientTemperature;
+    HistoryChannel evaporatorTemperature;
+};
+
+/**
+ * @brief Called with every sample of a range query in chronological order.
+ */
+typedef void (*HistorySampleCallback)(const HistorySample &sample, void *context);
+
+struct HistorySegmentFile;
+struct SegmentVisitor;
+
+class HistoryStore {
+private:
+    struct Series {
+        uint8_t peripheralID;
+        // Time of the first sample of every segment, ascending
+        int64_t *segments;
+        size_t segmentCount;
+        size_t segmentCapacity;
+        // The mapped newest segment while appending
+        HistorySegmentFile *active;
+        int64_t lastTime;
+    };
+
+    char _directory[256];
+    bool _writable;
+    Series _series[HISTORY_STORE_MAX_CONTROLLERS];
+    uint8_t _seriesCount;
+
+    Series *series(uint8_t peripheralID, bool create);
+    bool addSegment(Series &series, int64_t firstTime);
+    void segmentPath(char *path, size_t size, uint8_t peripheralID, int64_t firstTime) const;
+    HistorySegmentFile *map(uint8_t peripheralID, int64_t firstTime, bool writable) const;
+    void unmap(HistorySegmentFile *segment) const;
+    bool openActive(Series &series, int64_t time);
+
+    /**
+     * @brief Finds the segments of a series that may hold samples within [from, to).
+     * @return false if there are none.
+     */
+    bool segmentRange(const Series &series, int64_t from, int64_t to, size_t &first, size_t &last) const;
+    HistorySegmentFile *mapForReading(const Series &series, size_t index) const;
+    void release(const Series &series, HistorySegmentFile *segment) const;
+
+    /**
+     * @brief Passes the contents of all segments of a controller within the range of the visitor.
+     * @return false if a segment couldn't be mapped.
+     */
+    bool visit(uint8_t peripheralID, const SegmentVisitor &visitor);
+
+public:
+    HistoryStore();
+    ~HistoryStore();
+
+    /**
+     * @brief Opens the store and scans its directory for segments.
+     * @param directory The directory, which must exist.
+     * @param writable Whether samples are appended. Any number of processes
+     * can query a store while a single one appends to it.
+     * @return false if the directory can't be read.
+     */
+    bool begin(const char *directory, bool writable = true);
+
+    /**
+     * @brief Flushes and unmaps the open segments.
+     */
+    void end();
+
+    /**
+     * @brief Appends a snapshot to the series of a controller.
+     * @param time Seconds since the epoch, not older than the previous sample.
+     * @return false if the store is read-only, the time went backwards or a segment couldn't be created.
+     */
+    bool append(uint8_t peripheralID, int64_t time, const ControllerSnapshot &snapshot);
+
+    /**
+     * @brief Schedules writing the open segments to disk.
+     */
+    void sync();
+
+    /**
+     * @brief Reads the samples of a controller within [from, to).
+     * @return The amount of samples passed to the callback or -1 on failure.
+     */
+    long read(uint8_t peripheralID, int64_t from, int64_t to, HistorySampleCallback callback, void *context);
+
+    /**
+     * @brief Aggregates the temperatures of a controller within [from, to).
+     * @param interval The length of a bucket in seconds, 0 for a single bucket.
+     * @param buckets Receives the buckets, starting at from.
+     * @param capacity The size of the buckets array.
+     * @return The amount of buckets filled or -1 on failure.
+     */
+    long rollup(uint8_t peripheralID, int64_t from, int64_t to, int64_t interval, HistoryRollup *buckets, size_t capacity);
+};
+
+#endif
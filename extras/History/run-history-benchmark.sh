@@ -0,0 +1,36 @@
+#!/bin/bash
+
+# Builds the history store benchmark and the query tool for the host and
+# runs the benchmark. All arguments are passed on, e.g. --days 730.
+
+HISTORY_PATH=$(cd "$(dirname "$0")" && pwd)
+LIBRARY_PATH="$HISTORY_PATH/../../src"
+HOST_PATH="$HISTORY_PATH/../host"
+BUILD_PATH="$HISTORY_PATH/build"
+CXX=${CXX:-g++}
+
+mkdir -p "$BUILD_PATH"
+echo "🔧 Compiling history benchmark ..."
+$CXX -std=gnu++11 -O2 -Wall -I"$HOST_PATH" -I"$LIBRARY_PATH" \
+    "$HISTORY_PATH/HistoryBenchmark.cpp" \
+    "$HISTORY_PATH/HistoryStore.cpp" \
+    -o "$BUILD_PATH/HistoryBenchmark" && \
+$CXX -std=gnu++11 -O2 -Wall -I"$HOST_PATH" -I"$LIBRARY_PATH" \
+    "$HISTORY_PATH/HistoryQuery.cpp" \
+    "$HISTORY_PATH/HistoryStore.cpp" \
+    -o "$BUILD_PATH/HistoryQuery"
+
+if [ $? -ne 0 ]; then
+    echo "❌ Compilation failed."
+    exit 1
+fi
+
+"$BUILD_PATH/HistoryBenchmark" "$@"
+RESULT=$?
+
+if [ $RESULT -eq 0 ]; then
+    echo "✅ History benchmark passed."
+else
+    echo "❌ History benchmark failed."
+fi
+exit $RESULT
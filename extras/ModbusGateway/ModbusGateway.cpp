@@ -0,0 +1,431 @@
+/*
+Exposes Pego controllers on an RS485 bus as Modbus TCP units.
+
+Reads are answered from the cache of a PollScheduler, so any amount of TCP
+clients can poll at any rate while the RTU bus only carries the scheduler's
+load: one snapshot per controller and poll interval plus an occasional
+parameter refresh. Writes are passed to a CommandQueue that sends them
+ahead of the polling, their response is sent once the controller
+acknowledged them.
+
+The unit ID of a TCP request is the peripheral ID of the controller.
+Registers served from the cache:
+- 256 .. 257 temperatures
+- 512 .. 518, 768 .. 798 parameters
+- 1280 .. 1282 output, input and alarm status
+- 1536 device status
+
+With --shm every new snapshot is published into a shared memory table as
+well, which local processes read with SnapshotTableReader. With --history
+they are appended to a HistoryStore in the given directory, see HistoryQuery.
+
+Usage: ModbusGateway --units <id,id,...> [--device <path>] [--baud <rate>] [--listen <port>]
+                     [--interval <ms>] [--parameter-interval <ms>] [--direction auto|none|kernel|rts]
+                     [--shm <name>] [--history <directory>]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <ArduinoModbus.h>
+#include "PegoController.h"
+#include "PollScheduler.h"
+#include "BusSupervisor.h"
+#include "CommandQueue.h"
+#include "ModbusTcpServer.h"
+#include "SnapshotTable.h"
+#include "HistoryStore.h"
+#ifdef SIMULATE
+#include "MockModbusClient.h"
+#else
+#include "SerialModbusClient.h"
+#endif
+
+#define DEFAULT_LISTEN_PORT 502
+#define STATISTICS_INTERVAL 60000
+
+// Amount of TCP write requests waiting for the bus
+#define PENDING_WRITES 16
+
+#define MODBUS_READ_HOLDING_REGISTERS 0x03
+#define MODBUS_READ_INPUT_REGISTERS 0x04
+#define MODBUS_WRITE_SINGLE_REGISTER 0x06
+#define MODBUS_WRITE_MULTIPLE_REGISTERS 0x10
+
+struct Gateway;
+
+/**
+ * @brief A TCP write request, forwarded as one queued command per register.
+ */
+struct PendingWrite {
+    bool used;
+    Gateway *gateway;
+    ModbusTcpRequest request;
+    uint8_t index;
+    uint16_t address;
+    uint8_t count;
+    uint8_t remaining;
+    uint16_t commands[123];
+    // Exception code to respond with, 0 if all registers were written
+    uint8_t exception;
+};
+
+struct Gateway {
+    PollScheduler *scheduler;
+    CommandQueue *commands;
+    ModbusTcpServer *server;
+    PendingWrite writes[PENDING_WRITES];
+    unsigned long cacheReads;
+    unsigned long forwardedWrites;
+};
+
+static volatile bool running = true;
+
+static void stop(int){
+    running = false;
+}
+
+static bool parameterRegister(uint16_t address){
+    return (address >= PARAMETER_BLOCK_BASE_FIRST && address < PARAMETER_BLOCK_BASE_FIRST + PARAMETER_BLOCK_BASE_COUNT) ||
+           (address >= PARAMETER_BLOCK_EXPERT_FIRST && address < PARAMETER_BLOCK_EXPERT_FIRST + PARAMETER_BLOCK_EXPERT_COUNT) ||
+           (address >= PARAMETER_BLOCK_CONFIGURATION_FIRST && address < PARAMETER_BLOCK_CONFIGURATION_FIRST + PARAMETER_BLOCK_CONFIGURATION_COUNT);
+}
+
+/**
+ * @brief Looks up a register in the cache.
+ * @return 0 on success or the exception code to respond with.
+ */
+static uint8_t cachedRegister(PollScheduler &scheduler, uint8_t index, uint16_t address, uint16_t &value){
+    const ControllerSnapshot &snapshot = scheduler.snapshot(index);
+    uint8_t validFlag;
+    switch(address){
+        case 256: value = snapshot.ambientTemperature; validFlag = SNAPSHOT_TEMPERATURES_VALID; break;
+        case 257: value = snapshot.evaporatorTemperature; validFlag = SNAPSHOT_TEMPERATURES_VALID; break;
+        case 1280: value = snapshot.outputStatus; validFlag = SNAPSHOT_STATUS_VALID; break;
+        case 1281: value = snapshot.inputStatus; validFlag = SNAPSHOT_STATUS_VALID; break;
+        case 1282: value = snapshot.alarmStatus; validFlag = SNAPSHOT_STATUS_VALID; break;
+        case 1536: value = snapshot.deviceStatus; validFlag = SNAPSHOT_DEVICE_STATUS_VALID; break;
+        default:
+            if(!parameterRegister(address)) return MODBUS_TCP_ILLEGAL_DATA_ADDRESS;
+            if(!scheduler.parameters(index).get(address, value)){
+                // Either not provided by the model or not read yet
+                bool baseParameter = address >= PARAMETER_BLOCK_BASE_FIRST && address < PARAMETER_BLOCK_BASE_FIRST + PARAMETER_BLOCK_BASE_COUNT;
+                if(!baseParameter && scheduler.controller(index).model() == PEGO_MODEL_ECP_BASE) return MODBUS_TCP_ILLEGAL_DATA_ADDRESS;
+                return MODBUS_TCP_GATEWAY_TARGET_FAILED;
+            }
+            return 0;
+    }
+    if(!(snapshot.valid & validFlag) || !snapshot.responsive) return MODBUS_TCP_GATEWAY_TARGET_FAILED;
+    return 0;
+}
+
+static void handleRead(Gateway &gateway, ModbusTcpServer &server, const ModbusTcpRequest &request, uint8_t index){
+    if(request.length != 5){
+        server.respondException(request, MODBUS_TCP_ILLEGAL_DATA_VALUE);
+        return;
+    }
+    uint16_t address = (request.pdu[1] << 8) | request.pdu[2];
+    uint16_t count = (request.pdu[3] << 8) | request.pdu[4];
+    if(count < 1 || count > 125){
+        server.respondException(request, MODBUS_TCP_ILLEGAL_DATA_VALUE);
+        return;
+    }
+
+    uint8_t pdu[2 + 2 * 125];
+    pdu[0] = request.pdu[0];
+    pdu[1] = 2 * count;
+    for(uint16_t i = 0; i < count; ++i){
+        uint16_t value;
+        uint8_t exception = cachedRegister(*gateway.scheduler, index, address + i, value);
+        if(exception != 0){
+            server.respondException(request, exception);
+            return;
+        }
+        pdu[2 + 2 * i] = highByte(value);
+        pdu[3 + 2 * i] = lowByte(value);
+    }
+    ++gateway.cacheReads;
+    server.respond(request, pdu, 2 + 2 * count);
+}
+
+/**
+ * @brief Maps why a forwarded write failed to the exception code to respond with.
+ * Exceptions of the controller are forwarded, anything else means it didn't answer.
+ */
+static uint8_t forwardedException(ModbusErrorKind kind){
+    switch(kind){
+        case MODBUS_ERROR_ILLEGAL_FUNCTION: return MODBUS_TCP_ILLEGAL_FUNCTION;
+        case MODBUS_ERROR_ILLEGAL_ADDRESS:
+        case MODBUS_ERROR_UNSUPPORTED: return MODBUS_TCP_ILLEGAL_DATA_ADDRESS;
+        case MODBUS_ERROR_ILLEGAL_VALUE: return MODBUS_TCP_ILLEGAL_DATA_VALUE;
+        case MODBUS_ERROR_DEVICE_FAILURE: return MODBUS_TCP_SERVER_DEVICE_FAILURE;
+        case MODBUS_ERROR_BUSY: return MODBUS_TCP_SERVER_DEVICE_BUSY;
+        default: return MODBUS_TCP_GATEWAY_TARGET_FAILED;
+    }
+}
+
+static void writeFinished(uint16_t id, CommandResult result, void *context){
+    PendingWrite &write = *(PendingWrite *)context;
+    Gateway &gateway = *write.gateway;
+    if(result != COMMAND_COMPLETED && write.exception == 0){
+        // Dropped commands never reached the controller, so its last error belongs to another transaction
+        bool sent = result == COMMAND_FAILED;
+        write.exception = sent ? forwardedException(gateway.scheduler->controller(write.index).lastErrorKind()) : MODBUS_TCP_GATEWAY_TARGET_FAILED;
+        // The remaining registers of the request are not written anymore
+        for(uint8_t i = 0; i < write.count; ++i){
+            if(write.commands[i] != id) gateway.commands->cancel(write.commands[i]);
+        }
+    }
+    if(--write.remaining > 0) return;
+
+    // Refresh the cache so that clients read back what they wrote
+    for(uint8_t i = 0; i < write.count; ++i){
+        uint16_t address = write.address + i;
+        if(parameterRegister(address)) gateway.scheduler->requestParameters(write.index);
+        if(address == 1536) gateway.scheduler->requestPoll(write.index);
+    }
+    ++gateway.forwardedWrites;
+
+    if(write.exception != 0){
+        gateway.server->respondException(write.request, write.exception);
+    } else {
+        // Both write functions echo address and value / quantity
+        gateway.server->respond(write.request, write.request.pdu, 5);
+    }
+    write.used = false;
+}
+
+static void handleWrite(Gateway &gateway, ModbusTcpServer &server, const ModbusTcpRequest &request, uint8_t index){
+    PendingWrite *slot = NULL;
+    for(uint8_t i = 0; i < PENDING_WRITES && slot == NULL; ++i){
+        if(!gateway.writes[i].used) slot = &gateway.writes[i];
+    }
+    if(slot == NULL){
+        server.respondException(request, MODBUS_TCP_SERVER_DEVICE_BUSY);
+        return;
+    }
+    PendingWrite &write = *slot;
+    uint16_t values[123];
+    write.address = (request.pdu[1] << 8) | request.pdu[2];
+
+    if(request.pdu[0] == MODBUS_WRITE_SINGLE_REGISTER){
+        if(request.length != 5){
+            server.respondException(request, MODBUS_TCP_ILLEGAL_DATA_VALUE);
+            return;
+        }
+        write.count = 1;
+        values[0] = (request.pdu[3] << 8) | request.pdu[4];
+    } else {
+        uint16_t count = (request.pdu[3] << 8) | request.pdu[4];
+        if(count < 1 || count > 123 || request.length != 6 + 2 * count || request.pdu[5] != 2 * count){
+            server.respondException(request, MODBUS_TCP_ILLEGAL_DATA_VALUE);
+            return;
+        }
+        write.count = count;
+        for(uint16_t i = 0; i < count; ++i){
+            values[i] = (request.pdu[6 + 2 * i] << 8) | request.pdu[7 + 2 * i];
+        }
+    }
+
+    for(uint8_t i = 0; i < write.count; ++i){
+        uint16_t address = write.address + i;
+        if(address != 1536 && !parameterRegister(address)){
+            server.respondException(request, MODBUS_TCP_ILLEGAL_DATA_ADDRESS);
+            return;
+        }
+    }
+    if(gateway.commands->pending() + write.count > COMMAND_QUEUE_SIZE){
+        server.respondException(request, MODBUS_TCP_SERVER_DEVICE_BUSY);
+        return;
+    }
+
+    write.used = true;
+    write.gateway = &gateway;
+    write.request = request;
+    write.index = index;
+    write.remaining = write.count;
+    write.exception = 0;
+    PegoController &controller = gateway.scheduler->controller(index);
+    // Every client expects its own write to reach the controller, so nothing is superseded
+    for(uint8_t i = 0; i < write.count; ++i){
+        write.commands[i] = gateway.commands->enqueueWrite(controller, write.address + i, values[i], COMMAND_PRIORITY_OPERATOR, false, writeFinished, &write);
+    }
+}
+
+static void handleRequest(ModbusTcpServer &server, const ModbusTcpRequest &request, void *context){
+    Gateway &gateway = *(Gateway *)context;
+    if(request.length < 1) return;
+    int8_t index = gateway.scheduler->indexOf(request.unitID);
+    if(index < 0){
+        server.respondException(request, MODBUS_TCP_GATEWAY_PATH_UNAVAILABLE);
+        return;
+    }
+    switch(request.pdu[0]){
+        case MODBUS_READ_HOLDING_REGISTERS:
+        case MODBUS_READ_INPUT_REGISTERS:
+            handleRead(gateway, server, request, index);
+            break;
+        case MODBUS_WRITE_SINGLE_REGISTER:
+        case MODBUS_WRITE_MULTIPLE_REGISTERS:
+            handleWrite(gateway, server, request, index);
+            break;
+        default:
+            server.respondException(request, MODBUS_TCP_ILLEGAL_FUNCTION);
+    }
+}
+
+static void usage(const char *name){
+    fprintf(stderr, "Usage: %s --units <id,id,...> [--device <path>] [--baud <rate>] [--listen <port>] [--interval <ms>] [--parameter-interval <ms>] [--direction auto|none|kernel|rts] [--shm <name>] [--history <directory>]\n", name);
+}
+
+int main(int argc, char **argv){
+    const char *device = "/dev/ttyUSB0";
+    const char *units = NULL;
+    unsigned long baudRate = RS485_DEFAULT_BAUD_RATE;
+    unsigned long pollInterval = POLL_SCHEDULER_DEFAULT_INTERVAL;
+    unsigned long parameterInterval = POLL_SCHEDULER_DEFAULT_PARAMETER_INTERVAL;
+    uint16_t port = DEFAULT_LISTEN_PORT;
+    const char *direction = "auto";
+    const char *tableName = NULL;
+    const char *historyDirectory = NULL;
+
+    for(int i = 1; i < argc; ++i){
+        bool hasValue = i + 1 < argc;
+        if(strcmp(argv[i], "--device") == 0 && hasValue){
+            device = argv[++i];
+        } else if(strcmp(argv[i], "--units") == 0 && hasValue){
+            units = argv[++i];
+        } else if(strcmp(argv[i], "--baud") == 0 && hasValue){
+            baudRate = strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--listen") == 0 && hasValue){
+            port = strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--interval") == 0 && hasValue){
+            pollInterval = strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--parameter-interval") == 0 && hasValue){
+            parameterInterval = strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--direction") == 0 && hasValue){
+            direction = argv[++i];
+        } else if(strcmp(argv[i], "--shm") == 0 && hasValue){
+            tableName = argv[++i];
+        } else if(strcmp(argv[i], "--history") == 0 && hasValue){
+            historyDirectory = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if(units == NULL){
+        usage(argv[0]);
+        return 2;
+    }
+
+    #ifdef SIMULATE
+    // Every simulated controller answers with the same cold room at 4.5 °C
+    (void)device;
+    (void)direction;
+    MockBus.setRegister(256, 45);
+    MockBus.setRegister(257, (uint16_t)-120);
+    MockBus.setRegister(768, 40);
+    MockBus.setRegister(1280, bit(OUTPUT_STATUS_COMPRESSOR_RELAY_BIT) | bit(OUTPUT_STATUS_FANS_RELAY_BIT));
+    #else
+    serialModbusSetPort(device);
+    if(strcmp(direction, "none") == 0){
+        serialModbusSetDirectionControl(SERIAL_DIRECTION_NONE);
+    } else if(strcmp(direction, "kernel") == 0){
+        serialModbusSetDirectionControl(SERIAL_DIRECTION_KERNEL);
+    } else if(strcmp(direction, "rts") == 0){
+        serialModbusSetDirectionControl(SERIAL_DIRECTION_RTS);
+    }
+    #endif
+
+    static PegoController *controllers[POLL_SCHEDULER_MAX_CONTROLLERS];
+    static PollScheduler scheduler(pollInterval, parameterInterval);
+    BusSupervisor supervisor(baudRate);
+
+    char *list = strdup(units);
+    for(char *unit = strtok(list, ","); unit != NULL; unit = strtok(NULL, ",")){
+        uint8_t id = atoi(unit);
+        if(id < 1 || id > 247 || scheduler.indexOf(id) >= 0 || scheduler.count() >= POLL_SCHEDULER_MAX_CONTROLLERS){
+            fprintf(stderr, "Invalid or duplicate unit ID: %s\n", unit);
+            return 2;
+        }
+        PegoController *controller = new PegoController(baudRate, id);
+        controller->setBusSupervisor(&supervisor);
+        controllers[scheduler.count()] = controller;
+        scheduler.add(*controller);
+    }
+    free(list);
+
+    if(!controllers[0]->begin()){
+        fprintf(stderr, "Couldn't open the RTU bus on %s\n", device);
+        return 1;
+    }
+
+    static CommandQueue commands;
+    commands.setScheduler(&scheduler);
+    ModbusTcpServer server;
+    static Gateway gateway;
+    gateway.scheduler = &scheduler;
+    gateway.commands = &commands;
+    gateway.server = &server;
+    if(!server.begin(port, handleRequest, &gateway)){
+        fprintf(stderr, "Couldn't listen on port %u\n", port);
+        return 1;
+    }
+    SnapshotTableWriter table;
+    if(tableName != NULL && !table.begin(tableName, scheduler.count())){
+        perror(tableName);
+        return 1;
+    }
+    HistoryStore history;
+    if(historyDirectory != NULL && !history.begin(historyDirectory)){
+        perror(historyDirectory);
+        return 1;
+    }
+    // Timestamp of the last published snapshot per controller
+    static unsigned long published[POLL_SCHEDULER_MAX_CONTROLLERS];
+    printf("Serving %u controller(s) on port %u\n", scheduler.count(), port);
+    fflush(stdout);
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    unsigned long lastStatistics = millis();
+    while(running){
+        // A single bus transaction per iteration, so that TCP clients
+        // are served between two of them
+        server.poll(commands.update() ? 0 : 10);
+        supervisor.update();
+
+        if(tableName != NULL || historyDirectory != NULL){
+            for(uint8_t i = 0; i < scheduler.count(); ++i){
+                const ControllerSnapshot &snapshot = scheduler.snapshot(i);
+                if(snapshot.timestamp == published[i]) continue;
+                uint8_t peripheralID = scheduler.controller(i).peripheralID();
+                if(tableName != NULL) table.publish(i, peripheralID, snapshot);
+                if(historyDirectory != NULL) history.append(peripheralID, time(NULL), snapshot);
+                published[i] = snapshot.timestamp;
+            }
+        }
+
+        if(millis() - lastStatistics >= STATISTICS_INTERVAL){
+            lastStatistics = millis();
+            printf("Clients: %u, requests: %lu, cache reads: %lu, forwarded writes: %lu, bus polls: %lu\n",
+                server.connectionCount(), server.requestCount(), gateway.cacheReads, gateway.forwardedWrites, scheduler.pollCount());
+            commands.printStatistics(Serial);
+            #ifndef SIMULATE
+            SerialModbusStatistics bus;
+            serialModbusStatistics(bus);
+            if(bus.transactions > 0){
+                printf("RTU round trip: mean %llu µs, max %lu µs, wire time %llu µs, failed: %lu\n",
+                    bus.roundTripSum / bus.transactions, bus.maximumRoundTrip, bus.wireTimeSum / bus.transactions, bus.failures);
+            }
+            serialModbusResetStatistics();
+            #endif
+            fflush(stdout);
+        }
+    }
+    ModbusRTUClient.end();
+    return 0;
+}
@@ -0,0 +1,184 @@
+#include "ModbusTcpServer.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+ModbusTcpServer::ModbusTcpServer() :
+_listenSocket(-1),
+_nextConnectionID(1),
+_handler(NULL),
+_context(NULL),
+_requests(0)
+{
+    for(uint8_t i = 0; i < MODBUS_TCP_MAX_CONNECTIONS; ++i){
+        _connections[i].socket = -1;
+    }
+}
+
+bool ModbusTcpServer::begin(uint16_t port, ModbusTcpRequestHandler handler, void *context){
+    _handler = handler;
+    _context = context;
+    _listenSocket = socket(AF_INET6, SOCK_STREAM, 0);
+    if(_listenSocket < 0){
+        perror("socket");
+        return false;
+    }
+    int enabled = 1;
+    int disabled = 0;
+    setsockopt(_listenSocket, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled));
+    // Accept IPv4 clients as well
+    setsockopt(_listenSocket, IPPROTO_IPV6, IPV6_V6ONLY, &disabled, sizeof(disabled));
+
+    struct sockaddr_in6 address;
+    memset(&address, 0, sizeof(address));
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons(port);
+    if(bind(_listenSocket, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(_listenSocket, 16) != 0){
+        perror("bind");
+        ::close(_listenSocket);
+        _listenSocket = -1;
+        return false;
+    }
+    fcntl(_listenSocket, F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+void ModbusTcpServer::accept(){
+    int client = ::accept(_listenSocket, NULL, NULL);
+    if(client < 0) return;
+    for(uint8_t i = 0; i < MODBUS_TCP_MAX_CONNECTIONS; ++i){
+        Connection &connection = _connections[i];
+        if(connection.socket >= 0) continue;
+        int enabled = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+        fcntl(client, F_SETFL, O_NONBLOCK);
+        connection.socket = client;
+        connection.id = _nextConnectionID++;
+        connection.length = 0;
+        return;
+    }
+    // No free slot
+    ::close(client);
+}
+
+void ModbusTcpServer::close(Connection &connection){
+    ::close(connection.socket);
+    connection.socket = -1;
+}
+
+void ModbusTcpServer::receive(Connection &connection){
+    ssize_t count = recv(connection.socket, connection.buffer + connection.length, sizeof(connection.buffer) - connection.length, 0);
+    if(count == 0 || (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)){
+        close(connection);
+        return;
+    }
+    if(count < 0) return;
+    connection.length += count;
+
+    // Several requests may arrive in one segment when clients pipeline them
+    while(connection.length >= MODBUS_TCP_HEADER_SIZE){
+        uint8_t *header = connection.buffer;
+        uint16_t protocolID = (header[2] << 8) | header[3];
+        uint16_t length = (header[4] << 8) | header[5];
+        if(protocolID != 0 || length < 2 || length > MODBUS_TCP_MAX_PDU + 1){
+            close(connection);
+            return;
+        }
+        size_t frameLength = MODBUS_TCP_HEADER_SIZE - 1 + length;
+        if(connection.length < frameLength) return;
+
+        ModbusTcpRequest request;
+        request.connection = connection.id;
+        request.transactionID = (header[0] << 8) | header[1];
+        request.unitID = header[6];
+        request.length = length - 1;
+        memcpy(request.pdu, header + MODBUS_TCP_HEADER_SIZE, request.length);
+
+        connection.length -= frameLength;
+        memmove(connection.buffer, connection.buffer + frameLength, connection.length);
+        ++_requests;
+        _handler(*this, request, _context);
+        // The handler may have responded to a connection that failed in the meantime
+        if(connection.socket < 0) return;
+    }
+}
+
+void ModbusTcpServer::poll(int timeout){
+    struct pollfd descriptors[MODBUS_TCP_MAX_CONNECTIONS + 1];
+    Connection *connections[MODBUS_TCP_MAX_CONNECTIONS + 1];
+    nfds_t count = 0;
+    if(_listenSocket >= 0){
+        descriptors[count].fd = _listenSocket;
+        descriptors[count].events = POLLIN;
+        connections[count++] = NULL;
+    }
+    for(uint8_t i = 0; i < MODBUS_TCP_MAX_CONNECTIONS; ++i){
+        if(_connections[i].socket < 0) continue;
+        descriptors[count].fd = _connections[i].socket;
+        descriptors[count].events = POLLIN;
+        connections[count++] = &_connections[i];
+    }
+    if(::poll(descriptors, count, timeout) <= 0) return;
+
+    for(nfds_t i = 0; i < count; ++i){
+        if(descriptors[i].revents == 0) continue;
+        if(connections[i] == NULL){
+            accept();
+        } else if(connections[i]->socket >= 0){
+            receive(*connections[i]);
+        }
+    }
+}
+
+ModbusTcpServer::Connection *ModbusTcpServer::find(unsigned long connection){
+    for(uint8_t i = 0; i < MODBUS_TCP_MAX_CONNECTIONS; ++i){
+        if(_connections[i].socket >= 0 && _connections[i].id == connection) return &_connections[i];
+    }
+    return NULL;
+}
+
+bool ModbusTcpServer::respond(const ModbusTcpRequest &request, const uint8_t *pdu, uint8_t length){
+    Connection *connection = find(request.connection);
+    if(connection == NULL) return false;
+
+    uint8_t frame[MODBUS_TCP_HEADER_SIZE + MODBUS_TCP_MAX_PDU];
+    frame[0] = highByte(request.transactionID);
+    frame[1] = lowByte(request.transactionID);
+    frame[2] = 0;
+    frame[3] = 0;
+    frame[4] = highByte(length + 1);
+    frame[5] = lowByte(length + 1);
+    frame[6] = request.unitID;
+    memcpy(frame + MODBUS_TCP_HEADER_SIZE, pdu, length);
+
+    size_t frameLength = MODBUS_TCP_HEADER_SIZE + length;
+    if(send(connection->socket, frame, frameLength, MSG_NOSIGNAL) != (ssize_t)frameLength){
+        // A client that doesn't read its responses is dropped
+        close(*connection);
+        return false;
+    }
+    return true;
+}
+
+bool ModbusTcpServer::respondException(const ModbusTcpRequest &request, uint8_t exceptionCode){
+    uint8_t pdu[2] = {(uint8_t)(request.pdu[0] | 0x80), exceptionCode};
+    return respond(request, pdu, sizeof(pdu));
+}
+
+uint8_t ModbusTcpServer::connectionCount() const {
+    uint8_t count = 0;
+    for(uint8_t i = 0; i < MODBUS_TCP_MAX_CONNECTIONS; ++i){
+        if(_connections[i].socket >= 0) ++count;
+    }
+    return count;
+}
+
+unsigned long ModbusTcpServer::requestCount() const {
+    return _requests;
+}
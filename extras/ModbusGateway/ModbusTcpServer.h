@@ -0,0 +1,107 @@
+#ifndef MODBUS_TCP_SERVER_H
+#define MODBUS_TCP_SERVER_H
+
+#include <Arduino.h>
+
+// Maximum amount of simultaneously connected TCP clients
+#define MODBUS_TCP_MAX_CONNECTIONS 32
+
+// MBAP header: transaction ID (2), protocol ID (2), length (2), unit ID (1)
+#define MODBUS_TCP_HEADER_SIZE 7
+#define MODBUS_TCP_MAX_PDU 253
+
+// Exception codes
+#define MODBUS_TCP_ILLEGAL_FUNCTION 0x01
+#define MODBUS_TCP_ILLEGAL_DATA_ADDRESS 0x02
+#define MODBUS_TCP_ILLEGAL_DATA_VALUE 0x03
+#define MODBUS_TCP_SERVER_DEVICE_FAILURE 0x04
+#define MODBUS_TCP_SERVER_DEVICE_BUSY 0x06
+#define MODBUS_TCP_GATEWAY_PATH_UNAVAILABLE 0x0A
+#define MODBUS_TCP_GATEWAY_TARGET_FAILED 0x0B
+
+/**
+ * @brief A request received from a TCP client.
+ * It can be answered right away or kept and answered later,
+ * the response is dropped if the client disconnected in the meantime.
+ */
+struct ModbusTcpRequest {
+    // Identifies the connection the request arrived on
+    unsigned long connection;
+    uint16_t transactionID;
+    uint8_t unitID;
+    uint8_t pdu[MODBUS_TCP_MAX_PDU];
+    uint8_t length;
+};
+
+class ModbusTcpServer;
+
+/**
+ * @brief Called for every complete request.
+ */
+typedef void (*ModbusTcpRequestHandler)(ModbusTcpServer &server, const ModbusTcpRequest &request, void *context);
+
+/**
+ * @brief Single threaded Modbus TCP server on non-blocking POSIX sockets.
+ */
+class ModbusTcpServer {
+private:
+    struct Connection {
+        int socket;
+        unsigned long id;
+        uint8_t buffer[MODBUS_TCP_HEADER_SIZE + MODBUS_TCP_MAX_PDU];
+        size_t length;
+    };
+
+    int _listenSocket;
+    Connection _connections[MODBUS_TCP_MAX_CONNECTIONS];
+    unsigned long _nextConnectionID;
+    ModbusTcpRequestHandler _handler;
+    void *_context;
+    unsigned long _requests;
+
+    void accept();
+    void receive(Connection &connection);
+    void close(Connection &connection);
+    Connection *find(unsigned long connection);
+
+public:
+    ModbusTcpServer();
+
+    /**
+     * @brief Starts listening for clients.
+     * @param port The TCP port, 502 is the standard Modbus port.
+     * @param handler Called for every complete request.
+     * @param context Passed on to the handler.
+     * @return false if the port couldn't be opened.
+     */
+    bool begin(uint16_t port, ModbusTcpRequestHandler handler, void *context = NULL);
+
+    /**
+     * @brief Waits for socket activity and dispatches the received requests.
+     * @param timeout Maximum time to wait in ms.
+     */
+    void poll(int timeout);
+
+    /**
+     * @brief Sends a response PDU to the client of a request.
+     * @return false if the client is gone.
+     */
+    bool respond(const ModbusTcpRequest &request, const uint8_t *pdu, uint8_t length);
+
+    /**
+     * @brief Sends an exception response for a request.
+     */
+    bool respondException(const ModbusTcpRequest &request, uint8_t exceptionCode);
+
+    /**
+     * @brief Amount of connected clients.
+     */
+    uint8_t connectionCount() const;
+
+    /**
+     * @brief Amount of requests received since start.
+     */
+    unsigned long requestCount() const;
+};
+
+#endif
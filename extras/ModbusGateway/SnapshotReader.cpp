@@ -0,0 +1,71 @@
+/*
+Prints the snapshots the gateway publishes with --shm, as an example of a
+local consumer. Reading takes no bus access and no system calls.
+
+Usage: SnapshotReader [--name <shm name>] [--watch <ms>]
+With --watch the table is checked at the given interval and every
+controller is printed again once it was published anew.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "SnapshotTable.h"
+
+static uint64_t wallClock(){
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void printRecord(const SnapshotTableRecord &record){
+    const ControllerSnapshot &snapshot = record.snapshot;
+    printf("%3u  %6.1f s  %-12s", record.peripheralID, (wallClock() - record.updated) / 1000.0,
+        snapshot.responsive ? "responsive" : "unresponsive");
+    if(snapshot.valid & SNAPSHOT_TEMPERATURES_VALID){
+        printf("  %5.1f °C  %5.1f °C", snapshot.ambientTemperature / 10.0, snapshot.evaporatorTemperature / 10.0);
+    } else {
+        printf("  %8s  %8s", "-", "-");
+    }
+    if(snapshot.valid & SNAPSHOT_STATUS_VALID){
+        printf("  out %04X  in %04X  alarm %04X", snapshot.outputStatus, snapshot.inputStatus, snapshot.alarmStatus);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv){
+    const char *name = SNAPSHOT_TABLE_DEFAULT_NAME;
+    unsigned long watch = 0;
+    for(int i = 1; i < argc; ++i){
+        bool hasValue = i + 1 < argc;
+        if(strcmp(argv[i], "--name") == 0 && hasValue){
+            name = argv[++i];
+        } else if(strcmp(argv[i], "--watch") == 0 && hasValue){
+            watch = strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "Usage: %s [--name <shm name>] [--watch <ms>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    SnapshotTableReader table;
+    if(!table.open(name)){
+        fprintf(stderr, "No snapshot table %s\n", name);
+        return 1;
+    }
+    if(!table.writerAlive()) printf("The gateway isn't running, showing the last published values\n");
+
+    static uint32_t sequences[UINT16_MAX + 1];
+    do {
+        for(uint16_t i = 0; i < table.count(); ++i){
+            if(table.sequence(i) == sequences[i]) continue;
+            SnapshotTableRecord record;
+            if(table.read(i, record, &sequences[i])) printRecord(record);
+        }
+        fflush(stdout);
+        if(watch > 0) usleep(watch * 1000);
+    } while(watch > 0);
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include "SnapshotTable.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SNAPSHOT_TABLE_RECORD_WORDS (sizeof(((SnapshotTableSlot *)0)->words) / 4)
+
+static size_t tableSize(size_t capacity){
+    return sizeof(SnapshotTableHeader) + capacity * sizeof(SnapshotTableSlot);
+}
+
+static uint64_t wallClock(){
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+SnapshotTableWriter::SnapshotTableWriter() :
+_header(NULL),
+_slots(NULL),
+_size(0)
+{}
+
+SnapshotTableWriter::~SnapshotTableWriter(){
+    end();
+}
+
+/**
+ * @brief Maps an existing object if its layout matches the given capacity.
+ * @return The mapping or NULL if the object doesn't exist or is laid out differently.
+ */
+static SnapshotTableHeader *mapCompatible(const char *name, uint16_t capacity){
+    int fd = shm_open(name, O_RDWR, 0);
+    if(fd < 0) return NULL;
+    size_t size = tableSize(capacity);
+    struct stat status;
+    if(fstat(fd, &status) != 0 || (size_t)status.st_size != size){
+        ::close(fd);
+        return NULL;
+    }
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(memory == MAP_FAILED) return NULL;
+
+    SnapshotTableHeader *header = (SnapshotTableHeader *)memory;
+    if(header->magic != SNAPSHOT_TABLE_MAGIC || header->version != SNAPSHOT_TABLE_VERSION ||
+       header->slotSize != sizeof(SnapshotTableSlot) || header->capacity != capacity){
+        munmap(memory, size);
+        return NULL;
+    }
+    return header;
+}
+
+bool SnapshotTableWriter::begin(const char *name, uint16_t capacity){
+    end();
+    size_t size = tableSize(capacity);
+    SnapshotTableHeader *header = mapCompatible(name, capacity);
+    if(header != NULL){
+        // The slots of the previous writer stay readable. One that died in
+        // the middle of a publication left an odd sequence behind.
+        SnapshotTableSlot *slots = (SnapshotTableSlot *)(header + 1);
+        for(uint16_t i = 0; i < capacity; ++i){
+            uint32_t sequence = slots[i].sequence;
+            if(sequence & 1) __atomic_store_n(&slots[i].sequence, sequence + 1, __ATOMIC_RELEASE);
+        }
+    } else {
+        // Readers may still map an object with another layout. Resizing it in place
+        // would let them fault with SIGBUS, so a new object replaces it under the
+        // same name and they keep the old one until they reopen.
+        shm_unlink(name);
+        int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+        if(fd < 0) return false;
+        if(ftruncate(fd, size) != 0){
+            ::close(fd);
+            shm_unlink(name);
+            return false;
+        }
+        void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(memory == MAP_FAILED){
+            shm_unlink(name);
+            return false;
+        }
+        // A new object is zero filled, i.e. no slot has been published yet
+        header = (SnapshotTableHeader *)memory;
+        header->version = SNAPSHOT_TABLE_VERSION;
+        header->slotSize = sizeof(SnapshotTableSlot);
+        header->capacity = capacity;
+    }
+
+    _header = header;
+    _slots = (SnapshotTableSlot *)(header + 1);
+    _size = size;
+    _header->writerPid = getpid();
+    __atomic_store_n(&_header->magic, SNAPSHOT_TABLE_MAGIC, __ATOMIC_RELEASE);
+    return true;
+}
+
+void SnapshotTableWriter::end(){
+    if(_header == NULL) return;
+    __atomic_store_n(&_header->writerPid, 0, __ATOMIC_RELEASE);
+    munmap(_header, _size);
+    _header = NULL;
+    _slots = NULL;
+    _size = 0;
+}
+
+bool SnapshotTableWriter::publish(uint16_t index, uint8_t peripheralID, const ControllerSnapshot &snapshot){
+    if(_header == NULL || tableSize((size_t)index + 1) > _size) return false;
+    SnapshotTableSlot &slot = _slots[index];
+
+    // Composed on the stack, so that the slot is only touched while it is locked
+    SnapshotTableSlot update;
+    memset(&update, 0, sizeof(update));
+    update.record.updated = wallClock();
+    update.record.peripheralID = peripheralID;
+    update.record.snapshot = snapshot;
+
+    // Only this process writes the sequence, so it doesn't need to be loaded atomically
+    uint32_t sequence = slot.sequence;
+    __atomic_store_n(&slot.sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for(size_t i = 0; i < SNAPSHOT_TABLE_RECORD_WORDS; ++i){
+        __atomic_store_n(&slot.words[i], update.words[i], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&slot.sequence, sequence + 2, __ATOMIC_RELEASE);
+
+    if(index >= _header->count) __atomic_store_n(&_header->count, index + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+SnapshotTableReader::SnapshotTableReader() :
+_header(NULL),
+_slots(NULL),
+_size(0)
+{}
+
+SnapshotTableReader::~SnapshotTableReader(){
+    close();
+}
+
+bool SnapshotTableReader::open(const char *name){
+    close();
+    int fd = shm_open(name, O_RDONLY, 0);
+    if(fd < 0) return false;
+    struct stat status;
+    if(fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(SnapshotTableHeader)){
+        ::close(fd);
+        return false;
+    }
+    size_t size = status.st_size;
+    void *memory = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(memory == MAP_FAILED) return false;
+
+    const SnapshotTableHeader *header = (const SnapshotTableHeader *)memory;
+    bool compatible = __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) == SNAPSHOT_TABLE_MAGIC &&
+                      header->version == SNAPSHOT_TABLE_VERSION && header->slotSize == sizeof(SnapshotTableSlot) &&
+                      tableSize(header->capacity) <= size;
+    if(!compatible){
+        munmap(memory, size);
+        return false;
+    }
+    _header = header;
+    _slots = (const SnapshotTableSlot *)(header + 1);
+    _size = size;
+    return true;
+}
+
+void SnapshotTableReader::close(){
+    if(_header == NULL) return;
+    munmap((void *)_header, _size);
+    _header = NULL;
+    _slots = NULL;
+    _size = 0;
+}
+
+uint16_t SnapshotTableReader::count() const {
+    if(_header == NULL) return 0;
+    return __atomic_load_n(&_header->count, __ATOMIC_ACQUIRE);
+}
+
+bool SnapshotTableReader::writerAlive() const {
+    if(_header == NULL) return false;
+    int32_t pid = __atomic_load_n(&_header->writerPid, __ATOMIC_ACQUIRE);
+    return pid != 0 && kill(pid, 0) == 0;
+}
+
+// The slots are bounded by the mapping rather than the capacity in the header,
+// which the reader can't trust to stay what it was at open()
+uint32_t SnapshotTableReader::sequence(uint16_t index) const {
+    if(_header == NULL || tableSize((size_t)index + 1) > _size) return 0;
+    return __atomic_load_n(&_slots[index].sequence, __ATOMIC_ACQUIRE);
+}
+
+bool SnapshotTableReader::read(uint16_t index, SnapshotTableRecord &record, uint32_t *sequence) const {
+    if(_header == NULL || tableSize((size_t)index + 1) > _size) return false;
+    const SnapshotTableSlot &slot = _slots[index];
+    SnapshotTableSlot copy;
+
+    for(uint16_t attempt = 0; attempt < SNAPSHOT_TABLE_READ_ATTEMPTS; ++attempt){
+        uint32_t before = __atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE);
+        if(before & 1) continue;
+        for(size_t i = 0; i < SNAPSHOT_TABLE_RECORD_WORDS; ++i){
+            copy.words[i] = __atomic_load_n(&slot.words[i], __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&slot.sequence, __ATOMIC_RELAXED) != before) continue;
+
+        if(before == 0) return false;
+        record = copy.record;
+        if(sequence != NULL) *sequence = before;
+        return true;
+    }
+    return false;
+}
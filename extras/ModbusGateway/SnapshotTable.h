@@ -0,0 +1,156 @@
+#ifndef SNAPSHOT_TABLE_H
+#define SNAPSHOT_TABLE_H
+
+/*
+Latest controller snapshots in a POSIX shared memory segment, so that local
+processes like an HMI, a logger or an exporter can read them without bus
+access of their own.
+
+The segment holds a header followed by one cache line aligned slot per
+controller. Every slot is guarded by a sequence lock: the writer makes the
+sequence odd, updates the record and makes it even again. A reader copies
+the record and retries if the sequence was odd or changed meanwhile. Readers
+thus never block the writer, take no locks and make no system calls after
+open(), and any number of them can read at the same time.
+
+The segment outlives the writer, so readers keep working across restarts
+of the gateway and see the last published values while it is down. A writer
+that needs another layout, e.g. more slots, replaces the object instead of
+resizing it. Readers keep the old one until they reopen the table.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ControllerSnapshot.h"
+
+#define SNAPSHOT_TABLE_MAGIC 0x50475354 // "PGST"
+#define SNAPSHOT_TABLE_VERSION 1
+#define SNAPSHOT_TABLE_CACHE_LINE 64
+
+// Default name of the shared memory object
+#define SNAPSHOT_TABLE_DEFAULT_NAME "/pego-snapshots"
+
+// Copies a reader attempts while the writer keeps updating the same slot
+#define SNAPSHOT_TABLE_READ_ATTEMPTS 1000
+
+/**
+ * @brief The published state of a controller.
+ */
+struct SnapshotTableRecord {
+    // Wall clock time of the publication in ms since the epoch
+    uint64_t updated;
+    uint8_t peripheralID;
+    ControllerSnapshot snapshot;
+};
+
+/**
+ * @brief A slot of the table, a whole number of cache lines so that two
+ * controllers never share one.
+ */
+struct alignas(SNAPSHOT_TABLE_CACHE_LINE) SnapshotTableSlot {
+    // Odd while the writer updates the record, incremented twice per publication
+    uint32_t sequence;
+    uint32_t reserved;
+    union {
+        SnapshotTableRecord record;
+        uint32_t words[(sizeof(SnapshotTableRecord) + 3) / 4];
+    };
+};
+
+struct alignas(SNAPSHOT_TABLE_CACHE_LINE) SnapshotTableHeader {
+    // Written last when the segment is initialized
+    uint32_t magic;
+    uint16_t version;
+    uint16_t slotSize;
+    uint16_t capacity;
+    // Amount of slots in use, the first ones
+    uint16_t count;
+    // Process ID of the writer, 0 when it shut down
+    int32_t writerPid;
+};
+
+/**
+ * @brief Publishes snapshots into the table, one process at a time.
+ */
+class SnapshotTableWriter {
+private:
+    SnapshotTableHeader *_header;
+    SnapshotTableSlot *_slots;
+    size_t _size;
+
+public:
+    SnapshotTableWriter();
+    ~SnapshotTableWriter();
+
+    /**
+     * @brief Creates the shared memory object or takes over an existing one
+     * with the same layout. One with another layout is replaced by a new object.
+     * @param name The name of the object, starting with a slash.
+     * @param capacity Amount of controller slots.
+     * @return false if the object couldn't be created or mapped.
+     */
+    bool begin(const char *name, uint16_t capacity);
+
+    /**
+     * @brief Marks the table as orphaned and unmaps it. The object itself
+     * is kept for the readers.
+     */
+    void end();
+
+    /**
+     * @brief Publishes the snapshot of a controller.
+     * @param index The slot, usually the index of the controller in the PollScheduler.
+     * @return false if the table isn't open or the index is out of range.
+     */
+    bool publish(uint16_t index, uint8_t peripheralID, const ControllerSnapshot &snapshot);
+};
+
+/**
+ * @brief Reads consistent copies of the published snapshots.
+ */
+class SnapshotTableReader {
+private:
+    const SnapshotTableHeader *_header;
+    const SnapshotTableSlot *_slots;
+    size_t _size;
+
+public:
+    SnapshotTableReader();
+    ~SnapshotTableReader();
+
+    /**
+     * @brief Maps an existing table read-only.
+     * @return false if it doesn't exist or was written by an incompatible version.
+     */
+    bool open(const char *name);
+
+    void close();
+
+    /**
+     * @brief Amount of slots in use.
+     */
+    uint16_t count() const;
+
+    /**
+     * @brief Whether the writing process is still running. Costs a system call.
+     */
+    bool writerAlive() const;
+
+    /**
+     * @brief Returns the sequence of a slot, which changes with every publication.
+     * Compare it with the last value to find out whether read() is worthwhile.
+     */
+    uint32_t sequence(uint16_t index) const;
+
+    /**
+     * @brief Copies the record of a slot.
+     * @param index The slot.
+     * @param record Receives the copy.
+     * @param sequence Optionally receives the sequence of the copy.
+     * @return false if the slot is out of range, was never published or the
+     * writer didn't let go of it within SNAPSHOT_TABLE_READ_ATTEMPTS copies.
+     */
+    bool read(uint16_t index, SnapshotTableRecord &record, uint32_t *sequence = NULL) const;
+};
+
+#endif
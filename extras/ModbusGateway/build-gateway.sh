@@ -0,0 +1,54 @@
+#!/bin/bash
+
+# Builds the Modbus TCP gateway for a Linux / macOS host.
+# Set SIMULATE=1 to link the simulated controllers of the benchmark instead of a serial port.
+# SnapshotReader, an example reader of the shared memory snapshot table, is built as well.
+
+GATEWAY_PATH=$(cd "$(dirname "$0")" && pwd)
+LIBRARY_PATH="$GATEWAY_PATH/../../src"
+HOST_PATH="$GATEWAY_PATH/../host"
+HISTORY_PATH="$GATEWAY_PATH/../History"
+BUILD_PATH="$GATEWAY_PATH/build"
+CXX=${CXX:-g++}
+# shm_open() lives in librt with older glibc versions
+if [ "$(uname)" == "Linux" ]; then
+    LIBRARIES="-lrt"
+fi
+
+if [ "$SIMULATE" == "1" ]; then
+    MODBUS_CLIENT="$GATEWAY_PATH/../Benchmark/MockModbusClient.cpp -I$GATEWAY_PATH/../Benchmark -DSIMULATE"
+    echo "🔧 Compiling gateway with simulated controllers ..."
+else
+    MODBUS_CLIENT="$HOST_PATH/SerialModbusClient.cpp"
+    echo "🔧 Compiling gateway ..."
+fi
+
+mkdir -p "$BUILD_PATH"
+$CXX -std=gnu++11 -O2 -Wall -I"$HOST_PATH" -I"$LIBRARY_PATH" -I"$GATEWAY_PATH" -I"$HISTORY_PATH" \
+    -DPOLL_SCHEDULER_MAX_CONTROLLERS=64 -DCOMMAND_QUEUE_SIZE=128 \
+    "$GATEWAY_PATH/ModbusGateway.cpp" \
+    "$GATEWAY_PATH/ModbusTcpServer.cpp" \
+    "$GATEWAY_PATH/SnapshotTable.cpp" \
+    "$HISTORY_PATH/HistoryStore.cpp" \
+    "$HOST_PATH/Arduino.cpp" \
+    $MODBUS_CLIENT \
+    "$LIBRARY_PATH/PegoController.cpp" \
+    "$LIBRARY_PATH/PegoModel.cpp" \
+    "$LIBRARY_PATH/BusSupervisor.cpp" \
+    "$LIBRARY_PATH/ReadCoalescer.cpp" \
+    "$LIBRARY_PATH/ModbusError.cpp" \
+    "$LIBRARY_PATH/UnsupportedRegisterCache.cpp" \
+    "$LIBRARY_PATH/PollScheduler.cpp" \
+    "$LIBRARY_PATH/CommandQueue.cpp" \
+    -o "$BUILD_PATH/ModbusGateway" $LIBRARIES && \
+$CXX -std=gnu++11 -O2 -Wall -I"$HOST_PATH" -I"$LIBRARY_PATH" \
+    "$GATEWAY_PATH/SnapshotReader.cpp" \
+    "$GATEWAY_PATH/SnapshotTable.cpp" \
+    -o "$BUILD_PATH/SnapshotReader" $LIBRARIES
+
+if [ $? -eq 0 ]; then
+    echo "✅ Gateway built: $BUILD_PATH/ModbusGateway"
+else
+    echo "❌ Compilation failed."
+    exit 1
+fi
@@ -0,0 +1,190 @@
+/*
+Measures the MqttPublisher against a real broker, e.g. a local Mosquitto:
+    mosquitto -p 1883 &
+    ./run-mqtt-benchmark.sh --devices 16 --polls 500
+
+Simulated controllers are polled as fast as possible. Between two polls the
+temperatures drift and the relays switch now and then, so the publisher
+sends a mix of retained states and batched changes. The report shows the
+messages and payload bytes per poll as well as the throughput the broker took.
+With --full the states also carry auxiliary values, the bus health and all
+parameters, and the run fails if any of them didn't fit into a message.
+
+Usage: MqttBenchmark [--host <name>] [--port <port>] [--devices <n>] [--polls <n>]
+                     [--qos <state>,<changes>] [--state-interval <ms>] [--full]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ArduinoMqttClient.h>
+#include "PegoController.h"
+#include "MqttPublisher.h"
+#include "MockModbusClient.h"
+
+#define DEFAULT_HOST "localhost"
+#define DEFAULT_PORT 1883
+#define DEFAULT_DEVICES 8
+#define DEFAULT_POLLS 200
+// Simulated time between two polls of the same controller in ms
+#define POLL_INTERVAL 10000
+// Time to wait for outstanding acknowledgements at the end in ms
+#define ACKNOWLEDGEMENT_TIMEOUT 2000
+
+static double wallClock(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void initializeRegisters(){
+    MockBus.setRegister(256, 45);
+    MockBus.setRegister(257, (uint16_t)-120);
+    MockBus.setRegister(1280, bit(OUTPUT_STATUS_COMPRESSOR_RELAY_BIT) | bit(OUTPUT_STATUS_FANS_RELAY_BIT));
+    MockBus.setRegister(1281, 0);
+    MockBus.setRegister(1282, 0);
+    MockBus.setRegister(1536, 0);
+    // Parameters with the longest decimal representation
+    for(uint16_t i = 0; i < PARAMETER_BLOCK_BASE_COUNT; ++i) MockBus.setRegister(PARAMETER_BLOCK_BASE_FIRST + i, 65535 - i);
+    for(uint16_t i = 0; i < PARAMETER_BLOCK_EXPERT_COUNT; ++i) MockBus.setRegister(PARAMETER_BLOCK_EXPERT_FIRST + i, 65535 - i);
+    for(uint16_t i = 0; i < PARAMETER_BLOCK_CONFIGURATION_COUNT; ++i) MockBus.setRegister(PARAMETER_BLOCK_CONFIGURATION_FIRST + i, 65535 - i);
+}
+
+/**
+ * @brief Lets the simulated room drift: the temperatures change by a tenth
+ * every few polls and the compressor switches every 20 polls.
+ */
+static void simulateRoom(unsigned long poll, uint8_t device){
+    unsigned long step = poll + device * 7;
+    if(step % 3 == 0) MockBus.setRegister(256, 40 + step % 10);
+    if(step % 4 == 0) MockBus.setRegister(257, (uint16_t)(-125 + (int)(step % 12)));
+    uint16_t outputStatus = bit(OUTPUT_STATUS_FANS_RELAY_BIT);
+    if((step / 20) % 2 == 0) bitSet(outputStatus, OUTPUT_STATUS_COMPRESSOR_RELAY_BIT);
+    MockBus.setRegister(1280, outputStatus);
+}
+
+/**
+ * @brief Fills in auxiliary values as the AuxiliarySampler would, one level unknown.
+ */
+static void simulateAuxiliary(unsigned long poll, uint8_t device, ControllerSnapshot &snapshot){
+    for(uint8_t i = 0; i < SNAPSHOT_AUXILIARY_CHANNELS; ++i){
+        snapshot.auxiliaryLevels[i] = i == 0 ? AUXILIARY_LEVEL_UNKNOWN : (uint8_t)(50 + (poll + device + i) % 50);
+    }
+    snapshot.auxiliaryStates = (poll / 10) % 2 ? 0x05 : 0x01;
+    snapshot.valid |= SNAPSHOT_AUXILIARY_VALID;
+}
+
+int main(int argc, char **argv){
+    const char *host = DEFAULT_HOST;
+    unsigned int port = DEFAULT_PORT;
+    unsigned int devices = DEFAULT_DEVICES;
+    unsigned long polls = DEFAULT_POLLS;
+    unsigned int stateQoS = 1;
+    unsigned int changesQoS = 0;
+    unsigned long stateInterval = MQTT_PUBLISHER_DEFAULT_STATE_INTERVAL;
+    bool full = false;
+
+    for(int i = 1; i < argc; ++i){
+        if(strcmp(argv[i], "--host") == 0 && i + 1 < argc){
+            host = argv[++i];
+        } else if(strcmp(argv[i], "--port") == 0 && i + 1 < argc){
+            port = strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--devices") == 0 && i + 1 < argc){
+            devices = strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--polls") == 0 && i + 1 < argc){
+            polls = strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--qos") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%u,%u", &stateQoS, &changesQoS) == 2){
+            ++i;
+        } else if(strcmp(argv[i], "--state-interval") == 0 && i + 1 < argc){
+            stateInterval = strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--full") == 0){
+            full = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--host <name>] [--port <port>] [--devices <n>] [--polls <n>] [--qos <state>,<changes>] [--state-interval <ms>] [--full]\n", argv[0]);
+            return 2;
+        }
+    }
+    if(devices == 0 || devices > MQTT_PUBLISHER_MAX_DEVICES){
+        fprintf(stderr, "Between 1 and %d devices are supported.\n", MQTT_PUBLISHER_MAX_DEVICES);
+        return 2;
+    }
+
+    hostUseSimulatedClock(true);
+    Serial.setMuted(true);
+    initializeRegisters();
+
+    MqttClient client;
+    client.setId("pego-benchmark");
+    if(!client.connect(host, port)){
+        fprintf(stderr, "Couldn't connect to %s:%u (error %d)\n", host, port, client.connectError());
+        return 1;
+    }
+
+    static PegoController controllers[MQTT_PUBLISHER_MAX_DEVICES];
+    static ControllerParameters parameters[MQTT_PUBLISHER_MAX_DEVICES];
+    static char names[MQTT_PUBLISHER_MAX_DEVICES][16];
+    BusSupervisor supervisor(RS485_DEFAULT_BAUD_RATE);
+    MqttPublisher publisher(client, "pego/benchmark");
+    publisher.setQoS(stateQoS, changesQoS);
+    publisher.setStateInterval(stateInterval);
+    for(unsigned int i = 0; i < devices; ++i){
+        controllers[i] = PegoController(RS485_DEFAULT_BAUD_RATE, i + 1);
+        controllers[i].begin();
+        controllers[i].setModel(PEGO_MODEL_ECP_202);
+        snprintf(names[i], sizeof(names[i]), "room%u", i + 1);
+        publisher.add(names[i]);
+        if(full){
+            controllers[i].readParameters(parameters[i]);
+            publisher.writer(i).setParameters(&parameters[i]);
+            publisher.writer(i).setBusHealth(&controllers[i], &supervisor);
+        }
+    }
+
+    double start = wallClock();
+    unsigned long maxQueued = 0;
+    for(unsigned long poll = 0; poll < polls; ++poll){
+        for(unsigned int i = 0; i < devices; ++i){
+            simulateRoom(poll, i);
+            ControllerSnapshot snapshot;
+            controllers[i].readSnapshot(snapshot);
+            if(full) simulateAuxiliary(poll, i, snapshot);
+            publisher.publish(i, snapshot);
+            if(publisher.queued() > maxQueued) maxQueued = publisher.queued();
+            publisher.update();
+            hostAdvanceClock(POLL_INTERVAL * 1000UL / devices);
+        }
+    }
+    while(publisher.queued() > 0 && client.connected()) publisher.update();
+    double sent = wallClock();
+    while(client.pendingAcknowledgements() > 0 && client.connected() && wallClock() - sent < ACKNOWLEDGEMENT_TIMEOUT / 1000.0){
+        client.poll();
+    }
+    double elapsed = wallClock() - start;
+
+    const MqttPublisherStatistics &statistics = publisher.statistics();
+    unsigned long messages = statistics.stateMessages + statistics.changeMessages;
+    unsigned long snapshots = polls * devices;
+    printf("Broker: %s:%u, QoS %u/%u (state/changes)%s\n", host, port, stateQoS, changesQoS, full ? ", full states" : "");
+    printf("Devices: %u, polls: %lu, snapshots: %lu\n\n", devices, polls, snapshots);
+    printf("%-28s %lu\n", "State messages", statistics.stateMessages);
+    printf("%-28s %lu\n", "Change messages", statistics.changeMessages);
+    printf("%-28s %lu\n", "Dropped / superseded", statistics.dropped + statistics.superseded);
+    printf("%-28s %lu\n", "Oversized snapshots", statistics.oversized);
+    printf("%-28s %lu\n", "Peak queue length", maxQueued);
+    printf("%-28s %.2f\n", "Messages per poll", (double)messages / snapshots);
+    printf("%-28s %.1f\n", "Payload bytes per poll", (double)statistics.bytes / snapshots);
+    printf("%-28s %.0f\n", "Messages per second", messages / elapsed);
+    printf("%-28s %.1f\n", "Payload kB per second", statistics.bytes / elapsed / 1000);
+    printf("%-28s %lu\n", "Unacknowledged", client.pendingAcknowledgements());
+
+    if(full && statistics.oversized > 0){
+        printf("\nFull states didn't fit into %d bytes.\n", MQTT_PUBLISHER_PAYLOAD_SIZE);
+        return 1;
+    }
+    if(!client.connected() || client.pendingAcknowledgements() > 0){
+        printf("\nThe broker dropped the connection or didn't acknowledge all messages.\n");
+        return 1;
+    }
+    return 0;
+}
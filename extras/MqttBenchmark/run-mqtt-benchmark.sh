@@ -0,0 +1,44 @@
+#!/bin/bash
+
+# Builds the MQTT publisher benchmark for the host and runs it against a broker,
+# by default a Mosquitto on localhost:1883. All arguments are passed on, e.g. --devices 16
+
+BENCHMARK_PATH=$(cd "$(dirname "$0")" && pwd)
+LIBRARY_PATH="$BENCHMARK_PATH/../../src"
+HOST_PATH="$BENCHMARK_PATH/../host"
+MOCK_PATH="$BENCHMARK_PATH/../Benchmark"
+BUILD_PATH="$BENCHMARK_PATH/build"
+CXX=${CXX:-g++}
+
+mkdir -p "$BUILD_PATH"
+echo "🔧 Compiling MQTT benchmark ..."
+$CXX -std=gnu++11 -O2 -Wall -I"$HOST_PATH" -I"$LIBRARY_PATH" -I"$MOCK_PATH" \
+    -DMQTT_PUBLISHER_MAX_DEVICES=64 -DMQTT_PUBLISHER_QUEUE_SIZE=16 \
+    "$BENCHMARK_PATH/MqttBenchmark.cpp" \
+    "$MOCK_PATH/MockModbusClient.cpp" \
+    "$HOST_PATH/Arduino.cpp" \
+    "$HOST_PATH/ArduinoMqttClient.cpp" \
+    "$LIBRARY_PATH/PegoController.cpp" \
+    "$LIBRARY_PATH/PegoModel.cpp" \
+    "$LIBRARY_PATH/BusSupervisor.cpp" \
+    "$LIBRARY_PATH/ReadCoalescer.cpp" \
+    "$LIBRARY_PATH/ModbusError.cpp" \
+    "$LIBRARY_PATH/UnsupportedRegisterCache.cpp" \
+    "$LIBRARY_PATH/SnapshotJson.cpp" \
+    "$LIBRARY_PATH/MqttPublisher.cpp" \
+    -o "$BUILD_PATH/MqttBenchmark"
+
+if [ $? -ne 0 ]; then
+    echo "❌ Compilation failed."
+    exit 1
+fi
+
+"$BUILD_PATH/MqttBenchmark" "$@"
+RESULT=$?
+
+if [ $RESULT -eq 0 ]; then
+    echo "✅ MQTT benchmark passed."
+else
+    echo "❌ MQTT benchmark failed."
+fi
+exit $RESULT
@@ -0,0 +1,261 @@
+/*
+Measures the round trip latency of the native serial transport with the same
+register calls an on-board sketch makes, so that the numbers can be put next
+to the bus phase of the LoopProfiler report of a MKR board on the same bus.
+
+Each iteration reads a snapshot and writes the set point back. The report
+shows the time per call as well as the round trip per transaction split
+into the wire time of the characters and the overhead of the controller's
+turnaround plus the serial driver.
+
+Without --device a simulated controller is attached to a pseudo terminal.
+It delays every response by the wire time at the configured baud rate,
+so the overhead shown is the one of the host side alone.
+
+Usage: SerialLatency [--device <path>] [--unit <id>] [--baud <rate>] [--iterations <n>]
+                     [--direction auto|none|kernel|rts] [--no-low-latency]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <ArduinoModbus.h>
+#include "PegoController.h"
+#include "SerialModbusClient.h"
+
+#define DEFAULT_ITERATIONS 200
+#define MAX_ITERATIONS 10000
+#define SIMULATED_REGISTERS 2048
+
+static uint16_t crc16(const uint8_t *buffer, size_t length){
+    uint16_t crc = 0xFFFF;
+    while(length--){
+        crc ^= *buffer++;
+        for(uint8_t i = 0; i < 8; ++i){
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief Answers read holding registers and write single register requests
+ * on the master side of a pseudo terminal until the other side is closed.
+ */
+static void simulateController(int fd, uint8_t unit, unsigned long characterTime){
+    static uint16_t registers[SIMULATED_REGISTERS];
+    registers[256] = 45;
+    registers[257] = (uint16_t)-120;
+    registers[768] = 40;
+    registers[1280] = bit(OUTPUT_STATUS_COMPRESSOR_RELAY_BIT) | bit(OUTPUT_STATUS_FANS_RELAY_BIT);
+
+    uint8_t request[8];
+    size_t received = 0;
+    while(true){
+        ssize_t count = read(fd, request + received, sizeof(request) - received);
+        if(count <= 0) return;
+        received += count;
+        if(received < sizeof(request)) continue;
+        received = 0;
+
+        uint16_t crc = request[6] | (request[7] << 8);
+        if(request[0] != unit || crc != crc16(request, 6)) continue;
+        uint16_t address = (request[2] << 8) | request[3];
+        uint16_t value = (request[4] << 8) | request[5];
+
+        uint8_t response[256];
+        size_t length;
+        if(request[1] == 0x03 && value >= 1 && value <= 125 && address + value <= SIMULATED_REGISTERS){
+            response[0] = unit;
+            response[1] = 0x03;
+            response[2] = 2 * value;
+            for(uint16_t i = 0; i < value; ++i){
+                response[3 + 2 * i] = highByte(registers[address + i]);
+                response[4 + 2 * i] = lowByte(registers[address + i]);
+            }
+            length = 3 + 2 * value;
+        } else if(request[1] == 0x06 && address < SIMULATED_REGISTERS){
+            registers[address] = value;
+            memcpy(response, request, 6);
+            length = 6;
+        } else {
+            response[0] = unit;
+            response[1] = request[1] | 0x80;
+            response[2] = MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+            length = 3;
+        }
+        crc = crc16(response, length);
+        response[length++] = lowByte(crc);
+        response[length++] = highByte(crc);
+        // The request and the response take their time on a real bus
+        usleep((sizeof(request) + length) * characterTime);
+        if(write(fd, response, length) != (ssize_t)length) return;
+    }
+}
+
+/**
+ * @brief Opens a pseudo terminal and forks the simulated controller onto it.
+ * @return The path of the terminal side or NULL on failure.
+ */
+static const char *startSimulation(uint8_t unit, unsigned long baudRate, pid_t &child){
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) return NULL;
+    static char path[64];
+    strncpy(path, ptsname(fd), sizeof(path) - 1);
+
+    // The terminal side is raw, so the master side must not echo either
+    int slave = open(path, O_RDWR | O_NOCTTY);
+    if(slave < 0) return NULL;
+    struct termios options;
+    tcgetattr(slave, &options);
+    cfmakeraw(&options);
+    tcsetattr(slave, TCSANOW, &options);
+
+    child = fork();
+    if(child < 0) return NULL;
+    if(child == 0){
+        close(slave);
+        simulateController(fd, unit, 10000000UL / baudRate);
+        _exit(0);
+    }
+    // The terminal side stays open, so the simulation never sees a hang up
+    // between two opens of the client
+    close(fd);
+    return path;
+}
+
+static int compare(const void *a, const void *b){
+    unsigned long x = *(const unsigned long *)a;
+    unsigned long y = *(const unsigned long *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void printDurations(const char *name, unsigned long *durations, int count){
+    if(count == 0) return;
+    qsort(durations, count, sizeof(unsigned long), compare);
+    unsigned long long sum = 0;
+    for(int i = 0; i < count; ++i) sum += durations[i];
+    printf("%-18s %8lu %8llu %8lu %8lu %8lu\n", name, durations[0], sum / count,
+        durations[count / 2], durations[count * 99 / 100], durations[count - 1]);
+}
+
+static SerialDirectionControl parseDirection(const char *name){
+    if(strcmp(name, "none") == 0) return SERIAL_DIRECTION_NONE;
+    if(strcmp(name, "kernel") == 0) return SERIAL_DIRECTION_KERNEL;
+    if(strcmp(name, "rts") == 0) return SERIAL_DIRECTION_RTS;
+    return SERIAL_DIRECTION_AUTO;
+}
+
+static const char *directionName(SerialDirectionControl control){
+    switch(control){
+        case SERIAL_DIRECTION_KERNEL: return "kernel (TIOCSRS485)";
+        case SERIAL_DIRECTION_RTS: return "RTS";
+        default: return "adapter";
+    }
+}
+
+static void usage(const char *name){
+    fprintf(stderr, "Usage: %s [--device <path>] [--unit <id>] [--baud <rate>] [--iterations <n>] [--direction auto|none|kernel|rts] [--no-low-latency]\n", name);
+}
+
+int main(int argc, char **argv){
+    const char *device = NULL;
+    uint8_t unit = DEFAULT_PERIPHERAL_ID;
+    unsigned long baudRate = RS485_DEFAULT_BAUD_RATE;
+    int iterations = DEFAULT_ITERATIONS;
+
+    for(int i = 1; i < argc; ++i){
+        bool hasValue = i + 1 < argc;
+        if(strcmp(argv[i], "--device") == 0 && hasValue){
+            device = argv[++i];
+        } else if(strcmp(argv[i], "--unit") == 0 && hasValue){
+            unit = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--baud") == 0 && hasValue){
+            baudRate = strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--iterations") == 0 && hasValue){
+            iterations = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--direction") == 0 && hasValue){
+            serialModbusSetDirectionControl(parseDirection(argv[++i]));
+        } else if(strcmp(argv[i], "--no-low-latency") == 0){
+            serialModbusSetLowLatency(false);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if(unit < 1 || unit > 247 || iterations < 1 || iterations > MAX_ITERATIONS){
+        usage(argv[0]);
+        return 2;
+    }
+
+    pid_t simulation = 0;
+    if(device == NULL){
+        device = startSimulation(unit, baudRate, simulation);
+        if(device == NULL){
+            perror("Couldn't start the simulated controller");
+            return 1;
+        }
+    }
+    serialModbusSetPort(device);
+
+    PegoController controller(baudRate, unit);
+    if(!controller.begin()){
+        fprintf(stderr, "Couldn't open %s: %s\n", device, ModbusRTUClient.lastError());
+        return 1;
+    }
+    printf("Device: %s%s, %lu baud, direction control: %s\n", device, simulation != 0 ? " (simulated)" : "",
+        baudRate, directionName(serialModbusDirectionControl()));
+
+    static unsigned long snapshotDurations[MAX_ITERATIONS];
+    static unsigned long writeDurations[MAX_ITERATIONS];
+    int snapshots = 0;
+    int writes = 0;
+    int failures = 0;
+    ControllerSnapshot snapshot;
+    RegisterDescription setPoint = {HOLDING_REGISTERS, 768, true, 10};
+    // The first snapshot detects the model, which isn't part of the steady state
+    controller.readSnapshot(snapshot);
+    serialModbusResetStatistics();
+
+    for(int i = 0; i < iterations; ++i){
+        unsigned long start = micros();
+        if(controller.readSnapshot(snapshot) && snapshot.responsive){
+            snapshotDurations[snapshots++] = micros() - start;
+        } else {
+            ++failures;
+        }
+        start = micros();
+        if(controller.writeModbusRegister(setPoint, 40)){
+            writeDurations[writes++] = micros() - start;
+        } else {
+            ++failures;
+        }
+    }
+
+    SerialModbusStatistics statistics;
+    serialModbusStatistics(statistics);
+    printf("\n%-18s %8s %8s %8s %8s %8s\n", "µs per call", "min", "mean", "p50", "p99", "max");
+    printDurations("readSnapshot", snapshotDurations, snapshots);
+    printDurations("writeModbusRegister", writeDurations, writes);
+
+    if(statistics.transactions > 0){
+        unsigned long roundTrip = statistics.roundTripSum / statistics.transactions;
+        unsigned long wireTime = statistics.wireTimeSum / statistics.transactions;
+        printf("\nTransactions: %lu, failed: %lu\n", statistics.transactions, statistics.failures);
+        printf("Round trip: min %lu µs, mean %lu µs, max %lu µs\n", statistics.minimumRoundTrip, roundTrip, statistics.maximumRoundTrip);
+        printf("Wire time: mean %lu µs, overhead: mean %lu µs\n", wireTime, roundTrip > wireTime ? roundTrip - wireTime : 0);
+    }
+
+    ModbusRTUClient.end();
+    if(simulation != 0){
+        kill(simulation, SIGTERM);
+        waitpid(simulation, NULL, 0);
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+#!/bin/bash
+
+# Builds the serial latency probe for a Linux / macOS host and runs it.
+# All arguments are passed on, e.g. --device /dev/ttyUSB0 --unit 3.
+# Without --device a simulated controller on a pseudo terminal answers.
+
+PROBE_PATH=$(cd "$(dirname "$0")" && pwd)
+LIBRARY_PATH="$PROBE_PATH/../../src"
+HOST_PATH="$PROBE_PATH/../host"
+BUILD_PATH="$PROBE_PATH/build"
+CXX=${CXX:-g++}
+
+mkdir -p "$BUILD_PATH"
+echo "🔧 Compiling serial latency probe ..."
+$CXX -std=gnu++11 -O2 -Wall -I"$HOST_PATH" -I"$LIBRARY_PATH" \
+    "$PROBE_PATH/SerialLatency.cpp" \
+    "$HOST_PATH/Arduino.cpp" \
+    "$HOST_PATH/SerialModbusClient.cpp" \
+    "$LIBRARY_PATH/PegoController.cpp" \
+    "$LIBRARY_PATH/PegoModel.cpp" \
+    "$LIBRARY_PATH/BusSupervisor.cpp" \
+    "$LIBRARY_PATH/ReadCoalescer.cpp" \
+    "$LIBRARY_PATH/ModbusError.cpp" \
+    "$LIBRARY_PATH/UnsupportedRegisterCache.cpp" \
+    -o "$BUILD_PATH/SerialLatency"
+
+if [ $? -ne 0 ]; then
+    echo "❌ Compilation failed."
+    exit 1
+fi
+
+"$BUILD_PATH/SerialLatency" "$@"
+RESULT=$?
+
+if [ $RESULT -eq 0 ]; then
+    echo "✅ Latency measurement finished."
+else
+    echo "❌ Latency measurement failed."
+fi
+exit $RESULT
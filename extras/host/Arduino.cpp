@@ -0,0 +1,100 @@
+#include "Arduino.h"
+#include <stdio.h>
+#include <time.h>
+
+HostSerial Serial;
+
+static bool simulatedClock = false;
+static unsigned long long simulatedMicroseconds = 0;
+
+static unsigned long long monotonicMicroseconds(){
+    static struct timespec start = {0, 0};
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(start.tv_sec == 0 && start.tv_nsec == 0) start = now;
+    return (unsigned long long)(now.tv_sec - start.tv_sec) * 1000000ULL + (now.tv_nsec - start.tv_nsec) / 1000;
+}
+
+void hostUseSimulatedClock(bool simulated){
+    simulatedClock = simulated;
+}
+
+void hostAdvanceClock(unsigned long microseconds){
+    simulatedMicroseconds += microseconds;
+}
+
+unsigned long micros(){
+    return simulatedClock ? simulatedMicroseconds : monotonicMicroseconds();
+}
+
+unsigned long millis(){
+    return (simulatedClock ? simulatedMicroseconds : monotonicMicroseconds()) / 1000;
+}
+
+void delay(unsigned long milliseconds){
+    delayMicroseconds(milliseconds * 1000);
+}
+
+void delayMicroseconds(unsigned int microseconds){
+    if(simulatedClock){
+        hostAdvanceClock(microseconds);
+        return;
+    }
+    struct timespec duration = {(time_t)(microseconds / 1000000), (long)(microseconds % 1000000) * 1000};
+    nanosleep(&duration, NULL);
+}
+
+long map(long value, long fromLow, long fromHigh, long toLow, long toHigh){
+    return (value - fromLow) * (toHigh - toLow) / (fromHigh - fromLow) + toLow;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size){
+    size_t written = 0;
+    while(size--) written += write(*buffer++);
+    return written;
+}
+
+static size_t printNumber(Print &output, unsigned long long value, int base, bool negative){
+    char buffer[66];
+    char *position = buffer + sizeof(buffer) - 1;
+    *position = '\0';
+    if(base < 2) base = 10;
+    do {
+        int digit = value % base;
+        *--position = digit < 10 ? '0' + digit : 'A' + digit - 10;
+        value /= base;
+    } while(value > 0);
+    if(negative) *--position = '-';
+    return output.write(position);
+}
+
+size_t Print::print(const __FlashStringHelper *text){ return write(reinterpret_cast<const char *>(text)); }
+size_t Print::print(const char *text){ return write(text); }
+size_t Print::print(char character){ return write((uint8_t)character); }
+size_t Print::print(int value, int base){ return print((long)value, base); }
+size_t Print::print(unsigned int value, int base){ return print((unsigned long)value, base); }
+
+size_t Print::print(long value, int base){
+    if(base == DEC && value < 0) return printNumber(*this, -(long long)value, base, true);
+    if(base != DEC) return printNumber(*this, (unsigned long)value, base, false);
+    return printNumber(*this, value, base, false);
+}
+
+size_t Print::print(unsigned long value, int base){
+    return printNumber(*this, value, base, false);
+}
+
+size_t Print::print(double value, int digits){
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+    return write(buffer);
+}
+
+size_t Print::println(){
+    return write("\r\n");
+}
+
+size_t HostSerial::write(uint8_t character){
+    if(_muted) return 1;
+    return fputc(character, stdout) == EOF ? 0 : 1;
+}
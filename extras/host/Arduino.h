@@ -0,0 +1,126 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/*
+Minimal subset of the Arduino core API used by the library sources,
+so that they can be compiled and run on a Linux / macOS host
+for benchmarks, tests and gateway deployments.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+#define BIN 2
+#define OCT 8
+#define DEC 10
+#define HEX 16
+
+#define SERIAL_8N1 0x06
+#define SERIAL_8E1 0x1A
+#define SERIAL_8O1 0x2A
+#define SERIAL_8N2 0x0E
+
+#define AR_DEFAULT 0
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define pgm_read_ptr(address) (*(const void * const *)(address))
+#define strlen_P strlen
+#define memcpy_P memcpy
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+#define bit(b) (1UL << (b))
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+
+template<class T, class L, class H>
+T constrain(T value, L low, H high){ return value < low ? low : (value > high ? high : value); }
+
+long map(long value, long fromLow, long fromHigh, long toLow, long toHigh);
+
+class __FlashStringHelper;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long milliseconds);
+void delayMicroseconds(unsigned int microseconds);
+
+/**
+ * @brief Switches the host clock between wall time (default) and a simulated clock
+ * that only advances through hostAdvanceClock() and delay().
+ */
+void hostUseSimulatedClock(bool simulated);
+
+/**
+ * @brief Advances the simulated clock.
+ */
+void hostAdvanceClock(unsigned long microseconds);
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t character) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *text){ return text == NULL ? 0 : write((const uint8_t *)text, strlen(text)); }
+
+    size_t print(const __FlashStringHelper *text);
+    size_t print(const char *text);
+    size_t print(char character);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+
+    size_t println();
+    template<class T> size_t println(T value){ size_t n = print(value); return n + println(); }
+    template<class T> size_t println(T value, int format){ size_t n = print(value, format); return n + println(); }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+/**
+ * @brief Writes to stdout. Output can be muted, e.g. to keep benchmark results readable.
+ */
+class HostSerial : public Stream {
+private:
+    bool _muted;
+public:
+    HostSerial() : _muted(false) {}
+    void begin(unsigned long, uint16_t = SERIAL_8N1) {}
+    void end() {}
+    void setMuted(bool muted){ _muted = muted; }
+    using Print::write;
+    size_t write(uint8_t character) override;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() {}
+    operator bool() const { return true; }
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef HOST_ARDUINO_MODBUS_H
+#define HOST_ARDUINO_MODBUS_H
+
+/*
+Declares the subset of the ArduinoModbus API used by the library sources.
+The implementation of ModbusRTUClient is chosen at link time, e.g. the
+counting mock of the benchmark or a serial port backed client.
+*/
+
+#include "Arduino.h"
+#include <errno.h>
+
+#define COILS 0
+#define DISCRETE_INPUTS 1
+#define HOLDING_REGISTERS 2
+#define INPUT_REGISTERS 3
+
+// Error numbers as set by libmodbus
+#define MODBUS_ENOBASE 112345678
+
+enum {
+    MODBUS_EXCEPTION_ILLEGAL_FUNCTION = 0x01,
+    MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+    MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE,
+    MODBUS_EXCEPTION_SLAVE_OR_SERVER_FAILURE,
+    MODBUS_EXCEPTION_ACKNOWLEDGE,
+    MODBUS_EXCEPTION_SLAVE_OR_SERVER_BUSY,
+    MODBUS_EXCEPTION_NEGATIVE_ACKNOWLEDGE,
+    MODBUS_EXCEPTION_MEMORY_PARITY,
+    MODBUS_EXCEPTION_NOT_DEFINED,
+    MODBUS_EXCEPTION_GATEWAY_PATH,
+    MODBUS_EXCEPTION_GATEWAY_TARGET,
+    MODBUS_EXCEPTION_MAX
+};
+
+#define EMBXILFUN (MODBUS_ENOBASE + MODBUS_EXCEPTION_ILLEGAL_FUNCTION)
+#define EMBXILADD (MODBUS_ENOBASE + MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS)
+#define EMBXILVAL (MODBUS_ENOBASE + MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE)
+#define EMBXSFAIL (MODBUS_ENOBASE + MODBUS_EXCEPTION_SLAVE_OR_SERVER_FAILURE)
+#define EMBXACK (MODBUS_ENOBASE + MODBUS_EXCEPTION_ACKNOWLEDGE)
+#define EMBXSBUSY (MODBUS_ENOBASE + MODBUS_EXCEPTION_SLAVE_OR_SERVER_BUSY)
+#define EMBXNACK (MODBUS_ENOBASE + MODBUS_EXCEPTION_NEGATIVE_ACKNOWLEDGE)
+#define EMBXMEMPAR (MODBUS_ENOBASE + MODBUS_EXCEPTION_MEMORY_PARITY)
+#define EMBXGPATH (MODBUS_ENOBASE + MODBUS_EXCEPTION_GATEWAY_PATH)
+#define EMBXGTAR (MODBUS_ENOBASE + MODBUS_EXCEPTION_GATEWAY_TARGET)
+#define EMBBADCRC (EMBXGTAR + 1)
+#define EMBBADDATA (EMBXGTAR + 2)
+#define EMBBADEXC (EMBXGTAR + 3)
+#define EMBUNKEXC (EMBXGTAR + 4)
+#define EMBMDATA (EMBXGTAR + 5)
+#define EMBBADSLAVE (EMBXGTAR + 6)
+
+// The bus a client works on, defined by the implementation that is linked in
+struct ModbusRTUPort;
+
+class ModbusRTUClientClass {
+private:
+    ModbusRTUPort *_port;
+
+public:
+    // Like the RS485Class of the ArduinoModbus client, every instance gets its own port
+    ModbusRTUClientClass(ModbusRTUPort &port) : _port(&port) {}
+    ModbusRTUPort &port() const { return *_port; }
+
+    int begin(unsigned long baudrate, uint16_t config = SERIAL_8N1);
+    void end();
+    void setTimeout(unsigned long timeout);
+
+    int requestFrom(int id, int type, int address, int nb);
+    int available();
+    long read();
+
+    int beginTransmission(int id, int type, int address, int nb);
+    int write(unsigned int value);
+    int endTransmission();
+
+    const char *lastError();
+};
+
+extern ModbusRTUClientClass ModbusRTUClient;
+
+#endif
@@ -0,0 +1,260 @@
+#include "ArduinoMqttClient.h"
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_PINGREQ 0xC0
+#define MQTT_PINGRESP 0xD0
+#define MQTT_DISCONNECT 0xE0
+
+// Connect errors as reported by ArduinoMqttClient
+#define MQTT_CONNECTION_REFUSED -2
+#define MQTT_CONNECTION_TIMEOUT -1
+#define MQTT_SUCCESS 0
+
+#define MQTT_CONNECT_TIMEOUT 5000
+
+static size_t encodeLength(uint8_t *buffer, unsigned long length){
+    size_t position = 0;
+    do {
+        uint8_t digit = length % 128;
+        length /= 128;
+        if(length > 0) digit |= 0x80;
+        buffer[position++] = digit;
+    } while(length > 0);
+    return position;
+}
+
+MqttClient::MqttClient() :
+_socket(-1),
+_id("pego"),
+_keepAliveInterval(60000),
+_lastSent(0),
+_connectError(MQTT_SUCCESS),
+_size(0),
+_retain(false),
+_qos(0),
+_length(0),
+_packetId(0),
+_pendingAcknowledgements(0),
+_receivedLength(0)
+{
+    _topic[0] = '\0';
+}
+
+MqttClient::~MqttClient(){
+    stop();
+}
+
+void MqttClient::setId(const char *id){
+    _id = id;
+}
+
+void MqttClient::setKeepAliveInterval(unsigned long interval){
+    _keepAliveInterval = interval;
+}
+
+bool MqttClient::sendPacket(const uint8_t *buffer, size_t length){
+    while(length > 0){
+        ssize_t sent = send(_socket, buffer, length, MSG_NOSIGNAL);
+        if(sent < 0){
+            if(errno == EINTR) continue;
+            disconnected();
+            return false;
+        }
+        buffer += sent;
+        length -= sent;
+    }
+    _lastSent = millis();
+    return true;
+}
+
+void MqttClient::disconnected(){
+    if(_socket >= 0) close(_socket);
+    _socket = -1;
+    _receivedLength = 0;
+    _pendingAcknowledgements = 0;
+}
+
+int MqttClient::connect(const char *host, uint16_t port){
+    stop();
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *addresses;
+    if(getaddrinfo(host, service, &hints, &addresses) != 0){
+        _connectError = MQTT_CONNECTION_REFUSED;
+        return 0;
+    }
+    for(struct addrinfo *address = addresses; address != NULL; address = address->ai_next){
+        _socket = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if(_socket < 0) continue;
+        if(::connect(_socket, address->ai_addr, address->ai_addrlen) == 0) break;
+        close(_socket);
+        _socket = -1;
+    }
+    freeaddrinfo(addresses);
+    if(_socket < 0){
+        _connectError = MQTT_CONNECTION_REFUSED;
+        return 0;
+    }
+    int noDelay = 1;
+    setsockopt(_socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    // Clean session without credentials
+    uint8_t packet[128];
+    size_t idLength = strlen(_id);
+    if(idLength > 64) idLength = 64;
+    uint16_t keepAlive = _keepAliveInterval / 1000;
+    uint8_t variable[] = {0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, highByte(keepAlive), lowByte(keepAlive)};
+    size_t position = 0;
+    packet[position++] = MQTT_CONNECT;
+    position += encodeLength(packet + position, sizeof(variable) + 2 + idLength);
+    memcpy(packet + position, variable, sizeof(variable));
+    position += sizeof(variable);
+    packet[position++] = 0;
+    packet[position++] = idLength;
+    memcpy(packet + position, _id, idLength);
+    position += idLength;
+    if(!sendPacket(packet, position)){
+        _connectError = MQTT_CONNECTION_REFUSED;
+        return 0;
+    }
+
+    uint8_t acknowledgement[4];
+    size_t received = 0;
+    unsigned long start = millis();
+    while(received < sizeof(acknowledgement)){
+        struct pollfd descriptor = {_socket, POLLIN, 0};
+        long remaining = MQTT_CONNECT_TIMEOUT - (long)(millis() - start);
+        if(remaining <= 0 || ::poll(&descriptor, 1, remaining) <= 0){
+            disconnected();
+            _connectError = MQTT_CONNECTION_TIMEOUT;
+            return 0;
+        }
+        ssize_t count = recv(_socket, acknowledgement + received, sizeof(acknowledgement) - received, 0);
+        if(count <= 0){
+            disconnected();
+            _connectError = MQTT_CONNECTION_REFUSED;
+            return 0;
+        }
+        received += count;
+    }
+    if(acknowledgement[0] != MQTT_CONNACK || acknowledgement[3] != 0){
+        _connectError = acknowledgement[0] == MQTT_CONNACK ? acknowledgement[3] : MQTT_CONNECTION_REFUSED;
+        disconnected();
+        return 0;
+    }
+    _connectError = MQTT_SUCCESS;
+    return 1;
+}
+
+int MqttClient::connected(){
+    return _socket >= 0;
+}
+
+void MqttClient::stop(){
+    if(_socket < 0) return;
+    uint8_t packet[] = {MQTT_DISCONNECT, 0};
+    sendPacket(packet, sizeof(packet));
+    disconnected();
+}
+
+int MqttClient::connectError() const {
+    return _connectError;
+}
+
+void MqttClient::poll(){
+    if(_socket < 0) return;
+    while(true){
+        ssize_t count = recv(_socket, _received + _receivedLength, sizeof(_received) - _receivedLength, MSG_DONTWAIT);
+        if(count == 0){
+            disconnected();
+            return;
+        }
+        if(count < 0){
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) disconnected();
+            break;
+        }
+        _receivedLength += count;
+
+        // Only short packets are expected: PUBACK and PINGRESP
+        size_t position = 0;
+        while(_receivedLength - position >= 2){
+            uint8_t remaining = _received[position + 1];
+            if(_receivedLength - position < 2u + remaining) break;
+            if((_received[position] & 0xF0) == MQTT_PUBACK && _pendingAcknowledgements > 0){
+                --_pendingAcknowledgements;
+            }
+            position += 2 + remaining;
+        }
+        memmove(_received, _received + position, _receivedLength - position);
+        _receivedLength -= position;
+    }
+
+    if(_socket >= 0 && _keepAliveInterval != 0 && millis() - _lastSent >= _keepAliveInterval / 2){
+        uint8_t packet[] = {MQTT_PINGREQ, 0};
+        sendPacket(packet, sizeof(packet));
+    }
+}
+
+int MqttClient::beginMessage(const char *topic, unsigned long size, bool retain, uint8_t qos, bool dup){
+    (void)dup;
+    if(_socket < 0 || size > MQTT_HOST_MAX_MESSAGE || strlen(topic) >= sizeof(_topic) || qos > 1) return 0;
+    strcpy(_topic, topic);
+    _size = size;
+    _retain = retain;
+    _qos = qos;
+    _length = 0;
+    return 1;
+}
+
+size_t MqttClient::write(uint8_t character){
+    return write(&character, 1);
+}
+
+size_t MqttClient::write(const uint8_t *buffer, size_t size){
+    if(_length + size > _size) size = _size - _length;
+    memcpy(_message + _length, buffer, size);
+    _length += size;
+    return size;
+}
+
+int MqttClient::endMessage(){
+    if(_socket < 0 || _length != _size) return 0;
+    static uint8_t packet[MQTT_HOST_MAX_MESSAGE + 256];
+    size_t topicLength = strlen(_topic);
+    unsigned long remaining = 2 + topicLength + (_qos > 0 ? 2 : 0) + _length;
+    size_t position = 0;
+    packet[position++] = MQTT_PUBLISH | (_qos << 1) | (_retain ? 1 : 0);
+    position += encodeLength(packet + position, remaining);
+    packet[position++] = highByte(topicLength);
+    packet[position++] = lowByte(topicLength);
+    memcpy(packet + position, _topic, topicLength);
+    position += topicLength;
+    if(_qos > 0){
+        if(++_packetId == 0) _packetId = 1;
+        packet[position++] = highByte(_packetId);
+        packet[position++] = lowByte(_packetId);
+    }
+    memcpy(packet + position, _message, _length);
+    position += _length;
+    if(!sendPacket(packet, position)) return 0;
+    if(_qos > 0) ++_pendingAcknowledgements;
+    return 1;
+}
+
+unsigned long MqttClient::pendingAcknowledgements() const {
+    return _pendingAcknowledgements;
+}
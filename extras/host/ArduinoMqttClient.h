@@ -0,0 +1,74 @@
+#ifndef ARDUINO_MQTT_CLIENT_H
+#define ARDUINO_MQTT_CLIENT_H
+
+/*
+Host replacement for the ArduinoMqttClient library. Implements the subset
+used by MqttPublisher on top of a POSIX TCP socket: MQTT 3.1.1 connect,
+publish with QoS 0 / 1 and the keep alive. Unlike the original there is no
+Client to pass in, the client opens the socket itself in connect().
+*/
+
+#include "Arduino.h"
+
+// Largest message that can be published
+#define MQTT_HOST_MAX_MESSAGE 4096
+
+class MqttClient : public Print {
+private:
+    int _socket;
+    const char *_id;
+    unsigned long _keepAliveInterval;
+    unsigned long _lastSent;
+    int _connectError;
+
+    char _topic[128];
+    unsigned long _size;
+    bool _retain;
+    uint8_t _qos;
+    uint8_t _message[MQTT_HOST_MAX_MESSAGE];
+    unsigned long _length;
+
+    uint16_t _packetId;
+    unsigned long _pendingAcknowledgements;
+
+    uint8_t _received[256];
+    size_t _receivedLength;
+
+    bool sendPacket(const uint8_t *buffer, size_t length);
+    void disconnected();
+
+public:
+    MqttClient();
+    ~MqttClient();
+
+    void setId(const char *id);
+    void setKeepAliveInterval(unsigned long interval);
+
+    /**
+     * @brief Opens the TCP connection and waits for the CONNACK.
+     * @return 1 on success, 0 otherwise. See connectError().
+     */
+    int connect(const char *host, uint16_t port = 1883);
+    int connected();
+    void stop();
+    int connectError() const;
+
+    /**
+     * @brief Reads acknowledgements and sends a ping when the connection is idle.
+     */
+    void poll();
+
+    int beginMessage(const char *topic, unsigned long size, bool retain = false, uint8_t qos = 0, bool dup = false);
+    int endMessage();
+
+    using Print::write;
+    size_t write(uint8_t character) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+
+    /**
+     * @brief QoS 1 messages the broker didn't acknowledge yet. Host only.
+     */
+    unsigned long pendingAcknowledgements() const;
+};
+
+#endif
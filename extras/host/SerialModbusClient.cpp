@@ -0,0 +1,466 @@
+#include "SerialModbusClient.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+
+#define MODBUS_READ_HOLDING_REGISTERS 0x03
+#define MODBUS_WRITE_SINGLE_REGISTER 0x06
+#define MODBUS_WRITE_MULTIPLE_REGISTERS 0x10
+
+// Above 19200 baud the Modbus specification fixes the silent intervals
+#define MODBUS_RTU_FIXED_TIMING_BAUD_RATE 19200
+#define MODBUS_RTU_FIXED_FRAME_SILENCE 1750 // µs
+
+// Time the driver may hold back received characters, in µs. USB adapters
+// collect characters for their latency timer, which is 16 ms for FTDI
+// chips unless low latency is set.
+#define SERIAL_LOW_LATENCY_DELAY 1000
+#define SERIAL_DEFAULT_LATENCY_DELAY 16000
+
+ModbusRTUPort::ModbusRTUPort(const char *path) :
+path(path),
+fd(-1),
+requestedDirectionControl(SERIAL_DIRECTION_AUTO),
+directionControl(SERIAL_DIRECTION_NONE),
+lowLatencyRequested(true),
+characterTime(1042), // 9600 baud
+frameSilence(3646), // 3.5 characters
+latencyDelay(SERIAL_DEFAULT_LATENCY_DELAY),
+responseTimeout(1000),
+lastActivity(0),
+errorMessage(""),
+responseLength(0),
+responsePosition(0),
+transmissionId(-1),
+transmissionAddress(0),
+transmissionCount(0),
+transmissionLength(0),
+statistics({0, 0, 0, 0, 0, 0})
+{}
+
+static ModbusRTUPort defaultPort;
+ModbusRTUClientClass ModbusRTUClient(defaultPort);
+
+void serialModbusSetPort(ModbusRTUClientClass &client, const char *path){
+    client.port().path = path;
+}
+
+void serialModbusSetDirectionControl(ModbusRTUClientClass &client, SerialDirectionControl control){
+    client.port().requestedDirectionControl = control;
+}
+
+void serialModbusSetLowLatency(ModbusRTUClientClass &client, bool enabled){
+    client.port().lowLatencyRequested = enabled;
+}
+
+SerialDirectionControl serialModbusDirectionControl(const ModbusRTUClientClass &client){
+    return client.port().directionControl;
+}
+
+void serialModbusStatistics(const ModbusRTUClientClass &client, SerialModbusStatistics &result){
+    result = client.port().statistics;
+}
+
+void serialModbusResetStatistics(ModbusRTUClientClass &client){
+    client.port().statistics = (SerialModbusStatistics){0, 0, 0, 0, 0, 0};
+}
+
+void serialModbusSetPort(const char *path){
+    serialModbusSetPort(ModbusRTUClient, path);
+}
+
+void serialModbusSetDirectionControl(SerialDirectionControl control){
+    serialModbusSetDirectionControl(ModbusRTUClient, control);
+}
+
+void serialModbusSetLowLatency(bool enabled){
+    serialModbusSetLowLatency(ModbusRTUClient, enabled);
+}
+
+SerialDirectionControl serialModbusDirectionControl(){
+    return serialModbusDirectionControl(ModbusRTUClient);
+}
+
+void serialModbusStatistics(SerialModbusStatistics &result){
+    serialModbusStatistics(ModbusRTUClient, result);
+}
+
+void serialModbusResetStatistics(){
+    serialModbusResetStatistics(ModbusRTUClient);
+}
+
+static speed_t speedForBaudRate(unsigned long baudRate){
+    switch(baudRate){
+        case 1200: return B1200;
+        case 2400: return B2400;
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        default: return 0;
+    }
+}
+
+static uint16_t crc16(const uint8_t *buffer, size_t length){
+    uint16_t crc = 0xFFFF;
+    while(length--){
+        crc ^= *buffer++;
+        for(uint8_t i = 0; i < 8; ++i){
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+static void fail(ModbusRTUPort &port, int error, const char *message){
+    errno = error;
+    port.errorMessage = message;
+}
+
+static bool setRts(ModbusRTUPort &port, bool enabled){
+    int flag = TIOCM_RTS;
+    return ioctl(port.fd, enabled ? TIOCMBIS : TIOCMBIC, &flag) == 0;
+}
+
+/**
+ * @brief Hands the driver enable pin to the kernel.
+ * @return true if the driver supports TIOCSRS485.
+ */
+static bool enableKernelDirectionControl(ModbusRTUPort &port){
+    #if defined(__linux__) && defined(TIOCSRS485)
+    struct serial_rs485 rs485;
+    memset(&rs485, 0, sizeof(rs485));
+    // RTS is high while sending and low otherwise, without extra delays
+    rs485.flags = SER_RS485_ENABLED | SER_RS485_RTS_ON_SEND;
+    return ioctl(port.fd, TIOCSRS485, &rs485) == 0;
+    #else
+    return false;
+    #endif
+}
+
+/**
+ * @brief Asks the driver to pass on received characters right away.
+ * @return true if the driver accepted the flag.
+ */
+static bool enableLowLatency(ModbusRTUPort &port){
+    #if defined(__linux__) && defined(ASYNC_LOW_LATENCY)
+    struct serial_struct serial;
+    if(ioctl(port.fd, TIOCGSERIAL, &serial) != 0) return false;
+    serial.flags |= ASYNC_LOW_LATENCY;
+    return ioctl(port.fd, TIOCSSERIAL, &serial) == 0;
+    #else
+    return false;
+    #endif
+}
+
+/**
+ * @brief Waits until the serial port is readable.
+ * @param timeout The timeout in µs. poll() only takes milliseconds,
+ * so ppoll() is used where available.
+ * @return true if there is something to read.
+ */
+static bool waitReadable(ModbusRTUPort &port, unsigned long timeout){
+    struct pollfd descriptor = {port.fd, POLLIN, 0};
+    #ifdef __linux__
+    struct timespec duration = {(time_t)(timeout / 1000000), (long)(timeout % 1000000) * 1000};
+    return ::ppoll(&descriptor, 1, &duration, NULL) > 0;
+    #else
+    return ::poll(&descriptor, 1, (timeout + 999) / 1000) > 0;
+    #endif
+}
+
+static bool sendFrame(ModbusRTUPort &port, size_t length, unsigned long &start){
+    uint16_t crc = crc16(port.frame, length);
+    port.frame[length++] = lowByte(crc);
+    port.frame[length++] = highByte(crc);
+
+    // Drop whatever a previous, timed out response left behind
+    tcflush(port.fd, TCIFLUSH);
+    // Only the part of the silent interval that didn't pass yet since the
+    // last character on the bus is waited for
+    unsigned long silence = micros() - port.lastActivity;
+    if(silence < port.frameSilence) delayMicroseconds(port.frameSilence - silence);
+
+    if(port.directionControl == SERIAL_DIRECTION_RTS && !setRts(port, true)){
+        fail(port, EIO, "Couldn't switch RS485 direction");
+        return false;
+    }
+    start = micros();
+    bool written = ::write(port.fd, port.frame, length) == (ssize_t)length;
+    tcdrain(port.fd);
+    if(port.directionControl == SERIAL_DIRECTION_RTS){
+        setRts(port, false);
+        // The receiver saw the request as well
+        tcflush(port.fd, TCIFLUSH);
+    }
+    port.lastActivity = micros();
+    if(!written){
+        fail(port, EIO, "Write to serial port failed");
+        return false;
+    }
+    return true;
+}
+
+static bool receive(ModbusRTUPort &port, size_t length, size_t &received, unsigned long timeout){
+    while(received < length){
+        if(!waitReadable(port, timeout)){
+            fail(port, ETIMEDOUT, received == 0 ? "Connection timed out" : "Incomplete frame");
+            return false;
+        }
+        ssize_t count = ::read(port.fd, port.frame + received, length - received);
+        if(count <= 0){
+            fail(port, EIO, "Read from serial port failed");
+            return false;
+        }
+        received += count;
+        port.lastActivity = micros();
+        // Once the frame started, a gap of 3.5 characters ends it
+        timeout = port.frameSilence + port.latencyDelay;
+    }
+    return true;
+}
+
+/**
+ * @brief Receives the response to a request into the frame buffer of the port.
+ * @param id The addressed peripheral.
+ * @param functionCode The function code of the request.
+ * @param dataLength The expected length following address and function code, 0 if the third byte holds it.
+ * @return The length of the frame without CRC or 0 on failure.
+ */
+static size_t receiveResponse(ModbusRTUPort &port, uint8_t id, uint8_t functionCode, size_t dataLength){
+    size_t received = 0;
+    if(!receive(port, 3, received, port.responseTimeout * 1000)) return 0;
+
+    size_t length;
+    if(port.frame[1] == (functionCode | 0x80)){
+        length = 3;
+    } else if(port.frame[1] == functionCode){
+        length = 2 + (dataLength == 0 ? 1 + port.frame[2] : dataLength);
+    } else {
+        fail(port, EMBBADDATA, "Invalid data");
+        return 0;
+    }
+    if(length + 2 > SERIAL_MODBUS_MAX_FRAME || !receive(port, length + 2, received, port.frameSilence + port.latencyDelay)) return 0;
+
+    uint16_t crc = port.frame[length] | (port.frame[length + 1] << 8);
+    if(crc != crc16(port.frame, length)){
+        fail(port, EMBBADCRC, "Invalid CRC");
+        return 0;
+    }
+    if(port.frame[0] != id){
+        fail(port, EMBBADSLAVE, "Response not from requested slave");
+        return 0;
+    }
+    if(port.frame[1] & 0x80){
+        uint8_t exception = port.frame[2];
+        if(exception >= MODBUS_EXCEPTION_ILLEGAL_FUNCTION && exception < MODBUS_EXCEPTION_MAX){
+            fail(port, MODBUS_ENOBASE + exception, "Modbus exception");
+        } else {
+            fail(port, EMBUNKEXC, "Unknown Modbus exception");
+        }
+        return 0;
+    }
+    return length;
+}
+
+/**
+ * @brief Adds a transaction to the statistics of the port.
+ * @param start The time the request was written in µs.
+ * @param characters Request and response length including CRC, 0 if the transaction failed.
+ */
+static void recordTransaction(ModbusRTUPort &port, unsigned long start, size_t characters){
+    if(characters == 0){
+        ++port.statistics.failures;
+        return;
+    }
+    unsigned long roundTrip = port.lastActivity - start;
+    if(port.statistics.transactions == 0 || roundTrip < port.statistics.minimumRoundTrip) port.statistics.minimumRoundTrip = roundTrip;
+    if(roundTrip > port.statistics.maximumRoundTrip) port.statistics.maximumRoundTrip = roundTrip;
+    ++port.statistics.transactions;
+    port.statistics.roundTripSum += roundTrip;
+    port.statistics.wireTimeSum += characters * port.characterTime;
+}
+
+int ModbusRTUClientClass::begin(unsigned long baudrate, uint16_t config){
+    ModbusRTUPort &port = *_port;
+    speed_t speed = speedForBaudRate(baudrate);
+    if(speed == 0){
+        fail(port, EINVAL, "Unsupported baud rate");
+        return 0;
+    }
+    if(port.fd < 0){
+        port.fd = open(port.path, O_RDWR | O_NOCTTY);
+        if(port.fd < 0){
+            fail(port, errno, "Couldn't open serial port");
+            perror(port.path);
+            return 0;
+        }
+    }
+
+    struct termios options;
+    tcgetattr(port.fd, &options);
+    cfmakeraw(&options);
+    cfsetispeed(&options, speed);
+    cfsetospeed(&options, speed);
+    options.c_cflag |= CLOCAL | CREAD;
+    options.c_cflag &= ~(PARENB | PARODD | CSTOPB);
+    if(config == SERIAL_8E1) options.c_cflag |= PARENB;
+    if(config == SERIAL_8O1) options.c_cflag |= PARENB | PARODD;
+    if(config == SERIAL_8N2) options.c_cflag |= CSTOPB;
+    // Reads never block, all waiting is done with poll
+    options.c_cc[VMIN] = 0;
+    options.c_cc[VTIME] = 0;
+    if(tcsetattr(port.fd, TCSANOW, &options) != 0){
+        fail(port, errno, "Couldn't configure serial port");
+        return 0;
+    }
+
+    port.directionControl = port.requestedDirectionControl;
+    if(port.directionControl == SERIAL_DIRECTION_AUTO || port.directionControl == SERIAL_DIRECTION_KERNEL){
+        bool kernel = enableKernelDirectionControl(port);
+        if(!kernel && port.directionControl == SERIAL_DIRECTION_KERNEL){
+            fail(port, ENOTTY, "RS485 mode not supported by the serial driver");
+            return 0;
+        }
+        port.directionControl = kernel ? SERIAL_DIRECTION_KERNEL : SERIAL_DIRECTION_NONE;
+    } else if(port.directionControl == SERIAL_DIRECTION_RTS && !setRts(port, false)){
+        fail(port, errno, "Couldn't switch RS485 direction");
+        return 0;
+    }
+    port.latencyDelay = port.lowLatencyRequested && enableLowLatency(port) ? SERIAL_LOW_LATENCY_DELAY : SERIAL_DEFAULT_LATENCY_DELAY;
+
+    unsigned long bits = config == SERIAL_8N1 ? 10 : 11;
+    port.characterTime = bits * 1000000UL / baudrate;
+    port.frameSilence = baudrate > MODBUS_RTU_FIXED_TIMING_BAUD_RATE ? MODBUS_RTU_FIXED_FRAME_SILENCE : port.characterTime * 7 / 2;
+    return 1;
+}
+
+void ModbusRTUClientClass::end(){
+    ModbusRTUPort &port = *_port;
+    if(port.fd >= 0) close(port.fd);
+    port.fd = -1;
+}
+
+void ModbusRTUClientClass::setTimeout(unsigned long timeout){
+    ModbusRTUPort &port = *_port;
+    port.responseTimeout = timeout;
+}
+
+int ModbusRTUClientClass::requestFrom(int id, int type, int address, int nb){
+    ModbusRTUPort &port = *_port;
+    port.responseLength = 0;
+    port.responsePosition = 0;
+    if(port.fd < 0){
+        fail(port, EBADF, "Serial port not open");
+        return 0;
+    }
+    if(type != HOLDING_REGISTERS || nb < 1 || nb > 125){
+        fail(port, EINVAL, "Invalid argument");
+        return 0;
+    }
+
+    port.frame[0] = id;
+    port.frame[1] = MODBUS_READ_HOLDING_REGISTERS;
+    port.frame[2] = highByte(address);
+    port.frame[3] = lowByte(address);
+    port.frame[4] = highByte(nb);
+    port.frame[5] = lowByte(nb);
+    unsigned long start;
+    if(!sendFrame(port, 6, start)) return 0;
+    size_t length = receiveResponse(port, id, MODBUS_READ_HOLDING_REGISTERS, 0);
+    if(length != 0 && port.frame[2] != 2 * nb){
+        fail(port, EMBBADDATA, "Invalid data");
+        length = 0;
+    }
+    recordTransaction(port, start, length == 0 ? 0 : 8 + length + 2);
+    if(length == 0) return 0;
+    port.responseLength = nb;
+    return nb;
+}
+
+int ModbusRTUClientClass::available(){
+    ModbusRTUPort &port = *_port;
+    return port.responseLength - port.responsePosition;
+}
+
+long ModbusRTUClientClass::read(){
+    ModbusRTUPort &port = *_port;
+    if(port.responsePosition >= port.responseLength) return -1;
+    const uint8_t *value = port.frame + 3 + 2 * port.responsePosition++;
+    return (value[0] << 8) | value[1];
+}
+
+int ModbusRTUClientClass::beginTransmission(int id, int type, int address, int nb){
+    ModbusRTUPort &port = *_port;
+    port.responseLength = 0;
+    port.responsePosition = 0;
+    if(type != HOLDING_REGISTERS || nb < 1 || nb > 123){
+        fail(port, EINVAL, "Invalid argument");
+        return 0;
+    }
+    port.transmissionId = id;
+    port.transmissionAddress = address;
+    port.transmissionCount = nb;
+    port.transmissionLength = 0;
+    return 1;
+}
+
+int ModbusRTUClientClass::write(unsigned int value){
+    ModbusRTUPort &port = *_port;
+    if(port.transmissionId < 0 || port.transmissionLength >= port.transmissionCount) return 0;
+    // Values go straight to their place in a write multiple registers request
+    uint8_t *position = port.frame + 7 + 2 * port.transmissionLength++;
+    position[0] = highByte(value);
+    position[1] = lowByte(value);
+    return 1;
+}
+
+int ModbusRTUClientClass::endTransmission(){
+    ModbusRTUPort &port = *_port;
+    if(port.transmissionId < 0) return 0;
+    uint8_t id = port.transmissionId;
+    port.transmissionId = -1;
+    if(port.fd < 0){
+        fail(port, EBADF, "Serial port not open");
+        return 0;
+    }
+
+    port.frame[0] = id;
+    port.frame[2] = highByte(port.transmissionAddress);
+    port.frame[3] = lowByte(port.transmissionAddress);
+    size_t length;
+    if(port.transmissionLength == 1){
+        port.frame[1] = MODBUS_WRITE_SINGLE_REGISTER;
+        port.frame[4] = port.frame[7];
+        port.frame[5] = port.frame[8];
+        length = 6;
+    } else {
+        port.frame[1] = MODBUS_WRITE_MULTIPLE_REGISTERS;
+        port.frame[4] = highByte(port.transmissionLength);
+        port.frame[5] = lowByte(port.transmissionLength);
+        port.frame[6] = 2 * port.transmissionLength;
+        length = 7 + 2 * port.transmissionLength;
+    }
+    uint8_t functionCode = port.frame[1];
+    unsigned long start;
+    if(!sendFrame(port, length, start)) return 0;
+    // Broadcasts are never answered
+    if(id == 0) return 1;
+    size_t received = receiveResponse(port, id, functionCode, 4);
+    recordTransaction(port, start, received == 0 ? 0 : length + 2 + received + 2);
+    return received != 0 ? 1 : 0;
+}
+
+const char *ModbusRTUClientClass::lastError(){
+    ModbusRTUPort &port = *_port;
+    return port.errorMessage;
+}
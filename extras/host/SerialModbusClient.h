@@ -0,0 +1,123 @@
+#ifndef SERIAL_MODBUS_CLIENT_H
+#define SERIAL_MODBUS_CLIENT_H
+
+/*
+ModbusRTUClient implementation for Linux / macOS hosts on top of a termios
+serial port, e.g. a USB RS485 adapter or the UART of a Raspberry Pi with a
+transceiver. Link SerialModbusClient.cpp instead of a mock to talk to real
+controllers through the unchanged PegoController API.
+
+ModbusRTUClient works on /dev/ttyUSB0 by default. Further buses get a port
+and a client each, which are passed to PegoController as its transport:
+
+    ModbusRTUPort secondPort("/dev/ttyUSB1");
+    ModbusRTUClientClass secondBus(secondPort);
+*/
+
+#include "ArduinoModbus.h"
+
+#define SERIAL_MODBUS_MAX_FRAME 256
+
+/**
+ * @brief How the driver enable pin of the RS485 transceiver is switched.
+ */
+enum SerialDirectionControl : uint8_t {
+    // TIOCSRS485 if the driver supports it, otherwise left to the adapter
+    SERIAL_DIRECTION_AUTO = 0,
+    // The adapter switches on its own, as most USB RS485 adapters do
+    SERIAL_DIRECTION_NONE,
+    // The kernel drives RTS around each frame, begin() fails without TIOCSRS485
+    SERIAL_DIRECTION_KERNEL,
+    // RTS is raised before and dropped after each frame by the client
+    SERIAL_DIRECTION_RTS
+};
+
+/**
+ * @brief Round trip times of the transactions since the last reset.
+ * A round trip lasts from the first byte of the request being written until
+ * the last byte of the response was received, wire time is the part of it
+ * that the characters alone need at the configured baud rate. The
+ * difference is the turnaround of the controller plus the latency of the
+ * serial driver, which is what the LoopProfiler bus phase of an on-board
+ * sketch compares against.
+ */
+struct SerialModbusStatistics {
+    unsigned long transactions;
+    unsigned long failures;
+    unsigned long minimumRoundTrip; // µs
+    unsigned long maximumRoundTrip; // µs
+    unsigned long long roundTripSum; // µs
+    unsigned long long wireTimeSum; // µs
+};
+
+/**
+ * @brief The serial port of one bus and the state of its current transaction.
+ */
+struct ModbusRTUPort {
+    const char *path;
+    int fd;
+    SerialDirectionControl requestedDirectionControl;
+    SerialDirectionControl directionControl;
+    bool lowLatencyRequested;
+    unsigned long characterTime; // µs
+    unsigned long frameSilence; // µs
+    unsigned long latencyDelay; // µs
+    unsigned long responseTimeout; // ms
+    unsigned long lastActivity; // µs
+    const char *errorMessage;
+
+    // Requests are built and responses received in place, read() and write()
+    // convert directly from and to the wire format of this buffer
+    uint8_t frame[SERIAL_MODBUS_MAX_FRAME];
+    int responseLength;
+    int responsePosition;
+
+    int transmissionId;
+    int transmissionAddress;
+    int transmissionCount;
+    int transmissionLength;
+
+    SerialModbusStatistics statistics;
+
+    ModbusRTUPort(const char *path = "/dev/ttyUSB0");
+};
+
+/**
+ * @brief Sets the serial device used by the next begin() of a client.
+ * @param path The device path, e.g. /dev/ttyUSB0
+ */
+void serialModbusSetPort(ModbusRTUClientClass &client, const char *path);
+
+/**
+ * @brief Sets the direction control used by the next begin() of a client.
+ * @param control SERIAL_DIRECTION_AUTO by default.
+ */
+void serialModbusSetDirectionControl(ModbusRTUClientClass &client, SerialDirectionControl control);
+
+/**
+ * @brief Whether begin() asks the driver for low latency, which shortens
+ * the 16 ms latency timer of FTDI adapters to 1 ms. Enabled by default.
+ */
+void serialModbusSetLowLatency(ModbusRTUClientClass &client, bool enabled);
+
+/**
+ * @brief Returns the direction control that begin() ended up with.
+ */
+SerialDirectionControl serialModbusDirectionControl(const ModbusRTUClientClass &client);
+
+/**
+ * @brief Copies the round trip statistics of a client.
+ */
+void serialModbusStatistics(const ModbusRTUClientClass &client, SerialModbusStatistics &statistics);
+
+void serialModbusResetStatistics(ModbusRTUClientClass &client);
+
+// The same for ModbusRTUClient
+void serialModbusSetPort(const char *path);
+void serialModbusSetDirectionControl(SerialDirectionControl control);
+void serialModbusSetLowLatency(bool enabled);
+SerialDirectionControl serialModbusDirectionControl();
+void serialModbusStatistics(SerialModbusStatistics &statistics);
+void serialModbusResetStatistics();
+
+#endif
@@ -0,0 +1,80 @@
+// Payload formatter for LoRaWAN network servers (e.g. The Things Stack)
+// Decodes the frames produced by SnapshotEncoder (see src/SnapshotCodec.h).
+// Delta frames only contain the fields that changed since the full frame
+// with the sequence number given in "referenceSequence".
+// The meaning of some alarm bits depends on the controller model, which every
+// frame carries. Frames of encoders that predate it report the model "unknown".
+
+const SNAPSHOT_CODEC_VERSION = 1;
+const FRAME_FULL = 0;
+const FRAME_DELTA = 1;
+const READ_ERROR = -32768;
+const MODEL_NAMES = ["unknown", "ecpBase", "ecp202"];
+
+// Alarm Status Register bits per model (see src/StatusBits.h)
+const ALARM_BITS = {
+    ecpBase: { temperatureAlarm: 3, openDoorAlarm: 4 },
+    ecp202: {
+        highTemperatureAlarm: 4, lowTemperatureAlarm: 5, openDoorAlarm: 6,
+        manInRoomAlarm: 7, compressorProtectionAlarm: 8, lightAlarm: 9
+    }
+};
+
+function readInt16(bytes, index) {
+    let value = (bytes[index] << 8) | bytes[index + 1];
+    return value > 32767 ? value - 65536 : value;
+}
+
+function toTemperature(value) {
+    return value == READ_ERROR ? null : value / 10;
+}
+
+function decodeStatusWord(word, data) {
+    data.alarmStatus = word & 0x3FF;
+    data.ambientProbeFault = (data.alarmStatus & 0x01) != 0;
+    data.evaporatorProbeFault = (data.alarmStatus & 0x02) != 0;
+    data.eepromError = (data.alarmStatus & 0x04) != 0;
+    let bits = ALARM_BITS[data.model];
+    for (let name in bits) data[name] = ((data.alarmStatus >> bits[name]) & 1) == 1;
+    data.deviceStatus = (word >> 10) & 0x07;
+    data.deviceResponsive = ((word >> 13) & 1) == 1;
+    data.statusValid = ((word >> 14) & 1) == 1;
+    data.deviceStatusValid = ((word >> 15) & 1) == 1;
+}
+
+function decodeUplink(input) {
+    let bytes = input.bytes;
+    let data = {};
+    if (bytes.length < 2) return { errors: ["Frame too short"] };
+    if ((bytes[0] >> 4) != SNAPSHOT_CODEC_VERSION) return { errors: ["Unsupported version " + (bytes[0] >> 4)] };
+
+    let frameType = bytes[0] & 0x03;
+    data.model = MODEL_NAMES[(bytes[0] >> 2) & 0x03] || "unknown";
+    data.sequence = bytes[1];
+
+    if (frameType == FRAME_FULL) {
+        if (bytes.length != 10) return { errors: ["Invalid full frame length"] };
+        data.full = true;
+        data.ambientTemperature = toTemperature(readInt16(bytes, 2));
+        data.evaporatorTemperature = toTemperature(readInt16(bytes, 4));
+        data.outputStatus = bytes[6];
+        data.inputStatus = bytes[7];
+        decodeStatusWord((bytes[8] << 8) | bytes[9], data);
+        return { data: data };
+    }
+
+    if (frameType != FRAME_DELTA) return { errors: ["Unknown frame type " + frameType] };
+    if (bytes.length < 4) return { errors: ["Invalid delta frame length"] };
+
+    data.full = false;
+    data.referenceSequence = bytes[2];
+    let mask = bytes[3];
+    let index = 4;
+    if (mask & 0x01) { data.ambientTemperature = toTemperature(readInt16(bytes, index)); index += 2; }
+    if (mask & 0x02) { data.evaporatorTemperature = toTemperature(readInt16(bytes, index)); index += 2; }
+    if (mask & 0x04) { data.outputStatus = bytes[index++]; }
+    if (mask & 0x08) { data.inputStatus = bytes[index++]; }
+    if (mask & 0x10) { decodeStatusWord((bytes[index] << 8) | bytes[index + 1], data); index += 2; }
+    if (index != bytes.length) return { errors: ["Invalid delta frame length"] };
+    return { data: data };
+}
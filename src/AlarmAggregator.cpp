@@ -0,0 +1,200 @@
+#include "AlarmAggregator.h"
+#include "PegoModel.h"
+
+static const char *alarmNames[ALARM_COUNT] = {
+    "ambientProbeFault", "evaporatorProbeFault", "eepromError", "temperature",
+    "highTemperature", "lowTemperature", "openDoor", "manInRoom",
+    "compressorProtection", "light", "doorSwitch", "unresponsive"
+};
+
+const char *alarmName(AlarmId alarm){
+    return alarm < ALARM_COUNT ? alarmNames[alarm] : "none";
+}
+
+AlarmAggregator::AlarmAggregator() :
+_callback(NULL),
+_context(NULL),
+_digestInterval(0),
+_lastDigest(0),
+_digestStarted(false),
+_raisedCount(0),
+_clearedCount(0),
+_suppressedCount(0),
+_notifications(0),
+_now(0)
+{
+    AlarmPolicy policy = {ALARM_DEFAULT_HOLD_OFF, ALARM_DEFAULT_ESCALATION, ALARM_DEFAULT_RENOTIFY_INTERVAL, true};
+    for(uint8_t i = 0; i < ALARM_COUNT; ++i){
+        _alarms[i].policy = policy;
+        _alarms[i].state = ALARM_STATE_IDLE;
+        _alarms[i].escalated = false;
+    }
+    // Duplicates the open door alarm on models that have one
+    _alarms[ALARM_DOOR_SWITCH].policy.holdOff = ALARM_DEFAULT_DOOR_HOLD_OFF;
+    _alarms[ALARM_DOOR_SWITCH].policy.enabled = false;
+    // The snapshot already waits RESPONSIVENESS_THRESHOLD before reporting it
+    _alarms[ALARM_UNRESPONSIVE].policy.holdOff = 0;
+}
+
+void AlarmAggregator::setCallback(AlarmCallback callback, void *context){
+    _callback = callback;
+    _context = context;
+}
+
+void AlarmAggregator::setPolicy(AlarmId alarm, const AlarmPolicy &policy){
+    if(alarm >= ALARM_COUNT) return;
+    _alarms[alarm].policy = policy;
+    if(!policy.enabled) _alarms[alarm].state = ALARM_STATE_IDLE;
+}
+
+const AlarmPolicy &AlarmAggregator::policy(AlarmId alarm) const {
+    if(alarm >= ALARM_COUNT) alarm = ALARM_UNRESPONSIVE;
+    return _alarms[alarm].policy;
+}
+
+void AlarmAggregator::setDigestInterval(unsigned long interval){
+    _digestInterval = interval;
+}
+
+void AlarmAggregator::notify(AlarmId alarm, AlarmEvent event, unsigned long duration){
+    ++_notifications;
+    if(_callback != NULL) _callback(alarm, event, duration, _context);
+}
+
+void AlarmAggregator::advance(AlarmId alarm, bool condition, unsigned long now){
+    Alarm &entry = _alarms[alarm];
+    const AlarmPolicy &policy = entry.policy;
+    if(!policy.enabled) return;
+
+    if(entry.state == ALARM_STATE_IDLE && condition){
+        entry.state = ALARM_STATE_PENDING;
+        entry.changed = now;
+    } else if(entry.state == ALARM_STATE_CLEARING && condition){
+        // It came back before the hold-off, i.e. it never went away
+        entry.state = ALARM_STATE_ACTIVE;
+        ++_suppressedCount;
+    } else if(entry.state == ALARM_STATE_ACTIVE && !condition){
+        entry.state = ALARM_STATE_CLEARING;
+        entry.changed = now;
+    } else if(entry.state == ALARM_STATE_PENDING && !condition){
+        entry.state = ALARM_STATE_IDLE;
+        ++_suppressedCount;
+        return;
+    }
+
+    switch(entry.state){
+        case ALARM_STATE_PENDING:
+            if(now - entry.changed < policy.holdOff) break;
+            entry.state = ALARM_STATE_ACTIVE;
+            entry.escalated = false;
+            entry.raised = entry.changed;
+            entry.notified = now;
+            ++_raisedCount;
+            notify(alarm, ALARM_EVENT_RAISED, now - entry.raised);
+            break;
+        case ALARM_STATE_ACTIVE:
+            if(policy.escalation != 0 && !entry.escalated && now - entry.raised >= policy.escalation){
+                entry.escalated = true;
+                entry.notified = now;
+                notify(alarm, ALARM_EVENT_ESCALATED, now - entry.raised);
+            } else if(policy.renotifyInterval != 0 && now - entry.notified >= policy.renotifyInterval){
+                entry.notified = now;
+                notify(alarm, ALARM_EVENT_REMINDER, now - entry.raised);
+            }
+            break;
+        case ALARM_STATE_CLEARING:
+            if(now - entry.changed < policy.holdOff) break;
+            entry.state = ALARM_STATE_IDLE;
+            ++_clearedCount;
+            notify(alarm, ALARM_EVENT_CLEARED, entry.changed - entry.raised);
+            break;
+        default:
+            break;
+    }
+}
+
+uint8_t AlarmAggregator::update(const ControllerSnapshot &snapshot){
+    unsigned long now = snapshot.timestamp;
+    _now = now;
+    _notifications = 0;
+
+    if(snapshot.valid & SNAPSHOT_STATUS_VALID){
+        const PegoModelDescriptor &descriptor = descriptorForModel((PegoModel)snapshot.model);
+        // In the order of AlarmId, 0 if the model doesn't have the alarm
+        uint16_t masks[ALARM_LIGHT + 1] = {
+            bit(ALARM_STATUS_AMBIENT_PROBE_FAULT_BIT),
+            bit(ALARM_STATUS_EVAPORATOR_PROBE_FAULT_BIT),
+            bit(ALARM_STATUS_EEPROM_ERROR_BIT),
+            descriptor.temperatureAlarmMask,
+            descriptor.highTemperatureAlarmMask,
+            descriptor.lowTemperatureAlarmMask,
+            descriptor.openDoorAlarmMask,
+            descriptor.manInRoomAlarmMask,
+            descriptor.compressorProtectionAlarmMask,
+            descriptor.lightAlarmMask
+        };
+        // Models with split temperature alarms report an excursion as high or low, so the
+        // generic alarm would notify every excursion twice
+        uint16_t splitMask = descriptor.highTemperatureAlarmMask | descriptor.lowTemperatureAlarmMask;
+        if(splitMask != 0 && (masks[ALARM_TEMPERATURE] & ~splitMask) == 0) masks[ALARM_TEMPERATURE] = 0;
+        for(uint8_t i = 0; i <= ALARM_LIGHT; ++i){
+            advance((AlarmId)i, (snapshot.alarmStatus & masks[i]) != 0, now);
+        }
+        advance(ALARM_DOOR_SWITCH, bitRead(snapshot.inputStatus, INPUT_STATUS_DOOR_SWITCH_BIT), now);
+    }
+    advance(ALARM_UNRESPONSIVE, !snapshot.responsive, now);
+
+    if(!_digestStarted){
+        _lastDigest = now;
+        _digestStarted = true;
+    }
+    if(_digestInterval != 0 && now - _lastDigest >= _digestInterval){
+        _lastDigest = now;
+        bool activity = _raisedCount != 0 || _clearedCount != 0 || _suppressedCount != 0;
+        if(activity || activeCount() != 0) notify(ALARM_NONE, ALARM_EVENT_DIGEST, _digestInterval);
+        // After the callback, which may print the digest of the period that just ended
+        _raisedCount = 0;
+        _clearedCount = 0;
+        _suppressedCount = 0;
+    }
+    return _notifications;
+}
+
+bool AlarmAggregator::active(AlarmId alarm) const {
+    if(alarm >= ALARM_COUNT) return false;
+    AlarmState state = _alarms[alarm].state;
+    return state == ALARM_STATE_ACTIVE || state == ALARM_STATE_CLEARING;
+}
+
+uint8_t AlarmAggregator::activeCount() const {
+    uint8_t count = 0;
+    for(uint8_t i = 0; i < ALARM_COUNT; ++i){
+        if(active((AlarmId)i)) ++count;
+    }
+    return count;
+}
+
+void AlarmAggregator::printDigest(Print &output) const {
+    output.print("Alarms: ");
+    output.print(activeCount());
+    output.print(" active");
+    bool first = true;
+    for(uint8_t i = 0; i < ALARM_COUNT; ++i){
+        if(!active((AlarmId)i)) continue;
+        output.print(first ? " (" : ", ");
+        first = false;
+        output.print(alarmNames[i]);
+        output.print(' ');
+        output.print((_now - _alarms[i].raised) / 60000);
+        output.print(" min");
+        if(_alarms[i].escalated) output.print(" escalated");
+    }
+    if(!first) output.print(')');
+    output.print("; since last digest ");
+    output.print(_raisedCount);
+    output.print(" raised, ");
+    output.print(_clearedCount);
+    output.print(" cleared, ");
+    output.print(_suppressedCount);
+    output.println(" flaps suppressed");
+}
@@ -0,0 +1,173 @@
+#ifndef ALARM_AGGREGATOR_H
+#define ALARM_AGGREGATOR_H
+
+#include <Arduino.h>
+#include "ControllerSnapshot.h"
+
+// Default time in ms a condition has to persist before it is raised or cleared
+#define ALARM_DEFAULT_HOLD_OFF 60000
+
+// Default hold-off of the door, which is opened regularly during work
+#define ALARM_DEFAULT_DOOR_HOLD_OFF 300000
+
+// Default time in ms after which an alarm that is still active is escalated
+#define ALARM_DEFAULT_ESCALATION 1800000
+
+// Default time in ms between two reminders of an active alarm
+#define ALARM_DEFAULT_RENOTIFY_INTERVAL 14400000
+
+/**
+ * @brief The conditions an AlarmAggregator watches.
+ */
+enum AlarmId : uint8_t {
+    // Alarm Status Register (1282), decoded for the controller model
+    ALARM_AMBIENT_PROBE_FAULT = 0,
+    ALARM_EVAPORATOR_PROBE_FAULT,
+    ALARM_EEPROM_ERROR,
+    // Only on models without separate high and low temperature alarms
+    ALARM_TEMPERATURE,
+    ALARM_HIGH_TEMPERATURE,
+    ALARM_LOW_TEMPERATURE,
+    ALARM_OPEN_DOOR,
+    ALARM_MAN_IN_ROOM,
+    ALARM_COMPRESSOR_PROTECTION,
+    ALARM_LIGHT,
+    // Input Status Register (1281): door switch open, also on models without an open door alarm
+    ALARM_DOOR_SWITCH,
+    // The controller didn't answer for RESPONSIVENESS_THRESHOLD
+    ALARM_UNRESPONSIVE,
+    ALARM_COUNT,
+    // Used with ALARM_EVENT_DIGEST
+    ALARM_NONE = 0xFF
+};
+
+/**
+ * @brief The transitions that are worth a notification.
+ */
+enum AlarmEvent : uint8_t {
+    ALARM_EVENT_RAISED = 0,
+    // Still active after the escalation time
+    ALARM_EVENT_ESCALATED,
+    // Still active after the re-notify interval
+    ALARM_EVENT_REMINDER,
+    ALARM_EVENT_CLEARED,
+    // The digest interval elapsed, see printDigest()
+    ALARM_EVENT_DIGEST
+};
+
+/**
+ * @brief Called for every notification.
+ * @param alarm The alarm or ALARM_NONE for a digest.
+ * @param event The transition.
+ * @param duration For how long in ms the alarm is (or was) active.
+ * @param context The context passed to setCallback().
+ */
+typedef void (*AlarmCallback)(AlarmId alarm, AlarmEvent event, unsigned long duration, void *context);
+
+/**
+ * @brief Timing of one alarm in ms. 0 disables the escalation or reminders.
+ */
+struct AlarmPolicy {
+    unsigned long holdOff;
+    unsigned long escalation;
+    unsigned long renotifyInterval;
+    bool enabled;
+};
+
+/**
+ * @brief Turns the alarm and input status of a controller into notifications.
+ * The status words are level signals, so sending them on every poll (as a
+ * webhook does) produces a message per poll for as long as an alarm lasts.
+ * The aggregator runs a state machine per alarm instead and only reports
+ * transitions: a condition is raised once it persisted for the hold-off and
+ * cleared once it was gone for the hold-off, so short flaps are suppressed.
+ * An alarm that lasts is escalated once and reminded at a long interval.
+ * A digest summarises the active alarms and the activity in between.
+ */
+class AlarmAggregator {
+private:
+    enum AlarmState : uint8_t {
+        ALARM_STATE_IDLE = 0,
+        // The condition appeared, waiting for the hold-off
+        ALARM_STATE_PENDING,
+        ALARM_STATE_ACTIVE,
+        // The condition disappeared, waiting for the hold-off
+        ALARM_STATE_CLEARING
+    };
+
+    struct Alarm {
+        AlarmPolicy policy;
+        AlarmState state;
+        bool escalated;
+        // When the condition changed last, when the alarm was raised and last notified
+        unsigned long changed;
+        unsigned long raised;
+        unsigned long notified;
+    };
+
+    Alarm _alarms[ALARM_COUNT];
+    AlarmCallback _callback;
+    void *_context;
+
+    unsigned long _digestInterval;
+    unsigned long _lastDigest;
+    bool _digestStarted;
+
+    // Activity since the last digest
+    uint16_t _raisedCount;
+    uint16_t _clearedCount;
+    uint16_t _suppressedCount;
+
+    // Notifications sent by the current update() and its timestamp
+    uint8_t _notifications;
+    unsigned long _now;
+
+    void notify(AlarmId alarm, AlarmEvent event, unsigned long duration);
+    void advance(AlarmId alarm, bool condition, unsigned long now);
+
+public:
+    AlarmAggregator();
+
+    void setCallback(AlarmCallback callback, void *context = NULL);
+
+    /**
+     * @brief Changes the timing of an alarm.
+     */
+    void setPolicy(AlarmId alarm, const AlarmPolicy &policy);
+    const AlarmPolicy &policy(AlarmId alarm) const;
+
+    /**
+     * @brief Sets the time in ms between two digests. 0 (default) disables them.
+     * A digest is only sent if an alarm is active or something happened since the previous one.
+     */
+    void setDigestInterval(unsigned long interval);
+
+    /**
+     * @brief Feeds a new snapshot. Parts of the snapshot that aren't valid leave their alarms unchanged.
+     * @return The amount of notifications that were sent.
+     */
+    uint8_t update(const ControllerSnapshot &snapshot);
+
+    /**
+     * @brief Whether an alarm has been raised and not cleared yet.
+     */
+    bool active(AlarmId alarm) const;
+
+    /**
+     * @brief Amount of raised alarms.
+     */
+    uint8_t activeCount() const;
+
+    /**
+     * @brief Prints the active alarms and the activity since the previous digest on one line.
+     * The activity counters are reset by update() once the digest event was notified.
+     */
+    void printDigest(Print &output) const;
+};
+
+/**
+ * @brief The name of an alarm, e.g. "openDoor".
+ */
+const char *alarmName(AlarmId alarm);
+
+#endif
@@ -0,0 +1,126 @@
+#include "AuxiliarySampler.h"
+
+AuxiliarySampler::AuxiliarySampler(unsigned long interval) :
+_channelCount(0),
+_interval(interval),
+_lastRound(0),
+_sampling(false),
+_activeReference(AUXILIARY_SAMPLER_DEFAULT_REFERENCE),
+_referenceSwitched(0),
+_current(-1),
+_referenceSwitches(0)
+{}
+
+int8_t AuxiliarySampler::addChannel(uint8_t pin, AuxiliaryReference reference, uint16_t fullScale, uint8_t onLevel, uint8_t offLevel){
+    if(_channelCount >= SNAPSHOT_AUXILIARY_CHANNELS) return -1;
+    Channel &channel = _channels[_channelCount];
+    channel.pin = pin;
+    channel.reference = reference;
+    channel.fullScale = fullScale == 0 ? 1 : fullScale;
+    channel.onLevel = onLevel;
+    channel.offLevel = offLevel > onLevel ? onLevel : offLevel;
+    channel.sum = 0;
+    channel.samples = 0;
+    channel.level = AUXILIARY_LEVEL_UNKNOWN;
+    channel.state = false;
+    channel.done = false;
+    return _channelCount++;
+}
+
+void AuxiliarySampler::applyReference(AuxiliaryReference reference){
+    if(reference == _activeReference) return;
+    #ifndef AUXILIARY_SAMPLER_FIXED_REFERENCE
+    analogReference(reference);
+    #endif
+    _activeReference = reference;
+    _referenceSwitched = micros();
+    ++_referenceSwitches;
+}
+
+int8_t AuxiliarySampler::nextChannel() const {
+    // Prefer a pending channel that uses the reference that is already applied
+    int8_t candidate = -1;
+    for(uint8_t i = 0; i < _channelCount; ++i){
+        if(_channels[i].done) continue;
+        if(_channels[i].reference == _activeReference) return i;
+        if(candidate == -1) candidate = i;
+    }
+    return candidate;
+}
+
+void AuxiliarySampler::finish(Channel &channel){
+    uint32_t average = channel.sum / channel.samples;
+    uint32_t level = average * 100 / channel.fullScale;
+    channel.level = level > 100 ? 100 : level;
+    if(channel.level >= channel.onLevel){
+        channel.state = true;
+    } else if(channel.level < channel.offLevel){
+        channel.state = false;
+    }
+    channel.sum = 0;
+    channel.samples = 0;
+    channel.done = true;
+}
+
+void AuxiliarySampler::update(){
+    if(_channelCount == 0) return;
+
+    if(!_sampling){
+        if(_lastRound != 0 && millis() - _lastRound < _interval) return;
+        for(uint8_t i = 0; i < _channelCount; ++i) _channels[i].done = false;
+        _sampling = true;
+        _current = -1;
+    }
+
+    if(_current == -1){
+        _current = nextChannel();
+        if(_current == -1){
+            // Round complete. Leave the ADC the way other code expects it.
+            applyReference(AUXILIARY_SAMPLER_DEFAULT_REFERENCE);
+            _sampling = false;
+            _lastRound = millis();
+            if(_lastRound == 0) _lastRound = 1;
+            return;
+        }
+        applyReference(_channels[_current].reference);
+    }
+
+    if(micros() - _referenceSwitched < AUXILIARY_SAMPLER_SETTLING_TIME) return;
+
+    Channel &channel = _channels[_current];
+    channel.sum += analogRead(channel.pin);
+    if(++channel.samples >= AUXILIARY_SAMPLER_OVERSAMPLING){
+        finish(channel);
+        _current = -1;
+    }
+}
+
+uint8_t AuxiliarySampler::level(int8_t channel) const {
+    if(channel < 0 || channel >= _channelCount) return AUXILIARY_LEVEL_UNKNOWN;
+    return _channels[channel].level;
+}
+
+bool AuxiliarySampler::state(int8_t channel) const {
+    if(channel < 0 || channel >= _channelCount) return false;
+    return _channels[channel].state;
+}
+
+bool AuxiliarySampler::ready() const {
+    for(uint8_t i = 0; i < _channelCount; ++i){
+        if(_channels[i].level == AUXILIARY_LEVEL_UNKNOWN) return false;
+    }
+    return true;
+}
+
+uint16_t AuxiliarySampler::referenceSwitches() const {
+    return _referenceSwitches;
+}
+
+void AuxiliarySampler::fill(ControllerSnapshot &snapshot) const {
+    snapshot.auxiliaryStates = 0;
+    for(uint8_t i = 0; i < SNAPSHOT_AUXILIARY_CHANNELS; ++i){
+        snapshot.auxiliaryLevels[i] = level(i);
+        if(state(i)) bitSet(snapshot.auxiliaryStates, i);
+    }
+    snapshot.valid |= SNAPSHOT_AUXILIARY_VALID;
+}
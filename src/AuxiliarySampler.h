@@ -0,0 +1,132 @@
+#ifndef AUXILIARY_SAMPLER_H
+#define AUXILIARY_SAMPLER_H
+
+#include <Arduino.h>
+#include "ControllerSnapshot.h"
+
+// Amount of samples averaged into one filtered value
+#ifndef AUXILIARY_SAMPLER_OVERSAMPLING
+#define AUXILIARY_SAMPLER_OVERSAMPLING 16
+#endif
+
+// Time in µs to wait after switching the analog reference before sampling
+#define AUXILIARY_SAMPLER_SETTLING_TIME 1000
+
+// Default time in ms between two sampling rounds
+#define AUXILIARY_SAMPLER_DEFAULT_INTERVAL 5000
+
+// The argument of the core's analogReference() and the reference it starts with.
+// Cores the sampler doesn't know keep their default reference for all channels.
+#if defined(ARDUINO_ARCH_SAMD)
+typedef eAnalogReference AuxiliaryReference;
+#define AUXILIARY_SAMPLER_DEFAULT_REFERENCE AR_DEFAULT
+#elif defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_MEGAAVR)
+typedef uint8_t AuxiliaryReference;
+#define AUXILIARY_SAMPLER_DEFAULT_REFERENCE DEFAULT
+#elif defined(ARDUINO_ARCH_NRF52840)
+typedef uint8_t AuxiliaryReference;
+#define AUXILIARY_SAMPLER_DEFAULT_REFERENCE AR_VDD
+#else
+typedef uint8_t AuxiliaryReference;
+#define AUXILIARY_SAMPLER_DEFAULT_REFERENCE 0
+#define AUXILIARY_SAMPLER_FIXED_REFERENCE
+#endif
+
+/**
+ * @brief Samples analog auxiliary sensors such as the battery level or an
+ * ambient light sensor in the background.
+ * Channels sharing the same analog reference are sampled together so that
+ * the reference only has to be switched (and settle) once per group and round.
+ * Each call to update() takes at most one reading, so it never blocks the loop.
+ * Every channel is oversampled and averaged, and a hysteresis turns the
+ * level into an on/off state.
+ */
+class AuxiliarySampler {
+private:
+    struct Channel {
+        uint8_t pin;
+        AuxiliaryReference reference;
+        // Raw reading that corresponds to 100%
+        uint16_t fullScale;
+        // Hysteresis thresholds in %
+        uint8_t onLevel;
+        uint8_t offLevel;
+        uint32_t sum;
+        uint8_t samples;
+        uint8_t level;
+        bool state;
+        // Whether the channel was sampled in the current round
+        bool done;
+    };
+
+    Channel _channels[SNAPSHOT_AUXILIARY_CHANNELS];
+    uint8_t _channelCount;
+
+    unsigned long _interval;
+    unsigned long _lastRound;
+    bool _sampling;
+
+    // The reference that is currently applied and when it was switched (in µs)
+    AuxiliaryReference _activeReference;
+    unsigned long _referenceSwitched;
+
+    // The channel that is currently being sampled or -1
+    int8_t _current;
+
+    uint16_t _referenceSwitches;
+
+    void applyReference(AuxiliaryReference reference);
+    int8_t nextChannel() const;
+    void finish(Channel &channel);
+
+public:
+    /**
+     * @brief Construct a new Auxiliary Sampler object
+     * @param interval The time in ms between two sampling rounds.
+     */
+    AuxiliarySampler(unsigned long interval = AUXILIARY_SAMPLER_DEFAULT_INTERVAL);
+
+    /**
+     * @brief Adds a channel to be sampled.
+     * @param pin The analog pin.
+     * @param reference The analog reference to be used, e.g. AR_INTERNAL2V23 on SAMD.
+     * @param fullScale The raw reading that corresponds to 100%.
+     * @param onLevel The level (in %) at or above which the state turns on.
+     * @param offLevel The level (in %) below which the state turns off again.
+     * @return The channel index or -1 if no channel is left.
+     */
+    int8_t addChannel(uint8_t pin, AuxiliaryReference reference, uint16_t fullScale, uint8_t onLevel = 50, uint8_t offLevel = 50);
+
+    /**
+     * @brief Takes at most one reading. Call it from every loop() iteration.
+     */
+    void update();
+
+    /**
+     * @brief The filtered level of a channel in % or AUXILIARY_LEVEL_UNKNOWN.
+     */
+    uint8_t level(int8_t channel) const;
+
+    /**
+     * @brief The hysteresis state of a channel.
+     */
+    bool state(int8_t channel) const;
+
+    /**
+     * @brief Tells whether all channels have been sampled at least once.
+     */
+    bool ready() const;
+
+    /**
+     * @brief Amount of analog reference switches since start, for diagnostics.
+     */
+    uint16_t referenceSwitches() const;
+
+    /**
+     * @brief Copies the filtered levels and states into a snapshot
+     * and flags them with SNAPSHOT_AUXILIARY_VALID.
+     */
+    void fill(ControllerSnapshot &snapshot) const;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "BusSupervisor.h"
+#include <errno.h>
+
+#ifndef SerialPort
+#define SerialPort Serial
+#endif
+
+BusSupervisor::BusSupervisor(unsigned long baudRate, uint16_t serialConfig, unsigned long responseTimeout) :
+BusSupervisor(PEGO_DEFAULT_TRANSPORT, baudRate, serialConfig, responseTimeout)
+{}
+
+BusSupervisor::BusSupervisor(PegoTransport &transport, unsigned long baudRate, uint16_t serialConfig, unsigned long responseTimeout) :
+_transport(&transport),
+_baudRate(baudRate),
+_serialConfig(serialConfig),
+_responseTimeout(responseTimeout),
+_suspect(false),
+_knownPeripherals(0),
+_pendingCause(BUS_FAILURE_NONE),
+_lastRecovery(0),
+_backoff(0),
+_attempt(0),
+_historyHead(0),
+_historyCount(0),
+_recoveryCount(0)
+{
+    resetCounters();
+}
+
+void BusSupervisor::resetCounters(){
+    _corruptFrames = 0;
+    _immediateFailures = 0;
+    _timeouts = 0;
+    _silentPeripherals = 0;
+}
+
+void BusSupervisor::report(uint8_t peripheralID, bool success, int error, unsigned long duration){
+    uint32_t peripheral = 1UL << (peripheralID % 32);
+    _knownPeripherals |= peripheral;
+
+    // An exception response still proves that the bus works
+    bool exception = error > MODBUS_ENOBASE && error < EMBBADCRC;
+    if(success || exception){
+        resetCounters();
+        _suspect = false;
+        _pendingCause = BUS_FAILURE_NONE;
+        _backoff = 0;
+        _attempt = 0;
+        return;
+    }
+
+    if(error == EMBBADCRC || error == EMBBADDATA || error == EMBBADSLAVE){
+        ++_corruptFrames;
+        _suspect = true;
+    } else if(duration < _responseTimeout / 2){
+        ++_immediateFailures;
+        _suspect = true;
+    } else {
+        if(_timeouts < UINT16_MAX) ++_timeouts;
+        _silentPeripherals |= peripheral;
+    }
+
+    if(_pendingCause != BUS_FAILURE_NONE) return;
+
+    if(_corruptFrames >= BUS_SUPERVISOR_CORRUPT_FRAME_LIMIT){
+        _pendingCause = BUS_FAILURE_CORRUPT_FRAMES;
+    } else if(_immediateFailures >= BUS_SUPERVISOR_IMMEDIATE_FAILURE_LIMIT){
+        _pendingCause = BUS_FAILURE_IMMEDIATE_ERRORS;
+    } else if(_silentPeripherals == _knownPeripherals && (_knownPeripherals & (_knownPeripherals - 1)) != 0 && _timeouts >= BUS_SUPERVISOR_SILENT_LIMIT){
+        // More than one peripheral is known and all of them went silent
+        _pendingCause = BUS_FAILURE_ALL_PERIPHERALS_SILENT;
+    } else if(_timeouts >= BUS_SUPERVISOR_TIMEOUT_LIMIT && (_suspect || _attempt > 0)){
+        // Either the bus misbehaved before it went quiet or a recovery hasn't
+        // brought it back yet. Otherwise the controller is most likely offline.
+        _pendingCause = BUS_FAILURE_SUSTAINED_TIMEOUTS;
+    }
+}
+
+bool BusSupervisor::update(){
+    if(_pendingCause == BUS_FAILURE_NONE) return false;
+    if(_attempt > 0 && millis() - _lastRecovery < _backoff) return false;
+    recover(_pendingCause);
+    return true;
+}
+
+bool BusSupervisor::recover(BusFailureCause cause){
+    SerialPort.print("Restarting Modbus RTU client, cause: ");
+    SerialPort.println(cause);
+
+    _transport->end();
+    bool restarted = _transport->begin(_baudRate, _serialConfig);
+    _transport->setTimeout(_responseTimeout);
+
+    ++_attempt;
+    ++_recoveryCount;
+    _lastRecovery = millis();
+    _backoff = _backoff == 0 ? BUS_SUPERVISOR_MIN_BACKOFF : _backoff * 2;
+    if(_backoff > BUS_SUPERVISOR_MAX_BACKOFF) _backoff = BUS_SUPERVISOR_MAX_BACKOFF;
+
+    BusRecovery &entry = _history[_historyHead];
+    entry.timestamp = _lastRecovery;
+    entry.cause = cause;
+    entry.attempt = _attempt;
+    entry.restarted = restarted;
+    _historyHead = (_historyHead + 1) % BUS_SUPERVISOR_HISTORY_SIZE;
+    if(_historyCount < BUS_SUPERVISOR_HISTORY_SIZE) ++_historyCount;
+
+    // Give the new client a fresh chance before judging it
+    resetCounters();
+    _pendingCause = BUS_FAILURE_NONE;
+    return restarted;
+}
+
+BusFailureCause BusSupervisor::pendingCause() const {
+    return _pendingCause;
+}
+
+uint16_t BusSupervisor::recoveryCount() const {
+    return _recoveryCount;
+}
+
+uint8_t BusSupervisor::historyCount() const {
+    return _historyCount;
+}
+
+const BusRecovery &BusSupervisor::history(uint8_t index) const {
+    if(index >= _historyCount) index = _historyCount == 0 ? 0 : _historyCount - 1;
+    uint8_t position = (_historyHead + BUS_SUPERVISOR_HISTORY_SIZE - 1 - index) % BUS_SUPERVISOR_HISTORY_SIZE;
+    return _history[position];
+}
@@ -0,0 +1,162 @@
+#ifndef BUS_SUPERVISOR_H
+#define BUS_SUPERVISOR_H
+
+#include <Arduino.h>
+#include "PegoTransport.h"
+
+// Amount of recoveries kept in the history ring buffer
+#define BUS_SUPERVISOR_HISTORY_SIZE 8
+
+// Consecutive corrupt frames (CRC / framing errors) that trigger a recovery
+#define BUS_SUPERVISOR_CORRUPT_FRAME_LIMIT 5
+
+// Consecutive failures returning much faster than the response timeout that trigger a recovery
+#define BUS_SUPERVISOR_IMMEDIATE_FAILURE_LIMIT 5
+
+// Consecutive timeouts after which several known peripherals that all went silent trigger a recovery
+#define BUS_SUPERVISOR_SILENT_LIMIT 5
+
+// Consecutive timeouts that trigger a recovery, but only while the bus is suspect
+// already. A controller that is simply switched off produces timeouts as well.
+#define BUS_SUPERVISOR_TIMEOUT_LIMIT 20
+
+// Backoff between two recoveries in ms, doubled after every unsuccessful one
+#define BUS_SUPERVISOR_MIN_BACKOFF 5000
+#define BUS_SUPERVISOR_MAX_BACKOFF 600000
+
+// Default response timeout of ArduinoModbus in ms
+#define BUS_SUPERVISOR_DEFAULT_RESPONSE_TIMEOUT 1000
+
+/**
+ * @brief The failure pattern that caused a recovery.
+ */
+enum BusFailureCause : uint8_t {
+    BUS_FAILURE_NONE = 0,
+    // Frames arrive but fail the CRC or are malformed: noise or a confused transceiver
+    BUS_FAILURE_CORRUPT_FRAMES,
+    // Requests fail without waiting for the response timeout: the UART or driver is wedged
+    BUS_FAILURE_IMMEDIATE_ERRORS,
+    // Several peripherals stopped answering at the same time
+    BUS_FAILURE_ALL_PERIPHERALS_SILENT,
+    // Requests kept timing out for a long time after the bus had failed in another way
+    BUS_FAILURE_SUSTAINED_TIMEOUTS,
+    // Recovery requested by the sketch
+    BUS_FAILURE_MANUAL
+};
+
+/**
+ * @brief A recorded recovery.
+ */
+struct BusRecovery {
+    // millis() at the time of the recovery
+    unsigned long timestamp;
+    BusFailureCause cause;
+    // Consecutive recovery attempt, starting at 1
+    uint8_t attempt;
+    // Whether the Modbus client could be started again
+    bool restarted;
+};
+
+/**
+ * @brief Watches the outcome of all bus transactions and re-initializes the
+ * Modbus RTU client and serial port when the failure pattern points to a
+ * wedged bus rather than to an offline controller. Timeouts alone are what a
+ * controller that is switched off produces, so on a bus with a single
+ * controller they only lead to a recovery if the bus had already failed in
+ * another way since the last successful transaction.
+ * Attach it to every controller on the bus with PegoController::setBusSupervisor()
+ * and call update() from the loop.
+ */
+class BusSupervisor {
+private:
+    PegoTransport *_transport;
+    unsigned long _baudRate;
+    uint16_t _serialConfig;
+    unsigned long _responseTimeout;
+
+    uint8_t _corruptFrames;
+    uint8_t _immediateFailures;
+    uint16_t _timeouts;
+
+    // Whether corrupt frames or immediate failures occurred since the last success
+    bool _suspect;
+
+    // Bit mask of peripheral IDs (modulo 32) that answered / failed since the last success
+    uint32_t _silentPeripherals;
+    uint32_t _knownPeripherals;
+
+    BusFailureCause _pendingCause;
+    unsigned long _lastRecovery;
+    unsigned long _backoff;
+    uint8_t _attempt;
+
+    BusRecovery _history[BUS_SUPERVISOR_HISTORY_SIZE];
+    uint8_t _historyHead;
+    uint8_t _historyCount;
+    uint16_t _recoveryCount;
+
+    void resetCounters();
+
+public:
+    /**
+     * @brief Construct a new Bus Supervisor object
+     * @param baudRate The baud rate used to restart the Modbus client.
+     * @param serialConfig The serial configuration used to restart the Modbus client.
+     * @param responseTimeout The response timeout of the Modbus client in ms.
+     */
+    BusSupervisor(unsigned long baudRate, uint16_t serialConfig = SERIAL_8N1, unsigned long responseTimeout = BUS_SUPERVISOR_DEFAULT_RESPONSE_TIMEOUT);
+
+    /**
+     * @brief Construct a new Bus Supervisor object for the bus of the given transport.
+     * @param transport The Modbus client that is restarted, the same one the supervised controllers are bound to.
+     * @param baudRate The baud rate used to restart the Modbus client.
+     * @param serialConfig The serial configuration used to restart the Modbus client.
+     * @param responseTimeout The response timeout of the Modbus client in ms.
+     */
+    BusSupervisor(PegoTransport &transport, unsigned long baudRate, uint16_t serialConfig = SERIAL_8N1, unsigned long responseTimeout = BUS_SUPERVISOR_DEFAULT_RESPONSE_TIMEOUT);
+
+    /**
+     * @brief Reports the outcome of a transaction. Called by PegoController.
+     * @param peripheralID The addressed peripheral.
+     * @param success Whether the transaction succeeded.
+     * @param error The errno value of a failed transaction.
+     * @param duration The duration of the transaction in ms.
+     */
+    void report(uint8_t peripheralID, bool success, int error, unsigned long duration);
+
+    /**
+     * @brief Performs a pending recovery once its backoff has elapsed.
+     * @return true if a recovery was performed.
+     */
+    bool update();
+
+    /**
+     * @brief Tears down and restarts the Modbus RTU client and serial port right away.
+     * @param cause The cause to be recorded.
+     * @return true if the client could be started again.
+     */
+    bool recover(BusFailureCause cause = BUS_FAILURE_MANUAL);
+
+    /**
+     * @brief The cause of a detected failure that still awaits recovery or BUS_FAILURE_NONE.
+     */
+    BusFailureCause pendingCause() const;
+
+    /**
+     * @brief Amount of recoveries since start.
+     */
+    uint16_t recoveryCount() const;
+
+    /**
+     * @brief Amount of recoveries held in the history.
+     */
+    uint8_t historyCount() const;
+
+    /**
+     * @brief Returns a recorded recovery.
+     * @param index 0 is the most recent recovery.
+     */
+    const BusRecovery &history(uint8_t index) const;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include "CommandQueue.h"
+#include <ArduinoModbus.h>
+
+CommandQueue::CommandQueue(unsigned long maxDelay) :
+_nextID(1),
+_maxDelay(maxDelay),
+_scheduler(NULL)
+{
+    for(uint8_t i = 0; i < COMMAND_QUEUE_SIZE; ++i){
+        _entries[i].used = false;
+    }
+    memset(_latency, 0, sizeof(_latency));
+    for(uint8_t i = 0; i < COMMAND_PRIORITY_COUNT; ++i){
+        _latency[i].minimum = ULONG_MAX;
+    }
+}
+
+void CommandQueue::setScheduler(PollScheduler *scheduler){
+    _scheduler = scheduler;
+}
+
+uint16_t CommandQueue::add(PegoController &controller, ControllerCommand command, uint16_t registerNumber, float value, CommandPriority priority, bool supersede, CommandCallback callback, void *context){
+    unsigned long now = millis();
+    Entry *slot = NULL;
+    for(uint8_t i = 0; i < COMMAND_QUEUE_SIZE; ++i){
+        Entry &entry = _entries[i];
+        if(!entry.used){
+            if(slot == NULL) slot = &entry;
+            continue;
+        }
+        bool sameSetting = entry.controller == &controller && entry.command == command && (command != NULL || entry.registerNumber == registerNumber);
+        if(supersede && entry.supersede && sameSetting){
+            finish(entry, COMMAND_SUPERSEDED, now);
+            if(slot == NULL) slot = &entry;
+        }
+    }
+    if(slot == NULL) return 0;
+
+    slot->used = true;
+    slot->id = _nextID++;
+    if(_nextID == 0) _nextID = 1;
+    slot->priority = priority < COMMAND_PRIORITY_COUNT ? priority : COMMAND_PRIORITY_AUTOMATION;
+    slot->controller = &controller;
+    slot->command = command;
+    slot->registerNumber = registerNumber;
+    slot->value = value;
+    slot->supersede = supersede;
+    slot->enqueued = now;
+    slot->callback = callback;
+    slot->context = context;
+    return slot->id;
+}
+
+uint16_t CommandQueue::enqueue(PegoController &controller, ControllerCommand command, float value, CommandPriority priority, CommandCallback callback, void *context){
+    if(command == NULL) return 0;
+    return add(controller, command, 0, value, priority, true, callback, context);
+}
+
+uint16_t CommandQueue::enqueueWrite(PegoController &controller, uint16_t registerNumber, int16_t value, CommandPriority priority, bool supersede, CommandCallback callback, void *context){
+    return add(controller, NULL, registerNumber, value, priority, supersede, callback, context);
+}
+
+void CommandQueue::finish(Entry &entry, CommandResult result, unsigned long now){
+    entry.used = false;
+    CommandLatency &latency = _latency[entry.priority];
+    if(result == COMMAND_COMPLETED || result == COMMAND_FAILED){
+        unsigned long delay = now - entry.enqueued;
+        ++latency.count;
+        latency.total += delay;
+        if(delay < latency.minimum) latency.minimum = delay;
+        if(delay > latency.maximum) latency.maximum = delay;
+    } else {
+        ++latency.dropped;
+    }
+    if(entry.callback != NULL) entry.callback(entry.id, result, entry.context);
+}
+
+bool CommandQueue::cancel(uint16_t id){
+    for(uint8_t i = 0; i < COMMAND_QUEUE_SIZE; ++i){
+        Entry &entry = _entries[i];
+        if(entry.used && entry.id == id){
+            finish(entry, COMMAND_CANCELLED, millis());
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t CommandQueue::pending() const {
+    uint8_t count = 0;
+    for(uint8_t i = 0; i < COMMAND_QUEUE_SIZE; ++i){
+        if(_entries[i].used) ++count;
+    }
+    return count;
+}
+
+CommandQueue::Entry *CommandQueue::next(){
+    unsigned long now = millis();
+    Entry *next = NULL;
+    for(uint8_t i = 0; i < COMMAND_QUEUE_SIZE; ++i){
+        Entry &entry = _entries[i];
+        if(!entry.used) continue;
+        // Executing a command long after it was issued would surprise the operator
+        if(_maxDelay != 0 && now - entry.enqueued > _maxDelay){
+            finish(entry, COMMAND_EXPIRED, now);
+            continue;
+        }
+        // Highest priority first, FIFO within a priority
+        if(next == NULL || entry.priority < next->priority ||
+           (entry.priority == next->priority && now - entry.enqueued > now - next->enqueued)){
+            next = &entry;
+        }
+    }
+    return next;
+}
+
+bool CommandQueue::update(){
+    Entry *entry = next();
+    if(entry == NULL){
+        return _scheduler != NULL && _scheduler->update() >= 0;
+    }
+
+    bool success;
+    if(entry->command != NULL){
+        success = entry->command(*entry->controller, entry->value);
+    } else {
+        RegisterDescription description = {HOLDING_REGISTERS, entry->registerNumber, false, 1};
+        success = entry->controller->writeModbusRegister(description, (int16_t)entry->value);
+    }
+    finish(*entry, success ? COMMAND_COMPLETED : COMMAND_FAILED, millis());
+    return true;
+}
+
+const CommandLatency &CommandQueue::latency(CommandPriority priority) const {
+    return _latency[priority < COMMAND_PRIORITY_COUNT ? priority : COMMAND_PRIORITY_AUTOMATION];
+}
+
+void CommandQueue::printStatistics(Print &output) const {
+    static const char *names[COMMAND_PRIORITY_COUNT] = {"operator", "automation"};
+    for(uint8_t i = 0; i < COMMAND_PRIORITY_COUNT; ++i){
+        const CommandLatency &latency = _latency[i];
+        output.print(names[i]);
+        output.print(": sent ");
+        output.print(latency.count);
+        output.print(", dropped ");
+        output.print(latency.dropped);
+        output.print(", delay min/avg/max ");
+        output.print(latency.count == 0 ? 0 : latency.minimum);
+        output.print('/');
+        output.print(latency.average());
+        output.print('/');
+        output.print(latency.maximum);
+        output.println(" ms");
+    }
+}
@@ -0,0 +1,160 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <Arduino.h>
+#include "PegoController.h"
+#include "PollScheduler.h"
+
+// Amount of commands that can wait for the bus
+#ifndef COMMAND_QUEUE_SIZE
+#define COMMAND_QUEUE_SIZE 16
+#endif
+
+// Default time in ms after which a command that is still waiting is dropped
+#define COMMAND_QUEUE_DEFAULT_MAX_DELAY 30000
+
+/**
+ * @brief Priority of a command. Lower values go first,
+ * periodic polls only run when no command is waiting.
+ */
+enum CommandPriority : uint8_t {
+    // Issued by an operator, e.g. a forced defrost or a new set point
+    COMMAND_PRIORITY_OPERATOR = 0,
+    // Issued by automation, e.g. a defrost scheduler
+    COMMAND_PRIORITY_AUTOMATION,
+    COMMAND_PRIORITY_COUNT
+};
+
+/**
+ * @brief Outcome of a command, passed to its callback.
+ */
+enum CommandResult : uint8_t {
+    COMMAND_COMPLETED = 0,
+    COMMAND_FAILED,
+    // Replaced by a newer command for the same controller and setting before it was sent
+    COMMAND_SUPERSEDED,
+    COMMAND_CANCELLED,
+    // Waited longer than the maximum queueing delay
+    COMMAND_EXPIRED
+};
+
+/**
+ * @brief A controller setter, e.g. [](PegoController &controller, float value){ return controller.setTemperatureSetPoint(value); }
+ * The function also identifies the setting: a newer command with the same function
+ * for the same controller supersedes a waiting one.
+ */
+typedef bool (*ControllerCommand)(PegoController &controller, float value);
+
+/**
+ * @brief Called once a command left the queue.
+ */
+typedef void (*CommandCallback)(uint16_t id, CommandResult result, void *context);
+
+/**
+ * @brief Queueing delay (enqueue until the controller acknowledged) of one priority in ms.
+ */
+struct CommandLatency {
+    unsigned long count;
+    unsigned long minimum;
+    unsigned long maximum;
+    unsigned long total;
+    // Commands that left the queue without being sent (superseded, cancelled, expired)
+    unsigned long dropped;
+
+    unsigned long average() const { return count == 0 ? 0 : total / count; }
+};
+
+/**
+ * @brief Serializes all bus transactions of the sketch: queued commands
+ * go ahead of the periodic polls of an attached PollScheduler.
+ * Only one transaction is performed per update(), so a command waits at most
+ * for the transaction in progress plus the commands of higher or equal priority before it.
+ */
+class CommandQueue {
+private:
+    struct Entry {
+        bool used;
+        uint16_t id;
+        CommandPriority priority;
+        PegoController *controller;
+        // Setter to call or NULL for a raw register write
+        ControllerCommand command;
+        uint16_t registerNumber;
+        float value;
+        bool supersede;
+        unsigned long enqueued;
+        CommandCallback callback;
+        void *context;
+    };
+
+    Entry _entries[COMMAND_QUEUE_SIZE];
+    uint16_t _nextID;
+    unsigned long _maxDelay;
+    PollScheduler *_scheduler;
+    CommandLatency _latency[COMMAND_PRIORITY_COUNT];
+
+    uint16_t add(PegoController &controller, ControllerCommand command, uint16_t registerNumber, float value, CommandPriority priority, bool supersede, CommandCallback callback, void *context);
+    void finish(Entry &entry, CommandResult result, unsigned long now);
+    Entry *next();
+
+public:
+    /**
+     * @brief Construct a new Command Queue object
+     * @param maxDelay Time in ms after which a waiting command is dropped, 0 to never drop commands.
+     */
+    CommandQueue(unsigned long maxDelay = COMMAND_QUEUE_DEFAULT_MAX_DELAY);
+
+    /**
+     * @brief Runs the polls of the given scheduler whenever no command is waiting.
+     */
+    void setScheduler(PollScheduler *scheduler);
+
+    /**
+     * @brief Queues a setter call.
+     * @param controller The controller to send the command to.
+     * @param command The setter, it also identifies the setting for superseding.
+     * @param value The value passed to the setter.
+     * @param priority The priority of the command.
+     * @param callback Optional callback receiving the outcome.
+     * @param context Passed on to the callback.
+     * @return The ID of the command or 0 if the queue is full.
+     */
+    uint16_t enqueue(PegoController &controller, ControllerCommand command, float value, CommandPriority priority = COMMAND_PRIORITY_OPERATOR, CommandCallback callback = NULL, void *context = NULL);
+
+    /**
+     * @brief Queues a write of a raw register value.
+     * @param supersede Whether the command replaces a waiting write to the same register.
+     * Disable it if every write needs to reach the controller, e.g. when forwarding requests of other clients.
+     * @return The ID of the command or 0 if the queue is full.
+     */
+    uint16_t enqueueWrite(PegoController &controller, uint16_t registerNumber, int16_t value, CommandPriority priority = COMMAND_PRIORITY_OPERATOR, bool supersede = true, CommandCallback callback = NULL, void *context = NULL);
+
+    /**
+     * @brief Drops a waiting command.
+     * @return false if the command isn't waiting anymore.
+     */
+    bool cancel(uint16_t id);
+
+    /**
+     * @brief Amount of waiting commands.
+     */
+    uint8_t pending() const;
+
+    /**
+     * @brief Sends the most urgent command or, if none is waiting, runs the scheduler.
+     * @return true if a bus transaction was performed.
+     */
+    bool update();
+
+    /**
+     * @brief The queueing delay statistics of a priority.
+     */
+    const CommandLatency &latency(CommandPriority priority) const;
+
+    /**
+     * @brief Prints one line per priority with the latency statistics.
+     */
+    void printStatistics(Print &output) const;
+};
+
+#endif
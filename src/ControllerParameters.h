@@ -0,0 +1,57 @@
+#ifndef CONTROLLER_PARAMETERS_H
+#define CONTROLLER_PARAMETERS_H
+
+#include <Arduino.h>
+
+// Parameter register blocks that are read with a single request each
+#define PARAMETER_BLOCK_BASE_FIRST 768 // r0 .. HSE, all models
+#define PARAMETER_BLOCK_BASE_COUNT 21
+#define PARAMETER_BLOCK_EXPERT_FIRST 789 // StA .. F7, ECP 202 only
+#define PARAMETER_BLOCK_EXPERT_COUNT 10
+#define PARAMETER_BLOCK_CONFIGURATION_FIRST 512 // mOd .. AU2, ECP 202 only
+#define PARAMETER_BLOCK_CONFIGURATION_COUNT 7
+
+// Flags telling which parameter blocks hold valid data
+#define PARAMETERS_BASE_VALID 0x01
+#define PARAMETERS_EXPERT_VALID 0x02
+#define PARAMETERS_CONFIGURATION_VALID 0x04
+
+/**
+ * @brief The raw values of all parameter registers of a controller.
+ * Values are stored exactly as transferred over the wire,
+ * i.e. without signed conversion or multiplication factor.
+ */
+struct ControllerParameters {
+    // Combination of the PARAMETERS_*_VALID flags
+    uint8_t valid;
+    uint16_t base[PARAMETER_BLOCK_BASE_COUNT];
+    uint16_t expert[PARAMETER_BLOCK_EXPERT_COUNT];
+    uint16_t configuration[PARAMETER_BLOCK_CONFIGURATION_COUNT];
+
+    /**
+     * @brief Looks up a parameter by its register number.
+     * @param registerNumber The register number, e.g. 768 for the temperature set point.
+     * @param value Receives the raw register value.
+     * @return true if the register belongs to a valid block, false otherwise.
+     */
+    bool get(uint16_t registerNumber, uint16_t &value) const {
+        if(registerNumber >= PARAMETER_BLOCK_BASE_FIRST && registerNumber < PARAMETER_BLOCK_BASE_FIRST + PARAMETER_BLOCK_BASE_COUNT){
+            if(!(valid & PARAMETERS_BASE_VALID)) return false;
+            value = base[registerNumber - PARAMETER_BLOCK_BASE_FIRST];
+            return true;
+        }
+        if(registerNumber >= PARAMETER_BLOCK_EXPERT_FIRST && registerNumber < PARAMETER_BLOCK_EXPERT_FIRST + PARAMETER_BLOCK_EXPERT_COUNT){
+            if(!(valid & PARAMETERS_EXPERT_VALID)) return false;
+            value = expert[registerNumber - PARAMETER_BLOCK_EXPERT_FIRST];
+            return true;
+        }
+        if(registerNumber >= PARAMETER_BLOCK_CONFIGURATION_FIRST && registerNumber < PARAMETER_BLOCK_CONFIGURATION_FIRST + PARAMETER_BLOCK_CONFIGURATION_COUNT){
+            if(!(valid & PARAMETERS_CONFIGURATION_VALID)) return false;
+            value = configuration[registerNumber - PARAMETER_BLOCK_CONFIGURATION_FIRST];
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif
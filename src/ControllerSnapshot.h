@@ -0,0 +1,57 @@
+#ifndef CONTROLLER_SNAPSHOT_H
+#define CONTROLLER_SNAPSHOT_H
+
+#include <Arduino.h>
+
+// Flags telling which parts of a snapshot hold valid data
+#define SNAPSHOT_TEMPERATURES_VALID 0x01
+#define SNAPSHOT_STATUS_VALID 0x02 // Output, input and alarm status
+#define SNAPSHOT_DEVICE_STATUS_VALID 0x04
+#define SNAPSHOT_AUXILIARY_VALID 0x08 // Filled in by AuxiliarySampler::fill()
+
+// Amount of auxiliary sensor channels (battery, light, ...) a snapshot can hold
+#define SNAPSHOT_AUXILIARY_CHANNELS 4
+
+// Level of an auxiliary channel that hasn't been sampled yet
+#define AUXILIARY_LEVEL_UNKNOWN 0xFF
+
+/**
+ * @brief The complete live state of a controller as read in one poll.
+ * Temperatures are kept as raw register values in tenths of a degree (deci-degrees)
+ * so that they can be compared and encoded without floating point math.
+ * A temperature that couldn't be read holds READ_ERROR.
+ */
+struct ControllerSnapshot {
+    // millis() at the time the snapshot was taken
+    unsigned long timestamp;
+
+    // Whether the controller was considered responsive when the snapshot was taken
+    bool responsive;
+
+    // The PegoModel of the controller. The meaning of some alarm bits depends on it,
+    // use descriptorForModel() to decode them.
+    uint8_t model;
+
+    // Combination of the SNAPSHOT_*_VALID flags
+    uint8_t valid;
+
+    // Register 256 in 0.1 °C
+    int16_t ambientTemperature;
+
+    // Register 257 in 0.1 °C
+    int16_t evaporatorTemperature;
+
+    // Registers 1280, 1281, 1282 and 1536. Decode them with the constants from StatusBits.h
+    uint16_t outputStatus;
+    uint16_t inputStatus;
+    uint16_t alarmStatus;
+    uint16_t deviceStatus;
+
+    // Filtered levels of the auxiliary sensors in %, AUXILIARY_LEVEL_UNKNOWN if not available
+    uint8_t auxiliaryLevels[SNAPSHOT_AUXILIARY_CHANNELS];
+
+    // Hysteresis state of the auxiliary sensors, one bit per channel
+    uint8_t auxiliaryStates;
+};
+
+#endif
@@ -0,0 +1,166 @@
+#include "DefrostScheduler.h"
+
+// Registers of the defrost settings within the base parameter block
+#define DEFROSTING_PERIOD_REGISTER 770 // d0
+#define END_OF_DEFROSTING_TEMPERATURE_REGISTER 771 // d2
+
+DefrostScheduler::DefrostScheduler(uint8_t maxSimultaneous, unsigned long spacing) :
+_count(0),
+_maxSimultaneous(maxSimultaneous),
+_spacing(spacing),
+_lastForcedStart(0),
+_hasForced(false),
+_commands(NULL),
+_forcedDefrosts(0),
+_skippedDefrosts(0)
+{}
+
+void DefrostScheduler::setCommandQueue(CommandQueue *commands){
+    _commands = commands;
+}
+
+int8_t DefrostScheduler::add(PegoController &controller){
+    if(_count >= DEFROST_SCHEDULER_MAX_ROOMS) return -1;
+    Room &room = _rooms[_count];
+    room.controller = &controller;
+    room.period = 0;
+    room.endTemperature = INT16_MAX;
+    room.evaporatorTemperature = READ_ERROR;
+    // Rooms whose last defrost is unknown are due right away, the spacing spreads them
+    room.lastStart = millis();
+    room.forcedAt = 0;
+    room.observed = false;
+    room.defrosting = false;
+    room.forced = false;
+    return _count++;
+}
+
+void DefrostScheduler::setSettings(uint8_t index, int16_t periodHours, int16_t endTemperature){
+    if(index >= _count) return;
+    Room &room = _rooms[index];
+    unsigned long period = periodHours > 0 ? (unsigned long)periodHours * 3600000UL : 0;
+    // Make an unknown last defrost due right away
+    if(room.period == 0 && !room.defrosting) room.lastStart = millis() - period;
+    room.period = period;
+    room.endTemperature = endTemperature * 10;
+}
+
+bool DefrostScheduler::loadSettings(uint8_t index, const ControllerParameters &parameters){
+    uint16_t period;
+    uint16_t endTemperature;
+    if(!parameters.get(DEFROSTING_PERIOD_REGISTER, period)) return false;
+    if(!parameters.get(END_OF_DEFROSTING_TEMPERATURE_REGISTER, endTemperature)) return false;
+    setSettings(index, period, (int16_t)endTemperature);
+    return true;
+}
+
+bool DefrostScheduler::loadSettings(uint8_t index){
+    if(index >= _count) return false;
+    PegoController &controller = *_rooms[index].controller;
+    int16_t period = controller.getDefrostingPeriod();
+    if(period == READ_ERROR) return false;
+    int16_t endTemperature = controller.getEndOfDefrostingTemperature();
+    if(endTemperature == READ_ERROR) return false;
+    setSettings(index, period, endTemperature);
+    return true;
+}
+
+void DefrostScheduler::observe(uint8_t index, const ControllerSnapshot &snapshot){
+    if(index >= _count) return;
+    Room &room = _rooms[index];
+    if(snapshot.valid & SNAPSHOT_TEMPERATURES_VALID){
+        room.evaporatorTemperature = snapshot.evaporatorTemperature;
+    }
+    if(!(snapshot.valid & SNAPSHOT_STATUS_VALID)) return;
+
+    bool heating = bitRead(snapshot.outputStatus, OUTPUT_STATUS_DEFROST_RELAY_BIT) ||
+                   bitRead(snapshot.outputStatus, OUTPUT_STATUS_HOT_RESISTANCE_BIT);
+    // A defrost started by the controller's own timer restarts the period as well
+    if(heating && !room.defrosting && !room.forced) room.lastStart = snapshot.timestamp;
+    if(heating) room.forced = false;
+    room.defrosting = heating;
+    room.observed = true;
+}
+
+unsigned long DefrostScheduler::spacing() const {
+    if(_spacing != 0 || _count == 0) return _spacing;
+    unsigned long shortest = 0;
+    for(uint8_t i = 0; i < _count; ++i){
+        unsigned long period = _rooms[i].period;
+        if(period != 0 && (shortest == 0 || period < shortest)) shortest = period;
+    }
+    return shortest / _count;
+}
+
+bool DefrostScheduler::force(Room &room){
+    if(_commands != NULL){
+        return _commands->enqueue(*room.controller, [](PegoController &controller, float value){
+            return controller.setDefrostForcingStatus(value != 0);
+        }, 1, COMMAND_PRIORITY_AUTOMATION) != 0;
+    }
+    return room.controller->setDefrostForcingStatus(true);
+}
+
+int8_t DefrostScheduler::update(){
+    unsigned long now = millis();
+    unsigned long minimumSpacing = spacing();
+
+    uint8_t active = 0;
+    int8_t next = -1;
+    unsigned long nextElapsed = 0;
+    for(uint8_t i = 0; i < _count; ++i){
+        Room &room = _rooms[i];
+        if(room.forced && now - room.forcedAt >= DEFROST_SCHEDULER_CONFIRM_TIMEOUT){
+            // The controller didn't start it, e.g. because its evaporator was warm enough
+            room.forced = false;
+            ++_skippedDefrosts;
+        }
+        if(room.defrosting || room.forced){
+            ++active;
+            continue;
+        }
+        if(room.period == 0 || !room.observed) continue;
+        // Forcing up to one spacing early keeps the controller's own timer from firing
+        unsigned long elapsed = now - room.lastStart;
+        if(elapsed + minimumSpacing < room.period) continue;
+        if(next == -1 || elapsed > nextElapsed){
+            next = i;
+            nextElapsed = elapsed;
+        }
+    }
+
+    if(next == -1 || active >= _maxSimultaneous) return -1;
+    if(_hasForced && now - _lastForcedStart < minimumSpacing) return -1;
+
+    Room &room = _rooms[next];
+    if(room.evaporatorTemperature != READ_ERROR && room.evaporatorTemperature >= room.endTemperature){
+        // Nothing to melt, check again after a period
+        room.lastStart = now;
+        ++_skippedDefrosts;
+        return -1;
+    }
+    if(!force(room)) return -1;
+    room.forced = true;
+    room.forcedAt = now;
+    room.lastStart = now;
+    _lastForcedStart = now;
+    _hasForced = true;
+    ++_forcedDefrosts;
+    return next;
+}
+
+uint8_t DefrostScheduler::defrosting() const {
+    uint8_t count = 0;
+    for(uint8_t i = 0; i < _count; ++i){
+        if(_rooms[i].defrosting) ++count;
+    }
+    return count;
+}
+
+unsigned long DefrostScheduler::forcedDefrosts() const {
+    return _forcedDefrosts;
+}
+
+unsigned long DefrostScheduler::skippedDefrosts() const {
+    return _skippedDefrosts;
+}
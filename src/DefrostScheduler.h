@@ -0,0 +1,124 @@
+#ifndef DEFROST_SCHEDULER_H
+#define DEFROST_SCHEDULER_H
+
+#include <Arduino.h>
+#include "PegoController.h"
+#include "CommandQueue.h"
+
+// Amount of rooms a scheduler can serve
+#ifndef DEFROST_SCHEDULER_MAX_ROOMS
+#define DEFROST_SCHEDULER_MAX_ROOMS 64
+#endif
+
+// Time in ms a forced defrost may take to show up in the relay bits before it counts as skipped
+#define DEFROST_SCHEDULER_CONFIRM_TIMEOUT 120000
+
+/**
+ * @brief Spreads the defrosts of several rooms on a site over time, so that the
+ * heaters don't run all at once and trip the peak demand tariff.
+ * Each room is defrosted once per defrosting period (d0). Instead of waiting
+ * for the controllers' own timers, the scheduler forces the defrosts with a
+ * minimum spacing between two starts and a maximum amount of simultaneous defrosts.
+ * As a forced defrost restarts the controller's own timer, the rooms keep the spread.
+ * A room whose evaporator is already above the end of defrosting temperature (d2)
+ * has no ice to melt and is skipped for one period.
+ *
+ * Feed every snapshot with observe(), which only updates a few fields,
+ * and call update() once per loop iteration.
+ */
+class DefrostScheduler {
+private:
+    struct Room {
+        PegoController *controller;
+        // Defrosting period (d0) in ms, 0 if cyclic defrosts are disabled
+        unsigned long period;
+        // End of defrosting temperature (d2) in 0.1 °C
+        int16_t endTemperature;
+        int16_t evaporatorTemperature;
+        unsigned long lastStart;
+        unsigned long forcedAt;
+        bool observed;
+        bool defrosting;
+        bool forced;
+    };
+
+    Room _rooms[DEFROST_SCHEDULER_MAX_ROOMS];
+    uint8_t _count;
+    uint8_t _maxSimultaneous;
+    unsigned long _spacing;
+    unsigned long _lastForcedStart;
+    bool _hasForced;
+    CommandQueue *_commands;
+
+    unsigned long _forcedDefrosts;
+    unsigned long _skippedDefrosts;
+
+    unsigned long spacing() const;
+    bool force(Room &room);
+
+public:
+    /**
+     * @brief Construct a new Defrost Scheduler object
+     * @param maxSimultaneous Maximum amount of rooms defrosting at the same time.
+     * @param spacing Minimum time in ms between two forced defrost starts.
+     * 0 spreads the starts evenly over the shortest defrosting period.
+     */
+    DefrostScheduler(uint8_t maxSimultaneous = 1, unsigned long spacing = 0);
+
+    /**
+     * @brief Sends the defrost commands through the given queue with automation priority
+     * instead of writing them right away.
+     */
+    void setCommandQueue(CommandQueue *commands);
+
+    /**
+     * @brief Adds a room. Set its defrost settings before the first update().
+     * @return The index of the room or -1 if the scheduler is full.
+     */
+    int8_t add(PegoController &controller);
+
+    /**
+     * @brief Sets the defrost settings of a room.
+     * @param index The index returned by add().
+     * @param periodHours The defrosting period (d0) in hours, 0 to never force a defrost.
+     * @param endTemperature The end of defrosting temperature (d2) in °C.
+     */
+    void setSettings(uint8_t index, int16_t periodHours, int16_t endTemperature);
+
+    /**
+     * @brief Takes the defrost settings from the cached parameters of a room.
+     * @return false if the parameters don't hold valid base parameters.
+     */
+    bool loadSettings(uint8_t index, const ControllerParameters &parameters);
+
+    /**
+     * @brief Reads the defrost settings of a room from the controller (two transactions).
+     * @return false if a read failed.
+     */
+    bool loadSettings(uint8_t index);
+
+    /**
+     * @brief Updates the state of a room from a fresh snapshot.
+     */
+    void observe(uint8_t index, const ControllerSnapshot &snapshot);
+
+    /**
+     * @brief Forces the defrost of the most overdue room if the limits allow it.
+     * @return The index of the room whose defrost was forced or -1.
+     */
+    int8_t update();
+
+    /**
+     * @brief Amount of rooms defrosting right now.
+     */
+    uint8_t defrosting() const;
+
+    unsigned long forcedDefrosts() const;
+
+    /**
+     * @brief Defrosts that were skipped because the evaporator had no ice or the controller didn't start them.
+     */
+    unsigned long skippedDefrosts() const;
+};
+
+#endif
@@ -0,0 +1,160 @@
+#include "DefrostTracker.h"
+
+DefrostTracker::DefrostTracker(int16_t endOfDefrostingTemperature, int16_t maxDefrostingDuration) :
+_endOfDefrostingTemperature(endOfDefrostingTemperature),
+_maxDefrostingDuration(maxDefrostingDuration)
+{
+    reset();
+}
+
+void DefrostTracker::setLimits(int16_t endOfDefrostingTemperature, int16_t maxDefrostingDuration){
+    _endOfDefrostingTemperature = endOfDefrostingTemperature;
+    _maxDefrostingDuration = maxDefrostingDuration;
+}
+
+bool DefrostTracker::loadLimits(PegoController &controller){
+    int16_t endOfDefrostingTemperature = controller.getEndOfDefrostingTemperature();
+    if(endOfDefrostingTemperature == READ_ERROR) return false;
+    int16_t maxDefrostingDuration = controller.getMaxDefrostingDuration();
+    if(maxDefrostingDuration == READ_ERROR) return false;
+    setLimits(endOfDefrostingTemperature, maxDefrostingDuration);
+    return true;
+}
+
+void DefrostTracker::reset(){
+    _head = 0;
+    _count = 0;
+    _heating = false;
+    _dripping = false;
+    _lastUpdate = 0;
+    _pollInterval = 0;
+    _statisticsCycles = 0;
+    _terminationCount[DEFROST_TERMINATION_UNKNOWN] = 0;
+    _terminationCount[DEFROST_TERMINATION_TEMPERATURE] = 0;
+    _terminationCount[DEFROST_TERMINATION_TIMEOUT] = 0;
+    _durationSum = 0;
+    _drippingDurationSum = 0;
+    _maximumDuration = 0;
+    _peakTemperatureSum = 0;
+    _peakTemperatureCount = 0;
+}
+
+DefrostTermination DefrostTracker::classify(const DefrostCycle &cycle) const {
+    if(cycle.peakEvaporatorTemperature != READ_ERROR_FLOAT &&
+       cycle.peakEvaporatorTemperature >= _endOfDefrostingTemperature - DEFROST_TEMPERATURE_TOLERANCE){
+        return DEFROST_TERMINATION_TEMPERATURE;
+    }
+
+    // The relay state is only sampled once per poll, so the observed duration
+    // may be short of d3 by up to one polling interval.
+    unsigned long maxDuration = (unsigned long)_maxDefrostingDuration * 60000UL;
+    if(cycle.duration() + _pollInterval >= maxDuration){
+        return DEFROST_TERMINATION_TIMEOUT;
+    }
+    return DEFROST_TERMINATION_UNKNOWN;
+}
+
+void DefrostTracker::record(const DefrostCycle &cycle){
+    _cycles[_head] = cycle;
+    _head = (_head + 1) % DEFROST_TRACKER_CAPACITY;
+    if(_count < DEFROST_TRACKER_CAPACITY) ++_count;
+
+    ++_statisticsCycles;
+    ++_terminationCount[cycle.termination];
+    _durationSum += cycle.duration();
+    _drippingDurationSum += cycle.drippingDuration();
+    if(cycle.duration() > _maximumDuration) _maximumDuration = cycle.duration();
+    if(cycle.peakEvaporatorTemperature != READ_ERROR_FLOAT){
+        _peakTemperatureSum += cycle.peakEvaporatorTemperature;
+        ++_peakTemperatureCount;
+    }
+}
+
+bool DefrostTracker::update(unsigned long now, int16_t outputStatus, float evaporatorTemperature){
+    // All bits of a failed read would look like a running defrost
+    if(outputStatus == READ_ERROR) return false;
+    if(_lastUpdate != 0) _pollInterval = now - _lastUpdate;
+    _lastUpdate = now;
+
+    // The hot resistance bit is never set on models without one
+    bool heating = bitRead(outputStatus, OUTPUT_STATUS_DEFROST_RELAY_BIT) == 1 ||
+                   bitRead(outputStatus, OUTPUT_STATUS_HOT_RESISTANCE_BIT) == 1;
+    bool dripping = bitRead(outputStatus, OUTPUT_STATUS_DRIPPING_BIT) == 1;
+
+    if(heating && !_heating){
+        // A dripping phase that is interrupted by a new defrost is closed first
+        if(_dripping){
+            _current.drippingEnd = now;
+            record(_current);
+            _dripping = false;
+        }
+        _current.start = now;
+        _current.end = now;
+        _current.drippingEnd = now;
+        _current.peakEvaporatorTemperature = READ_ERROR_FLOAT;
+        _current.termination = DEFROST_TERMINATION_UNKNOWN;
+    }
+
+    if(heating && evaporatorTemperature != READ_ERROR_FLOAT){
+        if(_current.peakEvaporatorTemperature == READ_ERROR_FLOAT ||
+           evaporatorTemperature > _current.peakEvaporatorTemperature){
+            _current.peakEvaporatorTemperature = evaporatorTemperature;
+        }
+    }
+
+    if(!heating && _heating){
+        _current.end = now;
+        _current.drippingEnd = now;
+        _current.termination = classify(_current);
+        if(dripping){
+            _dripping = true;
+        } else {
+            record(_current);
+        }
+    } else if(_dripping && !dripping){
+        _current.drippingEnd = now;
+        record(_current);
+        _dripping = false;
+    }
+
+    _heating = heating;
+    return true;
+}
+
+bool DefrostTracker::update(PegoController &controller){
+    int16_t outputStatus = controller.getOutputStatus();
+    // Rejected by update() as well, checked here to skip the temperature read
+    if(outputStatus == READ_ERROR) return false;
+    float evaporatorTemperature = READ_ERROR_FLOAT;
+    // The evaporator temperature is only relevant while heating
+    bool heating = bitRead(outputStatus, OUTPUT_STATUS_DEFROST_RELAY_BIT) || bitRead(outputStatus, OUTPUT_STATUS_HOT_RESISTANCE_BIT);
+    if(heating) evaporatorTemperature = controller.getEvaporatorTemperature();
+    return update(millis(), outputStatus, evaporatorTemperature);
+}
+
+bool DefrostTracker::defrosting() const {
+    return _heating || _dripping;
+}
+
+uint8_t DefrostTracker::count() const {
+    return _count;
+}
+
+const DefrostCycle &DefrostTracker::cycle(uint8_t index) const {
+    if(index >= _count) index = _count == 0 ? 0 : _count - 1;
+    uint8_t position = (_head + DEFROST_TRACKER_CAPACITY - 1 - index) % DEFROST_TRACKER_CAPACITY;
+    return _cycles[position];
+}
+
+DefrostStatistics DefrostTracker::statistics() const {
+    DefrostStatistics statistics;
+    statistics.cycles = _statisticsCycles;
+    statistics.temperatureTerminations = _terminationCount[DEFROST_TERMINATION_TEMPERATURE];
+    statistics.timeoutTerminations = _terminationCount[DEFROST_TERMINATION_TIMEOUT];
+    statistics.unknownTerminations = _terminationCount[DEFROST_TERMINATION_UNKNOWN];
+    statistics.averageDuration = _statisticsCycles == 0 ? 0 : _durationSum / _statisticsCycles;
+    statistics.maximumDuration = _maximumDuration;
+    statistics.averageDrippingDuration = _statisticsCycles == 0 ? 0 : _drippingDurationSum / _statisticsCycles;
+    statistics.averagePeakEvaporatorTemperature = _peakTemperatureCount == 0 ? READ_ERROR_FLOAT : _peakTemperatureSum / _peakTemperatureCount;
+    return statistics;
+}
@@ -0,0 +1,187 @@
+#ifndef DEFROST_TRACKER_H
+#define DEFROST_TRACKER_H
+
+#include <Arduino.h>
+#include "PegoController.h"
+
+// Amount of completed defrost cycles kept in the ring buffer
+#ifndef DEFROST_TRACKER_CAPACITY
+#define DEFROST_TRACKER_CAPACITY 8
+#endif
+
+// Tolerance (in °C) below d2 for which a defrost still counts as ended on temperature
+#define DEFROST_TEMPERATURE_TOLERANCE 1.0
+
+/**
+ * @brief Describes why a defrost cycle ended.
+ */
+enum DefrostTermination : uint8_t {
+    // The cycle ended before reaching either limit (e.g. remote stop or manual abort)
+    DEFROST_TERMINATION_UNKNOWN = 0,
+    // The evaporator reached the end of defrosting temperature (d2)
+    DEFROST_TERMINATION_TEMPERATURE,
+    // The maximum defrosting duration (d3) elapsed. Usually means an iced evaporator.
+    DEFROST_TERMINATION_TIMEOUT
+};
+
+/**
+ * @brief A single recorded defrost cycle. All timestamps are millis() values.
+ */
+struct DefrostCycle {
+    // Time at which the defrost relay or hot resistance turned on
+    unsigned long start;
+    // Time at which the heating phase ended
+    unsigned long end;
+    // Time at which the dripping phase ended. Equals end if there was no dripping.
+    unsigned long drippingEnd;
+    // Highest evaporator temperature observed during the heating phase in °C
+    float peakEvaporatorTemperature;
+    DefrostTermination termination;
+
+    /**
+     * @brief Duration of the heating phase in ms
+     */
+    unsigned long duration() const { return end - start; }
+
+    /**
+     * @brief Duration of the dripping phase in ms
+     */
+    unsigned long drippingDuration() const { return drippingEnd - end; }
+};
+
+/**
+ * @brief Aggregated statistics over all defrost cycles completed since the last reset.
+ * Unlike the ring buffer these counters are not limited to the last cycles.
+ */
+struct DefrostStatistics {
+    uint16_t cycles;
+    uint16_t temperatureTerminations;
+    uint16_t timeoutTerminations;
+    uint16_t unknownTerminations;
+    // Durations in ms
+    unsigned long averageDuration;
+    unsigned long maximumDuration;
+    unsigned long averageDrippingDuration;
+    // Average of the per-cycle peak evaporator temperature in °C
+    float averagePeakEvaporatorTemperature;
+};
+
+/**
+ * @brief Follows the defrost relay, dripping and hot resistance bits of the
+ * Output Status Register together with the evaporator temperature and records
+ * one DefrostCycle per defrost in a small fixed ring buffer.
+ * The tracker doesn't talk to the bus on its own except for the convenience
+ * functions taking a PegoController reference.
+ */
+class DefrostTracker {
+private:
+    DefrostCycle _cycles[DEFROST_TRACKER_CAPACITY];
+
+    // Index of the slot that will be written next
+    uint8_t _head;
+
+    // Amount of valid entries in the ring buffer
+    uint8_t _count;
+
+    // The cycle that is currently in progress
+    DefrostCycle _current;
+    bool _heating;
+    bool _dripping;
+
+    // End of defrosting temperature (d2) in °C
+    int16_t _endOfDefrostingTemperature;
+
+    // Maximum defrosting duration (d3) in minutes
+    int16_t _maxDefrostingDuration;
+
+    // Time of the previous update, used to estimate the polling granularity
+    unsigned long _lastUpdate;
+    unsigned long _pollInterval;
+
+    // Running sums for the statistics
+    uint16_t _statisticsCycles;
+    uint16_t _terminationCount[3];
+    unsigned long long _durationSum;
+    unsigned long long _drippingDurationSum;
+    unsigned long _maximumDuration;
+    float _peakTemperatureSum;
+    uint16_t _peakTemperatureCount;
+
+    /**
+     * @brief Figures out why the heating phase that just ended was stopped.
+     */
+    DefrostTermination classify(const DefrostCycle &cycle) const;
+
+    /**
+     * @brief Stores a completed cycle in the ring buffer and adds it to the statistics.
+     */
+    void record(const DefrostCycle &cycle);
+
+public:
+    /**
+     * @brief Construct a new Defrost Tracker object
+     * @param endOfDefrostingTemperature The end of defrosting temperature (d2) in °C.
+     * @param maxDefrostingDuration The maximum defrosting duration (d3) in minutes.
+     */
+    DefrostTracker(int16_t endOfDefrostingTemperature = 8, int16_t maxDefrostingDuration = 25);
+
+    /**
+     * @brief Sets the limits used to determine the termination cause.
+     * @param endOfDefrostingTemperature The end of defrosting temperature (d2) in °C.
+     * @param maxDefrostingDuration The maximum defrosting duration (d3) in minutes.
+     */
+    void setLimits(int16_t endOfDefrostingTemperature, int16_t maxDefrostingDuration);
+
+    /**
+     * @brief Reads d2 and d3 from the controller and uses them as limits.
+     * @param controller The controller to read the parameters from.
+     * @return true if both parameters could be read, false otherwise.
+     */
+    bool loadLimits(PegoController &controller);
+
+    /**
+     * @brief Feeds a new sample into the tracker. Call it once per poll.
+     * @param now The current time in ms (millis()).
+     * @param outputStatus The raw Output Status Register value or READ_ERROR.
+     * @param evaporatorTemperature The evaporator temperature in °C or READ_ERROR_FLOAT.
+     * @return false if the sample was ignored because the output status couldn't be read.
+     */
+    bool update(unsigned long now, int16_t outputStatus, float evaporatorTemperature);
+
+    /**
+     * @brief Reads the Output Status Register and the evaporator temperature
+     * from the controller and feeds them into the tracker.
+     * @param controller The controller to read from.
+     * @return true if the output status could be read, false otherwise.
+     */
+    bool update(PegoController &controller);
+
+    /**
+     * @brief Tells whether a defrost cycle (heating or dripping) is in progress.
+     */
+    bool defrosting() const;
+
+    /**
+     * @brief Returns the amount of cycles currently held in the ring buffer.
+     */
+    uint8_t count() const;
+
+    /**
+     * @brief Returns a recorded cycle.
+     * @param index 0 is the most recent cycle, count() - 1 the oldest one.
+     * @return The cycle at the given index.
+     */
+    const DefrostCycle &cycle(uint8_t index) const;
+
+    /**
+     * @brief Computes the aggregated statistics over all completed cycles.
+     */
+    DefrostStatistics statistics() const;
+
+    /**
+     * @brief Clears the ring buffer and the statistics.
+     */
+    void reset();
+};
+
+#endif
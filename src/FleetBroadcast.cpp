@@ -0,0 +1,135 @@
+#include "FleetBroadcast.h"
+#include <ArduinoModbus.h>
+
+#define MODBUS_BROADCAST_ADDRESS 0
+
+#ifndef SerialPort
+#define SerialPort Serial
+#endif
+
+FleetBroadcast::FleetBroadcast(PegoTransport &transport) :
+_transport(&transport),
+_count(0),
+_registerNumber(0),
+_expectedValue(0),
+_verifyMask(0xFFFF),
+_value(0),
+_verifying(false),
+_sent(0),
+_next(0)
+{}
+
+bool FleetBroadcast::add(PegoController &controller){
+    if(_count >= FLEET_BROADCAST_MAX_CONTROLLERS) return false;
+    if(&controller.transport() != _transport) return false;
+    _controllers[_count] = &controller;
+    _states[_count] = BROADCAST_PENDING;
+    _attempts[_count] = 0;
+    ++_count;
+    return true;
+}
+
+bool FleetBroadcast::broadcast(uint16_t registerNumber, int16_t value, bool verify){
+    _registerNumber = registerNumber;
+    _value = value;
+    if(registerNumber == DEVICE_STATUS_REGISTER){
+        // The MSB selects the flags, the LSB holds their new state
+        _verifyMask = highByte(value);
+        _expectedValue = lowByte(value);
+    } else {
+        _verifyMask = 0xFFFF;
+        _expectedValue = value;
+    }
+
+    if(!_transport->beginTransmission(MODBUS_BROADCAST_ADDRESS, HOLDING_REGISTERS, registerNumber, 1)){
+        SerialPort.print("Broadcast failed: ");
+        SerialPort.println(_transport->lastError());
+        return false;
+    }
+    _transport->write((uint16_t)value);
+    if(!_transport->endTransmission()){
+        SerialPort.print("Broadcast failed: ");
+        SerialPort.println(_transport->lastError());
+        return false;
+    }
+    _sent = millis();
+
+    for(uint8_t i = 0; i < _count; ++i){
+        // Values shared from before the broadcast are outdated
+        _controllers[i]->clearReadCache();
+        _states[i] = BROADCAST_PENDING;
+        _attempts[i] = 0;
+    }
+    _next = 0;
+    _verifying = verify && _count > 0;
+    return true;
+}
+
+bool FleetBroadcast::broadcastStandBy(bool standBy, bool verify){
+    int16_t value = 0;
+    bitSet(value, DEVICE_STATUS_STAND_BY_BIT + 8);
+    if(standBy) bitSet(value, DEVICE_STATUS_STAND_BY_BIT);
+    return broadcast(DEVICE_STATUS_REGISTER, value, verify);
+}
+
+bool FleetBroadcast::update(){
+    if(!_verifying) return false;
+    if(millis() - _sent < FLEET_BROADCAST_SETTLE_TIME) return false;
+
+    // Continue with the next controller that isn't settled, round robin
+    uint8_t index = _count;
+    for(uint8_t i = 0; i < _count; ++i){
+        uint8_t candidate = (_next + i) % _count;
+        if(_states[candidate] == BROADCAST_PENDING){
+            index = candidate;
+            break;
+        }
+    }
+    if(index == _count){
+        _verifying = false;
+        return false;
+    }
+    _next = (index + 1) % _count;
+
+    PegoController &controller = *_controllers[index];
+    RegisterDescription description = {HOLDING_REGISTERS, _registerNumber, false, 1};
+    int16_t value = controller.readModbusRegister(description);
+    ++_attempts[index];
+
+    if(value == READ_ERROR && controller.lastErrorKind() != MODBUS_ERROR_NONE){
+        if(controller.lastErrorKind() == MODBUS_ERROR_UNSUPPORTED || controller.lastErrorKind() == MODBUS_ERROR_ILLEGAL_ADDRESS){
+            _states[index] = BROADCAST_SKIPPED;
+        } else if(_attempts[index] >= FLEET_BROADCAST_MAX_ATTEMPTS){
+            _states[index] = BROADCAST_FAILED;
+        }
+        return true;
+    }
+
+    if(((uint16_t)value & _verifyMask) == (_expectedValue & _verifyMask)){
+        _states[index] = _attempts[index] == 1 ? BROADCAST_VERIFIED : BROADCAST_RESENT;
+        return true;
+    }
+    if(_attempts[index] >= FLEET_BROADCAST_MAX_ATTEMPTS){
+        _states[index] = BROADCAST_FAILED;
+        return true;
+    }
+    // The controller missed the broadcast, it gets a unicast write and is read again later
+    controller.writeModbusRegister(description, _value);
+    return true;
+}
+
+bool FleetBroadcast::verifying() const {
+    return _verifying;
+}
+
+BroadcastVerification FleetBroadcast::state(uint8_t index) const {
+    return index < _count ? _states[index] : BROADCAST_FAILED;
+}
+
+uint8_t FleetBroadcast::count(BroadcastVerification state) const {
+    uint8_t count = 0;
+    for(uint8_t i = 0; i < _count; ++i){
+        if(_states[i] == state) ++count;
+    }
+    return count;
+}
@@ -0,0 +1,107 @@
+#ifndef FLEET_BROADCAST_H
+#define FLEET_BROADCAST_H
+
+#include <Arduino.h>
+#include "PegoController.h"
+
+// Amount of controllers a broadcast can verify
+#ifndef FLEET_BROADCAST_MAX_CONTROLLERS
+#define FLEET_BROADCAST_MAX_CONTROLLERS 32
+#endif
+
+// Time in ms the controllers get to process a broadcast before they are asked again
+#define FLEET_BROADCAST_SETTLE_TIME 500
+
+// Reads per controller until the verification gives up on it
+#define FLEET_BROADCAST_MAX_ATTEMPTS 3
+
+/**
+ * @brief Verification state of a controller after a broadcast.
+ */
+enum BroadcastVerification : uint8_t {
+    BROADCAST_PENDING = 0,
+    // The controller applied the broadcast
+    BROADCAST_VERIFIED,
+    // The controller missed the broadcast and applied the unicast write that was sent instead
+    BROADCAST_RESENT,
+    // The controller didn't answer or kept rejecting the value
+    BROADCAST_FAILED,
+    // The controller doesn't have the register
+    BROADCAST_SKIPPED
+};
+
+/**
+ * @brief Writes a register of all controllers on the bus with a single
+ * unacknowledged frame to the broadcast address 0.
+ * As nobody acknowledges a broadcast, an optional verification sweep reads
+ * the register back from every controller, one transaction per update(),
+ * and re-sends the write to the ones that didn't apply it.
+ */
+class FleetBroadcast {
+private:
+    PegoTransport *_transport;
+    PegoController *_controllers[FLEET_BROADCAST_MAX_CONTROLLERS];
+    BroadcastVerification _states[FLEET_BROADCAST_MAX_CONTROLLERS];
+    uint8_t _attempts[FLEET_BROADCAST_MAX_CONTROLLERS];
+    uint8_t _count;
+
+    uint16_t _registerNumber;
+    uint16_t _expectedValue;
+    uint16_t _verifyMask;
+    uint16_t _value;
+    bool _verifying;
+    unsigned long _sent;
+    uint8_t _next;
+
+public:
+    /**
+     * @brief Construct a new Fleet Broadcast object
+     * @param transport The Modbus client of the bus the broadcast is sent on.
+     */
+    FleetBroadcast(PegoTransport &transport = PEGO_DEFAULT_TRANSPORT);
+
+    /**
+     * @brief Adds a controller to the fleet that is verified after a broadcast.
+     * @return false if the fleet is full or the controller is on another bus.
+     */
+    bool add(PegoController &controller);
+
+    /**
+     * @brief Sends a register value to all controllers in one frame.
+     * Writes to the device status register (1536) only compare the flags selected
+     * by the MSB of the value during verification.
+     * @param registerNumber The register to write.
+     * @param value The raw register value.
+     * @param verify Whether to start the verification sweep.
+     * @return true if the frame was sent.
+     */
+    bool broadcast(uint16_t registerNumber, int16_t value, bool verify = true);
+
+    /**
+     * @brief Puts all controllers into stand-by or switches them on.
+     */
+    bool broadcastStandBy(bool standBy, bool verify = true);
+
+    /**
+     * @brief Performs the next step of the verification sweep.
+     * @return true if a bus transaction was performed.
+     */
+    bool update();
+
+    /**
+     * @brief Whether the verification sweep is still running.
+     */
+    bool verifying() const;
+
+    /**
+     * @brief Returns the verification state of a controller, in the order they were added.
+     */
+    BroadcastVerification state(uint8_t index) const;
+
+    /**
+     * @brief Amount of controllers in the given verification state.
+     */
+    uint8_t count(BroadcastVerification state) const;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "LoopProfiler.h"
+
+LoopProfiler Profiler;
+
+uint8_t LoopProfiler::bucket(unsigned long duration){
+    if(duration < 4) return duration;
+    uint8_t octave = 31 - __builtin_clz((uint32_t)duration);
+    // The bit below the leading one selects the lower or upper half of the octave
+    uint8_t index = octave * 2 + ((duration >> (octave - 1)) & 1);
+    return index < LOOP_PROFILER_BUCKETS ? index : LOOP_PROFILER_BUCKETS - 1;
+}
+
+unsigned long LoopProfiler::bucketLimit(uint8_t bucket){
+    if(bucket < 4) return bucket;
+    uint8_t octave = bucket / 2;
+    unsigned long lower = (2UL + (bucket & 1)) << (octave - 1);
+    return lower + (1UL << (octave - 1)) - 1;
+}
+
+void LoopProfiler::record(LoopPhase phase, unsigned long duration){
+    if(phase >= LOOP_PHASE_COUNT) return;
+    Phase &entry = _phases[phase];
+    if(entry.count == 0 || duration < entry.minimum) entry.minimum = duration;
+    if(duration > entry.maximum) entry.maximum = duration;
+    entry.sum += duration;
+    ++entry.count;
+
+    uint16_t &counter = entry.buckets[bucket(duration)];
+    if(counter == UINT16_MAX){
+        // Halving all buckets keeps their proportions and thereby the percentile
+        for(uint8_t i = 0; i < LOOP_PROFILER_BUCKETS; ++i){
+            entry.buckets[i] /= 2;
+        }
+    }
+    ++counter;
+}
+
+PhaseStatistics LoopProfiler::statistics(LoopPhase phase) const {
+    PhaseStatistics statistics = {0, 0, 0, 0, 0};
+    if(phase >= LOOP_PHASE_COUNT) return statistics;
+    const Phase &entry = _phases[phase];
+    if(entry.count == 0) return statistics;
+    statistics.count = entry.count;
+    statistics.minimum = entry.minimum;
+    statistics.maximum = entry.maximum;
+    statistics.average = entry.sum / entry.count;
+
+    unsigned long total = 0;
+    for(uint8_t i = 0; i < LOOP_PROFILER_BUCKETS; ++i) total += entry.buckets[i];
+    // Smallest bucket that holds at least 99% of the runs
+    unsigned long target = total - total / 100;
+    unsigned long seen = 0;
+    for(uint8_t i = 0; i < LOOP_PROFILER_BUCKETS; ++i){
+        seen += entry.buckets[i];
+        if(seen >= target){
+            statistics.percentile99 = constrain(bucketLimit(i), entry.minimum, entry.maximum);
+            break;
+        }
+    }
+    return statistics;
+}
+
+void LoopProfiler::reset(){
+    memset(_phases, 0, sizeof(_phases));
+}
+
+void LoopProfiler::printReport(Print &output) const {
+    static const char *names[LOOP_PHASE_COUNT] = {"loop", "bus", "decode", "publish", "log", "sensor"};
+    const Phase &loop = _phases[LOOP_PHASE_LOOP];
+    bool first = true;
+    for(uint8_t i = 0; i < LOOP_PHASE_COUNT; ++i){
+        PhaseStatistics phase = statistics((LoopPhase)i);
+        if(phase.count == 0) continue;
+        if(!first) output.print(" | ");
+        first = false;
+        output.print(names[i]);
+        output.print(' ');
+        if(i != LOOP_PHASE_LOOP && loop.sum != 0){
+            output.print((unsigned long)(_phases[i].sum * 100 / loop.sum));
+            output.print("% ");
+        }
+        output.print(phase.count);
+        output.print("x ");
+        output.print(phase.minimum);
+        output.print('/');
+        output.print(phase.average);
+        output.print('/');
+        output.print(phase.percentile99);
+        output.print('/');
+        output.print(phase.maximum);
+        output.print("us");
+    }
+    if(first) output.print("no phases recorded");
+    output.println();
+}
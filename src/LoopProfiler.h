@@ -0,0 +1,125 @@
+#ifndef LOOP_PROFILER_H
+#define LOOP_PROFILER_H
+
+#include <Arduino.h>
+
+/*
+Define LOOP_PROFILER as a build flag to enable the instrumentation,
+e.g. with --build-property "compiler.cpp.extra_flags=-DLOOP_PROFILER".
+Otherwise the PROFILE_* macros expand to nothing and the profiler is
+dropped by the linker. Defining it in the sketch only profiles the sketch,
+as the library is compiled separately.
+*/
+
+// Amount of histogram buckets per phase. There are two buckets per power of two,
+// the last one collects all durations above ~16 s.
+#define LOOP_PROFILER_BUCKETS 48
+
+/**
+ * @brief The phases of the main loop that are timed separately.
+ */
+enum LoopPhase : uint8_t {
+    // A whole loop() iteration, the other phases are reported as a share of it
+    LOOP_PHASE_LOOP = 0,
+    // A Modbus transaction, timed by the library itself
+    LOOP_PHASE_BUS,
+    // Turning register values into properties or messages
+    LOOP_PHASE_DECODE,
+    // Cloud or MQTT updates
+    LOOP_PHASE_PUBLISH,
+    // Serial output
+    LOOP_PHASE_LOG,
+    // Analog reads of the light sensor and battery
+    LOOP_PHASE_SENSOR,
+    LOOP_PHASE_COUNT
+};
+
+/**
+ * @brief Durations of one phase in µs.
+ */
+struct PhaseStatistics {
+    unsigned long count;
+    unsigned long minimum;
+    unsigned long average;
+    unsigned long percentile99;
+    unsigned long maximum;
+};
+
+/**
+ * @brief Collects the durations of the loop phases.
+ * Recording a duration is a handful of integer operations: besides
+ * min/max/sum it increments one bucket of a logarithmic histogram,
+ * from which the 99th percentile is estimated within ~30%.
+ * The object is all zero when constructed so it doesn't need any static initialisation.
+ */
+class LoopProfiler {
+private:
+    struct Phase {
+        unsigned long count;
+        unsigned long minimum;
+        unsigned long maximum;
+        uint64_t sum;
+        uint16_t buckets[LOOP_PROFILER_BUCKETS];
+    };
+
+    Phase _phases[LOOP_PHASE_COUNT];
+
+    static uint8_t bucket(unsigned long duration);
+    static unsigned long bucketLimit(uint8_t bucket);
+
+public:
+    /**
+     * @brief Adds the duration of one run of a phase.
+     * @param phase The phase that was timed.
+     * @param duration The duration in µs.
+     */
+    void record(LoopPhase phase, unsigned long duration);
+
+    /**
+     * @brief Returns the statistics of a phase. All values are 0 if the phase never ran.
+     */
+    PhaseStatistics statistics(LoopPhase phase) const;
+
+    /**
+     * @brief Clears the statistics of all phases.
+     */
+    void reset();
+
+    /**
+     * @brief Prints the statistics of all phases that ran on one line, e.g.
+     * loop 1200x 85/912/4096/120034us | bus 41% 60x ...
+     * The values are min/avg/p99/max. The percentage is the share of the total loop time.
+     */
+    void printReport(Print &output) const;
+};
+
+extern LoopProfiler Profiler;
+
+/**
+ * @brief Records the time from its construction to the end of the enclosing scope.
+ */
+class ProfileScope {
+private:
+    LoopPhase _phase;
+    unsigned long _start;
+
+public:
+    ProfileScope(LoopPhase phase) : _phase(phase), _start(micros()) {}
+    ~ProfileScope(){ Profiler.record(_phase, micros() - _start); }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#if defined(LOOP_PROFILER)
+    // Times the rest of the enclosing scope as the given phase
+    #define PROFILE_PHASE(phase) ProfileScope PROFILE_CONCAT(_profileScope, __LINE__)(phase)
+    #define PROFILE_REPORT(output) Profiler.printReport(output)
+    #define PROFILE_RESET() Profiler.reset()
+#else
+    #define PROFILE_PHASE(phase)
+    #define PROFILE_REPORT(output)
+    #define PROFILE_RESET()
+#endif
+
+#endif
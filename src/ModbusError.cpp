@@ -0,0 +1,52 @@
+#include "ModbusError.h"
+#include <ArduinoModbus.h>
+#include <errno.h>
+
+ModbusErrorKind decodeModbusError(int error){
+    if(error == 0) return MODBUS_ERROR_NONE;
+    if(error == ETIMEDOUT) return MODBUS_ERROR_TIMEOUT;
+    switch(error){
+        case EMBXILFUN: return MODBUS_ERROR_ILLEGAL_FUNCTION;
+        case EMBXILADD: return MODBUS_ERROR_ILLEGAL_ADDRESS;
+        case EMBXILVAL: return MODBUS_ERROR_ILLEGAL_VALUE;
+        case EMBXSFAIL: return MODBUS_ERROR_DEVICE_FAILURE;
+        case EMBXACK:
+        case EMBXSBUSY: return MODBUS_ERROR_BUSY;
+        case EMBBADCRC:
+        case EMBBADDATA:
+        case EMBBADSLAVE:
+        case EMBMDATA: return MODBUS_ERROR_CORRUPT_FRAME;
+        case EMBBADEXC:
+        case EMBUNKEXC: return MODBUS_ERROR_EXCEPTION;
+    }
+    if(error > MODBUS_ENOBASE && error < EMBBADCRC) return MODBUS_ERROR_EXCEPTION;
+    return MODBUS_ERROR_OTHER;
+}
+
+bool modbusErrorTransient(ModbusErrorKind kind){
+    switch(kind){
+        case MODBUS_ERROR_ILLEGAL_FUNCTION:
+        case MODBUS_ERROR_ILLEGAL_ADDRESS:
+        case MODBUS_ERROR_ILLEGAL_VALUE:
+        case MODBUS_ERROR_UNSUPPORTED:
+            return false;
+        default:
+            return true;
+    }
+}
+
+const char *modbusErrorName(ModbusErrorKind kind){
+    switch(kind){
+        case MODBUS_ERROR_NONE: return "none";
+        case MODBUS_ERROR_TIMEOUT: return "timeout";
+        case MODBUS_ERROR_CORRUPT_FRAME: return "corrupt frame";
+        case MODBUS_ERROR_ILLEGAL_FUNCTION: return "illegal function";
+        case MODBUS_ERROR_ILLEGAL_ADDRESS: return "illegal data address";
+        case MODBUS_ERROR_ILLEGAL_VALUE: return "illegal data value";
+        case MODBUS_ERROR_DEVICE_FAILURE: return "device failure";
+        case MODBUS_ERROR_BUSY: return "device busy";
+        case MODBUS_ERROR_EXCEPTION: return "exception";
+        case MODBUS_ERROR_UNSUPPORTED: return "unsupported register";
+        default: return "other";
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef MODBUS_ERROR_H
+#define MODBUS_ERROR_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Why a transaction failed, decoded from the errno value set by ArduinoModbus.
+ */
+enum ModbusErrorKind : uint8_t {
+    MODBUS_ERROR_NONE = 0,
+    // No (complete) response within the response timeout: controller offline or bus problem
+    MODBUS_ERROR_TIMEOUT,
+    // Response with a wrong CRC, from a wrong peripheral or with unexpected content
+    MODBUS_ERROR_CORRUPT_FRAME,
+    // Exception 01: the controller doesn't support the function code
+    MODBUS_ERROR_ILLEGAL_FUNCTION,
+    // Exception 02: the register doesn't exist on the controller. Retrying won't help.
+    MODBUS_ERROR_ILLEGAL_ADDRESS,
+    // Exception 03: the value or quantity isn't accepted
+    MODBUS_ERROR_ILLEGAL_VALUE,
+    // Exception 04: the controller failed to perform the request
+    MODBUS_ERROR_DEVICE_FAILURE,
+    // Exceptions 05 / 06: the controller is busy, retry later
+    MODBUS_ERROR_BUSY,
+    // Any other exception
+    MODBUS_ERROR_EXCEPTION,
+    // The request wasn't sent because the register is known to be unsupported
+    MODBUS_ERROR_UNSUPPORTED,
+    // Anything else, e.g. a serial port error
+    MODBUS_ERROR_OTHER
+};
+
+/**
+ * @brief Decodes an errno value of a failed ArduinoModbus call.
+ */
+ModbusErrorKind decodeModbusError(int error);
+
+/**
+ * @brief Tells whether repeating the request can succeed.
+ * Illegal function / address / value and unsupported registers are permanent.
+ */
+bool modbusErrorTransient(ModbusErrorKind kind);
+
+/**
+ * @brief Returns a short human readable name of the error kind.
+ */
+const char *modbusErrorName(ModbusErrorKind kind);
+
+#endif
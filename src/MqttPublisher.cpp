@@ -0,0 +1,152 @@
+#include "MqttPublisher.h"
+#include <stdio.h>
+
+MqttPublisher::MqttPublisher(MqttClient &client, const char *prefix) :
+_client(client),
+_prefix(prefix),
+_deviceCount(0),
+_head(0),
+_count(0),
+_stateQoS(1),
+_changesQoS(0),
+_stateInterval(MQTT_PUBLISHER_DEFAULT_STATE_INTERVAL),
+_connected(false)
+{
+    memset(&_statistics, 0, sizeof(_statistics));
+}
+
+int8_t MqttPublisher::add(const char *name){
+    if(_deviceCount >= MQTT_PUBLISHER_MAX_DEVICES) return -1;
+    Device &device = _devices[_deviceCount];
+    device.name = name;
+    device.writer.setOnlyChanged(true);
+    device.lastState = 0;
+    device.needsState = true;
+    return _deviceCount++;
+}
+
+SnapshotJsonWriter &MqttPublisher::writer(uint8_t index){
+    if(index >= _deviceCount) index = 0;
+    return _devices[index].writer;
+}
+
+void MqttPublisher::setQoS(uint8_t stateQoS, uint8_t changesQoS){
+    _stateQoS = stateQoS;
+    _changesQoS = changesQoS;
+}
+
+void MqttPublisher::setStateInterval(unsigned long interval){
+    _stateInterval = interval;
+}
+
+void MqttPublisher::resync(){
+    for(uint8_t i = 0; i < _deviceCount; ++i){
+        _devices[i].needsState = true;
+    }
+}
+
+MqttPublisher::Message &MqttPublisher::message(uint8_t position){
+    return _queue[(_head + position) % MQTT_PUBLISHER_SLOTS];
+}
+
+void MqttPublisher::removeDevice(uint8_t device){
+    // Compacts the queue, keeping the order of the other messages
+    uint8_t kept = 0;
+    for(uint8_t i = 0; i < _count; ++i){
+        Message &entry = message(i);
+        if(entry.device == device){
+            ++_statistics.superseded;
+            continue;
+        }
+        if(kept != i) message(kept) = entry;
+        ++kept;
+    }
+    _count = kept;
+}
+
+void MqttPublisher::dropOldest(){
+    // The receivers missed a change, so the device starts over with its full state
+    _devices[message(0).device].needsState = true;
+    _head = (_head + 1) % MQTT_PUBLISHER_SLOTS;
+    --_count;
+    ++_statistics.dropped;
+}
+
+bool MqttPublisher::publish(uint8_t index, const ControllerSnapshot &snapshot){
+    if(index >= _deviceCount) return false;
+    Device &device = _devices[index];
+    unsigned long now = millis();
+    bool state = device.needsState || now - device.lastState >= _stateInterval;
+
+    // Written into the spare slot behind the queue, so the queued messages stay
+    // untouched unless the snapshot turns into a message
+    uint8_t spare = _count;
+    Message &entry = message(spare);
+    if(state) device.writer.resetReference();
+    size_t length = device.writer.write(entry.payload, MQTT_PUBLISHER_PAYLOAD_SIZE, snapshot);
+    if(length == 0){
+        ++_statistics.oversized;
+        return false;
+    }
+    // Only the timestamp, i.e. no field changed
+    if(!state && memchr(entry.payload, ',', length) == NULL) return false;
+
+    entry.device = index;
+    entry.state = state;
+    entry.length = length;
+    // A full state makes the queued messages of the device obsolete
+    if(state) removeDevice(index);
+    if(_count != spare) message(_count) = entry;
+    if(_count == MQTT_PUBLISHER_QUEUE_SIZE) dropOldest();
+    ++_count;
+    if(state){
+        device.needsState = false;
+        device.lastState = now;
+    }
+    return true;
+}
+
+bool MqttPublisher::send(const Message &message){
+    char topic[MQTT_PUBLISHER_TOPIC_SIZE];
+    int length = snprintf(topic, sizeof(topic), "%s/%s/%s", _prefix, _devices[message.device].name, message.state ? "state" : "changes");
+    if(length < 0 || length >= (int)sizeof(topic)) return false;
+
+    uint8_t qos = message.state ? _stateQoS : _changesQoS;
+    if(!_client.beginMessage(topic, message.length, message.state, qos)) return false;
+    _client.write((const uint8_t *)message.payload, message.length);
+    if(!_client.endMessage()) return false;
+
+    if(message.state){
+        ++_statistics.stateMessages;
+    } else {
+        ++_statistics.changeMessages;
+    }
+    _statistics.bytes += message.length;
+    return true;
+}
+
+uint8_t MqttPublisher::update(uint8_t maxMessages){
+    _client.poll();
+    bool connected = _client.connected();
+    // The broker may have lost the retained states, and subscribers the changes
+    if(connected && !_connected) resync();
+    _connected = connected;
+    if(!connected) return 0;
+
+    uint8_t sent = 0;
+    while(_count > 0 && sent < maxMessages){
+        if(!send(message(0))) break;
+        _head = (_head + 1) % MQTT_PUBLISHER_SLOTS;
+        --_count;
+        ++sent;
+    }
+    return sent;
+}
+
+uint8_t MqttPublisher::queued() const {
+    return _count;
+}
+
+const MqttPublisherStatistics &MqttPublisher::statistics() const {
+    return _statistics;
+}
@@ -0,0 +1,158 @@
+#ifndef MQTT_PUBLISHER_H
+#define MQTT_PUBLISHER_H
+
+#include <Arduino.h>
+#include <ArduinoMqttClient.h>
+#include "SnapshotJson.h"
+
+// Amount of controllers a publisher can serve
+#ifndef MQTT_PUBLISHER_MAX_DEVICES
+#define MQTT_PUBLISHER_MAX_DEVICES 4
+#endif
+
+// Amount of messages held while the broker is unreachable or busy
+#ifndef MQTT_PUBLISHER_QUEUE_SIZE
+#define MQTT_PUBLISHER_QUEUE_SIZE 4
+#endif
+
+// Maximum JSON payload of one message in bytes including the terminating zero. By default
+// the longest state with bus health and parameters fits (~1.4 kB). Sketches that include
+// neither can save RAM by defining it as SNAPSHOT_JSON_MAX_SNAPSHOT_LENGTH + 1.
+#ifndef MQTT_PUBLISHER_PAYLOAD_SIZE
+#define MQTT_PUBLISHER_PAYLOAD_SIZE (SNAPSHOT_JSON_MAX_LENGTH + 1)
+#endif
+
+// The queue has one more slot than messages, into which a snapshot is written before
+// it is known whether it produces a message at all
+#define MQTT_PUBLISHER_SLOTS (MQTT_PUBLISHER_QUEUE_SIZE + 1)
+
+// Maximum length of a topic including the terminating zero
+#define MQTT_PUBLISHER_TOPIC_SIZE 64
+
+// Default time in ms after which the retained state is refreshed
+#define MQTT_PUBLISHER_DEFAULT_STATE_INTERVAL 300000
+
+/**
+ * @brief Counters of a MqttPublisher since start.
+ */
+struct MqttPublisherStatistics {
+    unsigned long stateMessages;
+    unsigned long changeMessages;
+    // Payload bytes handed to the MQTT client
+    unsigned long bytes;
+    // Messages pushed out of the full queue
+    unsigned long dropped;
+    // Queued messages replaced by a newer state of the same device
+    unsigned long superseded;
+    // Snapshots whose JSON didn't fit into MQTT_PUBLISHER_PAYLOAD_SIZE
+    unsigned long oversized;
+};
+
+/**
+ * @brief Publishes controller snapshots over MQTT as an alternative to the Arduino IoT Cloud.
+ * Every device gets two topics below the prefix:
+ * - <prefix>/<device>/state: all fields as JSON, retained, so that a new subscriber
+ *   immediately gets the last known state. Sent first, after a reconnect, after lost
+ *   messages and at least every state interval.
+ * - <prefix>/<device>/changes: all fields that changed since the previous message,
+ *   batched into one JSON object. Not sent if nothing changed.
+ * The JSON is written straight into the spare slot of a bounded queue, so nothing is allocated.
+ * When the queue is full and a new message was produced, the oldest message is dropped
+ * and its device resends the full state.
+ */
+class MqttPublisher {
+private:
+    struct Device {
+        const char *name;
+        SnapshotJsonWriter writer;
+        unsigned long lastState;
+        bool needsState;
+    };
+
+    struct Message {
+        uint8_t device;
+        bool state;
+        uint16_t length;
+        char payload[MQTT_PUBLISHER_PAYLOAD_SIZE];
+    };
+
+    MqttClient &_client;
+    const char *_prefix;
+
+    Device _devices[MQTT_PUBLISHER_MAX_DEVICES];
+    uint8_t _deviceCount;
+
+    Message _queue[MQTT_PUBLISHER_SLOTS];
+    uint8_t _head;
+    uint8_t _count;
+
+    uint8_t _stateQoS;
+    uint8_t _changesQoS;
+    unsigned long _stateInterval;
+    bool _connected;
+
+    MqttPublisherStatistics _statistics;
+
+    Message &message(uint8_t position);
+    void removeDevice(uint8_t device);
+    void dropOldest();
+    bool send(const Message &message);
+
+public:
+    /**
+     * @brief Construct a new Mqtt Publisher object
+     * @param client A connected (or to be connected) MQTT client.
+     * @param prefix The topic prefix, e.g. "coldstores/site1". Has to stay valid.
+     */
+    MqttPublisher(MqttClient &client, const char *prefix);
+
+    /**
+     * @brief Adds a device.
+     * @param name The topic level of the device, e.g. "room1". Has to stay valid.
+     * @return The index of the device or -1 if the publisher is full.
+     */
+    int8_t add(const char *name);
+
+    /**
+     * @brief The JSON writer of a device, e.g. to include parameters or the bus health.
+     */
+    SnapshotJsonWriter &writer(uint8_t index);
+
+    /**
+     * @brief Selects the QoS level (0 or 1) of the state and changes messages.
+     */
+    void setQoS(uint8_t stateQoS, uint8_t changesQoS);
+
+    /**
+     * @brief Sets the time in ms after which the retained state is refreshed. 0 sends every snapshot as state.
+     */
+    void setStateInterval(unsigned long interval);
+
+    /**
+     * @brief Queues the messages for a new snapshot of a device.
+     * @return true if a message was queued, false if nothing changed or the JSON didn't fit.
+     */
+    bool publish(uint8_t index, const ControllerSnapshot &snapshot);
+
+    /**
+     * @brief Services the MQTT client and sends queued messages while the client is connected.
+     * @param maxMessages Maximum amount of messages to be sent in this call.
+     * @return The amount of messages sent.
+     */
+    uint8_t update(uint8_t maxMessages = MQTT_PUBLISHER_QUEUE_SIZE);
+
+    /**
+     * @brief Makes every device send its full state with the next snapshot.
+     * Done automatically when the client reconnects.
+     */
+    void resync();
+
+    /**
+     * @brief Amount of messages waiting to be sent.
+     */
+    uint8_t queued() const;
+
+    const MqttPublisherStatistics &statistics() const;
+};
+
+#endif
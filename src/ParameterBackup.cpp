@@ -0,0 +1,270 @@
+#include <ArduinoModbus.h>
+#include <stddef.h>
+#include "ParameterBackup.h"
+
+#define NO_SECTOR 0xFFFF
+
+// Bytes of a record that are programmed, rounded to whole words
+#define RECORD_SIZE ((sizeof(ParameterRecord) + 3) / 4 * 4)
+
+#if defined(ARDUINO_ARCH_SAMD)
+// Part of the program image, the NVM controller erases it row by row
+__attribute__((__aligned__(256)))
+static const uint8_t backupRegion[PARAMETER_BACKUP_FLASH_SIZE] = {};
+
+#define SAMD_PAGE_SIZE (8 << NVMCTRL->PARAM.bit.PSZ)
+#define SAMD_ROW_SIZE (SAMD_PAGE_SIZE * 4)
+
+static void waitForNvm(){
+    while(NVMCTRL->INTFLAG.bit.READY == 0) {}
+}
+
+size_t SamdFlashMemory::sectorSize() const {
+    return SAMD_ROW_SIZE;
+}
+
+uint16_t SamdFlashMemory::sectorCount() const {
+    return PARAMETER_BACKUP_FLASH_SIZE / SAMD_ROW_SIZE;
+}
+
+bool SamdFlashMemory::read(uint32_t address, void *data, size_t size){
+    if(address + size > PARAMETER_BACKUP_FLASH_SIZE) return false;
+    const volatile uint8_t *source = backupRegion + address;
+    uint8_t *destination = (uint8_t *)data;
+    while(size--) *destination++ = *source++;
+    return true;
+}
+
+bool SamdFlashMemory::write(uint32_t address, const void *data, size_t size){
+    if(address % 4 != 0 || address + size > PARAMETER_BACKUP_FLASH_SIZE) return false;
+    volatile uint32_t *destination = (volatile uint32_t *)(backupRegion + address);
+    const uint8_t *source = (const uint8_t *)data;
+    uint32_t pageSize = SAMD_PAGE_SIZE;
+    NVMCTRL->CTRLB.bit.MANW = 1;
+    while(size > 0){
+        NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_PBC;
+        waitForNvm();
+        // The page buffer only takes 32 bit writes, unwritten words stay erased
+        do {
+            uint32_t word = 0xFFFFFFFF;
+            memcpy(&word, source, size < 4 ? size : 4);
+            *destination++ = word;
+            source += 4;
+            size = size < 4 ? 0 : size - 4;
+        } while(size > 0 && ((uintptr_t)destination % pageSize) != 0);
+        NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_WP;
+        waitForNvm();
+    }
+    return true;
+}
+
+bool SamdFlashMemory::erase(uint16_t sector){
+    if(sector >= sectorCount()) return false;
+    // The address register takes 16 bit words
+    NVMCTRL->ADDR.reg = ((uintptr_t)(backupRegion + sector * SAMD_ROW_SIZE)) / 2;
+    NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_ER;
+    waitForNvm();
+    return true;
+}
+#endif
+
+ParameterBackup::ParameterBackup(FlashMemory &flash) :
+_flash(flash),
+_slotsPerSector(0),
+_slots(0),
+_head(0),
+_sequence(1),
+_openSector(NO_SECTOR),
+_entryCount(0),
+_writes(0),
+_erases(0)
+{}
+
+uint32_t ParameterBackup::crc32(const void *data, size_t size){
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t crc = 0xFFFFFFFF;
+    while(size--){
+        crc ^= *bytes++;
+        for(uint8_t i = 0; i < 8; ++i){
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+bool ParameterBackup::readRecord(uint16_t slot, ParameterRecord &record){
+    if(!_flash.read((uint32_t)slot * PARAMETER_BACKUP_RECORD_STRIDE, &record, sizeof(record))) return false;
+    if(record.magic != PARAMETER_BACKUP_MAGIC) return false;
+    return record.crc == crc32(&record, offsetof(ParameterRecord, crc));
+}
+
+ParameterBackup::Entry *ParameterBackup::find(uint8_t peripheralID){
+    for(uint8_t i = 0; i < _entryCount; ++i){
+        if(_entries[i].peripheralID == peripheralID) return &_entries[i];
+    }
+    return NULL;
+}
+
+bool ParameterBackup::begin(){
+    _slotsPerSector = _flash.sectorSize() / PARAMETER_BACKUP_RECORD_STRIDE;
+    _slots = _slotsPerSector * _flash.sectorCount();
+    _entryCount = 0;
+    _head = 0;
+    _sequence = 1;
+    _openSector = NO_SECTOR;
+    if(_slotsPerSector == 0 || _flash.sectorCount() < 2 || RECORD_SIZE > PARAMETER_BACKUP_RECORD_STRIDE) return false;
+
+    uint32_t newest = 0;
+    uint32_t sequences[PARAMETER_BACKUP_MAX_CONTROLLERS];
+    ParameterRecord record;
+    for(uint16_t slot = 0; slot < _slots; ++slot){
+        if(!readRecord(slot, record)) continue;
+        if(record.sequence >= newest){
+            newest = record.sequence;
+            _head = (slot + 1) % _slots;
+        }
+        Entry *entry = find(record.peripheralID);
+        if(entry == NULL){
+            if(_entryCount == PARAMETER_BACKUP_MAX_CONTROLLERS) continue;
+            entry = &_entries[_entryCount];
+            entry->peripheralID = record.peripheralID;
+            sequences[_entryCount++] = 0;
+        }
+        uint32_t &sequence = sequences[entry - _entries];
+        if(record.sequence >= sequence){
+            sequence = record.sequence;
+            entry->slot = slot;
+        }
+    }
+    _sequence = newest + 1;
+    // A partially filled sector was prepared before, an empty one is prepared with the next record
+    if(newest != 0 && _head % _slotsPerSector != 0) _openSector = _head / _slotsPerSector;
+    return true;
+}
+
+bool ParameterBackup::prepareSector(uint16_t sector){
+    _openSector = sector;
+    if(!_flash.erase(sector)) return false;
+    ++_erases;
+
+    // Copies the images that only exist in the next sector, which is erased next
+    uint16_t next = (sector + 1) % (_slots / _slotsPerSector);
+    for(uint8_t i = 0; i < _entryCount; ++i){
+        if(_entries[i].slot / _slotsPerSector != next) continue;
+        ParameterRecord record;
+        if(!readRecord(_entries[i].slot, record)) continue;
+        if(!append(record)) return false;
+    }
+    return true;
+}
+
+bool ParameterBackup::append(ParameterRecord &record){
+    // Copying images forward may fill the sector, hence the loop
+    while(_head % _slotsPerSector == 0 && _openSector != _head / _slotsPerSector){
+        if(!prepareSector(_head / _slotsPerSector)) return false;
+    }
+
+    record.magic = PARAMETER_BACKUP_MAGIC;
+    record.sequence = _sequence++;
+    record.reserved = 0xFF;
+    record.crc = crc32(&record, offsetof(ParameterRecord, crc));
+    uint16_t slot = _head;
+    if(!_flash.write((uint32_t)slot * PARAMETER_BACKUP_RECORD_STRIDE, &record, RECORD_SIZE)) return false;
+    ++_writes;
+    _head = (_head + 1) % _slots;
+
+    Entry *entry = find(record.peripheralID);
+    if(entry == NULL){
+        if(_entryCount == PARAMETER_BACKUP_MAX_CONTROLLERS) return false;
+        entry = &_entries[_entryCount++];
+        entry->peripheralID = record.peripheralID;
+    }
+    entry->slot = slot;
+    return true;
+}
+
+int8_t ParameterBackup::store(uint8_t peripheralID, PegoModel model, const ControllerParameters &parameters){
+    if(_slots == 0 || !(parameters.valid & PARAMETERS_BASE_VALID)) return -1;
+
+    ParameterRecord record;
+    memset(&record, 0, sizeof(record));
+    record.peripheralID = peripheralID;
+    record.model = model;
+    record.valid = parameters.valid;
+    memcpy(record.base, parameters.base, sizeof(record.base));
+    memcpy(record.expert, parameters.expert, sizeof(record.expert));
+    memcpy(record.configuration, parameters.configuration, sizeof(record.configuration));
+
+    Entry *entry = find(peripheralID);
+    ParameterRecord stored;
+    if(entry != NULL && readRecord(entry->slot, stored)){
+        // Saves the flash from the frequent case of unchanged parameters
+        if(stored.model == record.model && stored.valid == record.valid &&
+           memcmp(stored.base, record.base, sizeof(record.base) + sizeof(record.expert) + sizeof(record.configuration)) == 0){
+            return 0;
+        }
+    } else if(entry == NULL && _entryCount == PARAMETER_BACKUP_MAX_CONTROLLERS){
+        return -1;
+    }
+    return append(record) ? 1 : -1;
+}
+
+int8_t ParameterBackup::store(const PegoController &controller, const ControllerParameters &parameters){
+    return store(controller.peripheralID(), controller.model(), parameters);
+}
+
+bool ParameterBackup::load(uint8_t peripheralID, ControllerParameters &parameters, PegoModel *model){
+    Entry *entry = find(peripheralID);
+    ParameterRecord record;
+    if(entry == NULL || !readRecord(entry->slot, record)) return false;
+    parameters.valid = record.valid;
+    memcpy(parameters.base, record.base, sizeof(parameters.base));
+    memcpy(parameters.expert, record.expert, sizeof(parameters.expert));
+    memcpy(parameters.configuration, record.configuration, sizeof(parameters.configuration));
+    if(model != NULL) *model = (PegoModel)record.model;
+    return true;
+}
+
+int16_t ParameterBackup::restore(PegoController &controller, uint8_t sourceID){
+    ControllerParameters image;
+    if(!load(sourceID == 0 ? controller.peripheralID() : sourceID, image)) return -1;
+
+    // Also detects the model, which tells the blocks the controller has
+    ControllerParameters current;
+    controller.readParameters(current);
+    bool expertRegisters = controller.modelDescriptor().expertRegisters;
+
+    // The configuration first, as it changes the meaning of some parameters
+    static const uint16_t blocks[][3] = {
+        {PARAMETERS_CONFIGURATION_VALID, PARAMETER_BLOCK_CONFIGURATION_FIRST, PARAMETER_BLOCK_CONFIGURATION_COUNT},
+        {PARAMETERS_BASE_VALID, PARAMETER_BLOCK_BASE_FIRST, PARAMETER_BLOCK_BASE_COUNT},
+        {PARAMETERS_EXPERT_VALID, PARAMETER_BLOCK_EXPERT_FIRST, PARAMETER_BLOCK_EXPERT_COUNT}
+    };
+    int16_t written = 0;
+    for(uint8_t block = 0; block < 3; ++block){
+        if(!(image.valid & blocks[block][0])) continue;
+        if(blocks[block][0] != PARAMETERS_BASE_VALID && !expertRegisters) continue;
+        for(uint16_t registerNumber = blocks[block][1]; registerNumber < blocks[block][1] + blocks[block][2]; ++registerNumber){
+            uint16_t value;
+            uint16_t currentValue;
+            if(!image.get(registerNumber, value)) continue;
+            if(current.get(registerNumber, currentValue) && currentValue == value) continue;
+            RegisterDescription description = {HOLDING_REGISTERS, registerNumber, false, 1};
+            if(!controller.writeModbusRegister(description, (int16_t)value)) return -1;
+            ++written;
+        }
+    }
+    return written;
+}
+
+uint8_t ParameterBackup::count() const {
+    return _entryCount;
+}
+
+unsigned long ParameterBackup::writes() const {
+    return _writes;
+}
+
+unsigned long ParameterBackup::erases() const {
+    return _erases;
+}
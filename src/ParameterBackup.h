@@ -0,0 +1,157 @@
+#ifndef PARAMETER_BACKUP_H
+#define PARAMETER_BACKUP_H
+
+#include <Arduino.h>
+#include "PegoController.h"
+
+// Amount of controllers whose image is kept
+#ifndef PARAMETER_BACKUP_MAX_CONTROLLERS
+#define PARAMETER_BACKUP_MAX_CONTROLLERS 8
+#endif
+
+// Size of the flash region reserved for the log on SAMD boards in bytes, a multiple of the 256 byte rows
+#ifndef PARAMETER_BACKUP_FLASH_SIZE
+#define PARAMETER_BACKUP_FLASH_SIZE 8192
+#endif
+
+// Distance between two records in the log. Has to divide the sector size.
+#define PARAMETER_BACKUP_RECORD_STRIDE 128
+
+#define PARAMETER_BACKUP_MAGIC 0x50475042 // "PGPB"
+
+/**
+ * @brief A flash region that can be erased in sectors and programmed in bytes
+ * that are still erased.
+ */
+class FlashMemory {
+public:
+    virtual ~FlashMemory() {}
+    /**
+     * @brief Size of the smallest erasable unit in bytes.
+     */
+    virtual size_t sectorSize() const = 0;
+    virtual uint16_t sectorCount() const = 0;
+    virtual bool read(uint32_t address, void *data, size_t size) = 0;
+    /**
+     * @brief Programs erased bytes. The address is a multiple of 4.
+     */
+    virtual bool write(uint32_t address, const void *data, size_t size) = 0;
+    virtual bool erase(uint16_t sector) = 0;
+};
+
+#if defined(ARDUINO_ARCH_SAMD)
+/**
+ * @brief PARAMETER_BACKUP_FLASH_SIZE bytes of the SAMD's internal flash, programmed through the NVM controller.
+ * The region is part of the sketch image, so uploading a sketch erases it.
+ */
+class SamdFlashMemory : public FlashMemory {
+public:
+    size_t sectorSize() const override;
+    uint16_t sectorCount() const override;
+    bool read(uint32_t address, void *data, size_t size) override;
+    bool write(uint32_t address, const void *data, size_t size) override;
+    bool erase(uint16_t sector) override;
+};
+#endif
+
+/**
+ * @brief A parameter image as stored in the log.
+ */
+struct ParameterRecord {
+    uint32_t magic;
+    uint32_t sequence;
+    uint8_t peripheralID;
+    uint8_t model;
+    uint8_t valid;
+    uint8_t reserved;
+    uint16_t base[PARAMETER_BLOCK_BASE_COUNT];
+    uint16_t expert[PARAMETER_BLOCK_EXPERT_COUNT];
+    uint16_t configuration[PARAMETER_BLOCK_CONFIGURATION_COUNT];
+    // CRC-32 of all fields above
+    uint32_t crc;
+};
+
+/**
+ * @brief Keeps the last known good parameter image of each controller in flash,
+ * e.g. to restore the settings after an EEPROM error or a controller swap.
+ * The images are appended to a log that runs through all sectors of the region
+ * in turn, so each sector is only erased once per lap. An image that didn't
+ * change is not written again. Every record carries a CRC, so a record torn
+ * by a power loss is ignored and the previous image of the controller is used.
+ * Before a sector is erased the newest image of each controller that is still
+ * in the sector after it is copied forward, so the newest images survive the laps.
+ */
+class ParameterBackup {
+private:
+    struct Entry {
+        uint8_t peripheralID;
+        uint16_t slot;
+    };
+
+    FlashMemory &_flash;
+    uint16_t _slotsPerSector;
+    uint16_t _slots;
+    uint16_t _head;
+    uint32_t _sequence;
+    // The sector the head was prepared for, 0xFFFF if none
+    uint16_t _openSector;
+
+    Entry _entries[PARAMETER_BACKUP_MAX_CONTROLLERS];
+    uint8_t _entryCount;
+
+    unsigned long _writes;
+    unsigned long _erases;
+
+    static uint32_t crc32(const void *data, size_t size);
+    bool readRecord(uint16_t slot, ParameterRecord &record);
+    Entry *find(uint8_t peripheralID);
+    bool prepareSector(uint16_t sector);
+    bool append(ParameterRecord &record);
+
+public:
+    ParameterBackup(FlashMemory &flash);
+
+    /**
+     * @brief Scans the log for the newest image of each controller.
+     * @return false if the flash can't hold a record.
+     */
+    bool begin();
+
+    /**
+     * @brief Stores the image of a controller if it differs from the stored one.
+     * Only store parameters that were read successfully, not while the controller reports an EEPROM error.
+     * @return 1 if the image was written, 0 if it was unchanged, -1 on failure.
+     */
+    int8_t store(uint8_t peripheralID, PegoModel model, const ControllerParameters &parameters);
+    int8_t store(const PegoController &controller, const ControllerParameters &parameters);
+
+    /**
+     * @brief Loads the stored image of a controller.
+     * @param model Receives the model the image was taken from, may be NULL.
+     * @return false if there is no image.
+     */
+    bool load(uint8_t peripheralID, ControllerParameters &parameters, PegoModel *model = NULL);
+
+    /**
+     * @brief Writes a stored image back to a controller. The current parameters are
+     * read first (one request per block), then only the registers that differ are written.
+     * Blocks the controller doesn't have are skipped.
+     * @param controller The controller to be restored.
+     * @param sourceID The peripheral ID the image was stored for, 0 for the controller's own.
+     * @return The amount of written registers or -1 if there is no image or a transaction failed.
+     */
+    int16_t restore(PegoController &controller, uint8_t sourceID = 0);
+
+    /**
+     * @brief Amount of controllers with a stored image.
+     */
+    uint8_t count() const;
+
+    /**
+     * @brief Amount of records written and sectors erased since start, to estimate the wear.
+     */
+    unsigned long writes() const;
+    unsigned long erases() const;
+};
+
+#endif
@@ -17,12 +17,11 @@ Single input "Discrete Input" | read only | 1-bit 02
  */
 
 #include <ArduinoModbus.h>
+#include <errno.h>
 #include "PegoController.h"
+#include "LoopProfiler.h"
 #include "registerdescriptions-ecp-base.h"
-
-#ifdef ECP_202
 #include "registerdescriptions-ecp-202.h"
-#endif
 
 #ifndef SerialPort
 #define SerialPort Serial
@@ -37,14 +36,130 @@ threshold give the controller a grace period until being considered unresponsive
 #define RESPONSIVENESS_THRESHOLD 300000
 
 PegoController::PegoController( unsigned long baudRate, uint8_t peripheralID, uint16_t serialConfig) : 
-_baudRate(baudRate),
+PegoController(PEGO_DEFAULT_TRANSPORT, baudRate, peripheralID, serialConfig)
+{}
+
+PegoController::PegoController(PegoTransport &transport, unsigned long baudRate, uint8_t peripheralID, uint16_t serialConfig) :
 _peripheralID(peripheralID),
-_serialConfig(serialConfig)
+_transport(&transport),
+_baudRate(baudRate),
+_serialConfig(serialConfig),
+_supervisor(NULL),
+_model(PEGO_MODEL_UNKNOWN),
+_descriptor(&descriptorForModel(PEGO_MODEL_UNKNOWN)),
+_lastError(MODBUS_ERROR_NONE)
 {}
 
 bool PegoController::begin(){
     _lastResponsive = millis();
-    return ModbusRTUClient.begin(_baudRate, _serialConfig);
+    return _transport->begin(_baudRate, _serialConfig);
+}
+
+uint8_t PegoController::peripheralID() const {
+    return _peripheralID;
+}
+
+PegoTransport &PegoController::transport() const {
+    return *_transport;
+}
+
+void PegoController::setBusSupervisor(BusSupervisor *supervisor){
+    _supervisor = supervisor;
+}
+
+void PegoController::reportTransaction(bool success, unsigned long start){
+    int error = success ? 0 : errno;
+    _lastError = decodeModbusError(error);
+    if(_supervisor == NULL) return;
+    _supervisor->report(_peripheralID, success, error, millis() - start);
+}
+
+bool PegoController::registerSupported(unsigned int registerNumber) const {
+    if(_unsupportedRegisters.contains(registerNumber)) return false;
+    if(_model != PEGO_MODEL_ECP_BASE) return true;
+    if(registerNumber >= PARAMETER_BLOCK_EXPERT_FIRST && registerNumber < PARAMETER_BLOCK_EXPERT_FIRST + PARAMETER_BLOCK_EXPERT_COUNT) return false;
+    if(registerNumber >= PARAMETER_BLOCK_CONFIGURATION_FIRST && registerNumber < PARAMETER_BLOCK_CONFIGURATION_FIRST + PARAMETER_BLOCK_CONFIGURATION_COUNT) return false;
+    return true;
+}
+
+int8_t PegoController::probeRegisters(unsigned int registerNumber, uint8_t count){
+    unsigned long start = millis();
+    bool received;
+    {
+        PROFILE_PHASE(LOOP_PHASE_BUS);
+        received = _transport->requestFrom(_peripheralID, HOLDING_REGISTERS, registerNumber, count);
+    }
+    if(received){
+        reportTransaction(true, start);
+        while(_transport->available()) _transport->read();
+        return 1;
+    }
+    reportTransaction(false, start);
+    // An exception response means the controller is there but doesn't know the registers
+    return modbusErrorTransient(_lastError) ? -1 : 0;
+}
+
+PegoModel PegoController::detectModel(bool force){
+    if(_model != PEGO_MODEL_UNKNOWN && !force) return _model;
+
+    int8_t expert = probeRegisters(PARAMETER_BLOCK_EXPERT_FIRST, PARAMETER_BLOCK_EXPERT_COUNT);
+    if(expert == -1) return PEGO_MODEL_UNKNOWN;
+    int8_t configuration = probeRegisters(PARAMETER_BLOCK_CONFIGURATION_FIRST, PARAMETER_BLOCK_CONFIGURATION_COUNT);
+    if(configuration == -1) return PEGO_MODEL_UNKNOWN;
+
+    setModel(expert == 1 && configuration == 1 ? PEGO_MODEL_ECP_202 : PEGO_MODEL_ECP_BASE);
+    #ifdef DEBUG
+    SerialPort.print("Detected controller model: ");
+    SerialPort.println(_descriptor->name);
+    #endif
+    return _model;
+}
+
+PegoModel PegoController::model() const {
+    return _model;
+}
+
+void PegoController::setModel(PegoModel model){
+    // Registers rejected by the previous model may exist on the new one
+    if(model != _model) _unsupportedRegisters.clear();
+    _model = model;
+    _descriptor = &descriptorForModel(model);
+}
+
+const PegoModelDescriptor &PegoController::modelDescriptor() const {
+    return *_descriptor;
+}
+
+void PegoController::setReadCoalescingWindow(unsigned long window){
+    _coalescer.setWindow(window);
+}
+
+void PegoController::clearReadCache(){
+    _coalescer.clear();
+}
+
+unsigned long PegoController::coalescedReads() const {
+    return _coalescer.savedRequests();
+}
+
+ModbusErrorKind PegoController::lastErrorKind() const {
+    return _lastError;
+}
+
+void PegoController::clearUnsupportedRegisters(){
+    _unsupportedRegisters.clear();
+}
+
+uint16_t PegoController::unsupportedRegisterCount() const {
+    return _unsupportedRegisters.count();
+}
+
+bool PegoController::readStatusFlag(RegisterDescription registerEntry, uint16_t mask){
+    // Flags the model doesn't provide are never read
+    if(mask == 0) return false;
+    int16_t value = readModbusRegister(registerEntry);
+    if(value == READ_ERROR) return false;
+    return (value & mask) != 0;
 }
 
 bool PegoController::responsive(){
@@ -63,18 +178,60 @@ int16_t PegoController::convertToSignedValue(uint16_t value, RegisterDescription
   return 0;
 }
 
+bool PegoController::requestRegisters(int type, uint16_t registerNumber, uint8_t count, uint16_t *values){
+    unsigned long start = millis();
+    bool received;
+    {
+        PROFILE_PHASE(LOOP_PHASE_BUS);
+        received = _transport->requestFrom(_peripheralID, type, registerNumber, count);
+    }
+    if (!received) {
+        reportTransaction(false, start);
+        if(_lastError == MODBUS_ERROR_ILLEGAL_ADDRESS){
+            if(count == 1){
+                // Permanently missing on this controller, it won't be requested again
+                _unsupportedRegisters.add(registerNumber);
+                values[0] = READ_ERROR;
+                return false;
+            }
+            // Find out which registers of the block are missing, the others are read in smaller blocks
+            uint8_t half = count / 2;
+            bool first = requestRegisters(type, registerNumber, half, values);
+            bool second = requestRegisters(type, registerNumber + half, count - half, values + half);
+            return first && second;
+        }
+        if(count == 1){
+            SerialPort.print("Failed to read register: ");
+        } else {
+            SerialPort.print("Failed to read registers starting at: ");
+        }
+        SerialPort.println(registerNumber);
+        SerialPort.println(modbusErrorName(_lastError));
+        return false;
+    }
+    reportTransaction(true, start);
+    if(_transport->available() < count){
+        _lastError = MODBUS_ERROR_CORRUPT_FRAME;
+        SerialPort.println(count == 1 ? "No values received." : "Not all values received.");
+        return false;
+    }
+    for(uint8_t i = 0; i < count; ++i){
+        values[i] = _transport->read();
+    }
+    return true;
+}
+
 int16_t PegoController::readModbusRegister(RegisterDescription registerEntry){      
-    if (!ModbusRTUClient.requestFrom(_peripheralID, registerEntry.type, registerEntry.registerNumber, 1 /* Amount of registers */)) {
-        SerialPort.print("Failed to read register: ");
-        SerialPort.println(registerEntry.registerNumber);
-        SerialPort.println(ModbusRTUClient.lastError());
+    if(!registerSupported(registerEntry.registerNumber)){
+        _lastError = MODBUS_ERROR_UNSUPPORTED;
         return READ_ERROR;
     }
-    if(ModbusRTUClient.available() == 0){
-        SerialPort.println("No values received.");
-        return READ_ERROR;
+    uint16_t rawValue;
+    if(_coalescer.lookup(registerEntry.registerNumber, 1, &rawValue)){
+        return convertToSignedValue(rawValue, registerEntry);
     }
-    long rawValue = ModbusRTUClient.read();
+    if(!requestRegisters(registerEntry.type, registerEntry.registerNumber, 1, &rawValue)) return READ_ERROR;
+    _coalescer.store(registerEntry.registerNumber, 1, &rawValue);
     #ifdef DEBUG
         SerialPort.print("RECEIVED BINARY VALUE: ");
         SerialPort.println(rawValue, BIN);    
@@ -82,25 +239,152 @@ int16_t PegoController::readModbusRegister(RegisterDescription registerEntry){
     return convertToSignedValue(rawValue, registerEntry);     
 }
 
+bool PegoController::readModbusRegisters(RegisterDescription registerEntry, uint8_t count, int16_t *values){
+    uint16_t *rawValues = (uint16_t *)values;
+    if(_coalescer.lookup(registerEntry.registerNumber, count, rawValues)){
+        for(uint8_t i = 0; i < count; ++i){
+            values[i] = convertToSignedValue(rawValues[i], registerEntry);
+        }
+        return true;
+    }
+
+    // Registers known to be missing are split out of the block
+    bool complete = true;
+    uint8_t position = 0;
+    while(position < count){
+        if(!registerSupported(registerEntry.registerNumber + position)){
+            values[position++] = READ_ERROR;
+            _lastError = MODBUS_ERROR_UNSUPPORTED;
+            complete = false;
+            continue;
+        }
+        uint8_t length = 1;
+        while(position + length < count && registerSupported(registerEntry.registerNumber + position + length)) ++length;
+        if(requestRegisters(registerEntry.type, registerEntry.registerNumber + position, length, rawValues + position)){
+            for(uint8_t i = position; i < position + length; ++i){
+                values[i] = convertToSignedValue(rawValues[i], registerEntry);
+            }
+        } else {
+            complete = false;
+        }
+        position += length;
+    }
+    if(complete) _coalescer.store(registerEntry.registerNumber, count, rawValues);
+    return complete;
+}
+
+bool PegoController::readSnapshot(ControllerSnapshot &snapshot){
+    int16_t values[3];
+    snapshot.valid = 0;
+    snapshot.ambientTemperature = READ_ERROR;
+    snapshot.evaporatorTemperature = READ_ERROR;
+    snapshot.outputStatus = 0;
+    snapshot.inputStatus = 0;
+    snapshot.alarmStatus = 0;
+    snapshot.deviceStatus = 0;
+    // Filled in by an AuxiliarySampler afterwards, if there is one
+    memset(snapshot.auxiliaryLevels, AUXILIARY_LEVEL_UNKNOWN, sizeof(snapshot.auxiliaryLevels));
+    snapshot.auxiliaryStates = 0;
+
+    // 256 - 257: ambient and evaporator temperature
+    if(readModbusRegisters(ambientTemperatureRegister, 2, values)){
+        snapshot.ambientTemperature = values[0];
+        snapshot.evaporatorTemperature = values[1];
+        snapshot.valid |= SNAPSHOT_TEMPERATURES_VALID;
+    }
+
+    // 1280 - 1282: output, input and alarm status
+    if(readModbusRegisters(outputStatusRegister, 3, values)){
+        snapshot.outputStatus = values[0];
+        snapshot.inputStatus = values[1];
+        snapshot.alarmStatus = values[2];
+        snapshot.valid |= SNAPSHOT_STATUS_VALID;
+    }
+
+    // 1536: device status
+    if(readModbusRegisters(deviceStatusRegister, 1, values)){
+        snapshot.deviceStatus = values[0];
+        snapshot.valid |= SNAPSHOT_DEVICE_STATUS_VALID;
+    }
+
+    snapshot.model = _model;
+    snapshot.timestamp = millis();
+    if(snapshot.valid != 0) _lastResponsive = snapshot.timestamp;
+    snapshot.responsive = snapshot.timestamp - _lastResponsive < RESPONSIVENESS_THRESHOLD;
+    return snapshot.valid != 0;
+}
+
+bool PegoController::readParameters(ControllerParameters &parameters){
+    parameters.valid = 0;
+    PegoModel model = detectModel();
+    bool complete = true;
+
+    RegisterDescription baseBlock = {HOLDING_REGISTERS, PARAMETER_BLOCK_BASE_FIRST, false, 1};
+    if(readModbusRegisters(baseBlock, PARAMETER_BLOCK_BASE_COUNT, (int16_t *)parameters.base)){
+        parameters.valid |= PARAMETERS_BASE_VALID;
+    } else {
+        complete = false;
+    }
+
+    // The expert ranges are only part of the plan if the model has them
+    if(model == PEGO_MODEL_ECP_BASE) return complete;
+
+    RegisterDescription expertBlock = {HOLDING_REGISTERS, PARAMETER_BLOCK_EXPERT_FIRST, false, 1};
+    if(readModbusRegisters(expertBlock, PARAMETER_BLOCK_EXPERT_COUNT, (int16_t *)parameters.expert)){
+        parameters.valid |= PARAMETERS_EXPERT_VALID;
+    } else {
+        complete = false;
+    }
+
+    RegisterDescription configurationBlock = {HOLDING_REGISTERS, PARAMETER_BLOCK_CONFIGURATION_FIRST, false, 1};
+    if(readModbusRegisters(configurationBlock, PARAMETER_BLOCK_CONFIGURATION_COUNT, (int16_t *)parameters.configuration)){
+        parameters.valid |= PARAMETERS_CONFIGURATION_VALID;
+    } else {
+        complete = false;
+    }
+    return complete;
+}
+
 bool PegoController::writeModbusRegister(RegisterDescription registerEntry, int16_t value){
     #ifdef DEBUG
     SerialPort.print("SENDING BINARY VALUE: ");
     SerialPort.println(value, BIN);    
     #endif
     
-    if(!ModbusRTUClient.beginTransmission(_peripheralID, registerEntry.type, registerEntry.registerNumber, 1)){
+    if(!registerSupported(registerEntry.registerNumber)){
+        _lastError = MODBUS_ERROR_UNSUPPORTED;
+        return false;
+    }
+    // The register holds the new value or, if the write failed, an unknown one
+    _coalescer.invalidate(registerEntry.registerNumber);
+    if(registerEntry.registerNumber == deviceStatusRegister.registerNumber){
+        // Stand-by, light key and defrost forcing switch relays and may raise or clear alarms
+        _coalescer.invalidate(outputStatusRegister.registerNumber);
+        _coalescer.invalidate(inputStatusRegister.registerNumber);
+        _coalescer.invalidate(alarmStatusRegister.registerNumber);
+    }
+    unsigned long start = millis();
+    if(!_transport->beginTransmission(_peripheralID, registerEntry.type, registerEntry.registerNumber, 1)){
+        reportTransaction(false, start);
         SerialPort.print("Writed operation failed: ");
-        SerialPort.println(ModbusRTUClient.lastError());
+        SerialPort.println(modbusErrorName(_lastError));
         return false;
     };
 
-    ModbusRTUClient.write(value);
+    _transport->write(value);
 
-    if (!ModbusRTUClient.endTransmission()) {
+    bool sent;
+    {
+        PROFILE_PHASE(LOOP_PHASE_BUS);
+        sent = _transport->endTransmission();
+    }
+    if (!sent) {
+        reportTransaction(false, start);
         SerialPort.print("Write operation failed: ");
-        SerialPort.println(ModbusRTUClient.lastError());
+        SerialPort.println(modbusErrorName(_lastError));
         return false;
     } else {
+        reportTransaction(true, start);
         #ifdef DEBUG
         SerialPort.println("Write operation successful.");
         #endif
@@ -327,8 +611,6 @@ bool PegoController::setTemperatureSetPointMaximumLimit(int16_t value){
     return writeModbusRegister(temperatureSetPointMaximumLimitRegister, value);
 };
 
-#ifdef ECP_202
-
 int16_t PegoController::getTemperatureSettingForAuxRelay(){
     return readModbusRegister(temperatureSettingForAuxRelayRegister);
 };
@@ -440,158 +722,142 @@ int16_t PegoController::getAuxiliaryRelay2Control(){
     return readModbusRegister(auxiliaryRelay2ControlRegister);
 };
 
-#endif
-
 
 // INPUTS / OUTPUTS / ALARMS STATUS REGISTERS
 
+int16_t PegoController::getOutputStatus(){
+    return readModbusRegister(outputStatusRegister);
+};
+
+int16_t PegoController::getInputStatus(){
+    return readModbusRegister(inputStatusRegister);
+};
+
+int16_t PegoController::getAlarmStatus(){
+    return readModbusRegister(alarmStatusRegister);
+};
+
+int16_t PegoController::getDeviceStatus(){
+    return readModbusRegister(deviceStatusRegister);
+};
+
 // # Output Status Register
 
-#ifdef ECP_202
 bool PegoController::getHotResistanceStatus(){
-    int16_t outputStatus = readModbusRegister(outputStatusRegister);
-    return getLSByteBit(outputStatus, 6) == 1;
+    return readStatusFlag(outputStatusRegister, _descriptor->outputStatusMask & bit(OUTPUT_STATUS_HOT_RESISTANCE_BIT));
 };
 
 bool PegoController::getStandByStatus(){
-    int16_t outputStatus = readModbusRegister(outputStatusRegister);
-    return getLSByteBit(outputStatus, 5) == 1;
+    return readStatusFlag(outputStatusRegister, _descriptor->outputStatusMask & bit(OUTPUT_STATUS_STAND_BY_BIT));
 };
-#endif
 
 bool PegoController::getDrippingStatus(){
     int16_t outputStatus = readModbusRegister(outputStatusRegister);
-    return getLSByteBit(outputStatus, 4) == 1;
+    return getLSByteBit(outputStatus, OUTPUT_STATUS_DRIPPING_BIT) == 1;
 };
 
 bool PegoController::getColdRoomLightRelayStatus(){
     int16_t outputStatus = readModbusRegister(outputStatusRegister);
-    return getLSByteBit(outputStatus, 3) == 1;
+    return getLSByteBit(outputStatus, OUTPUT_STATUS_COLD_ROOM_LIGHT_RELAY_BIT) == 1;
 };
 
 bool PegoController::getFansRelayStatus(){
     int16_t outputStatus = readModbusRegister(outputStatusRegister);
-    return getLSByteBit(outputStatus, 2) == 1;
+    return getLSByteBit(outputStatus, OUTPUT_STATUS_FANS_RELAY_BIT) == 1;
 };
 
 bool PegoController::getDefrostRelayStatus(){
     int16_t outputStatus = readModbusRegister(outputStatusRegister);
-    return getLSByteBit(outputStatus, 1) == 1;
+    return getLSByteBit(outputStatus, OUTPUT_STATUS_DEFROST_RELAY_BIT) == 1;
 };
 
 bool PegoController::getCompressorRelayStatus(){
     int16_t outputStatus = readModbusRegister(outputStatusRegister);
-    return getLSByteBit(outputStatus, 0) == 1;
+    return getLSByteBit(outputStatus, OUTPUT_STATUS_COMPRESSOR_RELAY_BIT) == 1;
 };
 
 
 // # Input Status Register
 
-#ifdef ECP_202
 bool PegoController::getNightDigitalInputStatus(){
-    int16_t inputStatus = readModbusRegister(inputStatusRegister);
-    return getLSByteBit(inputStatus, 7) == 1;
+    return readStatusFlag(inputStatusRegister, _descriptor->inputStatusMask & bit(INPUT_STATUS_NIGHT_DIGITAL_INPUT_BIT));
 };
 
 bool PegoController::getRemoteStopDefrostStatus(){
-    int16_t inputStatus = readModbusRegister(inputStatusRegister);
-    return getLSByteBit(inputStatus, 6) == 1;
+    return readStatusFlag(inputStatusRegister, _descriptor->inputStatusMask & bit(INPUT_STATUS_REMOTE_STOP_DEFROST_BIT));
 };
 
 bool PegoController::getRemoteStartDefrostStatus(){
-    int16_t inputStatus = readModbusRegister(inputStatusRegister);
-    return getLSByteBit(inputStatus, 5) == 1;
+    return readStatusFlag(inputStatusRegister, _descriptor->inputStatusMask & bit(INPUT_STATUS_REMOTE_START_DEFROST_BIT));
 };
 
 bool PegoController::getRemoteStandByStatus(){
-    int16_t inputStatus = readModbusRegister(inputStatusRegister);
-    return getLSByteBit(inputStatus, 4) == 1;
+    return readStatusFlag(inputStatusRegister, _descriptor->inputStatusMask & bit(INPUT_STATUS_REMOTE_STAND_BY_BIT));
 };
 
 bool PegoController::getPumpDownInputStatus(){
-    int16_t inputStatus = readModbusRegister(inputStatusRegister);
-    return getLSByteBit(inputStatus, 3) == 1;
+    return readStatusFlag(inputStatusRegister, _descriptor->inputStatusMask & bit(INPUT_STATUS_PUMP_DOWN_BIT));
 };
-#endif
 
 bool PegoController::getManInColdRoomAlarmStatus(){
     int16_t inputStatus = readModbusRegister(inputStatusRegister);
-    return getLSByteBit(inputStatus, 2) == 1;
+    return getLSByteBit(inputStatus, INPUT_STATUS_MAN_IN_COLD_ROOM_ALARM_BIT) == 1;
 };
 
 bool PegoController::getCompressorProtectionStatus(){
     int16_t inputStatus = readModbusRegister(inputStatusRegister);
-    return getLSByteBit(inputStatus, 1) == 1;
+    return getLSByteBit(inputStatus, INPUT_STATUS_COMPRESSOR_PROTECTION_BIT) == 1;
 };
 
 bool PegoController::getDoorSwitchStatus(){
     int16_t inputStatus = readModbusRegister(inputStatusRegister);
-    return getLSByteBit(inputStatus, 0) == 1;
+    return getLSByteBit(inputStatus, INPUT_STATUS_DOOR_SWITCH_BIT) == 1;
 };
 
 
 // # Alarm Status Register
 
-#ifdef ECP_202
 bool PegoController::getLightAlarmStatus(){
-    int16_t alarmStatus = readModbusRegister(alarmStatusRegister);
-    return getMSByteBit(alarmStatus, 1) == 1;
+    return readStatusFlag(alarmStatusRegister, _descriptor->lightAlarmMask);
 };
 
 bool PegoController::getCompressorProtectionAlarmStatus(){
-    int16_t alarmStatus = readModbusRegister(alarmStatusRegister);
-    return getMSByteBit(alarmStatus, 0) == 1;
+    return readStatusFlag(alarmStatusRegister, _descriptor->compressorProtectionAlarmMask);
 };
 
 bool PegoController::getManInRoomAlarmStatus(){
-    int16_t alarmStatus = readModbusRegister(alarmStatusRegister);
-    return getLSByteBit(alarmStatus, 7) == 1;
+    return readStatusFlag(alarmStatusRegister, _descriptor->manInRoomAlarmMask);
 };
 
 bool PegoController::getOpenDoorAlarmStatus(){
-    int16_t alarmStatus = readModbusRegister(alarmStatusRegister);
-    return getLSByteBit(alarmStatus, 6) == 1;
+    return readStatusFlag(alarmStatusRegister, _descriptor->openDoorAlarmMask);
 };
 
 bool PegoController::getLowTemperatureAlarmStatus(){
-    int16_t alarmStatus = readModbusRegister(alarmStatusRegister);
-    return getLSByteBit(alarmStatus, 5) == 1;
+    return readStatusFlag(alarmStatusRegister, _descriptor->lowTemperatureAlarmMask);
 };
 
 bool PegoController::getHighTemperatureAlarmStatus(){
-    int16_t alarmStatus = readModbusRegister(alarmStatusRegister);
-    return getLSByteBit(alarmStatus, 4) == 1;
+    return readStatusFlag(alarmStatusRegister, _descriptor->highTemperatureAlarmMask);
 };
 
 bool PegoController::getTemperatureAlarmStatus(){
-    return getLowTemperatureAlarmStatus() || getHighTemperatureAlarmStatus();
+    return readStatusFlag(alarmStatusRegister, _descriptor->temperatureAlarmMask);
 };
 
-#else
-bool PegoController::getOpenDoorAlarmStatus(){
-    int16_t alarmStatus = readModbusRegister(alarmStatusRegister);
-    return getLSByteBit(alarmStatus, 4) == 1;
-};
-
-bool PegoController::getTemperatureAlarmStatus(){
-    int16_t alarmStatus = readModbusRegister(alarmStatusRegister);
-    return getLSByteBit(alarmStatus, 3) == 1;
-};
-#endif
-
 bool PegoController::getEEPROMErrorStatus(){
     int16_t alarmStatus = readModbusRegister(alarmStatusRegister);
-    return getLSByteBit(alarmStatus, 2) == 1;
+    return getLSByteBit(alarmStatus, ALARM_STATUS_EEPROM_ERROR_BIT) == 1;
 };
 
 bool PegoController::getEvaporatorProbeFaultStatus(){
     int16_t alarmStatus = readModbusRegister(alarmStatusRegister);
-    return getLSByteBit(alarmStatus, 1) == 1;
+    return getLSByteBit(alarmStatus, ALARM_STATUS_EVAPORATOR_PROBE_FAULT_BIT) == 1;
 };
 
 bool PegoController::getAmbientProbeFaultStatus(){
     int16_t alarmStatus = readModbusRegister(alarmStatusRegister);
-    return getLSByteBit(alarmStatus, 0) == 1;
+    return getLSByteBit(alarmStatus, ALARM_STATUS_AMBIENT_PROBE_FAULT_BIT) == 1;
 };
 
 // DEVICE STATUS
@@ -599,36 +865,36 @@ bool PegoController::getAmbientProbeFaultStatus(){
 
 bool PegoController::getDefrostForcingStatus(){
     int16_t deviceStatus = readModbusRegister(deviceStatusRegister);
-    return getLSByteBit(deviceStatus, 2) == 1;
+    return getLSByteBit(deviceStatus, DEVICE_STATUS_DEFROST_FORCING_BIT) == 1;
 };
 
 bool PegoController::setDefrostForcingStatus(bool value){
     int16_t registerValue = 0;
-    setMSByteBit(&registerValue, 2);
-    if(value) setLSByteBit(&registerValue, 2); // 1 = defrost, 0 = non‐defrost
+    setMSByteBit(&registerValue, DEVICE_STATUS_DEFROST_FORCING_BIT);
+    if(value) setLSByteBit(&registerValue, DEVICE_STATUS_DEFROST_FORCING_BIT); // 1 = defrost, 0 = non‐defrost
     return writeModbusRegister(deviceStatusRegister, registerValue);
 };
 
 bool PegoController::getColdRoomLightKeyStatus(){
     int16_t deviceStatus = readModbusRegister(deviceStatusRegister);
-    return getLSByteBit(deviceStatus, 1) == 1;
+    return getLSByteBit(deviceStatus, DEVICE_STATUS_COLD_ROOM_LIGHT_KEY_BIT) == 1;
 };
 
 bool PegoController::setColdRoomLightKeyStatus(bool value){
     int16_t registerValue = 0;
-    setMSByteBit(&registerValue, 1);
-    if(value) setLSByteBit(&registerValue, 1); // 1 = active cold room light, 0 = non‐active cold room light
+    setMSByteBit(&registerValue, DEVICE_STATUS_COLD_ROOM_LIGHT_KEY_BIT);
+    if(value) setLSByteBit(&registerValue, DEVICE_STATUS_COLD_ROOM_LIGHT_KEY_BIT); // 1 = active cold room light, 0 = non‐active cold room light
     return writeModbusRegister(deviceStatusRegister, registerValue);
 };
 
 bool PegoController::getDeviceStandByStatus(){
     int16_t deviceStatus = readModbusRegister(deviceStatusRegister);
-    return getLSByteBit(deviceStatus, 0) == 1;
+    return getLSByteBit(deviceStatus, DEVICE_STATUS_STAND_BY_BIT) == 1;
 };
 
 bool PegoController::setDeviceStandByStatus(bool value){
     int16_t registerValue = 0;
-    setMSByteBit(&registerValue, 0);
-    if(value) setLSByteBit(&registerValue, 0); // 0 = ON, 1 = stand‐by
+    setMSByteBit(&registerValue, DEVICE_STATUS_STAND_BY_BIT);
+    if(value) setLSByteBit(&registerValue, DEVICE_STATUS_STAND_BY_BIT); // 0 = ON, 1 = stand‐by
     return writeModbusRegister(deviceStatusRegister, registerValue);
 };
@@ -1,4 +1,14 @@
+#ifndef PEGO_CONTROLLER_H
+#define PEGO_CONTROLLER_H
+
 #include "RegisterDescription.h"
+#include "PegoTransport.h"
+#include "ControllerSnapshot.h"
+#include "ControllerParameters.h"
+#include "BusSupervisor.h"
+#include "ReadCoalescer.h"
+#include "ModbusError.h"
+#include "UnsupportedRegisterCache.h"
 #include <limits.h>
 #include <float.h>
 #include <Arduino.h>
@@ -10,7 +20,15 @@
 #define READ_ERROR_FLOAT FLT_MIN
 
 #define DEFAULT_PERIPHERAL_ID 1
-#define ECP_202 // Enables the ECP 202 base features
+// Default model assumed until the model is detected or set. For a fleet of
+// ECP base controllers pass -DECP_BASE as a build flag, so that the sketch and
+// the library sources agree.
+#if !defined(ECP_202) && !defined(ECP_BASE)
+#define ECP_202
+#endif
+
+#include "StatusBits.h"
+#include "PegoModel.h"
 
 class PegoController {
 private:
@@ -19,12 +37,66 @@ private:
 
     unsigned long _lastResponsive;
 
+    // The Modbus client of the bus the controller is connected to
+    PegoTransport *_transport;
+
     // The baud rate for the RS485 connection
     unsigned long _baudRate;
 
     // The serial configuration for the RS485 connection
     uint16_t _serialConfig;
 
+    // Optional supervisor that is informed about the outcome of every transaction
+    BusSupervisor *_supervisor;
+
+    // The detected (or configured) controller model
+    PegoModel _model;
+
+    // Decoding table of the model, selected once when the model changes
+    const PegoModelDescriptor *_descriptor;
+
+    // Recently read register values shared by reads within the coalescing window
+    ReadCoalescer _coalescer;
+
+    // Registers the controller answered with an "illegal data address" exception
+    UnsupportedRegisterCache _unsupportedRegisters;
+
+    // Outcome of the last transaction
+    ModbusErrorKind _lastError;
+
+    /**
+     * @brief Reads a block of registers in one request. If the controller rejects the block
+     * because of a missing register, the block is split to find the missing registers,
+     * which are remembered and set to READ_ERROR.
+     * @return true if all values were received.
+     */
+    bool requestRegisters(int type, uint16_t registerNumber, uint8_t count, uint16_t *values);
+
+    /**
+     * @brief Reads a status register and tests the given bit mask.
+     * @return false if the mask is 0 (flag not provided by the model) or the read failed.
+     */
+    bool readStatusFlag(RegisterDescription description, uint16_t mask);
+
+    /**
+     * @brief Tells whether a register exists on the detected model and wasn't rejected by the controller.
+     * Registers of an unknown model are assumed to exist.
+     */
+    bool registerSupported(unsigned int registerNumber) const;
+
+    /**
+     * @brief Probes a register block that only exists on some models.
+     * @return 1 if the block exists, 0 if the controller rejected it, -1 if the probe failed.
+     */
+    int8_t probeRegisters(unsigned int registerNumber, uint8_t count);
+
+    /**
+     * @brief Informs the bus supervisor (if any) about the outcome of a transaction.
+     * @param success Whether the transaction succeeded.
+     * @param start The millis() value at the start of the transaction.
+     */
+    void reportTransaction(bool success, unsigned long start);
+
     /**
      * @brief Returns the requested bit from the least significant byte (little endian)     
      * @param value A two byte (word) value
@@ -75,6 +147,16 @@ public:
      * @param serialConfig The serial configuration to be used with ArduinoModbus. Default: SERIAL_8N1 @see https://www.arduino.cc/en/ArduinoModbus/ArduinoModbus
      */
     PegoController(unsigned long baudRate = RS485_DEFAULT_BAUD_RATE, uint8_t peripheralID = DEFAULT_PERIPHERAL_ID, uint16_t serialConfig = RS485_DEFAULT_SERIAL_CONFIG);    
+
+    /**
+     * @brief Construct a new Pego Controller object on a bus of its own.
+     * Controllers bound to different transports can be polled independently.
+     * @param transport The Modbus client of the bus, e.g. a ModbusRTUClientClass using another RS485Class.
+     * @param baudRate The baud rate to be used for the serial communication. Default: 9600
+     * @param peripheralID The ModBus server ID / peripheral ID of the Pego device. Default: 1
+     * @param serialConfig The serial configuration to be used with ArduinoModbus. Default: SERIAL_8N1
+     */
+    PegoController(PegoTransport &transport, unsigned long baudRate = RS485_DEFAULT_BAUD_RATE, uint8_t peripheralID = DEFAULT_PERIPHERAL_ID, uint16_t serialConfig = RS485_DEFAULT_SERIAL_CONFIG);
     
     /**
      * @brief Starts the communication with the Pego controller device over ModBus.
@@ -83,6 +165,86 @@ public:
      */
     bool begin();
 
+    /**
+     * @brief Returns the ModBus server ID / peripheral ID of the device.
+     */
+    uint8_t peripheralID() const;
+
+    /**
+     * @brief Returns the Modbus client of the bus the controller is connected to.
+     */
+    PegoTransport &transport() const;
+
+    /**
+     * @brief Attaches a bus supervisor that restarts the Modbus client when the bus gets wedged.
+     * The same supervisor should be attached to all controllers sharing the bus.
+     * @param supervisor The supervisor or NULL to detach it.
+     */
+    void setBusSupervisor(BusSupervisor *supervisor);
+
+    /**
+     * @brief Detects the controller model by probing the 789..798 and 512..518 register ranges.
+     * The result is cached, so subsequent calls don't touch the bus.
+     * Registers that don't exist on the detected model are never queried again,
+     * the corresponding getters return READ_ERROR right away.
+     * @param force Probe again even if the model is already known.
+     * @return The detected model or PEGO_MODEL_UNKNOWN if the controller didn't answer.
+     */
+    PegoModel detectModel(bool force = false);
+
+    /**
+     * @brief Returns the cached controller model without touching the bus.
+     */
+    PegoModel model() const;
+
+    /**
+     * @brief Sets the controller model, e.g. from a configuration, to skip the detection.
+     */
+    void setModel(PegoModel model);
+
+    /**
+     * @brief Returns the decoding table of the current model.
+     * Use it to decode raw status words, e.g. from a ControllerSnapshot.
+     */
+    const PegoModelDescriptor &modelDescriptor() const;
+
+    /**
+     * @brief Lets reads of the same register within the given window share a single transaction.
+     * Useful when several consumers call the same getters independently, e.g. a display,
+     * the alarm logic and the cloud sync. Values from block reads such as readSnapshot()
+     * are shared too, so getters called right after a snapshot don't touch the bus.
+     * Writes invalidate the written register.
+     * @param window The freshness window in ms. 0 (default) disables coalescing.
+     */
+    void setReadCoalescingWindow(unsigned long window);
+
+    /**
+     * @brief Forgets all shared register values, so the next reads go to the bus.
+     */
+    void clearReadCache();
+
+    /**
+     * @brief Amount of reads that were answered with a shared value instead of a transaction.
+     */
+    unsigned long coalescedReads() const;
+
+    /**
+     * @brief Returns why the last transaction failed.
+     * MODBUS_ERROR_UNSUPPORTED means that no request was sent because the register is known to be missing.
+     */
+    ModbusErrorKind lastErrorKind() const;
+
+    /**
+     * @brief Forgets the registers the controller rejected, so they are requested again.
+     * This happens automatically when the model changes.
+     */
+    void clearUnsupportedRegisters();
+
+    /**
+     * @brief Amount of registers known to be missing on the controller.
+     */
+    uint16_t unsupportedRegisterCount() const;
+
     /**
      * @brief Executed a dummy read request to figure out if the device is responsive.
      * @return true if the device responded to the request, false otherwise.
@@ -97,6 +259,36 @@ public:
      */
     int16_t readModbusRegister(RegisterDescription description);
 
+    /**
+     * @brief Reads a block of consecutive registers in a single request.
+     * The signed conversion of the given description is applied to all values.
+     * Registers known to be missing on the controller are split out of the request and set to READ_ERROR.
+     * Note that this function does not apply any multiplication factor.
+     * @param description The description of the first register of the block.
+     * @param count The amount of consecutive registers to read.
+     * @param values Buffer receiving at least count values.
+     * @return true if all values were received, false if at least one is missing.
+     */
+    bool readModbusRegisters(RegisterDescription description, uint8_t count, int16_t *values);
+
+    /**
+     * @brief Reads the temperatures and all status registers using block reads.
+     * This needs three requests instead of one request per value or status bit.
+     * Parts that couldn't be read are flagged in snapshot.valid and hold READ_ERROR
+     * temperatures and zero status words. The auxiliary values are reset to unknown.
+     * @param snapshot The snapshot to fill in.
+     * @return true if at least one part of the snapshot could be read.
+     */
+    bool readSnapshot(ControllerSnapshot &snapshot);
+
+    /**
+     * @brief Reads all parameter registers using one block read per register range.
+     * Detects the model first if necessary and only reads the ranges it supports.
+     * @param parameters The parameters to fill in. Missing blocks are flagged in parameters.valid.
+     * @return true if all blocks supported by the model could be read.
+     */
+    bool readParameters(ControllerParameters &parameters);
+
     /**
      * @brief Writes a word (2byte) value to the device's register.
      * Note that this function does not apply any multiplication factor.
@@ -434,7 +626,8 @@ public:
     int16_t getTemperatureSetPointMaximumLimit();
     bool setTemperatureSetPointMaximumLimit(int16_t value);
 
-    #ifdef ECP_202
+    // ECP 202 only. On other models the getters return READ_ERROR and the setters false
+    // without touching the bus once the model is known.
     
     /**
     * @brief brief description
@@ -617,16 +810,44 @@ public:
     */
     int16_t getAuxiliaryRelay2Control();
 
-    #endif
 
 
     // INPUTS / OUTPUTS / ALARMS STATUS REGISTERS
 
+    /**
+     * @brief Reads the raw Output Status Register (1280) in a single request.
+     * Use bitRead() together with the OUTPUT_STATUS_* constants from StatusBits.h
+     * to decode several flags without reading the register again for each one.
+     * @return The register word or READ_ERROR if the read failed.
+     */
+    int16_t getOutputStatus();
+
+    /**
+     * @brief Reads the raw Input Status Register (1281) in a single request.
+     * Decode it with the INPUT_STATUS_* constants from StatusBits.h.
+     * @return The register word or READ_ERROR if the read failed.
+     */
+    int16_t getInputStatus();
+
+    /**
+     * @brief Reads the raw Alarm Status Register (1282) in a single request.
+     * Decode it with the ALARM_STATUS_* constants from StatusBits.h.
+     * @return The register word or READ_ERROR if the read failed.
+     */
+    int16_t getAlarmStatus();
+
+    /**
+     * @brief Reads the raw Device Status Register (1536) in a single request.
+     * Decode it with the DEVICE_STATUS_* constants from StatusBits.h.
+     * @return The register word or READ_ERROR if the read failed.
+     */
+    int16_t getDeviceStatus();
+
     // # Output Status Register
-    #ifdef ECP_202
+
+    // ECP 202 only, false on other models
     bool getHotResistanceStatus();
     bool getStandByStatus();
-    #endif
 
     bool getDrippingStatus();
     bool getColdRoomLightRelayStatus();
@@ -637,14 +858,13 @@ public:
 
     // # Input Status Register
 
-    #ifdef ECP_202
+    // ECP 202 only, false on other models
     //  (energy saving)
     bool getNightDigitalInputStatus();
     bool getRemoteStopDefrostStatus();
     bool getRemoteStartDefrostStatus();
     bool getRemoteStandByStatus();
     bool getPumpDownInputStatus();
-    #endif
 
     // Status Code: (E8)
     bool getManInColdRoomAlarmStatus();
@@ -661,7 +881,7 @@ public:
 
     // # Alarm Status Register
 
-    #ifdef ECP_202
+    // ECP 202 only, false on other models
     // Status Code: (E9)
     bool getLightAlarmStatus();
 
@@ -676,7 +896,6 @@ public:
     
     // Status Code: (EH)
     bool getHighTemperatureAlarmStatus();
-    #endif
 
     /**
      * @brief Get the status of the Temperature Alarm
@@ -715,3 +934,5 @@ public:
     bool getDeviceStandByStatus();
     bool setDeviceStandByStatus(bool value);
 };
+
+#endif
@@ -0,0 +1,51 @@
+#include "PegoController.h"
+#include "PegoModel.h"
+
+const PegoModelDescriptor ecpBaseModelDescriptor = {
+    PEGO_MODEL_ECP_BASE,
+    "ECP base",
+    // Output status: compressor, defrost, fans, light, dripping
+    0x001F,
+    // Input status: door switch, compressor protection, man in cold room
+    0x0007,
+    bit(ALARM_STATUS_ECP_BASE_TEMPERATURE_BIT),
+    0,
+    0,
+    bit(ALARM_STATUS_ECP_BASE_OPEN_DOOR_BIT),
+    0,
+    0,
+    0,
+    false
+};
+
+const PegoModelDescriptor ecp202ModelDescriptor = {
+    PEGO_MODEL_ECP_202,
+    "ECP 202",
+    // Output status: additionally stand-by and hot resistance
+    0x007F,
+    // Input status: additionally pump down, remote stand-by / defrost and night input
+    0x00FF,
+    bit(ALARM_STATUS_HIGH_TEMPERATURE_BIT) | bit(ALARM_STATUS_LOW_TEMPERATURE_BIT),
+    bit(ALARM_STATUS_HIGH_TEMPERATURE_BIT),
+    bit(ALARM_STATUS_LOW_TEMPERATURE_BIT),
+    bit(ALARM_STATUS_OPEN_DOOR_BIT),
+    bit(ALARM_STATUS_MAN_IN_ROOM_BIT),
+    bit(ALARM_STATUS_COMPRESSOR_PROTECTION_BIT),
+    bit(ALARM_STATUS_LIGHT_BIT),
+    true
+};
+
+const PegoModelDescriptor &descriptorForModel(PegoModel model){
+    switch(model){
+        case PEGO_MODEL_ECP_BASE:
+            return ecpBaseModelDescriptor;
+        case PEGO_MODEL_ECP_202:
+            return ecp202ModelDescriptor;
+        default:
+            #ifdef ECP_202
+            return ecp202ModelDescriptor;
+            #else
+            return ecpBaseModelDescriptor;
+            #endif
+    }
+}
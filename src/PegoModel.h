@@ -0,0 +1,56 @@
+#ifndef PEGO_MODEL_H
+#define PEGO_MODEL_H
+
+#include <Arduino.h>
+#include "StatusBits.h"
+
+/**
+ * @brief The controller model as detected by probing the register map.
+ */
+enum PegoModel : uint8_t {
+    // Not detected yet or the controller didn't answer the probe
+    PEGO_MODEL_UNKNOWN = 0,
+    // ECP base / ECP expert: no registers beyond 788
+    PEGO_MODEL_ECP_BASE,
+    // ECP 202: additional parameters 789..798 and configuration registers 512..518
+    PEGO_MODEL_ECP_202
+};
+
+/**
+ * @brief Describes how the status registers of a model are decoded.
+ * Each field is a bit mask for the raw register word. A mask of 0 means
+ * that the model doesn't provide the flag. The tables are plain data,
+ * so decoding a flag is a single AND without any dispatch.
+ */
+struct PegoModelDescriptor {
+    PegoModel model;
+    const char *name;
+
+    // Bits of the Output and Input Status Register that are defined for the model
+    uint16_t outputStatusMask;
+    uint16_t inputStatusMask;
+
+    // Alarm Status Register
+    uint16_t temperatureAlarmMask;
+    uint16_t highTemperatureAlarmMask;
+    uint16_t lowTemperatureAlarmMask;
+    uint16_t openDoorAlarmMask;
+    uint16_t manInRoomAlarmMask;
+    uint16_t compressorProtectionAlarmMask;
+    uint16_t lightAlarmMask;
+
+    // Whether the parameter registers 789..798 and 512..518 exist
+    bool expertRegisters;
+};
+
+extern const PegoModelDescriptor ecpBaseModelDescriptor;
+extern const PegoModelDescriptor ecp202ModelDescriptor;
+
+/**
+ * @brief Returns the decoding table for a model.
+ * PEGO_MODEL_UNKNOWN maps to the default model, which is the ECP 202
+ * unless the library is built with -DECP_BASE, see PegoController.h.
+ */
+const PegoModelDescriptor &descriptorForModel(PegoModel model);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef PEGO_TRANSPORT_H
+#define PEGO_TRANSPORT_H
+
+#include <ArduinoModbus.h>
+
+/*
+The Modbus client class that all bus I/O of the library goes through.
+It is selected at compile time, so every request is a direct member call
+without a vtable. Any class with these members of the ArduinoModbus client
+API can be used, e.g. a mock or an adapter around a Modbus TCP client:
+
+    int begin(unsigned long baudRate, uint16_t serialConfig);
+    void end();
+    void setTimeout(unsigned long timeout);
+    int requestFrom(int id, int type, int address, int nb);
+    int available();
+    long read();
+    int beginTransmission(int id, int type, int address, int nb);
+    int write(unsigned int value);
+    int endTransmission();
+    const char *lastError();
+
+Select another class only with build flags, e.g. with --build-property
+"compiler.cpp.extra_flags=-DPEGO_TRANSPORT=<class> -DPEGO_DEFAULT_TRANSPORT=<instance>
+-include <header>", where the header declares both. Defining them in the sketch
+doesn't work, as the library is compiled separately and the sketch and the
+library would disagree on the layout of PegoController.
+
+There is one transport class per build. Several buses run side by side with
+one instance of it each, e.g. a ModbusRTUClientClass constructed with the
+RS485Class of another SERCOM UART, but a mock and a real client, or an RTU and
+a TCP client, can't be mixed in one build.
+*/
+
+#ifndef PEGO_TRANSPORT
+#define PEGO_TRANSPORT ModbusRTUClientClass
+#endif
+
+// The instance used by everything that isn't bound to a transport explicitly
+#ifndef PEGO_DEFAULT_TRANSPORT
+#define PEGO_DEFAULT_TRANSPORT ModbusRTUClient
+#endif
+
+typedef PEGO_TRANSPORT PegoTransport;
+
+#endif
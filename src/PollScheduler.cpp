@@ -0,0 +1,132 @@
+#include "PollScheduler.h"
+
+PollScheduler::PollScheduler(unsigned long pollInterval, unsigned long parameterInterval) :
+_count(0),
+_pollInterval(pollInterval),
+_parameterInterval(parameterInterval),
+_polls(0)
+{}
+
+bool PollScheduler::add(PegoController &controller){
+    if(_count >= POLL_SCHEDULER_MAX_CONTROLLERS) return false;
+    Entry &entry = _entries[_count++];
+    entry.controller = &controller;
+    memset(&entry.snapshot, 0, sizeof(entry.snapshot));
+    entry.snapshot.ambientTemperature = READ_ERROR;
+    entry.snapshot.evaporatorTemperature = READ_ERROR;
+    entry.parameters.valid = 0;
+    entry.lastPoll = 0;
+    entry.lastParameterRead = 0;
+    entry.polled = false;
+    entry.parametersRead = false;
+    entry.pollRequested = false;
+    entry.parametersRequested = false;
+    return true;
+}
+
+uint8_t PollScheduler::count() const {
+    return _count;
+}
+
+int8_t PollScheduler::indexOf(uint8_t peripheralID) const {
+    for(uint8_t i = 0; i < _count; ++i){
+        if(_entries[i].controller->peripheralID() == peripheralID) return i;
+    }
+    return -1;
+}
+
+PegoController &PollScheduler::controller(uint8_t index){
+    return *_entries[index].controller;
+}
+
+const ControllerSnapshot &PollScheduler::snapshot(uint8_t index) const {
+    return _entries[index].snapshot;
+}
+
+const ControllerParameters &PollScheduler::parameters(uint8_t index) const {
+    return _entries[index].parameters;
+}
+
+void PollScheduler::requestPoll(uint8_t index){
+    if(index < _count) _entries[index].pollRequested = true;
+}
+
+void PollScheduler::requestParameters(uint8_t index){
+    if(index < _count) _entries[index].parametersRequested = true;
+}
+
+unsigned long PollScheduler::pollCount() const {
+    return _polls;
+}
+
+void PollScheduler::poll(Entry &entry, unsigned long now){
+    ControllerSnapshot snapshot = entry.snapshot;
+    if(entry.controller->readSnapshot(snapshot)){
+        entry.snapshot = snapshot;
+    } else {
+        // Keep serving the last known values, only the responsiveness changes
+        entry.snapshot.responsive = snapshot.responsive;
+    }
+    entry.lastPoll = now;
+    entry.polled = true;
+    entry.pollRequested = false;
+    ++_polls;
+}
+
+void PollScheduler::readParameters(Entry &entry, unsigned long now){
+    ControllerParameters parameters;
+    entry.controller->readParameters(parameters);
+    // A partial read only replaces the blocks that could be read
+    if(parameters.valid & PARAMETERS_BASE_VALID){
+        memcpy(entry.parameters.base, parameters.base, sizeof(parameters.base));
+    }
+    if(parameters.valid & PARAMETERS_EXPERT_VALID){
+        memcpy(entry.parameters.expert, parameters.expert, sizeof(parameters.expert));
+    }
+    if(parameters.valid & PARAMETERS_CONFIGURATION_VALID){
+        memcpy(entry.parameters.configuration, parameters.configuration, sizeof(parameters.configuration));
+    }
+    entry.parameters.valid |= parameters.valid;
+    entry.lastParameterRead = now;
+    entry.parametersRead = true;
+    entry.parametersRequested = false;
+    ++_polls;
+}
+
+int8_t PollScheduler::update(){
+    if(_count == 0) return -1;
+    unsigned long now = millis();
+
+    // The most overdue snapshot wins. Requested and never polled controllers go first.
+    int8_t next = -1;
+    unsigned long nextOverdue = 0;
+    for(uint8_t i = 0; i < _count; ++i){
+        Entry &entry = _entries[i];
+        unsigned long overdue;
+        if(!entry.polled || entry.pollRequested){
+            overdue = ULONG_MAX;
+        } else {
+            unsigned long elapsed = now - entry.lastPoll;
+            if(elapsed < _pollInterval) continue;
+            overdue = elapsed - _pollInterval;
+        }
+        if(next == -1 || overdue > nextOverdue){
+            next = i;
+            nextOverdue = overdue;
+        }
+    }
+    if(next != -1){
+        poll(_entries[next], now);
+        return next;
+    }
+
+    for(uint8_t i = 0; i < _count; ++i){
+        Entry &entry = _entries[i];
+        bool due = _parameterInterval != 0 && (!entry.parametersRead || now - entry.lastParameterRead >= _parameterInterval);
+        if(entry.parametersRequested || due){
+            readParameters(entry, now);
+            return i;
+        }
+    }
+    return -1;
+}
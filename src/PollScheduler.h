@@ -0,0 +1,109 @@
+#ifndef POLL_SCHEDULER_H
+#define POLL_SCHEDULER_H
+
+#include <Arduino.h>
+#include "PegoController.h"
+
+// Amount of controllers a scheduler can serve. Gateways may raise it with a compiler flag.
+#ifndef POLL_SCHEDULER_MAX_CONTROLLERS
+#define POLL_SCHEDULER_MAX_CONTROLLERS 8
+#endif
+
+// Default interval in ms between two snapshots of the same controller
+#define POLL_SCHEDULER_DEFAULT_INTERVAL 5000
+
+// Default interval in ms between two reads of the parameter registers
+#define POLL_SCHEDULER_DEFAULT_PARAMETER_INTERVAL 600000
+
+/**
+ * @brief Keeps a cache of snapshots and parameters of several controllers
+ * sharing one bus fresh with a bounded bus load.
+ * Every call of update() performs at most one poll: the most overdue snapshot,
+ * or a parameter refresh when no snapshot is due. Consumers read the cache
+ * instead of the bus, so their polling rate doesn't affect the bus load.
+ */
+class PollScheduler {
+private:
+    struct Entry {
+        PegoController *controller;
+        ControllerSnapshot snapshot;
+        ControllerParameters parameters;
+        unsigned long lastPoll;
+        unsigned long lastParameterRead;
+        bool polled;
+        bool parametersRead;
+        bool pollRequested;
+        bool parametersRequested;
+    };
+
+    Entry _entries[POLL_SCHEDULER_MAX_CONTROLLERS];
+    uint8_t _count;
+    unsigned long _pollInterval;
+    unsigned long _parameterInterval;
+    unsigned long _polls;
+
+    void poll(Entry &entry, unsigned long now);
+    void readParameters(Entry &entry, unsigned long now);
+
+public:
+    /**
+     * @brief Construct a new Poll Scheduler object
+     * @param pollInterval Interval in ms between two snapshots of the same controller.
+     * @param parameterInterval Interval in ms between two parameter reads of the same controller, 0 to never read them.
+     */
+    PollScheduler(unsigned long pollInterval = POLL_SCHEDULER_DEFAULT_INTERVAL, unsigned long parameterInterval = POLL_SCHEDULER_DEFAULT_PARAMETER_INTERVAL);
+
+    /**
+     * @brief Adds a controller. It is polled as soon as possible.
+     * @return false if the scheduler is full.
+     */
+    bool add(PegoController &controller);
+
+    /**
+     * @brief Amount of controllers added.
+     */
+    uint8_t count() const;
+
+    /**
+     * @brief Returns the index of the controller with the given peripheral ID or -1.
+     */
+    int8_t indexOf(uint8_t peripheralID) const;
+
+    PegoController &controller(uint8_t index);
+
+    /**
+     * @brief The cached snapshot of a controller.
+     * A failed poll keeps the last values but clears snapshot.responsive once
+     * the controller is considered unresponsive.
+     * Check snapshot.valid before using it, it is 0 until the first successful poll.
+     */
+    const ControllerSnapshot &snapshot(uint8_t index) const;
+
+    /**
+     * @brief The cached parameters of a controller. Check parameters.valid before using them.
+     */
+    const ControllerParameters &parameters(uint8_t index) const;
+
+    /**
+     * @brief Polls the snapshot of a controller with the next update(), e.g. after a write.
+     */
+    void requestPoll(uint8_t index);
+
+    /**
+     * @brief Reads the parameters of a controller with the next update() that has no snapshot to take.
+     */
+    void requestParameters(uint8_t index);
+
+    /**
+     * @brief Performs the most urgent poll, if any.
+     * @return The index of the polled controller or -1 if nothing was due.
+     */
+    int8_t update();
+
+    /**
+     * @brief Amount of polls (snapshots and parameter reads) performed since start.
+     */
+    unsigned long pollCount() const;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "PowerManager.h"
+
+#if (defined(ARDUINO_ARCH_SAMD) || defined(ARDUINO_ARCH_NRF52)) && __has_include(<ArduinoLowPower.h>)
+#include <ArduinoLowPower.h>
+#define POWER_MANAGER_HAS_LOW_POWER
+#endif
+
+#if defined(POWER_MANAGER_HAS_LOW_POWER) && defined(ARDUINO_ARCH_SAMD)
+// ArduinoLowPower wakes the SAMD up with the RTC and keeps it configured,
+// this instance only reads the clock
+#include <RTCZero.h>
+#define POWER_MANAGER_HAS_RTC
+static RTCZero rtc;
+#endif
+
+PowerManager::PowerManager(unsigned long baseInterval, unsigned long maxInterval) :
+PowerManager(RS485, baseInterval, maxInterval)
+{}
+
+PowerManager::PowerManager(RS485Class &transceiver, unsigned long baseInterval, unsigned long maxInterval) :
+_transceiver(&transceiver),
+_baseInterval(baseInterval),
+_maxInterval(maxInterval < baseInterval ? baseInterval : maxInterval),
+_batteryLevel(100),
+_alarmActive(false),
+_batteryCapacity(0),
+_awakeCurrent(0),
+_sleepCurrent(0),
+_sleptTotal(0),
+_rtcReference(0),
+_millisReference(0),
+_sleptReference(0),
+_rtcReferenced(false),
+_lastPoll(0),
+_awakeDuration(0),
+_awakeMeasured(false),
+_polledOnce(false)
+{}
+
+void PowerManager::setConsumption(uint16_t capacity, float awakeCurrent, float sleepCurrent){
+    _batteryCapacity = capacity;
+    _awakeCurrent = awakeCurrent;
+    _sleepCurrent = sleepCurrent;
+}
+
+void PowerManager::setBatteryLevel(float percentage){
+    _batteryLevel = constrain(percentage, 0.0f, 100.0f);
+}
+
+void PowerManager::setAlarmActive(bool active){
+    _alarmActive = active;
+}
+
+unsigned long PowerManager::pollInterval() const {
+    if(_alarmActive || _batteryLevel >= POWER_MANAGER_HIGH_BATTERY_LEVEL) return _baseInterval;
+    if(_batteryLevel <= POWER_MANAGER_LOW_BATTERY_LEVEL) return _maxInterval;
+    float drained = (POWER_MANAGER_HIGH_BATTERY_LEVEL - _batteryLevel) / (POWER_MANAGER_HIGH_BATTERY_LEVEL - POWER_MANAGER_LOW_BATTERY_LEVEL);
+    return _baseInterval + (unsigned long)((_maxInterval - _baseInterval) * drained);
+}
+
+unsigned long PowerManager::uptime() const {
+    return millis() + _sleptTotal;
+}
+
+bool PowerManager::pollDue() const {
+    if(!_polledOnce) return true;
+    return uptime() - _lastPoll >= pollInterval();
+}
+
+void PowerManager::startPoll(){
+    _lastPoll = uptime();
+    _polledOnce = true;
+    _awakeMeasured = false;
+}
+
+void PowerManager::sleep(unsigned long duration){
+    // The driver is only enabled while transmitting. Disabling the receiver
+    // as well leaves the transceiver idle. The Modbus client re-enables it on the next request.
+    _transceiver->noReceive();
+    #if defined(POWER_MANAGER_HAS_RTC)
+    if(!_rtcReferenced){
+        if(!rtc.isConfigured()) rtc.begin();
+        _rtcReference = rtc.getEpoch();
+        _millisReference = millis();
+        _sleptReference = _sleptTotal;
+        _rtcReferenced = true;
+    }
+    LowPower.sleep(duration);
+    // The RTC time minus the time millis() saw is what passed asleep. It is
+    // only taken when it grew, so the truncated RTC seconds never make uptime() go back.
+    unsigned long elapsed = (unsigned long)(rtc.getEpoch() - _rtcReference) * 1000;
+    unsigned long awake = millis() - _millisReference;
+    if(elapsed > awake && _sleptReference + (elapsed - awake) > _sleptTotal){
+        _sleptTotal = _sleptReference + (elapsed - awake);
+    }
+    #elif defined(POWER_MANAGER_HAS_LOW_POWER)
+    LowPower.sleep(duration);
+    #else
+    delay(duration);
+    #endif
+    _transceiver->receive();
+}
+
+void PowerManager::sleepUntilNextPoll(){
+    unsigned long now = uptime();
+    if(!_awakeMeasured){
+        _awakeDuration = now - _lastPoll;
+        _awakeMeasured = true;
+    }
+    if(pollDue()) return;
+
+    unsigned long remaining = pollInterval() - (now - _lastPoll);
+    if(remaining > POWER_MANAGER_MAX_SLEEP_DURATION) remaining = POWER_MANAGER_MAX_SLEEP_DURATION;
+    sleep(remaining);
+}
+
+unsigned long PowerManager::estimatedRuntime() const {
+    if(_batteryCapacity == 0 || _awakeCurrent <= 0) return 0;
+    float interval = pollInterval();
+    float awake = _awakeDuration < interval ? _awakeDuration : interval;
+    float averageCurrent = (_awakeCurrent * awake + _sleepCurrent * (interval - awake)) / interval;
+    if(averageCurrent <= 0) return 0;
+    float remainingCapacity = _batteryCapacity * _batteryLevel / 100.0;
+    return (unsigned long)(remainingCapacity / averageCurrent * 60);
+}
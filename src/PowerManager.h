@@ -0,0 +1,136 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoRS485.h>
+
+// Battery level (in %) above which the base poll interval is used
+#define POWER_MANAGER_HIGH_BATTERY_LEVEL 60
+
+// Battery level (in %) at and below which the maximum poll interval is used
+#define POWER_MANAGER_LOW_BATTERY_LEVEL 15
+
+// Longest single sleep in ms. Bounds the time until the MCU checks back in.
+#define POWER_MANAGER_MAX_SLEEP_DURATION 60000
+
+/**
+ * @brief Schedules the controller polls while running on battery.
+ * Between polls the MCU is put to sleep (using ArduinoLowPower if available)
+ * and the RS485 receiver is disabled. The poll interval is stretched linearly
+ * from the base interval to the maximum interval as the battery drains,
+ * except while an alarm is active so that alarm changes are still caught quickly.
+ *
+ * Note: On SAMD boards millis() doesn't advance while sleeping. The time
+ * spent asleep is measured with the RTC, which keeps running, so an early
+ * wake-up by an interrupt is accounted for correctly. On other cores millis()
+ * is expected to keep running (as on nRF52) and nothing is added to it.
+ * Use uptime() for timestamps that need to include the time spent asleep.
+ */
+class PowerManager {
+private:
+    RS485Class *_transceiver;
+    unsigned long _baseInterval;
+    unsigned long _maxInterval;
+
+    // Last known battery level in %
+    float _batteryLevel;
+    bool _alarmActive;
+
+    // Battery capacity in mAh and current consumption in mA
+    uint16_t _batteryCapacity;
+    float _awakeCurrent;
+    float _sleepCurrent;
+
+    // Time spent asleep in ms, not accounted for by millis()
+    unsigned long _sleptTotal;
+
+    // RTC seconds, millis() and _sleptTotal before the first sleep. The slept
+    // time is derived from them on every wake-up, so the error of the one
+    // second RTC resolution doesn't add up.
+    uint32_t _rtcReference;
+    unsigned long _millisReference;
+    unsigned long _sleptReference;
+    bool _rtcReferenced;
+
+    // Time of the last poll and time awake during the last cycle, both in ms
+    unsigned long _lastPoll;
+    unsigned long _awakeDuration;
+    bool _awakeMeasured;
+    bool _polledOnce;
+
+    /**
+     * @brief Sleeps for at most the given duration with the RS485 receiver disabled.
+     */
+    void sleep(unsigned long duration);
+
+public:
+    /**
+     * @brief Construct a new Power Manager object
+     * @param baseInterval The poll interval in ms with a sufficiently charged battery.
+     * @param maxInterval The poll interval in ms with an almost empty battery.
+     */
+    PowerManager(unsigned long baseInterval = 30000, unsigned long maxInterval = 300000);
+
+    /**
+     * @brief Construct a new Power Manager object for a controller on another bus
+     * @param transceiver The RS485 transceiver that is idled while sleeping.
+     * @param baseInterval The poll interval in ms with a sufficiently charged battery.
+     * @param maxInterval The poll interval in ms with an almost empty battery.
+     */
+    PowerManager(RS485Class &transceiver, unsigned long baseInterval = 30000, unsigned long maxInterval = 300000);
+
+    /**
+     * @brief Sets the figures used to estimate the remaining runtime.
+     * @param capacity The battery capacity in mAh.
+     * @param awakeCurrent The average current in mA while awake (MCU, modem, RS485).
+     * @param sleepCurrent The average current in mA while asleep.
+     */
+    void setConsumption(uint16_t capacity, float awakeCurrent, float sleepCurrent);
+
+    /**
+     * @brief Updates the battery level, e.g. with batteryLevel() from the example's battery.h.
+     * @param percentage The battery level in %.
+     */
+    void setBatteryLevel(float percentage);
+
+    /**
+     * @brief Keeps the base poll interval while an alarm is active.
+     * @param active Whether any alarm of the controller is currently active.
+     */
+    void setAlarmActive(bool active);
+
+    /**
+     * @brief The poll interval in ms for the current battery level.
+     */
+    unsigned long pollInterval() const;
+
+    /**
+     * @brief Tells whether the next poll is due.
+     */
+    bool pollDue() const;
+
+    /**
+     * @brief Marks the start of a poll. Call it right before reading from the controller.
+     */
+    void startPoll();
+
+    /**
+     * @brief Sleeps until the next poll is due. Returns early after at most
+     * POWER_MANAGER_MAX_SLEEP_DURATION so the sketch can service other tasks.
+     */
+    void sleepUntilNextPoll();
+
+    /**
+     * @brief Milliseconds since start including the time spent asleep.
+     */
+    unsigned long uptime() const;
+
+    /**
+     * @brief Estimates the remaining runtime on battery in minutes
+     * based on the current battery level and duty cycle.
+     * @return The runtime in minutes or 0 if the consumption wasn't configured.
+     */
+    unsigned long estimatedRuntime() const;
+};
+
+#endif
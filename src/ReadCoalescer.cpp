@@ -0,0 +1,85 @@
+#include "ReadCoalescer.h"
+
+ReadCoalescer::ReadCoalescer(unsigned long window) :
+_window(window),
+_savedRequests(0)
+{
+    clear();
+}
+
+void ReadCoalescer::setWindow(unsigned long window){
+    _window = window;
+    if(window == 0) clear();
+}
+
+unsigned long ReadCoalescer::window() const {
+    return _window;
+}
+
+void ReadCoalescer::clear(){
+    for(uint8_t i = 0; i < READ_COALESCER_SIZE; ++i){
+        _entries[i].used = false;
+    }
+}
+
+ReadCoalescer::Entry *ReadCoalescer::find(uint16_t registerNumber, unsigned long now){
+    for(uint8_t i = 0; i < READ_COALESCER_SIZE; ++i){
+        Entry &entry = _entries[i];
+        if(!entry.used || entry.registerNumber != registerNumber) continue;
+        if(now - entry.timestamp >= _window){
+            entry.used = false;
+            return NULL;
+        }
+        return &entry;
+    }
+    return NULL;
+}
+
+bool ReadCoalescer::lookup(uint16_t registerNumber, uint8_t count, uint16_t *values){
+    if(_window == 0) return false;
+    unsigned long now = millis();
+    for(uint8_t i = 0; i < count; ++i){
+        Entry *entry = find(registerNumber + i, now);
+        if(entry == NULL) return false;
+        values[i] = entry->value;
+    }
+    ++_savedRequests;
+    return true;
+}
+
+ReadCoalescer::Entry *ReadCoalescer::slotFor(uint16_t registerNumber, unsigned long now){
+    // Reuse the slot of the same register, otherwise a free or the oldest one
+    for(uint8_t i = 0; i < READ_COALESCER_SIZE; ++i){
+        if(_entries[i].used && _entries[i].registerNumber == registerNumber) return &_entries[i];
+    }
+    for(uint8_t i = 0; i < READ_COALESCER_SIZE; ++i){
+        if(!_entries[i].used) return &_entries[i];
+    }
+    Entry *oldest = &_entries[0];
+    for(uint8_t i = 1; i < READ_COALESCER_SIZE; ++i){
+        if(now - _entries[i].timestamp > now - oldest->timestamp) oldest = &_entries[i];
+    }
+    return oldest;
+}
+
+void ReadCoalescer::store(uint16_t registerNumber, uint8_t count, const uint16_t *values){
+    if(_window == 0 || count > READ_COALESCER_MAX_BLOCK) return;
+    unsigned long now = millis();
+    for(uint8_t i = 0; i < count; ++i){
+        Entry *slot = slotFor(registerNumber + i, now);
+        slot->registerNumber = registerNumber + i;
+        slot->value = values[i];
+        slot->timestamp = now;
+        slot->used = true;
+    }
+}
+
+void ReadCoalescer::invalidate(uint16_t registerNumber){
+    for(uint8_t i = 0; i < READ_COALESCER_SIZE; ++i){
+        if(_entries[i].registerNumber == registerNumber) _entries[i].used = false;
+    }
+}
+
+unsigned long ReadCoalescer::savedRequests() const {
+    return _savedRequests;
+}
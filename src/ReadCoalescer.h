@@ -0,0 +1,76 @@
+#ifndef READ_COALESCER_H
+#define READ_COALESCER_H
+
+#include <Arduino.h>
+
+// Amount of register values remembered per controller
+#define READ_COALESCER_SIZE 16
+
+// Largest block read whose values are remembered. Larger blocks (e.g. the
+// parameter blocks) would evict everything else.
+#define READ_COALESCER_MAX_BLOCK 4
+
+/**
+ * @brief Remembers recently read register values of one controller so that
+ * reads of the same register within a freshness window share a single
+ * transaction. Several consumers calling the same getters in one loop
+ * iteration then cause one request instead of one per consumer.
+ * A window of 0 disables coalescing.
+ */
+class ReadCoalescer {
+private:
+    struct Entry {
+        uint16_t registerNumber;
+        uint16_t value;
+        unsigned long timestamp;
+        bool used;
+    };
+
+    Entry _entries[READ_COALESCER_SIZE];
+    unsigned long _window;
+    unsigned long _savedRequests;
+
+    Entry *find(uint16_t registerNumber, unsigned long now);
+    Entry *slotFor(uint16_t registerNumber, unsigned long now);
+
+public:
+    ReadCoalescer(unsigned long window = 0);
+
+    /**
+     * @brief Sets the freshness window in ms. 0 disables coalescing and clears the cache.
+     */
+    void setWindow(unsigned long window);
+    unsigned long window() const;
+
+    /**
+     * @brief Looks up fresh values of a block of consecutive registers.
+     * Counts a saved request if all of them are fresh.
+     * @param registerNumber The first register of the block.
+     * @param count The amount of registers.
+     * @param values Receives the raw values.
+     * @return true if all values were fresh.
+     */
+    bool lookup(uint16_t registerNumber, uint8_t count, uint16_t *values);
+
+    /**
+     * @brief Remembers the raw values of a block that was just read.
+     */
+    void store(uint16_t registerNumber, uint8_t count, const uint16_t *values);
+
+    /**
+     * @brief Forgets a register, e.g. because it was written.
+     */
+    void invalidate(uint16_t registerNumber);
+
+    /**
+     * @brief Forgets all registers.
+     */
+    void clear();
+
+    /**
+     * @brief Amount of requests that were answered from a shared result instead of the bus.
+     */
+    unsigned long savedRequests() const;
+};
+
+#endif
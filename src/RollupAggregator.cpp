@@ -0,0 +1,233 @@
+#include "RollupAggregator.h"
+
+static const char *signalNames[ROLLUP_SIGNAL_COUNT] = {
+    "compressor", "defrost", "fans", "coldRoomLight", "dripping",
+    "standBy", "hotResistance", "doorOpen", "alarm"
+};
+
+// Bits of the Output Status Register in the order of RollupSignal
+static const uint8_t outputBits[] = {
+    OUTPUT_STATUS_COMPRESSOR_RELAY_BIT, OUTPUT_STATUS_DEFROST_RELAY_BIT, OUTPUT_STATUS_FANS_RELAY_BIT,
+    OUTPUT_STATUS_COLD_ROOM_LIGHT_RELAY_BIT, OUTPUT_STATUS_DRIPPING_BIT, OUTPUT_STATUS_STAND_BY_BIT,
+    OUTPUT_STATUS_HOT_RESISTANCE_BIT
+};
+
+const char *rollupSignalName(RollupSignal signal){
+    return signal < ROLLUP_SIGNAL_COUNT ? signalNames[signal] : "none";
+}
+
+/**
+ * @brief Packs the state of every RollupSignal into one bit each.
+ */
+static uint16_t signalsOf(const ControllerSnapshot &snapshot){
+    uint16_t signals = 0;
+    for(uint8_t i = 0; i < sizeof(outputBits); ++i){
+        if(bitRead(snapshot.outputStatus, outputBits[i])) bitSet(signals, i);
+    }
+    if(bitRead(snapshot.inputStatus, INPUT_STATUS_DOOR_SWITCH_BIT)) bitSet(signals, ROLLUP_DOOR_OPEN);
+    if(snapshot.alarmStatus != 0) bitSet(signals, ROLLUP_ALARM);
+    return signals;
+}
+
+void RollupTemperature::clear(){
+    count = 0;
+    minimum = READ_ERROR;
+    maximum = READ_ERROR;
+    last = READ_ERROR;
+    sum = 0;
+}
+
+void RollupTemperature::add(int16_t value){
+    if(value == READ_ERROR) return;
+    if(count == 0 || value < minimum) minimum = value;
+    if(count == 0 || value > maximum) maximum = value;
+    last = value;
+    sum += value;
+    ++count;
+}
+
+void RollupTemperature::merge(const RollupTemperature &other){
+    if(other.count == 0) return;
+    if(count == 0 || other.minimum < minimum) minimum = other.minimum;
+    if(count == 0 || other.maximum > maximum) maximum = other.maximum;
+    last = other.last;
+    sum += other.sum;
+    count += other.count;
+}
+
+int16_t RollupTemperature::mean() const {
+    if(count == 0) return READ_ERROR;
+    int32_t divisor = (int32_t)count;
+    // Rounds half away from zero
+    return (int16_t)(sum >= 0 ? (sum + divisor / 2) / divisor : (sum - divisor / 2) / divisor);
+}
+
+void RollupWindow::clear(unsigned long start, unsigned long length){
+    this->start = start;
+    this->length = length;
+    samples = 0;
+    valid = 0;
+    ambientTemperature.clear();
+    evaporatorTemperature.clear();
+    covered = 0;
+    for(uint8_t i = 0; i < ROLLUP_SIGNAL_COUNT; ++i) onTime[i] = 0;
+    outputStatus = 0;
+    inputStatus = 0;
+    alarmStatus = 0;
+    alarmsSeen = 0;
+}
+
+void RollupWindow::merge(const RollupWindow &other){
+    samples += other.samples;
+    valid |= other.valid;
+    ambientTemperature.merge(other.ambientTemperature);
+    evaporatorTemperature.merge(other.evaporatorTemperature);
+    covered += other.covered;
+    for(uint8_t i = 0; i < ROLLUP_SIGNAL_COUNT; ++i) onTime[i] += other.onTime[i];
+    if(other.valid & SNAPSHOT_STATUS_VALID){
+        outputStatus = other.outputStatus;
+        inputStatus = other.inputStatus;
+        alarmStatus = other.alarmStatus;
+    }
+    alarmsSeen |= other.alarmsSeen;
+}
+
+float RollupWindow::onFraction(RollupSignal signal) const {
+    if(signal >= ROLLUP_SIGNAL_COUNT || covered == 0) return NAN;
+    return (float)onTime[signal] / covered;
+}
+
+RollupAggregator::RollupAggregator() :
+_callback(NULL),
+_context(NULL),
+_maxHold(ROLLUP_DEFAULT_MAX_HOLD),
+_started(false),
+_holding(false),
+_heldSignals(0),
+_heldSince(0),
+_integrated(0),
+_emitted(0)
+{
+    _windows[ROLLUP_PERIOD_MINUTE].clear(0, ROLLUP_MINUTE_LENGTH);
+    _windows[ROLLUP_PERIOD_HOUR].clear(0, ROLLUP_HOUR_LENGTH);
+}
+
+void RollupAggregator::setCallback(RollupCallback callback, void *context){
+    _callback = callback;
+    _context = context;
+}
+
+void RollupAggregator::setMaxHold(unsigned long maxHold){
+    _maxHold = maxHold;
+}
+
+void RollupAggregator::emit(const RollupWindow &window, RollupPeriod period){
+    if(window.samples == 0 && window.covered == 0) return;
+    ++_emitted;
+    if(_callback != NULL) _callback(window, period, _context);
+}
+
+void RollupAggregator::integrate(unsigned long until){
+    if(_holding){
+        unsigned long holdEnd = _heldSince + _maxHold;
+        unsigned long end = (long)(until - holdEnd) > 0 ? holdEnd : until;
+        if((long)(end - _integrated) > 0){
+            // Zero-order hold: the signals stayed as read until now
+            unsigned long span = end - _integrated;
+            RollupWindow &minute = _windows[ROLLUP_PERIOD_MINUTE];
+            minute.covered += span;
+            for(uint8_t i = 0; i < ROLLUP_SIGNAL_COUNT; ++i){
+                if(bitRead(_heldSignals, i)) minute.onTime[i] += span;
+            }
+        }
+        if((long)(until - holdEnd) >= 0) _holding = false;
+    }
+    _integrated = until;
+}
+
+void RollupAggregator::closeMinute(){
+    RollupWindow &minute = _windows[ROLLUP_PERIOD_MINUTE];
+    RollupWindow &hour = _windows[ROLLUP_PERIOD_HOUR];
+    unsigned long end = minute.start + minute.length;
+
+    emit(minute, ROLLUP_PERIOD_MINUTE);
+    hour.merge(minute);
+    minute.clear(end, ROLLUP_MINUTE_LENGTH);
+
+    if((long)(end - (hour.start + hour.length)) >= 0){
+        emit(hour, ROLLUP_PERIOD_HOUR);
+        hour.clear(end, ROLLUP_HOUR_LENGTH);
+    }
+}
+
+void RollupAggregator::advance(unsigned long now){
+    RollupWindow &minute = _windows[ROLLUP_PERIOD_MINUTE];
+    RollupWindow &hour = _windows[ROLLUP_PERIOD_HOUR];
+
+    while((long)(now - (minute.start + minute.length)) >= 0){
+        integrate(minute.start + minute.length);
+        closeMinute();
+        if(_holding || (long)(now - (minute.start + minute.length)) < 0) continue;
+
+        // Nothing to account for until now, skip the empty windows in one go
+        if((long)(now - (hour.start + hour.length)) >= 0){
+            emit(hour, ROLLUP_PERIOD_HOUR);
+            hour.clear(hour.start + (now - hour.start) / ROLLUP_HOUR_LENGTH * ROLLUP_HOUR_LENGTH, ROLLUP_HOUR_LENGTH);
+        }
+        minute.clear(minute.start + (now - minute.start) / ROLLUP_MINUTE_LENGTH * ROLLUP_MINUTE_LENGTH, ROLLUP_MINUTE_LENGTH);
+    }
+    integrate(now);
+}
+
+uint8_t RollupAggregator::update(const ControllerSnapshot &snapshot){
+    _emitted = 0;
+    unsigned long now = snapshot.timestamp;
+
+    if(!_started){
+        _windows[ROLLUP_PERIOD_MINUTE].clear(now - now % ROLLUP_MINUTE_LENGTH, ROLLUP_MINUTE_LENGTH);
+        _windows[ROLLUP_PERIOD_HOUR].clear(now - now % ROLLUP_HOUR_LENGTH, ROLLUP_HOUR_LENGTH);
+        _integrated = now;
+        _started = true;
+    } else if((long)(now - _integrated) < 0){
+        // Older than what has been accounted for already
+        return 0;
+    } else {
+        advance(now);
+    }
+
+    RollupWindow &minute = _windows[ROLLUP_PERIOD_MINUTE];
+    ++minute.samples;
+    minute.valid |= snapshot.valid;
+
+    if(snapshot.valid & SNAPSHOT_TEMPERATURES_VALID){
+        minute.ambientTemperature.add(snapshot.ambientTemperature);
+        minute.evaporatorTemperature.add(snapshot.evaporatorTemperature);
+    }
+
+    if(snapshot.valid & SNAPSHOT_STATUS_VALID){
+        minute.outputStatus = snapshot.outputStatus;
+        minute.inputStatus = snapshot.inputStatus;
+        minute.alarmStatus = snapshot.alarmStatus;
+        minute.alarmsSeen |= snapshot.alarmStatus;
+        _heldSignals = signalsOf(snapshot);
+        _heldSince = now;
+        _holding = true;
+    } else {
+        // The status is unknown from now on
+        _holding = false;
+    }
+    return _emitted;
+}
+
+const RollupWindow &RollupAggregator::current(RollupPeriod period) const {
+    if(period >= ROLLUP_PERIOD_COUNT) period = ROLLUP_PERIOD_MINUTE;
+    return _windows[period];
+}
+
+void RollupAggregator::reset(){
+    _started = false;
+    _holding = false;
+    _integrated = 0;
+    _windows[ROLLUP_PERIOD_MINUTE].clear(0, ROLLUP_MINUTE_LENGTH);
+    _windows[ROLLUP_PERIOD_HOUR].clear(0, ROLLUP_HOUR_LENGTH);
+}
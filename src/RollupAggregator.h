@@ -0,0 +1,181 @@
+#ifndef ROLLUP_AGGREGATOR_H
+#define ROLLUP_AGGREGATOR_H
+
+#include <Arduino.h>
+#include "PegoController.h"
+
+// Length of the short and the long window in ms. The long one has to be a multiple of the short one.
+#ifndef ROLLUP_MINUTE_LENGTH
+#define ROLLUP_MINUTE_LENGTH 60000
+#endif
+#ifndef ROLLUP_HOUR_LENGTH
+#define ROLLUP_HOUR_LENGTH 3600000
+#endif
+
+// Default time in ms a status is assumed to last after the snapshot that read it
+#define ROLLUP_DEFAULT_MAX_HOLD 300000
+
+/**
+ * @brief The windows a RollupAggregator produces.
+ */
+enum RollupPeriod : uint8_t {
+    ROLLUP_PERIOD_MINUTE = 0,
+    ROLLUP_PERIOD_HOUR,
+    ROLLUP_PERIOD_COUNT
+};
+
+/**
+ * @brief The status signals whose on-time is tracked.
+ */
+enum RollupSignal : uint8_t {
+    // Output Status Register (1280)
+    ROLLUP_COMPRESSOR = 0,
+    ROLLUP_DEFROST,
+    ROLLUP_FANS,
+    ROLLUP_COLD_ROOM_LIGHT,
+    ROLLUP_DRIPPING,
+    ROLLUP_STAND_BY,
+    ROLLUP_HOT_RESISTANCE,
+    // Input Status Register (1281): door switch open
+    ROLLUP_DOOR_OPEN,
+    // Alarm Status Register (1282): any alarm bit set
+    ROLLUP_ALARM,
+    ROLLUP_SIGNAL_COUNT
+};
+
+/**
+ * @brief Minimum, maximum, mean and last value of a temperature within a window.
+ */
+struct RollupTemperature {
+    // Amount of samples with a value
+    uint32_t count;
+    // In 0.1 °C, READ_ERROR without values
+    int16_t minimum;
+    int16_t maximum;
+    int16_t last;
+    int32_t sum;
+
+    void clear();
+    void add(int16_t value);
+    void merge(const RollupTemperature &other);
+
+    /**
+     * @brief The mean in 0.1 °C, rounded, or READ_ERROR without values.
+     */
+    int16_t mean() const;
+};
+
+/**
+ * @brief The aggregate of one window.
+ */
+struct RollupWindow {
+    // millis() at the start of the window and its length in ms
+    unsigned long start;
+    unsigned long length;
+
+    // Amount of snapshots fed within the window
+    uint32_t samples;
+
+    // Combination of the SNAPSHOT_*_VALID flags of the snapshots within the window
+    uint8_t valid;
+
+    RollupTemperature ambientTemperature;
+    RollupTemperature evaporatorTemperature;
+
+    // Time in ms the status was known and, per RollupSignal, for how much of it the signal was on
+    unsigned long covered;
+    unsigned long onTime[ROLLUP_SIGNAL_COUNT];
+
+    // The last status words read within the window
+    uint16_t outputStatus;
+    uint16_t inputStatus;
+    uint16_t alarmStatus;
+
+    // All alarm bits that were set at some point within the window
+    uint16_t alarmsSeen;
+
+    void clear(unsigned long start, unsigned long length);
+    void merge(const RollupWindow &other);
+
+    /**
+     * @brief The share of the covered time a signal was on, from 0 to 1, or NAN if the status was never read.
+     */
+    float onFraction(RollupSignal signal) const;
+};
+
+/**
+ * @brief Called for every completed window that holds data.
+ * @param window The aggregate, only valid during the call.
+ * @param period Whether it is a minute or an hour.
+ * @param context The context passed to setCallback().
+ */
+typedef void (*RollupCallback)(const RollupWindow &window, RollupPeriod period, void *context);
+
+/**
+ * @brief Condenses the snapshots of a controller into minute and hour aggregates.
+ * An uplink that only needs summaries can send one aggregate per window instead
+ * of every poll, while the minimum and maximum still capture short excursions.
+ * Each snapshot is folded into the open minute as it arrives, and every completed
+ * minute into the open hour, so the memory doesn't depend on the poll interval.
+ * A status is assumed to hold until the next snapshot, but at most for the maximum
+ * hold, and its time is split at the window boundaries. Windows are aligned to
+ * multiples of their length on the millis() clock.
+ */
+class RollupAggregator {
+private:
+    RollupWindow _windows[ROLLUP_PERIOD_COUNT];
+    RollupCallback _callback;
+    void *_context;
+    unsigned long _maxHold;
+    bool _started;
+
+    // The signals of the last snapshot with a valid status, when it was read
+    // and up to when its time has been accounted for
+    bool _holding;
+    uint16_t _heldSignals;
+    unsigned long _heldSince;
+    unsigned long _integrated;
+
+    // Windows emitted by the current update()
+    uint8_t _emitted;
+
+    void emit(const RollupWindow &window, RollupPeriod period);
+    void integrate(unsigned long until);
+    void closeMinute();
+    void advance(unsigned long now);
+
+public:
+    RollupAggregator();
+
+    void setCallback(RollupCallback callback, void *context = NULL);
+
+    /**
+     * @brief Sets for how long in ms a status is assumed to last without a new snapshot.
+     * Should exceed the poll interval. The time after it doesn't count as covered.
+     */
+    void setMaxHold(unsigned long maxHold);
+
+    /**
+     * @brief Feeds a new snapshot, completing the windows that ended before its timestamp.
+     * Temperatures and status are only taken from the valid parts of the snapshot.
+     * @return The amount of windows that were emitted.
+     */
+    uint8_t update(const ControllerSnapshot &snapshot);
+
+    /**
+     * @brief The window that is still open.
+     */
+    const RollupWindow &current(RollupPeriod period) const;
+
+    /**
+     * @brief Drops the open windows, e.g. after the controller was replaced.
+     */
+    void reset();
+};
+
+/**
+ * @brief The name of a signal, e.g. "compressor".
+ */
+const char *rollupSignalName(RollupSignal signal);
+
+#endif
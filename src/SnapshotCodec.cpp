@@ -0,0 +1,208 @@
+#include "SnapshotCodec.h"
+
+static void writeWord(uint8_t *buffer, uint16_t value){
+    buffer[0] = highByte(value);
+    buffer[1] = lowByte(value);
+}
+
+static uint16_t readWord(const uint8_t *buffer){
+    return ((uint16_t)buffer[0] << 8) | buffer[1];
+}
+
+static uint16_t statusWord(const ControllerSnapshot &snapshot){
+    uint16_t word = 0;
+    if(snapshot.valid & SNAPSHOT_STATUS_VALID){
+        word |= snapshot.alarmStatus & 0x3FF;
+        bitSet(word, SNAPSHOT_STATUS_WORD_STATUS_VALID_BIT);
+    }
+    if(snapshot.valid & SNAPSHOT_DEVICE_STATUS_VALID){
+        word |= (snapshot.deviceStatus & 0x07) << SNAPSHOT_STATUS_WORD_DEVICE_STATUS_SHIFT;
+        bitSet(word, SNAPSHOT_STATUS_WORD_DEVICE_STATUS_VALID_BIT);
+    }
+    if(snapshot.responsive) bitSet(word, SNAPSHOT_STATUS_WORD_RESPONSIVE_BIT);
+    return word;
+}
+
+// The low byte of a status register, 0 if the status wasn't read
+static uint8_t statusByte(const ControllerSnapshot &snapshot, uint16_t value){
+    return (snapshot.valid & SNAPSHOT_STATUS_VALID) ? lowByte(value) : 0;
+}
+
+static uint8_t header(uint8_t frameType, uint8_t model){
+    return (SNAPSHOT_CODEC_VERSION << 4) | ((model & SNAPSHOT_HEADER_MODEL_MASK) << SNAPSHOT_HEADER_MODEL_SHIFT) | frameType;
+}
+
+SnapshotEncoder::SnapshotEncoder(uint8_t fullFrameInterval) :
+_sequence(0),
+_referenceSequence(0),
+_hasReference(false),
+_deltasSinceFull(0),
+_fullFrameInterval(fullFrameInterval)
+{}
+
+size_t SnapshotEncoder::encodeFull(const ControllerSnapshot &snapshot, uint8_t *buffer, size_t size){
+    if(size < SNAPSHOT_FULL_FRAME_SIZE) return 0;
+    bool temperaturesValid = snapshot.valid & SNAPSHOT_TEMPERATURES_VALID;
+    buffer[0] = header(SNAPSHOT_FRAME_FULL, snapshot.model);
+    buffer[1] = _sequence;
+    writeWord(buffer + 2, temperaturesValid ? snapshot.ambientTemperature : READ_ERROR);
+    writeWord(buffer + 4, temperaturesValid ? snapshot.evaporatorTemperature : READ_ERROR);
+    buffer[6] = statusByte(snapshot, snapshot.outputStatus);
+    buffer[7] = statusByte(snapshot, snapshot.inputStatus);
+    writeWord(buffer + 8, statusWord(snapshot));
+
+    _reference = snapshot;
+    _referenceSequence = _sequence;
+    _hasReference = true;
+    _deltasSinceFull = 0;
+    ++_sequence;
+    return SNAPSHOT_FULL_FRAME_SIZE;
+}
+
+size_t SnapshotEncoder::encode(const ControllerSnapshot &snapshot, uint8_t *buffer, size_t size){
+    if(!_hasReference || _fullFrameInterval == 0 || _deltasSinceFull >= _fullFrameInterval){
+        return encodeFull(snapshot, buffer, size);
+    }
+    if(size < SNAPSHOT_MAX_FRAME_SIZE) return 0;
+
+    bool temperaturesValid = snapshot.valid & SNAPSHOT_TEMPERATURES_VALID;
+    bool referenceTemperaturesValid = _reference.valid & SNAPSHOT_TEMPERATURES_VALID;
+    int16_t ambientTemperature = temperaturesValid ? snapshot.ambientTemperature : READ_ERROR;
+    int16_t evaporatorTemperature = temperaturesValid ? snapshot.evaporatorTemperature : READ_ERROR;
+    int16_t referenceAmbientTemperature = referenceTemperaturesValid ? _reference.ambientTemperature : READ_ERROR;
+    int16_t referenceEvaporatorTemperature = referenceTemperaturesValid ? _reference.evaporatorTemperature : READ_ERROR;
+    uint16_t word = statusWord(snapshot);
+    // An unread status is flagged in the status word, the bytes of the reference stand
+    bool statusValid = snapshot.valid & SNAPSHOT_STATUS_VALID;
+
+    uint8_t mask = 0;
+    size_t length = SNAPSHOT_DELTA_HEADER_SIZE;
+    if(ambientTemperature != referenceAmbientTemperature){
+        mask |= SNAPSHOT_DELTA_AMBIENT_TEMPERATURE;
+        writeWord(buffer + length, ambientTemperature);
+        length += 2;
+    }
+    if(evaporatorTemperature != referenceEvaporatorTemperature){
+        mask |= SNAPSHOT_DELTA_EVAPORATOR_TEMPERATURE;
+        writeWord(buffer + length, evaporatorTemperature);
+        length += 2;
+    }
+    if(statusValid && lowByte(snapshot.outputStatus) != statusByte(_reference, _reference.outputStatus)){
+        mask |= SNAPSHOT_DELTA_OUTPUT_STATUS;
+        buffer[length++] = lowByte(snapshot.outputStatus);
+    }
+    if(statusValid && lowByte(snapshot.inputStatus) != statusByte(_reference, _reference.inputStatus)){
+        mask |= SNAPSHOT_DELTA_INPUT_STATUS;
+        buffer[length++] = lowByte(snapshot.inputStatus);
+    }
+    if(word != statusWord(_reference)){
+        mask |= SNAPSHOT_DELTA_STATUS_WORD;
+        writeWord(buffer + length, word);
+        length += 2;
+    }
+
+    // Nothing gained over a full frame, which also refreshes the reference
+    if(length >= SNAPSHOT_FULL_FRAME_SIZE){
+        return encodeFull(snapshot, buffer, size);
+    }
+
+    buffer[0] = header(SNAPSHOT_FRAME_DELTA, snapshot.model);
+    buffer[1] = _sequence;
+    buffer[2] = _referenceSequence;
+    buffer[3] = mask;
+    ++_sequence;
+    ++_deltasSinceFull;
+    return length;
+}
+
+void SnapshotEncoder::requestFullFrame(){
+    _hasReference = false;
+}
+
+SnapshotDecoder::SnapshotDecoder() :
+_referenceSequence(0),
+_hasReference(false),
+_lastSequence(0)
+{}
+
+static void applyStatusWord(uint16_t word, ControllerSnapshot &snapshot){
+    snapshot.valid &= SNAPSHOT_TEMPERATURES_VALID;
+    snapshot.alarmStatus = word & 0x3FF;
+    snapshot.deviceStatus = (word >> SNAPSHOT_STATUS_WORD_DEVICE_STATUS_SHIFT) & 0x07;
+    snapshot.responsive = bitRead(word, SNAPSHOT_STATUS_WORD_RESPONSIVE_BIT);
+    if(bitRead(word, SNAPSHOT_STATUS_WORD_STATUS_VALID_BIT)) snapshot.valid |= SNAPSHOT_STATUS_VALID;
+    if(bitRead(word, SNAPSHOT_STATUS_WORD_DEVICE_STATUS_VALID_BIT)) snapshot.valid |= SNAPSHOT_DEVICE_STATUS_VALID;
+}
+
+static void applyTemperatures(ControllerSnapshot &snapshot){
+    if(snapshot.ambientTemperature != READ_ERROR || snapshot.evaporatorTemperature != READ_ERROR){
+        snapshot.valid |= SNAPSHOT_TEMPERATURES_VALID;
+    } else {
+        snapshot.valid &= ~SNAPSHOT_TEMPERATURES_VALID;
+    }
+}
+
+int SnapshotDecoder::decode(const uint8_t *buffer, size_t length, ControllerSnapshot &snapshot){
+    if(length < 2) return SNAPSHOT_DECODE_INVALID_LENGTH;
+    if((buffer[0] >> 4) != SNAPSHOT_CODEC_VERSION) return SNAPSHOT_DECODE_UNSUPPORTED_VERSION;
+    uint8_t frameType = buffer[0] & SNAPSHOT_HEADER_FRAME_TYPE_MASK;
+    uint8_t model = (buffer[0] >> SNAPSHOT_HEADER_MODEL_SHIFT) & SNAPSHOT_HEADER_MODEL_MASK;
+
+    if(frameType == SNAPSHOT_FRAME_FULL){
+        if(length != SNAPSHOT_FULL_FRAME_SIZE) return SNAPSHOT_DECODE_INVALID_LENGTH;
+        unsigned long timestamp = snapshot.timestamp;
+        _reference.timestamp = timestamp;
+        _reference.valid = 0;
+        _reference.model = model;
+        _reference.ambientTemperature = readWord(buffer + 2);
+        _reference.evaporatorTemperature = readWord(buffer + 4);
+        _reference.outputStatus = buffer[6];
+        _reference.inputStatus = buffer[7];
+        applyStatusWord(readWord(buffer + 8), _reference);
+        applyTemperatures(_reference);
+        _referenceSequence = buffer[1];
+        _hasReference = true;
+        _lastSequence = buffer[1];
+        snapshot = _reference;
+        return SNAPSHOT_DECODE_OK;
+    }
+
+    if(frameType != SNAPSHOT_FRAME_DELTA) return SNAPSHOT_DECODE_UNSUPPORTED_VERSION;
+    if(length < SNAPSHOT_DELTA_HEADER_SIZE) return SNAPSHOT_DECODE_INVALID_LENGTH;
+    if(!_hasReference || buffer[2] != _referenceSequence) return SNAPSHOT_DECODE_OUT_OF_SYNC;
+
+    uint8_t mask = buffer[3];
+    size_t expected = SNAPSHOT_DELTA_HEADER_SIZE;
+    if(mask & SNAPSHOT_DELTA_AMBIENT_TEMPERATURE) expected += 2;
+    if(mask & SNAPSHOT_DELTA_EVAPORATOR_TEMPERATURE) expected += 2;
+    if(mask & SNAPSHOT_DELTA_OUTPUT_STATUS) expected += 1;
+    if(mask & SNAPSHOT_DELTA_INPUT_STATUS) expected += 1;
+    if(mask & SNAPSHOT_DELTA_STATUS_WORD) expected += 2;
+    if(length != expected) return SNAPSHOT_DECODE_INVALID_LENGTH;
+
+    unsigned long timestamp = snapshot.timestamp;
+    snapshot = _reference;
+    snapshot.timestamp = timestamp;
+    snapshot.model = model;
+    size_t position = SNAPSHOT_DELTA_HEADER_SIZE;
+    if(mask & SNAPSHOT_DELTA_AMBIENT_TEMPERATURE){
+        snapshot.ambientTemperature = readWord(buffer + position);
+        position += 2;
+    }
+    if(mask & SNAPSHOT_DELTA_EVAPORATOR_TEMPERATURE){
+        snapshot.evaporatorTemperature = readWord(buffer + position);
+        position += 2;
+    }
+    if(mask & SNAPSHOT_DELTA_OUTPUT_STATUS) snapshot.outputStatus = buffer[position++];
+    if(mask & SNAPSHOT_DELTA_INPUT_STATUS) snapshot.inputStatus = buffer[position++];
+    if(mask & SNAPSHOT_DELTA_STATUS_WORD){
+        applyStatusWord(readWord(buffer + position), snapshot);
+    }
+    applyTemperatures(snapshot);
+    _lastSequence = buffer[1];
+    return SNAPSHOT_DECODE_OK;
+}
+
+uint8_t SnapshotDecoder::lastSequence() const {
+    return _lastSequence;
+}
@@ -0,0 +1,154 @@
+#ifndef SNAPSHOT_CODEC_H
+#define SNAPSHOT_CODEC_H
+
+#include <Arduino.h>
+#include "PegoController.h"
+
+/*
+Compact binary encoding of a ControllerSnapshot for LoRaWAN uplinks.
+All multi byte values are big endian.
+
+Full frame (10 bytes):
+  0     Header: version (bits 4..7) | PegoModel (bits 2..3) | frame type SNAPSHOT_FRAME_FULL (bits 0..1)
+  1     Sequence number
+  2..3  Ambient temperature in 0.1 °C (int16, -32768 = unavailable)
+  4..5  Evaporator temperature in 0.1 °C (int16, -32768 = unavailable)
+  6     Output Status Register (1280), LSB, 0 if the status wasn't read
+  7     Input Status Register (1281), LSB, 0 if the status wasn't read
+  8..9  Status word:
+          bits 0..9   Alarm Status Register (1282), bits 0..9
+          bits 10..12 Device Status Register (1536), bits 0..2
+          bit 13      Controller responsive
+          bit 14      Output, input and alarm status valid
+          bit 15      Device status valid
+
+Delta frame (4..12 bytes):
+  0     Header: version | PegoModel | SNAPSHOT_FRAME_DELTA
+  1     Sequence number
+  2     Sequence number of the full frame the delta refers to
+  3     Change mask (SNAPSHOT_DELTA_* flags)
+  4..   The changed fields in the order of the full frame. The output and
+        input status are left out while the status wasn't read.
+
+The model tells how the alarm bits are decoded (see PegoModel.h), as they
+differ between the ECP base and the ECP 202. Encoders that predate it left
+the bits at 0, which decodes as PEGO_MODEL_UNKNOWN.
+
+Deltas always refer to the last full frame, so a lost delta doesn't
+corrupt the following ones. A lost full frame is detected through the
+reference sequence number.
+*/
+
+#define SNAPSHOT_CODEC_VERSION 1
+
+#define SNAPSHOT_FRAME_FULL 0
+#define SNAPSHOT_FRAME_DELTA 1
+
+// Fields of the header byte besides the version
+#define SNAPSHOT_HEADER_FRAME_TYPE_MASK 0x03
+#define SNAPSHOT_HEADER_MODEL_SHIFT 2
+#define SNAPSHOT_HEADER_MODEL_MASK 0x03
+
+#define SNAPSHOT_FULL_FRAME_SIZE 10
+#define SNAPSHOT_DELTA_HEADER_SIZE 4
+#define SNAPSHOT_MAX_FRAME_SIZE 12
+
+// Flags of the delta change mask
+#define SNAPSHOT_DELTA_AMBIENT_TEMPERATURE 0x01
+#define SNAPSHOT_DELTA_EVAPORATOR_TEMPERATURE 0x02
+#define SNAPSHOT_DELTA_OUTPUT_STATUS 0x04
+#define SNAPSHOT_DELTA_INPUT_STATUS 0x08
+#define SNAPSHOT_DELTA_STATUS_WORD 0x10
+
+// Bits of the status word
+#define SNAPSHOT_STATUS_WORD_DEVICE_STATUS_SHIFT 10
+#define SNAPSHOT_STATUS_WORD_RESPONSIVE_BIT 13
+#define SNAPSHOT_STATUS_WORD_STATUS_VALID_BIT 14
+#define SNAPSHOT_STATUS_WORD_DEVICE_STATUS_VALID_BIT 15
+
+// Results of SnapshotDecoder::decode()
+#define SNAPSHOT_DECODE_OK 0
+#define SNAPSHOT_DECODE_INVALID_LENGTH -1
+#define SNAPSHOT_DECODE_UNSUPPORTED_VERSION -2
+#define SNAPSHOT_DECODE_OUT_OF_SYNC -3
+
+/**
+ * @brief Encodes snapshots into full or delta frames.
+ */
+class SnapshotEncoder {
+private:
+    uint8_t _sequence;
+
+    // The snapshot and sequence number of the last full frame
+    ControllerSnapshot _reference;
+    uint8_t _referenceSequence;
+    bool _hasReference;
+
+    uint8_t _deltasSinceFull;
+    uint8_t _fullFrameInterval;
+
+public:
+    /**
+     * @brief Construct a new Snapshot Encoder object
+     * @param fullFrameInterval Send a full frame at least after this many delta frames.
+     * 0 disables delta frames.
+     */
+    SnapshotEncoder(uint8_t fullFrameInterval = 10);
+
+    /**
+     * @brief Encodes a snapshot as a full frame.
+     * @param snapshot The snapshot to encode.
+     * @param buffer Receives the frame.
+     * @param size The size of the buffer, at least SNAPSHOT_FULL_FRAME_SIZE.
+     * @return The amount of bytes written or 0 if the buffer is too small.
+     */
+    size_t encodeFull(const ControllerSnapshot &snapshot, uint8_t *buffer, size_t size);
+
+    /**
+     * @brief Encodes a snapshot as the smallest frame the receiver can decode.
+     * That is a delta frame against the last full frame unless a full frame is due
+     * or the delta wouldn't be smaller.
+     * @param snapshot The snapshot to encode.
+     * @param buffer Receives the frame.
+     * @param size The size of the buffer, at least SNAPSHOT_MAX_FRAME_SIZE.
+     * @return The amount of bytes written or 0 if the buffer is too small.
+     */
+    size_t encode(const ControllerSnapshot &snapshot, uint8_t *buffer, size_t size);
+
+    /**
+     * @brief Forces the next call to encode() to emit a full frame,
+     * e.g. after a (re)join or when the receiver reported being out of sync.
+     */
+    void requestFullFrame();
+};
+
+/**
+ * @brief Decodes full and delta frames back into snapshots.
+ * Meant for gateways and host side tooling.
+ */
+class SnapshotDecoder {
+private:
+    ControllerSnapshot _reference;
+    uint8_t _referenceSequence;
+    bool _hasReference;
+    uint8_t _lastSequence;
+
+public:
+    SnapshotDecoder();
+
+    /**
+     * @brief Decodes a frame.
+     * @param buffer The received frame.
+     * @param length The length of the frame.
+     * @param snapshot Receives the decoded state. The timestamp is left untouched.
+     * @return SNAPSHOT_DECODE_OK or one of the SNAPSHOT_DECODE_* error codes.
+     */
+    int decode(const uint8_t *buffer, size_t length, ControllerSnapshot &snapshot);
+
+    /**
+     * @brief Returns the sequence number of the last decoded frame.
+     */
+    uint8_t lastSequence() const;
+};
+
+#endif
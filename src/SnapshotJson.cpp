@@ -0,0 +1,316 @@
+#include "SnapshotJson.h"
+#include "PegoModel.h"
+
+#define FLASH_STRING(name) reinterpret_cast<const __FlashStringHelper *>(name)
+
+// Names of the status bits indexed by their bit position
+static const char outputStatusNames[][20] PROGMEM = {
+    "compressorRelay", "defrostRelay", "fansRelay", "coldRoomLightRelay",
+    "dripping", "standBy", "hotResistance"
+};
+static const char inputStatusNames[][24] PROGMEM = {
+    "doorSwitch", "compressorProtection", "manInColdRoom", "pumpDown",
+    "remoteStandBy", "remoteStartDefrost", "remoteStopDefrost", "nightInput"
+};
+static const char deviceStatusNames[][16] PROGMEM = {
+    "standByMode", "lightKey", "defrostForcing"
+};
+
+// Alarms in the order of alarmMasks()
+#define ALARM_FIELDS 10
+static const char alarmNames[ALARM_FIELDS][28] PROGMEM = {
+    "ambientProbeFault", "evaporatorProbeFault", "eepromError",
+    "temperatureAlarm", "highTemperatureAlarm", "lowTemperatureAlarm",
+    "openDoorAlarm", "manInRoomAlarm", "compressorProtectionAlarm", "lightAlarm"
+};
+
+static void alarmMasks(const PegoModelDescriptor &descriptor, uint16_t *masks){
+    masks[0] = bit(ALARM_STATUS_AMBIENT_PROBE_FAULT_BIT);
+    masks[1] = bit(ALARM_STATUS_EVAPORATOR_PROBE_FAULT_BIT);
+    masks[2] = bit(ALARM_STATUS_EEPROM_ERROR_BIT);
+    masks[3] = descriptor.temperatureAlarmMask;
+    masks[4] = descriptor.highTemperatureAlarmMask;
+    masks[5] = descriptor.lowTemperatureAlarmMask;
+    masks[6] = descriptor.openDoorAlarmMask;
+    masks[7] = descriptor.manInRoomAlarmMask;
+    masks[8] = descriptor.compressorProtectionAlarmMask;
+    masks[9] = descriptor.lightAlarmMask;
+}
+
+BufferPrint::BufferPrint(char *buffer, size_t size) :
+_buffer(buffer),
+_size(size),
+_length(0),
+_overflow(size == 0)
+{
+    if(size != 0) buffer[0] = '\0';
+}
+
+size_t BufferPrint::write(uint8_t character){
+    // One byte is kept for the terminating zero
+    if(_length + 1 >= _size){
+        _overflow = true;
+        return 0;
+    }
+    _buffer[_length++] = character;
+    _buffer[_length] = '\0';
+    return 1;
+}
+
+size_t BufferPrint::length() const {
+    return _length;
+}
+
+bool BufferPrint::overflow() const {
+    return _overflow;
+}
+
+/**
+ * @brief Counts the bytes passed on to another Print.
+ */
+class CountingPrint : public Print {
+private:
+    Print &_output;
+    size_t _count;
+public:
+    CountingPrint(Print &output) : _output(output), _count(0) {}
+    using Print::write;
+    size_t write(uint8_t character) override {
+        size_t written = _output.write(character);
+        _count += written;
+        return written;
+    }
+    size_t write(const uint8_t *buffer, size_t size) override {
+        size_t written = _output.write(buffer, size);
+        _count += written;
+        return written;
+    }
+    size_t count() const { return _count; }
+};
+
+static void writeKey(Print &output, const __FlashStringHelper *name){
+    output.print(',');
+    output.print('"');
+    output.print(name);
+    output.print(F("\":"));
+}
+
+static void writeBool(Print &output, const __FlashStringHelper *name, bool value){
+    writeKey(output, name);
+    output.print(value ? F("true") : F("false"));
+}
+
+// Writes a value in tenths as a decimal number without floating point math
+static void writeTemperature(Print &output, const __FlashStringHelper *name, int16_t value){
+    writeKey(output, name);
+    if(value == READ_ERROR){
+        output.print(F("null"));
+        return;
+    }
+    long magnitude = value;
+    if(magnitude < 0){
+        output.print('-');
+        magnitude = -magnitude;
+    }
+    output.print(magnitude / 10);
+    output.print('.');
+    output.print(magnitude % 10);
+}
+
+static void writeString(Print &output, const char *text){
+    output.print('"');
+    output.print(text);
+    output.print('"');
+}
+
+SnapshotJsonWriter::SnapshotJsonWriter() :
+_parameters(NULL),
+_controller(NULL),
+_supervisor(NULL),
+_onlyChanged(false),
+_hasReference(false)
+{}
+
+void SnapshotJsonWriter::setOnlyChanged(bool onlyChanged){
+    _onlyChanged = onlyChanged;
+}
+
+void SnapshotJsonWriter::setParameters(const ControllerParameters *parameters){
+    _parameters = parameters;
+}
+
+void SnapshotJsonWriter::setBusHealth(const PegoController *controller, const BusSupervisor *supervisor){
+    _controller = controller;
+    _supervisor = supervisor;
+}
+
+void SnapshotJsonWriter::resetReference(){
+    _hasReference = false;
+}
+
+void SnapshotJsonWriter::serialize(Print &output, const ControllerSnapshot &snapshot) const {
+    bool all = !_onlyChanged || !_hasReference;
+    const ControllerSnapshot &reference = _reference;
+
+    output.print(F("{\"timestamp\":"));
+    output.print(snapshot.timestamp);
+
+    if(all || snapshot.responsive != reference.responsive){
+        writeBool(output, F("responsive"), snapshot.responsive);
+    }
+    const PegoModelDescriptor &descriptor = descriptorForModel((PegoModel)snapshot.model);
+    if(all || snapshot.model != reference.model){
+        writeKey(output, F("model"));
+        if(snapshot.model == PEGO_MODEL_UNKNOWN){
+            output.print(F("null"));
+        } else {
+            writeString(output, descriptor.name);
+        }
+    }
+
+    bool temperaturesValid = snapshot.valid & SNAPSHOT_TEMPERATURES_VALID;
+    bool referenceTemperaturesValid = reference.valid & SNAPSHOT_TEMPERATURES_VALID;
+    int16_t ambientTemperature = temperaturesValid ? snapshot.ambientTemperature : READ_ERROR;
+    int16_t evaporatorTemperature = temperaturesValid ? snapshot.evaporatorTemperature : READ_ERROR;
+    if(all || ambientTemperature != (referenceTemperaturesValid ? reference.ambientTemperature : READ_ERROR)){
+        writeTemperature(output, F("ambientTemperature"), ambientTemperature);
+    }
+    if(all || evaporatorTemperature != (referenceTemperaturesValid ? reference.evaporatorTemperature : READ_ERROR)){
+        writeTemperature(output, F("evaporatorTemperature"), evaporatorTemperature);
+    }
+
+    if(snapshot.valid & SNAPSHOT_STATUS_VALID){
+        bool compare = !all && (reference.valid & SNAPSHOT_STATUS_VALID);
+        for(uint8_t i = 0; i < sizeof(outputStatusNames) / sizeof(outputStatusNames[0]); ++i){
+            if(!bitRead(descriptor.outputStatusMask, i)) continue;
+            bool value = bitRead(snapshot.outputStatus, i);
+            if(compare && value == bitRead(reference.outputStatus, i)) continue;
+            writeBool(output, FLASH_STRING(outputStatusNames[i]), value);
+        }
+        for(uint8_t i = 0; i < sizeof(inputStatusNames) / sizeof(inputStatusNames[0]); ++i){
+            if(!bitRead(descriptor.inputStatusMask, i)) continue;
+            bool value = bitRead(snapshot.inputStatus, i);
+            if(compare && value == bitRead(reference.inputStatus, i)) continue;
+            writeBool(output, FLASH_STRING(inputStatusNames[i]), value);
+        }
+        uint16_t masks[ALARM_FIELDS];
+        alarmMasks(descriptor, masks);
+        for(uint8_t i = 0; i < ALARM_FIELDS; ++i){
+            if(masks[i] == 0) continue;
+            bool value = (snapshot.alarmStatus & masks[i]) != 0;
+            if(compare && value == ((reference.alarmStatus & masks[i]) != 0)) continue;
+            writeBool(output, FLASH_STRING(alarmNames[i]), value);
+        }
+    }
+
+    if(snapshot.valid & SNAPSHOT_DEVICE_STATUS_VALID){
+        bool compare = !all && (reference.valid & SNAPSHOT_DEVICE_STATUS_VALID);
+        for(uint8_t i = 0; i < sizeof(deviceStatusNames) / sizeof(deviceStatusNames[0]); ++i){
+            bool value = bitRead(snapshot.deviceStatus, i);
+            if(compare && value == bitRead(reference.deviceStatus, i)) continue;
+            writeBool(output, FLASH_STRING(deviceStatusNames[i]), value);
+        }
+    }
+
+    if(snapshot.valid & SNAPSHOT_AUXILIARY_VALID){
+        bool changed = all || !(reference.valid & SNAPSHOT_AUXILIARY_VALID) ||
+                       snapshot.auxiliaryStates != reference.auxiliaryStates ||
+                       memcmp(snapshot.auxiliaryLevels, reference.auxiliaryLevels, SNAPSHOT_AUXILIARY_CHANNELS) != 0;
+        if(changed){
+            writeKey(output, F("auxiliaryLevels"));
+            output.print('[');
+            for(uint8_t i = 0; i < SNAPSHOT_AUXILIARY_CHANNELS; ++i){
+                if(i != 0) output.print(',');
+                if(snapshot.auxiliaryLevels[i] == AUXILIARY_LEVEL_UNKNOWN){
+                    output.print(F("null"));
+                } else {
+                    output.print(snapshot.auxiliaryLevels[i]);
+                }
+            }
+            output.print(']');
+            writeKey(output, F("auxiliaryStates"));
+            output.print(snapshot.auxiliaryStates);
+        }
+    }
+
+    if(_parameters != NULL && _parameters->valid != 0){
+        // Parameters are written in the order of the register numbers, only valid blocks
+        static const uint16_t blocks[][2] = {
+            {PARAMETER_BLOCK_CONFIGURATION_FIRST, PARAMETER_BLOCK_CONFIGURATION_COUNT},
+            {PARAMETER_BLOCK_BASE_FIRST, PARAMETER_BLOCK_BASE_COUNT},
+            {PARAMETER_BLOCK_EXPERT_FIRST, PARAMETER_BLOCK_EXPERT_COUNT}
+        };
+        bool opened = false;
+        for(uint8_t block = 0; block < 3; ++block){
+            for(uint16_t registerNumber = blocks[block][0]; registerNumber < blocks[block][0] + blocks[block][1]; ++registerNumber){
+                uint16_t value;
+                if(!_parameters->get(registerNumber, value)) break;
+                uint16_t referenceValue;
+                if(!all && _referenceParameters.get(registerNumber, referenceValue) && referenceValue == value) continue;
+                if(opened){
+                    output.print(',');
+                } else {
+                    writeKey(output, F("parameters"));
+                    output.print('{');
+                    opened = true;
+                }
+                output.print('"');
+                output.print(registerNumber);
+                output.print(F("\":"));
+                output.print(value);
+            }
+        }
+        if(opened) output.print('}');
+    }
+
+    if(_controller != NULL){
+        ModbusErrorKind error = _controller->lastErrorKind();
+        if(all || error != _referenceError){
+            writeKey(output, F("lastBusError"));
+            writeString(output, modbusErrorName(error));
+        }
+        uint16_t unsupportedRegisters = _controller->unsupportedRegisterCount();
+        if(all || unsupportedRegisters != _referenceUnsupportedRegisters){
+            writeKey(output, F("unsupportedRegisters"));
+            output.print(unsupportedRegisters);
+        }
+    }
+    if(_supervisor != NULL){
+        uint16_t recoveries = _supervisor->recoveryCount();
+        if(all || recoveries != _referenceRecoveries){
+            writeKey(output, F("busRecoveries"));
+            output.print(recoveries);
+        }
+    }
+    output.print('}');
+}
+
+void SnapshotJsonWriter::commit(const ControllerSnapshot &snapshot){
+    _reference = snapshot;
+    if(_parameters != NULL){
+        _referenceParameters = *_parameters;
+    } else {
+        _referenceParameters.valid = 0;
+    }
+    if(_controller != NULL){
+        _referenceError = _controller->lastErrorKind();
+        _referenceUnsupportedRegisters = _controller->unsupportedRegisterCount();
+    }
+    if(_supervisor != NULL) _referenceRecoveries = _supervisor->recoveryCount();
+    _hasReference = true;
+}
+
+size_t SnapshotJsonWriter::write(Print &output, const ControllerSnapshot &snapshot){
+    CountingPrint counter(output);
+    serialize(counter, snapshot);
+    commit(snapshot);
+    return counter.count();
+}
+
+size_t SnapshotJsonWriter::write(char *buffer, size_t size, const ControllerSnapshot &snapshot){
+    BufferPrint output(buffer, size);
+    serialize(output, snapshot);
+    if(output.overflow()) return 0;
+    commit(snapshot);
+    return output.length();
+}
@@ -0,0 +1,107 @@
+#ifndef SNAPSHOT_JSON_H
+#define SNAPSHOT_JSON_H
+
+#include <Arduino.h>
+#include "PegoController.h"
+#include "BusSupervisor.h"
+
+// Longest JSON a SnapshotJsonWriter produces, without the terminating zero. The snapshot
+// part adds up the timestamp (13 + digits), responsive (19), model (19), temperatures
+// (29 + 32), output, input and alarm bits (145 + 181 + 255), device status (60),
+// auxiliary values (62) and the closing brace, with every field at its longest.
+#define SNAPSHOT_JSON_TIMESTAMP_DIGITS (sizeof(unsigned long) > 4 ? 20 : 10)
+#define SNAPSHOT_JSON_MAX_SNAPSHOT_LENGTH (816 + SNAPSHOT_JSON_TIMESTAMP_DIGITS)
+// lastBusError (38), unsupportedRegisters (29) and busRecoveries (22)
+#define SNAPSHOT_JSON_MAX_BUS_HEALTH_LENGTH 89
+// "parameters" object with all 38 registers at five digits each
+#define SNAPSHOT_JSON_MAX_PARAMETERS_LENGTH 471
+#define SNAPSHOT_JSON_MAX_LENGTH (SNAPSHOT_JSON_MAX_SNAPSHOT_LENGTH + SNAPSHOT_JSON_MAX_BUS_HEALTH_LENGTH + SNAPSHOT_JSON_MAX_PARAMETERS_LENGTH)
+
+/**
+ * @brief A Print that fills a caller-provided buffer and remembers whether it overflowed.
+ * The content is always zero terminated.
+ */
+class BufferPrint : public Print {
+private:
+    char *_buffer;
+    size_t _size;
+    size_t _length;
+    bool _overflow;
+
+public:
+    BufferPrint(char *buffer, size_t size);
+    using Print::write;
+    size_t write(uint8_t character) override;
+    size_t length() const;
+    bool overflow() const;
+};
+
+/**
+ * @brief Writes a snapshot as a flat JSON object in a single pass, straight to
+ * a Print (Serial, a network client, ...) or into a caller-provided buffer.
+ * Nothing is allocated and all field names are kept in flash.
+ * Temperatures are written in °C with one decimal, status bits as booleans
+ * decoded for the controller model, parameters as raw register values keyed
+ * by their register number, e.g.
+ * {"timestamp":1200,"responsive":true,"model":"ECP 202","ambientTemperature":4.5,...}
+ *
+ * In the only changed mode the timestamp is always written, the other fields
+ * only if they differ from the previously written snapshot.
+ */
+class SnapshotJsonWriter {
+private:
+    const ControllerParameters *_parameters;
+    const PegoController *_controller;
+    const BusSupervisor *_supervisor;
+    bool _onlyChanged;
+
+    // What was written last, compared against in the only changed mode
+    bool _hasReference;
+    ControllerSnapshot _reference;
+    ControllerParameters _referenceParameters;
+    uint16_t _referenceRecoveries;
+    uint8_t _referenceError;
+    uint16_t _referenceUnsupportedRegisters;
+
+    void serialize(Print &output, const ControllerSnapshot &snapshot) const;
+    void commit(const ControllerSnapshot &snapshot);
+
+public:
+    SnapshotJsonWriter();
+
+    /**
+     * @brief Only writes the fields that changed since the last write.
+     */
+    void setOnlyChanged(bool onlyChanged);
+
+    /**
+     * @brief Includes the given parameters. They are read when writing, so keep them alive.
+     */
+    void setParameters(const ControllerParameters *parameters);
+
+    /**
+     * @brief Includes the bus health: the last error of the controller and its unsupported
+     * registers as well as the recoveries of the supervisor. Either may be NULL.
+     */
+    void setBusHealth(const PegoController *controller, const BusSupervisor *supervisor);
+
+    /**
+     * @brief Writes the snapshot to a Print.
+     * @return The amount of bytes written.
+     */
+    size_t write(Print &output, const ControllerSnapshot &snapshot);
+
+    /**
+     * @brief Writes the snapshot into a buffer as a zero terminated string.
+     * @return The length of the JSON or 0 if it didn't fit. In the latter case
+     * the snapshot doesn't count as written for the only changed mode.
+     */
+    size_t write(char *buffer, size_t size, const ControllerSnapshot &snapshot);
+
+    /**
+     * @brief Makes the next write contain all fields.
+     */
+    void resetReference();
+};
+
+#endif
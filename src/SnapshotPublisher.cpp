@@ -0,0 +1,143 @@
+#include "SnapshotPublisher.h"
+
+#define PUBLISH_INDEX_AMBIENT_TEMPERATURE 0
+#define PUBLISH_INDEX_EVAPORATOR_TEMPERATURE 1
+#define PUBLISH_INDEX_STATUS 2
+
+SnapshotPublisher::SnapshotPublisher() :
+_temperaturePolicy({0.5, 0, 60000, 3600000}),
+_statusPolicy({0, 0, 60000, 3600000}),
+_urgentStatusMask(PACKED_ALARM_STATUS_MASK | (1UL << PACKED_RESPONSIVE_BIT)),
+_ambientTemperature(READ_ERROR),
+_evaporatorTemperature(READ_ERROR),
+_packedStatus(0),
+_publishedOnce(0),
+_publishedCount(0),
+_suppressedCount(0)
+{}
+
+void SnapshotPublisher::setTemperaturePolicy(PublishPolicy policy){
+    _temperaturePolicy = policy;
+}
+
+void SnapshotPublisher::setStatusPolicy(PublishPolicy policy){
+    _statusPolicy = policy;
+}
+
+void SnapshotPublisher::setUrgentStatusMask(uint32_t mask){
+    _urgentStatusMask = mask;
+}
+
+uint32_t SnapshotPublisher::packStatus(const ControllerSnapshot &snapshot){
+    uint32_t packed = 0;
+    if(snapshot.valid & SNAPSHOT_STATUS_VALID){
+        packed |= (uint32_t)(snapshot.outputStatus & 0xFF) << PACKED_OUTPUT_STATUS_SHIFT;
+        packed |= (uint32_t)(snapshot.inputStatus & 0xFF) << PACKED_INPUT_STATUS_SHIFT;
+        packed |= (uint32_t)(snapshot.alarmStatus & 0x3FF) << PACKED_ALARM_STATUS_SHIFT;
+    }
+    if(snapshot.valid & SNAPSHOT_DEVICE_STATUS_VALID){
+        packed |= (uint32_t)(snapshot.deviceStatus & 0x07) << PACKED_DEVICE_STATUS_SHIFT;
+    }
+    if(snapshot.responsive) packed |= 1UL << PACKED_RESPONSIVE_BIT;
+    return packed;
+}
+
+bool SnapshotPublisher::temperatureDue(uint8_t index, int16_t published, int16_t current, unsigned long now) const {
+    bool publishedBefore = bitRead(_publishedOnce, index);
+    if(!publishedBefore) return true;
+    unsigned long elapsed = now - _lastPublished[index];
+    if(_temperaturePolicy.maxInterval != 0 && elapsed >= _temperaturePolicy.maxInterval) return true;
+    if(current == published) return false;
+    if(elapsed < _temperaturePolicy.minInterval) return false;
+
+    // A value becoming (un)available is always published
+    if(current == READ_ERROR || published == READ_ERROR) return true;
+
+    // Deadbands are evaluated in deci-degrees
+    float change = abs(current - published);
+    float deadband = _temperaturePolicy.absoluteDeadband * 10;
+    float relative = _temperaturePolicy.relativeDeadband * abs(published);
+    if(relative > deadband) deadband = relative;
+    return change >= deadband;
+}
+
+bool SnapshotPublisher::statusDue(uint32_t current, unsigned long now) const {
+    if(!bitRead(_publishedOnce, PUBLISH_INDEX_STATUS)) return true;
+    unsigned long elapsed = now - _lastPublished[PUBLISH_INDEX_STATUS];
+    if(_statusPolicy.maxInterval != 0 && elapsed >= _statusPolicy.maxInterval) return true;
+    uint32_t changed = current ^ _packedStatus;
+    if(changed == 0) return false;
+    if(changed & _urgentStatusMask) return true;
+    return elapsed >= _statusPolicy.minInterval;
+}
+
+uint8_t SnapshotPublisher::update(const ControllerSnapshot &snapshot){
+    uint8_t publish = 0;
+    unsigned long now = snapshot.timestamp;
+
+    if(snapshot.valid & SNAPSHOT_TEMPERATURES_VALID){
+        if(temperatureDue(PUBLISH_INDEX_AMBIENT_TEMPERATURE, _ambientTemperature, snapshot.ambientTemperature, now)){
+            _ambientTemperature = snapshot.ambientTemperature;
+            _lastPublished[PUBLISH_INDEX_AMBIENT_TEMPERATURE] = now;
+            bitSet(_publishedOnce, PUBLISH_INDEX_AMBIENT_TEMPERATURE);
+            publish |= PUBLISH_AMBIENT_TEMPERATURE;
+        } else if(snapshot.ambientTemperature != _ambientTemperature){
+            ++_suppressedCount;
+        }
+
+        if(temperatureDue(PUBLISH_INDEX_EVAPORATOR_TEMPERATURE, _evaporatorTemperature, snapshot.evaporatorTemperature, now)){
+            _evaporatorTemperature = snapshot.evaporatorTemperature;
+            _lastPublished[PUBLISH_INDEX_EVAPORATOR_TEMPERATURE] = now;
+            bitSet(_publishedOnce, PUBLISH_INDEX_EVAPORATOR_TEMPERATURE);
+            publish |= PUBLISH_EVAPORATOR_TEMPERATURE;
+        } else if(snapshot.evaporatorTemperature != _evaporatorTemperature){
+            ++_suppressedCount;
+        }
+    }
+
+    // A failed status read keeps the previously known bits but still reflects responsiveness
+    uint32_t packedStatus = packStatus(snapshot);
+    if(!(snapshot.valid & SNAPSHOT_STATUS_VALID)){
+        uint32_t statusBits = (0xFFUL << PACKED_OUTPUT_STATUS_SHIFT) | (0xFFUL << PACKED_INPUT_STATUS_SHIFT) | PACKED_ALARM_STATUS_MASK;
+        packedStatus |= _packedStatus & statusBits;
+    }
+    if(!(snapshot.valid & SNAPSHOT_DEVICE_STATUS_VALID)){
+        packedStatus |= _packedStatus & (0x07UL << PACKED_DEVICE_STATUS_SHIFT);
+    }
+
+    if(statusDue(packedStatus, now)){
+        _packedStatus = packedStatus;
+        _lastPublished[PUBLISH_INDEX_STATUS] = now;
+        bitSet(_publishedOnce, PUBLISH_INDEX_STATUS);
+        publish |= PUBLISH_STATUS;
+    } else if(packedStatus != _packedStatus){
+        ++_suppressedCount;
+    }
+
+    if(publish & PUBLISH_AMBIENT_TEMPERATURE) ++_publishedCount;
+    if(publish & PUBLISH_EVAPORATOR_TEMPERATURE) ++_publishedCount;
+    if(publish & PUBLISH_STATUS) ++_publishedCount;
+    return publish;
+}
+
+float SnapshotPublisher::ambientTemperature() const {
+    if(_ambientTemperature == READ_ERROR) return READ_ERROR_FLOAT;
+    return _ambientTemperature / 10.0;
+}
+
+float SnapshotPublisher::evaporatorTemperature() const {
+    if(_evaporatorTemperature == READ_ERROR) return READ_ERROR_FLOAT;
+    return _evaporatorTemperature / 10.0;
+}
+
+uint32_t SnapshotPublisher::packedStatus() const {
+    return _packedStatus;
+}
+
+uint32_t SnapshotPublisher::publishedCount() const {
+    return _publishedCount;
+}
+
+uint32_t SnapshotPublisher::suppressedCount() const {
+    return _suppressedCount;
+}
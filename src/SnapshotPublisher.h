@@ -0,0 +1,130 @@
+#ifndef SNAPSHOT_PUBLISHER_H
+#define SNAPSHOT_PUBLISHER_H
+
+#include <Arduino.h>
+#include "PegoController.h"
+
+// Flags returned by SnapshotPublisher::update() telling which values have to be published
+#define PUBLISH_AMBIENT_TEMPERATURE 0x01
+#define PUBLISH_EVAPORATOR_TEMPERATURE 0x02
+#define PUBLISH_STATUS 0x04
+
+/*
+Layout of the packed status word. All status registers only use a few bits
+so that they fit into a single integer cloud property.
+- Bits 0..7: Output Status Register (1280), LSB
+- Bits 8..15: Input Status Register (1281), LSB
+- Bits 16..25: Alarm Status Register (1282), bits 0..9
+- Bits 26..28: Device Status Register (1536), bits 0..2
+- Bit 29: Controller responsive
+*/
+#define PACKED_OUTPUT_STATUS_SHIFT 0
+#define PACKED_INPUT_STATUS_SHIFT 8
+#define PACKED_ALARM_STATUS_SHIFT 16
+#define PACKED_DEVICE_STATUS_SHIFT 26
+#define PACKED_RESPONSIVE_BIT 29
+
+#define PACKED_ALARM_STATUS_MASK (0x3FFUL << PACKED_ALARM_STATUS_SHIFT)
+
+/**
+ * @brief Describes when a value is worth publishing.
+ */
+struct PublishPolicy {
+    // Minimum absolute change (in °C for temperatures). 0 publishes every change.
+    float absoluteDeadband;
+    // Minimum change relative to the last published value (0.05 = 5%). 0 disables it.
+    float relativeDeadband;
+    // Minimum time between two publications in ms
+    unsigned long minInterval;
+    // Publish at least this often (in ms) even without changes. 0 disables the heartbeat.
+    unsigned long maxInterval;
+};
+
+/**
+ * @brief Sits between the controller snapshots and the cloud properties and
+ * decides which values actually have to be sent.
+ * All status bits are packed into one integer instead of one property per bit.
+ * Temperatures are filtered through a deadband and every value is rate limited.
+ * Changes of urgent status bits (alarms and responsiveness by default) are never delayed.
+ */
+class SnapshotPublisher {
+private:
+    PublishPolicy _temperaturePolicy;
+    PublishPolicy _statusPolicy;
+    uint32_t _urgentStatusMask;
+
+    // The last published values
+    int16_t _ambientTemperature;
+    int16_t _evaporatorTemperature;
+    uint32_t _packedStatus;
+
+    // Time of the last publication per value, indexed by bit position of the PUBLISH_* flags
+    unsigned long _lastPublished[3];
+    uint8_t _publishedOnce;
+
+    uint32_t _publishedCount;
+    uint32_t _suppressedCount;
+
+    bool temperatureDue(uint8_t index, int16_t published, int16_t current, unsigned long now) const;
+    bool statusDue(uint32_t current, unsigned long now) const;
+
+public:
+    SnapshotPublisher();
+
+    /**
+     * @brief Sets the policy for both temperatures.
+     * Default: 0.5 °C absolute deadband, at most once a minute, at least once an hour.
+     */
+    void setTemperaturePolicy(PublishPolicy policy);
+
+    /**
+     * @brief Sets the policy for the packed status word. The deadbands are ignored.
+     * Default: at most once a minute for non urgent bits, at least once an hour.
+     */
+    void setStatusPolicy(PublishPolicy policy);
+
+    /**
+     * @brief Sets the bits of the packed status word whose changes bypass the minimum interval.
+     * Default: all alarm bits and the responsive bit.
+     */
+    void setUrgentStatusMask(uint32_t mask);
+
+    /**
+     * @brief Processes a new snapshot.
+     * @param snapshot The snapshot as read from the controller.
+     * @return A combination of PUBLISH_* flags for the values that changed and have to be published.
+     */
+    uint8_t update(const ControllerSnapshot &snapshot);
+
+    /**
+     * @brief The last published ambient temperature in °C or READ_ERROR_FLOAT if unknown.
+     */
+    float ambientTemperature() const;
+
+    /**
+     * @brief The last published evaporator temperature in °C or READ_ERROR_FLOAT if unknown.
+     */
+    float evaporatorTemperature() const;
+
+    /**
+     * @brief The last published packed status word. See PACKED_* for the layout.
+     */
+    uint32_t packedStatus() const;
+
+    /**
+     * @brief Packs the status registers of a snapshot into a single word.
+     */
+    static uint32_t packStatus(const ControllerSnapshot &snapshot);
+
+    /**
+     * @brief Amount of values that were published since the start.
+     */
+    uint32_t publishedCount() const;
+
+    /**
+     * @brief Amount of value changes that were held back by a deadband or interval.
+     */
+    uint32_t suppressedCount() const;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef STATUS_BITS_H
+#define STATUS_BITS_H
+
+/*
+Bit positions inside the status registers (1280, 1281, 1282, 1536).
+Bit 0 is the least significant bit of the register word, bits 8..15 are the
+most significant byte. Use them together with bitRead() on the raw register
+value, e.g. bitRead(outputStatus, OUTPUT_STATUS_DEFROST_RELAY_BIT).
+Some bits differ between the models. PegoModelDescriptor (see PegoModel.h)
+tells which of them apply to a given controller.
+*/
+
+// # Output Status Register (1280)
+#define OUTPUT_STATUS_COMPRESSOR_RELAY_BIT 0
+#define OUTPUT_STATUS_DEFROST_RELAY_BIT 1
+#define OUTPUT_STATUS_FANS_RELAY_BIT 2
+#define OUTPUT_STATUS_COLD_ROOM_LIGHT_RELAY_BIT 3
+#define OUTPUT_STATUS_DRIPPING_BIT 4
+#define OUTPUT_STATUS_STAND_BY_BIT 5 // ECP 202 only
+#define OUTPUT_STATUS_HOT_RESISTANCE_BIT 6 // ECP 202 only
+
+// # Input Status Register (1281)
+#define INPUT_STATUS_DOOR_SWITCH_BIT 0
+#define INPUT_STATUS_COMPRESSOR_PROTECTION_BIT 1
+#define INPUT_STATUS_MAN_IN_COLD_ROOM_ALARM_BIT 2
+#define INPUT_STATUS_PUMP_DOWN_BIT 3 // ECP 202 only
+#define INPUT_STATUS_REMOTE_STAND_BY_BIT 4 // ECP 202 only
+#define INPUT_STATUS_REMOTE_START_DEFROST_BIT 5 // ECP 202 only
+#define INPUT_STATUS_REMOTE_STOP_DEFROST_BIT 6 // ECP 202 only
+#define INPUT_STATUS_NIGHT_DIGITAL_INPUT_BIT 7 // ECP 202 only
+
+// # Alarm Status Register (1282)
+#define ALARM_STATUS_AMBIENT_PROBE_FAULT_BIT 0
+#define ALARM_STATUS_EVAPORATOR_PROBE_FAULT_BIT 1
+#define ALARM_STATUS_EEPROM_ERROR_BIT 2
+#define ALARM_STATUS_HIGH_TEMPERATURE_BIT 4 // ECP 202 only
+#define ALARM_STATUS_LOW_TEMPERATURE_BIT 5 // ECP 202 only
+#define ALARM_STATUS_OPEN_DOOR_BIT 6 // ECP 202 only
+#define ALARM_STATUS_MAN_IN_ROOM_BIT 7 // ECP 202 only
+#define ALARM_STATUS_COMPRESSOR_PROTECTION_BIT 8 // ECP 202 only, MSB bit 0
+#define ALARM_STATUS_LIGHT_BIT 9 // ECP 202 only, MSB bit 1
+#define ALARM_STATUS_ECP_BASE_TEMPERATURE_BIT 3 // ECP base only
+#define ALARM_STATUS_ECP_BASE_OPEN_DOOR_BIT 4 // ECP base only
+
+// # Device Status Register (1536)
+// When writing, the matching bit of the MSB (bit + 8) selects which flag is changed.
+#define DEVICE_STATUS_REGISTER 1536
+#define DEVICE_STATUS_STAND_BY_BIT 0
+#define DEVICE_STATUS_COLD_ROOM_LIGHT_KEY_BIT 1
+#define DEVICE_STATUS_DEFROST_FORCING_BIT 2
+
+#endif
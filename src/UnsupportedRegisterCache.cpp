@@ -0,0 +1,74 @@
+#include "UnsupportedRegisterCache.h"
+
+UnsupportedRegisterCache::UnsupportedRegisterCache(){
+    clear();
+}
+
+void UnsupportedRegisterCache::remove(uint8_t index){
+    // Keeps the remaining ranges in insertion order, _next points past the newest one
+    uint8_t oldest = (_next + UNSUPPORTED_REGISTER_CACHE_SIZE - _count) % UNSUPPORTED_REGISTER_CACHE_SIZE;
+    for(uint8_t i = index; i != oldest; i = (i + UNSUPPORTED_REGISTER_CACHE_SIZE - 1) % UNSUPPORTED_REGISTER_CACHE_SIZE){
+        _ranges[i] = _ranges[(i + UNSUPPORTED_REGISTER_CACHE_SIZE - 1) % UNSUPPORTED_REGISTER_CACHE_SIZE];
+    }
+    --_count;
+}
+
+void UnsupportedRegisterCache::add(uint16_t registerNumber){
+    if(contains(registerNumber)) return;
+
+    // Extend a range that ends right before or starts right after the register
+    int16_t below = -1;
+    int16_t above = -1;
+    for(uint8_t i = 0; i < _count; ++i){
+        uint8_t index = (_next + UNSUPPORTED_REGISTER_CACHE_SIZE - 1 - i) % UNSUPPORTED_REGISTER_CACHE_SIZE;
+        if(registerNumber > 0 && _ranges[index].last == registerNumber - 1) below = index;
+        if(registerNumber < UINT16_MAX && _ranges[index].first == registerNumber + 1) above = index;
+    }
+    if(below >= 0 && above >= 0){
+        // The register closes the gap between two ranges
+        _ranges[below].last = _ranges[above].last;
+        remove(above);
+        return;
+    }
+    if(below >= 0){
+        _ranges[below].last = registerNumber;
+        return;
+    }
+    if(above >= 0){
+        _ranges[above].first = registerNumber;
+        return;
+    }
+
+    _ranges[_next].first = registerNumber;
+    _ranges[_next].last = registerNumber;
+    _next = (_next + 1) % UNSUPPORTED_REGISTER_CACHE_SIZE;
+    if(_count < UNSUPPORTED_REGISTER_CACHE_SIZE) ++_count;
+}
+
+bool UnsupportedRegisterCache::contains(uint16_t registerNumber) const {
+    return containsAny(registerNumber, 1);
+}
+
+bool UnsupportedRegisterCache::containsAny(uint16_t registerNumber, uint8_t count) const {
+    if(count == 0) return false;
+    uint32_t last = (uint32_t)registerNumber + count - 1;
+    for(uint8_t i = 0; i < _count; ++i){
+        uint8_t index = (_next + UNSUPPORTED_REGISTER_CACHE_SIZE - 1 - i) % UNSUPPORTED_REGISTER_CACHE_SIZE;
+        if(_ranges[index].first <= last && _ranges[index].last >= registerNumber) return true;
+    }
+    return false;
+}
+
+void UnsupportedRegisterCache::clear(){
+    _count = 0;
+    _next = 0;
+}
+
+uint16_t UnsupportedRegisterCache::count() const {
+    uint16_t registers = 0;
+    for(uint8_t i = 0; i < _count; ++i){
+        uint8_t index = (_next + UNSUPPORTED_REGISTER_CACHE_SIZE - 1 - i) % UNSUPPORTED_REGISTER_CACHE_SIZE;
+        registers += _ranges[index].last - _ranges[index].first + 1;
+    }
+    return registers;
+}
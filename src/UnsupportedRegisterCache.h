@@ -0,0 +1,48 @@
+#ifndef UNSUPPORTED_REGISTER_CACHE_H
+#define UNSUPPORTED_REGISTER_CACHE_H
+
+#include <Arduino.h>
+
+// Amount of ranges of consecutive unsupported registers remembered per controller.
+// An ECP base lacks two: the parameters 789..798 and the configuration 512..518.
+#define UNSUPPORTED_REGISTER_CACHE_SIZE 16
+
+/**
+ * @brief Remembers the registers a controller answered with an
+ * "illegal data address" exception, so they are never requested again.
+ * Consecutive registers share one entry, as the missing registers of a model
+ * come in blocks. When the cache is full the oldest entry is forgotten.
+ */
+class UnsupportedRegisterCache {
+private:
+    struct Range {
+        uint16_t first;
+        uint16_t last;
+    };
+
+    Range _ranges[UNSUPPORTED_REGISTER_CACHE_SIZE];
+    uint8_t _count;
+    uint8_t _next;
+
+    void remove(uint8_t index);
+
+public:
+    UnsupportedRegisterCache();
+
+    void add(uint16_t registerNumber);
+    bool contains(uint16_t registerNumber) const;
+
+    /**
+     * @brief Tells whether any register of a block is unsupported.
+     */
+    bool containsAny(uint16_t registerNumber, uint8_t count) const;
+
+    void clear();
+
+    /**
+     * @brief Amount of registers remembered.
+     */
+    uint16_t count() const;
+};
+
+#endif